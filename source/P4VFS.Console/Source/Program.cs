@@ -144,7 +144,7 @@ Available commands:
   hydrate     Synonym for 'resident -r'
   dehydrate   Synonym for 'resident -v'
 
-              p4vfs resident [-r -v -x <csx> -p <reg>] [file ...]
+              p4vfs resident [-r -v -x <csx> -p <reg> -b <count>] [file ...]
 
    -n         Flag previews the operation without updating the workspace.
    -r         Change file status to resident state (full downloaded size). Default.
@@ -156,6 +156,9 @@ Available commands:
               the service using a TCP Socket connection. (default behaviour)
    -x <csx>   Specify a string of comma separated file extensions to operate on.
    -p <reg>   Specify a regular expression string to match files to operate on.
+   -b <count> Hydrate files directly from p4vfs.exe in batches of <count> files,
+              each printed by a single command, instead of opening each file for
+              the service to hydrate. Overrides the HydratePrintBatchSize setting.
 "},
 
 {"reconfig", @"
@@ -228,11 +231,14 @@ Available commands:
 {"ctrl", @"
   ctrl        Perform administrative and debugging operations on P4VFS driver
 
-              p4vfs ctrl [-dc] [-dv] [-sv] [-f <name>=<value>]
+              p4vfs ctrl [-dc] [-dv] [-sv] [-t] [-tr] [-f <name>=<value>]
 
    -dc        Print the current connectivity state of the driver
    -dv        Print the current driver version
    -sv        Print the current service version
+   -t         Print the command telemetry of the service as JSON. Recorded
+              only while the DepotClientTelemetry setting is enabled
+   -tr        Print the command telemetry of the service and then reset it
    -f <v>     Set experimental driver flag by <name>=<value>. Examples include:
 
               p4vfs ctrl -f SanitizeAttributes=1
@@ -719,6 +725,7 @@ Available commands:
 			DepotSyncMethod syncMethod = DepotSyncMethod.Regular;
 			DepotSyncFlags syncFlags = SettingManager.SyncDefaultQuiet ? DepotSyncFlags.Quiet : DepotSyncFlags.Normal;
 			string syncResident = null;
+			int hydratePrintBatchSize = 0;
 
 			int argIndex = 0;
 			for (; argIndex < args.Length; ++argIndex)
@@ -759,6 +766,14 @@ Available commands:
 				{
 					syncFlags &= ~DepotSyncFlags.Quiet;
 				}
+				else if (String.Compare(args[argIndex], "-b") == 0 && argIndex+1 < args.Length)
+				{
+					if (Int32.TryParse(args[++argIndex], out hydratePrintBatchSize) == false || hydratePrintBatchSize < 2)
+					{
+						VirtualFileSystemLog.Error("Invalid hydrate batch size specified: {0}", args[argIndex]);
+						return false;
+					}
+				}
 				else
 				{
 					break;
@@ -813,6 +828,11 @@ Available commands:
 					syncOptions.SyncFlags = syncFlags;
 					syncOptions.SyncResident = syncResident;
 
+					if (hydratePrintBatchSize > 0)
+					{
+						SettingManager.HydratePrintBatchSize = hydratePrintBatchSize;
+					}
+
 					VirtualFileSystemLog.Verbose("Hydrating files ...");
 					DepotSyncStatus status = DepotOperations.Hydrate(depotClient, syncOptions)?.Status ?? DepotSyncStatus.Success;
 					return status == DepotSyncStatus.Success;
@@ -1216,6 +1236,17 @@ Available commands:
 					{
 						VirtualFileSystemLog.Info("{0} Version: {1}", VirtualFileSystem.ServiceTitle, VirtualFileSystem.GetServiceVersion());
 					}
+					else if (String.Compare(args[argIndex], "-t") == 0 || String.Compare(args[argIndex], "-tr") == 0)
+					{
+						Extensions.SocketModel.SocketModelClient serviceClient = new Extensions.SocketModel.SocketModelClient();
+						string telemetry = serviceClient.GetCommandTelemetry(String.Compare(args[argIndex], "-tr") == 0);
+						if (telemetry == null)
+						{
+							VirtualFileSystemLog.Error("CommandControl failed to get command telemetry");
+							return false;
+						}
+						VirtualFileSystemLog.Info("CommandTelemetry: {0}", telemetry);
+					}
 					else if (String.Compare(args[argIndex], "-f") == 0 && argIndex+1 < args.Length)
 					{
 						Match m = Regex.Match(args[++argIndex], @"(?<name>\S+)\s*=\s*(?<value>\d+)");
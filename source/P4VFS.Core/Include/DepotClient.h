@@ -18,6 +18,20 @@ namespace P4 {
 	typedef std::function<void(LogChannel::Enum channel, const char* severity, const char* text)> FDepotClientLogCallback;
 	typedef std::shared_ptr<FDepotClientLogCallback> DepotClientLogCallback;
 
+	// Sends a batch of commands a window at a time, waiting for the replies to each window only after all of its commands
+	// have been sent. The results are completed in the order of the commands once the replies to their window arrive.
+	struct DepotCommandPipeline
+	{
+		// Sends a command without waiting for its reply
+		typedef std::function<void(const DepotCommand& cmd, FDepotResult& result)> SendCommand;
+
+		// Waits for the replies to all of the commands sent since the previous wait
+		typedef std::function<void()> WaitCommand;
+
+		P4VFS_CORE_API static void Run(const Array<DepotCommand>& cmds, const Array<FDepotResult*>& results, size_t depth, const SendCommand& send, const WaitCommand& wait);
+		P4VFS_CORE_API static size_t GetDefaultDepth();
+	};
+
 	struct FDepotClient
 	{
 		P4VFS_CORE_API FDepotClient(FileContext* context = nullptr);
@@ -63,6 +77,13 @@ namespace P4 {
 
 		template <typename Result = DepotResult>
 		Result Run(const DepotString& name, const DepotStringArray& args = DepotStringArray());
+
+		// Runs the commands pipelined on this connection, so that a batch of small commands costs a round trip for each
+		// DepotClientPipelineDepth commands instead of one for every command
+		P4VFS_CORE_API void RunBatch(const Array<DepotCommand>& cmds, const Array<FDepotResult*>& results);
+
+		template <typename Result = DepotResult>
+		Array<Result> RunBatch(const Array<DepotCommand>& cmds);
 	
 		virtual void OnErrorPause(const char* message);
 		virtual void OnErrorCallback(LogChannel::Enum channel, const char* severity, const char* text);
@@ -104,6 +125,8 @@ namespace P4 {
 		bool LoginUsingClientOwner();
 		bool LoginUsingInteractiveSession();
 		bool RequestInteractivePassword(DepotString& passwd);
+		void SetCommandArgs(const DepotCommand& cmd);
+		void InvalidateConnectionCache(const FDepotResult& result);
 
 	private:
 		struct Api;
@@ -125,6 +148,22 @@ namespace P4 {
 		return Run<Result>(DepotCommand(name, args));
 	}
 
+	template <typename Result>
+	Array<Result> FDepotClient::RunBatch(const Array<DepotCommand>& cmds)
+	{
+		Array<Result> results;
+		Array<FDepotResult*> resultPtrs;
+		results.reserve(cmds.size());
+		resultPtrs.reserve(cmds.size());
+		for (size_t cmdIndex = 0; cmdIndex < cmds.size(); ++cmdIndex)
+		{
+			results.push_back(MakeResult<Result>());
+			resultPtrs.push_back(results.back().get());
+		}
+		RunBatch(cmds, resultPtrs);
+		return results;
+	}
+
 	DEFINE_ENUM_FLAG_OPERATORS(FDepotClient::Flags::Enum);
 
 	struct DepotInfo
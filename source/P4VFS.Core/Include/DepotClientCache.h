@@ -8,28 +8,71 @@ namespace Microsoft {
 namespace P4VFS {
 namespace P4 {
 
+	// Pools idle clients by port, user and client. Each key has a pool with its own lock, and a new client is connected
+	// without holding any lock, so that a slow connection to one server does not hold back allocations for any other.
+	// Idle clients are validated by Maintain, which also keeps each recently used key with at least
+	// DepotClientCacheWarmCount idle clients connected ahead of time, and are checked again without a round trip to the
+	// server when they are allocated.
 	class P4VFS_CORE_API DepotClientCache
 	{
 	public:
+		// Connects a new client with a config, returning false if a connection could not be made
+		typedef std::function<bool(FDepotClient& client, const DepotConfig& config)> ConnectCommand;
+
+		// Returns true if an idle client can still be allocated
+		typedef std::function<bool(FDepotClient& client, int64_t timeoutSeconds)> ValidateCommand;
+
 		DepotClientCache();
 		~DepotClientCache();
 
 		DepotClient Alloc(const DepotConfig& config, FileContext& fileContext);
+
+		// Allocates a valid idle client without connecting a new one or counting as a use of the key, returning null if
+		// there is no valid idle client for the key
+		DepotClient AllocIdle(const DepotConfig& config, FileContext& fileContext);
 		void Free(const DepotConfig& config, DepotClient client);
 		void Clear();
 		void GarbageCollect(int64_t timeoutSeconds);
-		
+
+		// Discards the idle clients which fail validation, and then connects idle clients up to warmCount for each key
+		// which has been allocated within timeoutSeconds
+		void Maintain(size_t warmCount, int64_t timeoutSeconds);
+
+		// Starts a thread which calls Maintain every DepotClientCachePeriodMs until Stop is called
+		bool Start();
+		void Stop();
+
+		void SetConnectCommand(const ConnectCommand& connectCommand);
+		void SetValidateCommand(const ValidateCommand& validateCommand);
+
 		size_t GetFreeCount() const;
+		size_t GetFreeCount(const DepotConfig& config) const;
+		size_t GetPoolCount() const;
 		static int64_t GetIdleTimeoutSeconds();
+		static size_t GetWarmCount();
+		static DWORD GetMaintainPeriodMs();
+		static ConnectCommand ConnectCommandDefault();
+		static ValidateCommand ValidateCommandDefault();
 
 	private:
+		struct Pool;
+		typedef std::shared_ptr<Pool> PoolPtr;
+		typedef HashMap<DepotString, PoolPtr, StringInfo::Hash, StringInfo::EqualInsensitive> PoolMapType;
+
 		static DepotString CreateKey(const DepotConfig& config);
+		static DWORD MaintainThreadEntry(void* data);
+		PoolPtr FindPool(const DepotString& key, const DepotConfig& config, const UserContext* userContext);
+		Array<PoolPtr> GetPools() const;
+		DepotClient PopValidClient(Pool& pool, bool isUse);
+		void Preconnect(const PoolPtr& pool, size_t connectCount);
 
 	private:
-		typedef UnorderedMultiMap<DepotString, DepotClient, StringInfo::Hash, StringInfo::EqualInsensitive> FreeMapType;
-
-		CriticalSection m_FreeMapLock;
-		FreeMapType* m_FreeMap;
+		mutable CriticalSection m_PoolMapLock;
+		PoolMapType* m_PoolMap;
+		ConnectCommand* m_ConnectCommand;
+		ValidateCommand* m_ValidateCommand;
+		HANDLE m_MaintainThread;
+		AutoHandle m_MaintainStopEvent;
 	};
 
 }}}
@@ -0,0 +1,119 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotClient.h"
+#include "DepotDateTime.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	struct DepotConcurrencyDecision
+	{
+		enum Enum
+		{
+			Hold,
+			Increase,
+			Decrease,
+		};
+
+		P4VFS_CORE_API static DepotString ToString(Enum value);
+	};
+
+	struct FDepotConcurrencyOptions
+	{
+		FDepotConcurrencyOptions() :
+			m_InitialConcurrency(1),
+			m_MinConcurrency(1),
+			m_MaxConcurrency(1),
+			m_SampleCount(32),
+			m_LatencyTolerancePercent(50),
+			m_DecreasePercent(75)
+		{}
+
+		size_t m_InitialConcurrency;
+		size_t m_MinConcurrency;
+		size_t m_MaxConcurrency;
+
+		// The number of completed items in each measurement window, which is never less than the current concurrency
+		size_t m_SampleCount;
+
+		// The concurrency is decreased once the mean latency of a window exceeds the lowest window mean by this percent
+		int32_t m_LatencyTolerancePercent;
+
+		// The percent of the concurrency which is kept by a decrease
+		int32_t m_DecreasePercent;
+
+		// Options for a fixed initialConcurrency, or a range from the AdaptiveConcurrency settings if they are enabled
+		P4VFS_CORE_API static FDepotConcurrencyOptions FromSettings(size_t initialConcurrency);
+	};
+
+	struct FDepotConcurrencyDecisionRecord
+	{
+		DepotConcurrencyDecision::Enum m_Decision;
+		size_t m_PreviousConcurrency;
+		size_t m_Concurrency;
+		int64_t m_TimeUs;
+		int64_t m_LatencyUs;
+		double m_ItemsPerSecond;
+	};
+
+	// Limits the number of workers which are active at once, adjusting the limit from the latency and throughput of the
+	// completed items. Each window of completed items increases the limit by one while the latency stays near the lowest
+	// seen, and decreases it by a percentage once the latency rises past the tolerance. Workers are started up to the
+	// maximum concurrency, and wait in Acquire while the limit is reached.
+	class DepotConcurrencyController
+	{
+	public:
+		// Returns the current time in microseconds, which may be simulated
+		typedef std::function<int64_t()> ClockFunction;
+
+		DepotConcurrencyController(const FDepotConcurrencyOptions& options, const ClockFunction& clock = ClockFunction());
+		~DepotConcurrencyController();
+
+		// Blocks while the concurrency limit is reached. Returns false if the cancelation event is set.
+		bool Acquire(HANDLE cancelationEvent = NULL);
+		bool TryAcquire();
+
+		// Completes an item which was started by a successful Acquire
+		void Release(int64_t latencyUs);
+
+		bool IsAdaptive() const;
+		size_t GetConcurrency() const;
+		size_t GetMinConcurrency() const;
+		size_t GetMaxConcurrency() const;
+		size_t GetActiveCount() const;
+		size_t GetCompletedCount() const;
+		size_t GetIncreaseCount() const;
+		size_t GetDecreaseCount() const;
+		Array<FDepotConcurrencyDecisionRecord> GetDecisions() const;
+
+		void LogSummary(DepotClient& depotClient) const;
+
+	private:
+		void Evaluate(int64_t timeUs);
+
+	private:
+		FDepotConcurrencyOptions m_Options;
+		ClockFunction* m_Clock;
+		DepotStopwatch m_Stopwatch;
+		mutable CriticalSection m_Lock;
+		AutoHandle m_ReleasedEvent;
+		size_t m_Concurrency;
+		size_t m_ActiveCount;
+		size_t m_CompletedCount;
+		size_t m_IncreaseCount;
+		size_t m_DecreaseCount;
+		size_t m_WindowCount;
+		size_t m_WindowMaxActiveCount;
+		int64_t m_WindowLatencyUs;
+		int64_t m_WindowStartUs;
+		int64_t m_BaselineLatencyUs;
+		double m_PreviousItemsPerSecond;
+		Array<FDepotConcurrencyDecisionRecord>* m_Decisions;
+	};
+
+}}}
+
+#pragma managed(pop)
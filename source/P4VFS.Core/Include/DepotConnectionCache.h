@@ -0,0 +1,74 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotResult.h"
+#include "DepotResultClient.h"
+#include "DepotCommand.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	// The client spec, login state and protocol levels which are established when a client connects to a server
+	struct DepotConnectionMetadata
+	{
+		DepotConnectionMetadata() :
+			m_IsLoginRequired(false),
+			m_IsServerUnicode(false),
+			m_ServerApiLevel(0)
+		{}
+
+		DepotResultClient m_Client;
+		bool m_IsLoginRequired;
+		bool m_IsServerUnicode;
+		int32_t m_ServerApiLevel;
+	};
+
+	// Keeps the metadata of each connection by port, user, client, tickets file and trust file, so that a new connection
+	// can skip the client, trust and login commands run by an earlier connection with the same login and trust state. An entry expires after DepotConnectionCacheTimeoutMs or
+	// when its login ticket expires, whichever is first, and is removed by a command which fails with a login error.
+	class DepotConnectionCache
+	{
+	public:
+		typedef std::function<void(const DepotCommand& cmd, FDepotResult& result)> RunCommand;
+		typedef std::function<void(DepotConnectionMetadata& metadata)> ReadProtocol;
+
+		P4VFS_CORE_API DepotConnectionCache();
+		P4VFS_CORE_API ~DepotConnectionCache();
+
+		// Returns the cached metadata of a connection, or else queries it from the server using run, and then reads the
+		// protocol levels which the server replied with. Only metadata of a connection which needs no login is stored.
+		// The returned client spec is a copy of its own, which is not shared with any other connection.
+		P4VFS_CORE_API DepotConnectionMetadata Query(const DepotString& key, const RunCommand& run, const ReadProtocol& protocol);
+
+		P4VFS_CORE_API bool Find(const DepotString& key, DepotConnectionMetadata& metadata);
+		P4VFS_CORE_API void Store(const DepotString& key, const DepotConnectionMetadata& metadata, int64_t validSeconds = -1);
+		P4VFS_CORE_API void Invalidate(const DepotString& key);
+		P4VFS_CORE_API void Clear();
+		P4VFS_CORE_API size_t GetCount() const;
+
+		P4VFS_CORE_API static DepotString CreateKey(const DepotString& port, const DepotString& user, const DepotString& client, const DepotString& ticketsFile, const DepotString& trustFile);
+		P4VFS_CORE_API static bool IsInvalidatingError(const FDepotResult& result);
+		P4VFS_CORE_API static int64_t GetTimeoutMs();
+		P4VFS_CORE_API static DepotConnectionCache& StaticInstance();
+
+	private:
+		static DepotResultClient CopyClient(const DepotResultClient& src);
+
+	private:
+		struct Entry
+		{
+			DepotConnectionMetadata m_Metadata;
+			uint64_t m_ExpireTime;
+		};
+
+		typedef Map<DepotString, Entry, DepotStringLess> EntryMapType;
+
+		mutable CriticalSection m_EntryMapLock;
+		EntryMapType* m_EntryMap;
+	};
+
+}}}
+
+#pragma managed(pop)
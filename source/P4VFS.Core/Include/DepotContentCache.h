@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotClient.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	struct FDepotContentCacheStats
+	{
+		FDepotContentCacheStats() :
+			m_HitCount(0),
+			m_HitBytes(0),
+			m_MissCount(0),
+			m_PublishCount(0),
+			m_PublishBytes(0),
+			m_EvictCount(0),
+			m_EvictBytes(0),
+			m_FileCount(0),
+			m_TotalBytes(0)
+		{}
+
+		uint64_t m_HitCount;
+		uint64_t m_HitBytes;
+		uint64_t m_MissCount;
+		uint64_t m_PublishCount;
+		uint64_t m_PublishBytes;
+		uint64_t m_EvictCount;
+		uint64_t m_EvictBytes;
+		uint64_t m_FileCount;
+		uint64_t m_TotalBytes;
+
+		P4VFS_CORE_API DepotString ToString() const;
+	};
+
+	// A local cache of the printed content of depot file revisions, shared by every workspace on the machine which
+	// hydrates the same revision. Each revision is a file named by the hash of its key, in a folder named by the first
+	// byte of the hash. A file is printed into the temp folder of the cache and renamed into place once it is complete,
+	// so that a partial file is never found, and its key is written to an alternate stream of the file which is checked
+	// on every lookup. The least recently used files are evicted once the cache exceeds its byte budget.
+	class P4VFS_CORE_API DepotContentCache
+	{
+	public:
+		DepotContentCache();
+		~DepotContentCache();
+
+		// Indexes the files already in folderPath. The cache is closed if folderPath is empty.
+		bool Open(const FileCore::String& folderPath, uint64_t maxBytes);
+		void Close();
+		bool IsOpen() const;
+
+		// Opens the cache with the folder and size of the DepotContentCache settings, unless it is already open with them
+		bool Configure();
+
+		// Opens the cached file of a key for reading, returning false if it is not in the cache
+		bool OpenFile(const DepotString& key, FileCore::AutoHandle& fileHandle);
+
+		// An empty file in the temp folder of the cache, which is to be printed to and then given to Publish
+		FileCore::String CreateTempFile();
+
+		// Moves a complete temp file into the cache as the content of key, or deletes it if it cannot be added. The
+		// published file is also opened for reading if fileHandle is given.
+		bool Publish(const DepotString& key, const FileCore::String& tempFilePath, FileCore::AutoHandle* fileHandle = nullptr);
+
+		// Evicts the least recently used files until the cache is within its byte budget
+		void Trim();
+
+		FDepotContentCacheStats GetStats() const;
+		FileCore::String GetFolderPath() const;
+		uint64_t GetMaxBytes() const;
+
+		// The key of a revision as it is printed by a client. Users do not share files, so that a user is never given
+		// the content of a file which the protections of the server would not let them print.
+		static DepotString CreateKey(FDepotClient& depotClient, const DepotString& depotFile, int32_t revision);
+		static FileCore::String GetConfiguredFolderPath();
+		static uint64_t GetConfiguredMaxBytes();
+
+	private:
+		struct Index;
+
+		static FileCore::String GetFilePath(const Index& index, uint64_t hash);
+		static bool IsKeyMatch(const FileCore::String& filePath, const DepotString& key);
+		static void TrimIndex(Index& index);
+
+	private:
+		mutable FileCore::CriticalSection m_Lock;
+		Index* m_Index;
+	};
+
+}}}
+
+#pragma managed(pop)
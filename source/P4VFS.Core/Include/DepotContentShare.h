@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotClient.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	// The digest and size of a depot file revision, as reported by fstat, which identify its content in a share
+	struct FDepotContentShareFile
+	{
+		FDepotContentShareFile() :
+			m_Revision(0),
+			m_FileSize(-1)
+		{}
+
+		DepotString m_DepotFile;
+		int32_t m_Revision;
+		DepotString m_Digest;
+		int64_t m_FileSize;
+	};
+
+	// A directory of printed depot file revisions shared by many machines, from which files are populated instead of
+	// printing them from the server. A revision is found by its digest at <root>\<hh>\<digest>, or else by its depot
+	// path at <root>\<depot path>#<revision>. Every file is verified against the size and digest reported by the server
+	// as it is read, so that a missing, partial or modified file is never populated.
+	struct DepotContentShare
+	{
+		// Gets the digest and size of a revision, returning false if they do not describe the file as it is printed by
+		// this client, such as for text files printed with CRLF line endings or with keywords expanded
+		P4VFS_CORE_API static bool GetShareFile(FDepotClient& depotClient, const DepotString& depotFile, int32_t revision, FDepotContentShareFile& shareFile);
+
+		// Whether a file of this type is printed by a client with these line endings exactly as it is stored by the server
+		P4VFS_CORE_API static bool IsDigestOfPrintedFile(const DepotString& fileType, const DepotString& lineEnd);
+
+		// Opens the file of a revision in the share for reading, returning false if it is not in the share
+		P4VFS_CORE_API static bool OpenFile(const FileCore::String& shareFolderPath, const FDepotContentShareFile& shareFile, FileCore::AutoHandle& fileHandle);
+
+		// Copies a file to hWriteHandle, failing if it does not have the size and digest of the revision
+		P4VFS_CORE_API static HRESULT CopyVerified(HANDLE hReadHandle, HANDLE hWriteHandle, const FDepotContentShareFile& shareFile, UINT64* bytesWritten = nullptr);
+
+		// Copies a local file of a revision into the share by its digest, unless it is already there. The file is
+		// copied to a temp folder of the share and verified before it is renamed into place.
+		P4VFS_CORE_API static bool Publish(const FileCore::String& shareFolderPath, const FDepotContentShareFile& shareFile, const FileCore::String& filePath);
+
+		P4VFS_CORE_API static FileCore::String GetDigestFilePath(const FileCore::String& shareFolderPath, const DepotString& digest);
+		P4VFS_CORE_API static FileCore::String GetDepotFilePath(const FileCore::String& shareFolderPath, const DepotString& depotFile, int32_t revision);
+		P4VFS_CORE_API static FileCore::String GetConfiguredFolderPath();
+	};
+
+}}}
+
+#pragma managed(pop)
@@ -0,0 +1,74 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotClient.h"
+#include "DepotSyncAction.h"
+#include "DepotDateTime.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	struct FDepotFlushBatchEntry
+	{
+		DepotSyncActionInfo m_Modification;
+		DepotString m_FileSpec;
+	};
+
+	class DepotFlushBatcher
+	{
+	public:
+		// Issues a single 'sync -k' round trip for all fileSpecs. Returns the error actions parsed
+		// from the command output, or nullptr if the command failed without per-file errors.
+		typedef std::function<DepotSyncActionInfoArray(DepotClient& depotClient, const DepotStringArray& fileSpecs)> FlushCommand;
+
+		// Called for each modification of a batch which was flushed without error
+		typedef std::function<void(const DepotSyncActionInfo& modification)> FlushedCallback;
+
+		DepotFlushBatcher(LogDevice* log, size_t batchSize, int64_t deadlineMs, const FlushCommand& flushCommand = FlushCommand());
+		~DepotFlushBatcher();
+
+		void SetFlushedCallback(const FlushedCallback& flushedCallback);
+
+		void Add(DepotClient& depotClient, const DepotSyncActionInfo& modification, const DepotString& fileSpec);
+		void Flush(DepotClient& depotClient);
+
+		// Executes the pending batch if its oldest entry has waited past the deadline, so that a partial batch is not
+		// held until another file is added. GetExpireWaitMs is the time until then, or INFINITE with no pending batch.
+		void FlushExpired(DepotClient& depotClient);
+		DWORD GetExpireWaitMs() const;
+
+		size_t GetBatchCount() const;
+		size_t GetFileCount() const;
+		size_t GetErrorCount() const;
+		int64_t GetFlushTime() const;
+
+		static DepotSyncActionInfoArray FlushCommandSync(DepotClient& depotClient, const DepotStringArray& fileSpecs);
+		static size_t GetDefaultBatchSize();
+		static int64_t GetDefaultDeadlineMs();
+
+	private:
+		typedef Array<FDepotFlushBatchEntry> EntryArray;
+
+		void ExecuteBatch(DepotClient& depotClient, EntryArray& batch);
+		bool IsPendingExpired() const;
+
+	private:
+		LogDevice* m_Log;
+		size_t m_BatchSize;
+		int64_t m_DeadlineMs;
+		FlushCommand* m_FlushCommand;
+		FlushedCallback* m_FlushedCallback;
+		mutable CriticalSection m_PendingLock;
+		EntryArray* m_Pending;
+		DepotStopwatch m_PendingTimer;
+		std::atomic<size_t> m_BatchCount;
+		std::atomic<size_t> m_FileCount;
+		std::atomic<size_t> m_ErrorCount;
+		std::atomic<int64_t> m_FlushTime;
+	};
+
+}}}
+
+#pragma managed(pop)
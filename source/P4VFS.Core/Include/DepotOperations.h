@@ -8,6 +8,14 @@
 #include "DepotResultFStat.h"
 #include "DepotResultSizes.h"
 #include "DepotReconfig.h"
+#include "DepotFlushBatcher.h"
+#include "DepotSyncPipeline.h"
+#include "DepotResidentMatcher.h"
+#include "DepotSyncJournal.h"
+#include "DepotSyncActionTable.h"
+#include "DepotSyncDirectoryScheduler.h"
+#include "DepotResidentDownloader.h"
+#include "DepotConcurrencyController.h"
 #pragma managed(push, off)
 
 namespace Microsoft {
@@ -39,16 +47,47 @@ namespace P4 {
 			const FDepotSyncOptions& syncOptions
 			);
 
+		// Totals of the applied modifications, accumulated as each modification is applied so that a
+		// streaming sync does not need to keep the modifications for its summary
+		struct FSyncVirtualSummary
+		{
+			FSyncVirtualSummary() :
+				m_ModificationCount(0),
+				m_AppliedCount(0),
+				m_VirtualFileSize(0),
+				m_DiskFileSize(0),
+				m_PlaceholderTime(0),
+				m_FlushTime(0),
+				m_SyncTime(0)
+			{}
+
+			void Add(const FDepotSyncActionInfo& modification, bool isFlushBatched, bool isDownloadBatched);
+
+			std::atomic<size_t> m_ModificationCount;
+			std::atomic<size_t> m_AppliedCount;
+			std::atomic<int64_t> m_VirtualFileSize;
+			std::atomic<int64_t> m_DiskFileSize;
+			std::atomic<int64_t> m_PlaceholderTime;
+			std::atomic<int64_t> m_FlushTime;
+			std::atomic<int64_t> m_SyncTime;
+		};
+
 		struct FSyncVirtualModificationParams
 		{
-			FSyncVirtualModificationParams(LogDevice* log, DepotClient& depotClient, DepotSyncActionInfoArray& results) :
+			FSyncVirtualModificationParams(LogDevice* log, DepotClient& depotClient, FDepotSyncActionTable::IndexArray* resultRows) :
 				m_Log(log),
 				m_DepotClient(depotClient),
 				m_Config(depotClient->Config()),
-				m_Results(results),
+				m_ResultRows(resultRows),
 				m_CancelationEvent(CreateEvent(NULL, TRUE, FALSE, NULL)),
 				m_ClientListMutex(CreateMutex(NULL, FALSE, NULL)),
-				m_ResultsMutex(CreateMutex(NULL, FALSE, NULL))
+				m_ResultsMutex(CreateMutex(NULL, FALSE, NULL)),
+				m_FlushBatcher(nullptr),
+				m_Journal(nullptr),
+				m_Summary(nullptr),
+				m_ResidentDownloader(nullptr),
+				m_Concurrency(nullptr),
+				m_DeleteEmptyDirectories(true)
 			{
 				m_DepotClientList.push_back(depotClient);
 			}
@@ -56,25 +95,65 @@ namespace P4 {
 			LogDevice* m_Log;
 			DepotClient& m_DepotClient;
 			DepotConfig m_Config;
-			DepotSyncActionInfoArray& m_Results;
+			DepotSyncActionTable m_Table;
+			FDepotSyncActionTable::IndexArray* m_ResultRows;
 			AutoHandle m_CancelationEvent;
 			AutoHandle m_ClientListMutex;
 			AutoHandle m_ResultsMutex;
 			Array<DepotClient> m_DepotClientList;
+			DepotFlushBatcher* m_FlushBatcher;
+			DepotSyncJournal* m_Journal;
+			FSyncVirtualSummary* m_Summary;
+			DepotResidentDownloader* m_ResidentDownloader;
+			DepotConcurrencyController* m_Concurrency;
+			bool m_DeleteEmptyDirectories;
 		};
 
+		static bool
+		SyncVirtualPipeline(
+			FSyncVirtualModificationParams& params,
+			const FDepotSyncOptions& syncOptions,
+			const DepotRevision& revision,
+			DepotSyncFlags::Enum primarySyncFlags,
+			DepotStopwatch& previewTime
+			);
+
+		static void
+		PrepareVirtualModification(
+			const DepotSyncActionInfo& modification,
+			const FDepotSyncOptions& syncOptions,
+			const FDepotResidentMatcher& residentMatcher,
+			DepotSyncFlags::Enum primarySyncFlags
+			);
+
+		// Returns false if the modification was not applied because the sync was canceled
+		static bool
+		ExecuteVirtualModification(
+			const DepotSyncActionInfo& modification,
+			FSyncVirtualModificationParams& params
+			);
+
 		static bool
 		SyncVirtualModification(
 			const DepotSyncActionInfo& modification,
 			FSyncVirtualModificationParams& params
 			);
 
+		static void
+		FlushExpiredBatch(
+			FSyncVirtualModificationParams& params
+			);
+
 		static void
 		ApplyVirtualModification(
 			DepotClient& depotClient, 
 			const DepotConfig& depotConfig,
 			const DepotSyncActionInfo& modification, 
-			LogDevice* parentLog = nullptr
+			LogDevice* parentLog = nullptr,
+			DepotFlushBatcher* flushBatcher = nullptr,
+			DepotSyncJournal* journal = nullptr,
+			bool deleteEmptyDirectories = true,
+			DepotResidentDownloader* residentDownloader = nullptr
 			);
 
 		static bool
@@ -83,12 +162,61 @@ namespace P4 {
 			const DepotSyncActionInfo& modification
 			);
 
+		static bool
+		PopulateFiles(
+			DepotClient& depotClient,
+			const Array<DepotSyncActionInfo>& modifications,
+			LogDevice* log = nullptr
+			);
+
 		static DepotSyncResult
 		Hydrate(
 			DepotClient& depotClient, 
 			const FDepotSyncOptions& syncOptions
 			);
 
+		// The placeholders of a hydrate which are printed with the port, user and client of their placeholder, keyed by
+		// CreateHydrateGroupKey
+		struct FHydrateGroup
+		{
+			DepotConfig m_Config;
+			Array<DepotSyncActionInfo> m_Modifications;
+		};
+
+		typedef Map<DepotString, FHydrateGroup> HydrateGroupMap;
+
+		// Connects the client of a group with another config than the hydrating client, returning null on failure
+		typedef std::function<DepotClient(const DepotConfig& config)> HydrateConnectCommand;
+
+		// Populates a batch of placeholders from a single print, returning false if any of them failed
+		typedef std::function<bool(DepotClient& depotClient, const Array<DepotSyncActionInfo>& batch)> HydratePopulateCommand;
+
+		// Populates each group in batches of printBatchSize on pooled connections. Every file of a group which cannot
+		// be connected is marked as an error.
+		static DepotSyncStatus::Enum
+		HydrateGroups(
+			DepotClient& depotClient,
+			const HydrateGroupMap& hydrateGroups,
+			size_t printBatchSize,
+			LogDevice* log,
+			const HydrateConnectCommand& connectCommand,
+			const HydratePopulateCommand& populateCommand,
+			size_t* printBatchCount = nullptr
+			);
+
+		// Marks each file which is still offline, and was not already marked, as an error
+		static DepotSyncStatus::Enum
+		VerifyHydratedFiles(
+			const Array<DepotSyncActionInfo>& modifications,
+			LogDevice* log
+			);
+
+		// The key of the hydrate group for placeholders of the port, user and client of this config
+		static DepotString
+		CreateHydrateGroupKey(
+			const DepotConfig& config
+			);
+
 		static bool
 		Reconfig(
 			DepotClient& depotClient, 
@@ -104,7 +232,8 @@ namespace P4 {
 
 		static bool
 		UninstallPlaceholderFile(
-			const DepotSyncActionInfo& modification
+			const DepotSyncActionInfo& modification,
+			bool deleteEmptyDirectories = true
 			);
 
 		static DepotSyncResult
@@ -122,6 +251,20 @@ namespace P4 {
 			FileCore::LogDevice* log = nullptr
 			);
 
+		static void
+		AppendSyncTextOutput(
+			const FDepotResult& syncResult,
+			DepotSyncActionInfoArray& modifications,
+			FileCore::LogDevice* log = nullptr
+			);
+
+		static bool
+		ResolveSyncModifications(
+			DepotClient& depotClient,
+			DepotSyncFlags::Enum syncFlags,
+			const Array<DepotSyncActionInfo>& modifications
+			);
+
 		static DepotRevision
 		GetHeadRevisionChangelist(
 			DepotClient& depotClient
@@ -160,7 +303,21 @@ namespace P4 {
 			DepotClient& depotClient,
 			DepotSyncFlags::Enum syncFlags,
 			const DepotStringArray& fileSpecs,
-			const DepotSyncActionInfoArray& fileModifications
+			const DepotSyncActionInfoArray& fileModifications,
+			Array<DepotClient>* pooledClients = nullptr
+			);
+
+		// Runs predicate for each item index on a bounded pool of connections to the same server as depotClient.
+		// The additional connections are kept in pooledClients when given, so that the next call reuses them. Every
+		// item is run, on the connections already made if an additional connection cannot be made.
+		typedef std::function<void(DepotClient& pooledClient, size_t itemIndex)> PooledClientPredicate;
+
+		static void
+		ForEachPooledClient(
+			DepotClient& depotClient,
+			size_t itemCount,
+			const PooledClientPredicate& predicate,
+			Array<DepotClient>* pooledClients = nullptr
 			);
 
 		static DepotResultDiff2
@@ -179,6 +336,38 @@ namespace P4 {
 			const DepotStringArray& optionArgs = DepotStringArray()
 			);
 
+		typedef std::function<void(const DepotResultTag& tag)> StreamTagPredicate;
+
+		// Runs a command which passes each record to the predicate as it arrives, without retaining the records in
+		// the result. The predicate is called on up to maxThreads workers while the remaining records are still being 
+		// received, or on the calling thread if maxThreads is 1.
+		static DepotResultStream
+		RunStream(
+			DepotClient& depotClient,
+			const DepotCommand& command,
+			size_t maxThreads,
+			const StreamTagPredicate& predicate
+			);
+
+		static DepotResultStream
+		FStatStream(
+			DepotClient& depotClient,
+			const DepotStringArray& files,
+			const DepotString& filterType,
+			FDepotResultFStatField::Enum fields,
+			size_t maxThreads,
+			const StreamTagPredicate& predicate,
+			const DepotStringArray& optionArgs = DepotStringArray()
+			);
+
+		static DepotCommand
+		CreateFStatCommand(
+			const DepotStringArray& files,
+			const DepotString& filterType,
+			FDepotResultFStatField::Enum fields,
+			const DepotStringArray& optionArgs
+			);
+
 		struct SizesFlags { enum Enum {
 			None			= 0,
 			ClientSize		= 1<<0,
@@ -214,6 +403,18 @@ namespace P4 {
 			const DepotRevision& revision = nullptr
 			);
 
+		static DepotStringArray
+		GetSymlinkTargetPaths(
+			DepotClient& depotClient,
+			const DepotStringArray& fileSpecs
+			);
+
+		static void
+		ResolveSymlinkTargets(
+			DepotClient& depotClient,
+			const Array<DepotSyncActionInfo>& modifications
+			);
+
 		static DepotString
 		GetSymlinkTargetDepotFile(
 			DepotClient& depotClient,
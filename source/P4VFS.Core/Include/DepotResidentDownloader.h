@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotClient.h"
+#include "DepotSyncAction.h"
+#include "DepotDateTime.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	// Downloads the always resident files of a virtual sync in batches of a similar total size, concurrently across
+	// a pool of connections. A batch is started as soon as it is full, so that downloads overlap with the placeholders
+	// which are still being installed. A file at least as large as the batch size is downloaded in a batch of its own.
+	class DepotResidentDownloader
+	{
+	public:
+		typedef Array<DepotSyncActionInfo> Batch;
+
+		// Issues a single 'sync -f' round trip for all fileSpecs. Returns false if the command failed.
+		typedef std::function<bool(DepotClient& depotClient, const DepotStringArray& fileSpecs)> DownloadCommand;
+
+		// Creates a connection for one of the download workers, or returns nullptr if a connection could not be made
+		typedef std::function<DepotClient()> ConnectCommand;
+
+		// Called for each modification of a batch which was downloaded without error
+		typedef std::function<void(const DepotSyncActionInfo& modification)> DownloadedCallback;
+
+		DepotResidentDownloader(LogDevice* log, size_t maxConnections, int64_t batchBytes, size_t maxBatchFiles, const DownloadCommand& downloadCommand, const ConnectCommand& connectCommand);
+		~DepotResidentDownloader();
+
+		void SetDownloadedCallback(const DownloadedCallback& downloadedCallback);
+
+		// Starts the download workers, which run until Complete is called or the cancelation event is set
+		bool Start(HANDLE cancelationEvent, const FileCore::UserContext* userContext);
+
+		void Add(const DepotSyncActionInfo& modification);
+
+		// Divides the remaining partial batch between the connections, and waits for all batches to be downloaded. Any
+		// batches which the workers could not download are downloaded with the calling client.
+		void Complete(DepotClient& depotClient);
+
+		size_t GetBatchCount() const;
+		size_t GetFileCount() const;
+		int64_t GetByteCount() const;
+		size_t GetErrorCount() const;
+		size_t GetConnectionCount() const;
+		int64_t GetDownloadTime() const;
+
+		static int64_t GetModificationBytes(const DepotSyncActionInfo& modification);
+		static Array<Batch> PartitionBatches(const Batch& modifications, size_t batchCount);
+		static ConnectCommand ConnectCommandPooled(const DepotClient& depotClient);
+		static int64_t GetDefaultBatchBytes();
+		static size_t GetDefaultMaxBatchFiles();
+
+	private:
+		typedef List<Batch> BatchListType;
+
+		static DWORD DispatchThreadEntry(void* data);
+		void DispatchBatches();
+		void PushBatch(Batch& batch);
+		bool PopBatch(Batch& batch, bool wait);
+		void ExecuteBatch(DepotClient& depotClient, Batch& batch);
+
+	private:
+		LogDevice* m_Log;
+		size_t m_MaxConnections;
+		int64_t m_BatchBytes;
+		size_t m_MaxBatchFiles;
+		DownloadCommand* m_DownloadCommand;
+		ConnectCommand* m_ConnectCommand;
+		DownloadedCallback* m_DownloadedCallback;
+		const FileCore::UserContext* m_UserContext;
+		HANDLE m_CancelationEvent;
+		HANDLE m_DispatchThread;
+		CriticalSection m_PendingLock;
+		Batch* m_Pending;
+		int64_t m_PendingBytes;
+		CriticalSection m_BatchesLock;
+		BatchListType* m_Batches;
+		AutoHandle m_BatchSemaphore;
+		AutoHandle m_CompletedEvent;
+		std::atomic<size_t> m_BatchCount;
+		std::atomic<size_t> m_FileCount;
+		std::atomic<int64_t> m_ByteCount;
+		std::atomic<size_t> m_ErrorCount;
+		std::atomic<size_t> m_ConnectionCount;
+		std::atomic<int64_t> m_DownloadTime;
+	};
+
+}}}
+
+#pragma managed(pop)
@@ -0,0 +1,58 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotResult.h"
+#include <regex>
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	typedef std::shared_ptr<const struct FDepotResidentMatcher> DepotResidentMatcher;
+
+	// A SyncResident pattern compiled once and shared read-only across threads. The pattern is an
+	// ECMAScript case-insensitive regex searched against the depot file. Alternations of extension
+	// suffixes such as "\.(xml|txt)$" and path prefixes such as "^//depot/tools/" are matched with
+	// a suffix hash set and a prefix trie. Any other pattern falls back to std::regex_search.
+	struct FDepotResidentMatcher
+	{
+		P4VFS_CORE_API FDepotResidentMatcher(const DepotString& pattern);
+		P4VFS_CORE_API ~FDepotResidentMatcher();
+
+		P4VFS_CORE_API bool IsMatch(const DepotString& depotFile) const;
+		P4VFS_CORE_API bool IsRegex() const;
+		P4VFS_CORE_API const DepotString& Pattern() const;
+
+		// Returns a shared matcher for the pattern, compiling it only if it is not already cached
+		P4VFS_CORE_API static DepotResidentMatcher FromPattern(const DepotString& pattern);
+
+	private:
+		typedef Array<DepotString> TermArray;
+
+		struct FPrefixNode
+		{
+			Map<char, size_t> m_Children;
+			bool m_IsTerminal;
+		};
+
+		bool Compile(const DepotString& pattern);
+		bool IsSuffixMatch(const DepotString& depotFile) const;
+		bool IsPrefixMatch(const DepotString& depotFile) const;
+
+		static bool SplitAlternatives(const char* begin, const char* end, Array<std::pair<const char*, const char*>>& alternatives);
+		static bool ExpandLiterals(const char* begin, const char* end, TermArray& terms);
+		static bool ParseLiteral(const char*& pos, const char* end, DepotString& literal);
+
+	private:
+		DepotString m_Pattern;
+		bool m_IsNegated;
+		HashSet<DepotString> m_Suffixes;
+		Array<size_t> m_SuffixLengths;
+		Array<FPrefixNode> m_PrefixNodes;
+		std::shared_ptr<std::regex> m_Regex;
+	};
+
+}}}
+
+#pragma managed(pop)
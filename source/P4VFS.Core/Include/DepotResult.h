@@ -27,8 +27,26 @@ namespace P4 {
 		Handled = 1,
 	};
 
+	struct FDepotResultArena;
+	struct FDepotResultArenaBlock;
+	typedef std::shared_ptr<FDepotResultArenaBlock> DepotResultArenaBlock;
+
+	// A field of a tag which is stored in a result arena. The key is the interned field name which is shared by all
+	// records, and the value is a null terminated slice at an offset from the start of the record.
+	struct FDepotResultArenaField
+	{
+		const char* m_Key;
+		uint32_t m_Offset;
+		uint32_t m_Length;
+	};
+
 	struct FDepotResultTag
 	{
+		P4VFS_CORE_API FDepotResultTag();
+		P4VFS_CORE_API FDepotResultTag(const FDepotResultTag& src);
+		P4VFS_CORE_API ~FDepotResultTag();
+		P4VFS_CORE_API FDepotResultTag& operator=(const FDepotResultTag& src);
+
 		bool ContainsKey(const char* tagKey) const;
 		void RemoveKey(const char* tagKey);
 		void SetValue(const char* tagKey, const DepotString& tagValue);
@@ -41,7 +59,27 @@ namespace P4 {
 		int64_t GetValueInt64(const char* tagKey, int64_t defaultValue = 0) const;
 
 		typedef Map<DepotString, DepotString, DepotStringLess> FieldsType;
+		P4VFS_CORE_API size_t GetFieldCount() const;
+		P4VFS_CORE_API FieldsType GetFields() const;
+		bool IsArena() const;
+
+		// The fields of a tag which was not created by a result arena, or which has been modified since
 		FieldsType m_Fields;
+
+	private:
+		friend struct FDepotResultArena;
+		const FDepotResultArenaField* FindArenaField(const char* tagKey) const;
+		const char* GetArenaFieldData(const FDepotResultArenaField* field) const;
+		const char* GetValueCStr(const char* tagKey) const;
+		void DetachArena();
+		void ReleaseArena();
+
+		// Arena fields are only read in place, except for values returned by reference, which are created once
+		// on first access into the matching value slot of the record.
+		DepotResultArenaBlock m_ArenaBlock;
+		const FDepotResultArenaField* m_ArenaFields;
+		DepotString** m_ArenaValues;
+		size_t m_ArenaFieldCount;
 	};
 
 	struct FDepotResultText
@@ -71,6 +109,7 @@ namespace P4 {
 		
 		virtual bool HasError() const;
 		virtual bool HasErrorRegex(const char* pattern) const;
+		virtual bool HasErrorText(const char* searchFor) const;
 		virtual void SetError(const char* errorText);
 		virtual DepotString GetError() const;
 
@@ -85,11 +124,22 @@ namespace P4 {
 		void Append(const Array<DepotResultTag>& srcTagList);
 		void Append(const Array<DepotResultText>& srcTextList);
 		void Append(const DepotResultTag& srcTag);
+
+		// Appends a tag from the fields of a tagged output record. The fields are stored in the result arena when
+		// DepotResultArenaTags is enabled, instead of a map for each tag. A repeated field name keeps its first value.
+		P4VFS_CORE_API void BeginTag();
+		P4VFS_CORE_API void AddTagField(const char* tagKey, const char* tagValue);
+		P4VFS_CORE_API const DepotResultTag& EndTag();
+
+		P4VFS_CORE_API bool IsArenaTags() const;
+		P4VFS_CORE_API size_t GetArenaBlockCount() const;
 	
 	protected:
 		friend class DepotClientCommand;	
 		Array<DepotResultTag> m_TagList;
 		Array<DepotResultText> m_TextList;
+		std::shared_ptr<FDepotResultArena> m_Arena;
+		bool m_ArenaTags;
 	};
 
 	struct FDepotResultNode
@@ -139,7 +189,7 @@ namespace P4 {
 
 		bool IsEmpty() const
 		{
-			return m_Tag.get() == nullptr || m_Tag->m_Fields.size() == 0;
+			return m_Tag.get() == nullptr || m_Tag->GetFieldCount() == 0;
 		}
 
 		template <typename T>
@@ -168,6 +218,24 @@ namespace P4 {
 		}
 	};
 
+	// A result which passes each tagged record to a visitor as it is received, and then drops it instead of retaining
+	// it in the TagList. The visitor is called on the thread which runs the command, so a slow visitor holds back the stream.
+	struct FDepotResultStream : FDepotResult
+	{
+		typedef std::function<void(const DepotResultTag& tag)> TagVisitor;
+
+		P4VFS_CORE_API FDepotResultStream(const TagVisitor& visitor);
+		virtual DepotResultReply OnStreamStat(IDepotClientCommand* cmd, const DepotResultTag& tag) override;
+
+		P4VFS_CORE_API size_t StreamCount() const;
+
+	private:
+		TagVisitor m_TagVisitor;
+		size_t m_StreamCount;
+	};
+
+	typedef std::shared_ptr<FDepotResultStream> DepotResultStream;
+
 	template <typename Result>
 	Result MakeResult()
 	{
@@ -49,6 +49,7 @@ namespace P4 {
 			HaveRev			= 1<<3,
 			HeadRev			= 1<<4,
 			HeadType		= 1<<5,
+			Digest			= 1<<6,
 		};
 
 		static DepotStringArray ToNames(Enum types);
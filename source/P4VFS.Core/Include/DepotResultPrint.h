@@ -11,6 +11,7 @@ namespace P4 {
 	typedef std::shared_ptr<struct FDepotResultPrintFile> DepotResultPrintFile;
 	typedef std::shared_ptr<struct FDepotResultPrintHandle> DepotResultPrintHandle;
 	typedef std::shared_ptr<struct FDepotResultPrintString> DepotResultPrintString;
+	typedef std::shared_ptr<struct FDepotResultPrintDemux> DepotResultPrintDemux;
 
 	struct FDepotResultPrintCharsetField
 	{
@@ -66,6 +67,45 @@ namespace P4 {
 		DepotString m_Text;
 	};
 
+	struct FDepotResultPrintDemuxFile
+	{
+		DepotString m_DepotFile;
+		int32_t m_Revision;
+		HANDLE m_hStream;
+		int64_t m_ByteCount;
+		bool m_IsPrinted;
+		bool m_IsWriteError;
+	};
+
+	// Prints several files with a single command, writing the output of each file to its own stream. The header record
+	// which the server sends before the content of each file selects the stream, and the text encoding, for the output
+	// which follows it.
+	struct FDepotResultPrintDemux : FDepotResultPrintCharset
+	{
+		FDepotResultPrintDemux();
+
+		// Adds a revision of a file to print to hStream, and returns the index of the file
+		size_t AddFile(const DepotString& depotFile, int32_t revision, HANDLE hStream);
+		DepotStringArray GetFileSpecs() const;
+
+		size_t GetFileCount() const;
+		const FDepotResultPrintDemuxFile& GetFile(size_t fileIndex) const;
+
+		// Returns true if the content of the file was received and written without error
+		bool IsFilePrinted(size_t fileIndex) const;
+
+		virtual DepotResultReply OnStreamStat(IDepotClientCommand* cmd, const DepotResultTag& tag) override;
+		virtual DepotResultReply OnStreamOutput(IDepotClientCommand* cmd, const char* data, size_t length) override;
+
+	private:
+		static DepotString CreateFileKey(const DepotString& depotFile, int32_t revision);
+
+	private:
+		Array<FDepotResultPrintDemuxFile> m_Files;
+		Map<DepotString, size_t, DepotStringLess> m_FileIndices;
+		FDepotResultPrintDemuxFile* m_CurrentFile;
+	};
+
 }}}
 
 #pragma managed(pop)
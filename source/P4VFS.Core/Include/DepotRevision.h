@@ -121,6 +121,163 @@ namespace P4 {
 		FDepotRevisionDate(time_t value = 0) : m_Value(value) {}
 		time_t m_Value = 0;
 	};
+
+	// A revision held by value, for the revisions which are only a type and a number. Parse and Format accept and
+	// produce exactly the text of FDepotRevision::FromString and ToString for these types, without allocating. A label,
+	// range or date is not a value, and is left to FDepotRevision.
+	struct FDepotRevisionValue
+	{
+		// The length of the longest revision text, which is "@-2147483648"
+		static constexpr size_t MaxLength = 12;
+
+		// The numbers which ToRevision returns without allocating
+		static constexpr int32_t SharedNumberCount = 1024;
+
+		constexpr FDepotRevisionValue() : m_Type(DepotRevisionType::Empty), m_Value(0) {}
+		constexpr FDepotRevisionValue(DepotRevisionType type, int32_t value = 0) : m_Type(type), m_Value(value) {}
+
+		DepotRevisionType m_Type;
+		int32_t m_Value;
+
+		// Returns true if text is a revision which is a value. As with FDepotRevision::FromString, surrounding whitespace
+		// is accepted for a number or changelist but not for a keyword. A number which does not fit in an int32_t is
+		// not a value.
+		static constexpr bool Parse(const char* text, size_t length, FDepotRevisionValue& value)
+		{
+			size_t end = length;
+			while (end > 0 && IsSpace(text[end-1]))
+				--end;
+			
+			size_t pos = 0;
+			while (pos < end && IsSpace(text[pos]))
+				++pos;
+
+			if (end - pos >= 2 && (text[pos] == '#' || text[pos] == '@') && IsDigit(text[pos+1]))
+			{
+				int64_t number = 0;
+				for (size_t digit = pos+1; digit < end; ++digit)
+				{
+					if (IsDigit(text[digit]) == false)
+						return false;
+					number = number*10 + (text[digit]-'0');
+					if (number > INT32_MAX)
+						return false;
+				}
+				value = FDepotRevisionValue(text[pos] == '#' ? DepotRevisionType::Number : DepotRevisionType::Changelist, int32_t(number));
+				return true;
+			}
+
+			constexpr DepotRevisionType keywordTypes[] = { DepotRevisionType::Now, DepotRevisionType::None, DepotRevisionType::Have, DepotRevisionType::Head };
+			for (DepotRevisionType keywordType : keywordTypes)
+			{
+				const char* keyword = Keyword(keywordType);
+				size_t keywordLength = 0;
+				while (keyword[keywordLength] != '\0')
+					++keywordLength;
+
+				if (length == keywordLength && EqualsInsensitive(text, keyword, length))
+				{
+					value = FDepotRevisionValue(keywordType);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Writes the revision text and a terminating null, returning its length, or zero if buffer is too small. An
+		// Empty revision is written as an empty string.
+		constexpr size_t Format(char* buffer, size_t size) const
+		{
+			char text[MaxLength+1] = {};
+			size_t length = 0;
+			if (m_Type == DepotRevisionType::Number || m_Type == DepotRevisionType::Changelist)
+			{
+				char digits[10] = {};
+				size_t digitCount = 0;
+				uint32_t number = m_Value < 0 ? 0u-uint32_t(m_Value) : uint32_t(m_Value);
+				do
+				{
+					digits[digitCount++] = char('0' + number % 10);
+					number /= 10;
+				}
+				while (number > 0);
+
+				text[length++] = m_Type == DepotRevisionType::Number ? '#' : '@';
+				if (m_Value < 0)
+					text[length++] = '-';
+				while (digitCount > 0)
+					text[length++] = digits[--digitCount];
+			}
+			else if (const char* keyword = Keyword(m_Type))
+			{
+				while (keyword[length] != '\0')
+				{
+					text[length] = keyword[length];
+					++length;
+				}
+			}
+
+			if (size <= length)
+			{
+				if (size > 0)
+					buffer[0] = '\0';
+				return 0;
+			}
+			for (size_t i = 0; i <= length; ++i)
+				buffer[i] = text[i];
+			return length;
+		}
+
+		constexpr bool operator==(const FDepotRevisionValue& rhs) const { return m_Type == rhs.m_Type && m_Value == rhs.m_Value; }
+		constexpr bool operator!=(const FDepotRevisionValue& rhs) const { return !(*this == rhs); }
+
+		// Returns false if the revision is not a value. A null revision is an Empty value.
+		P4VFS_CORE_API static bool FromRevision(const DepotRevision& revision, FDepotRevisionValue& value);
+
+		// A null revision for Empty. The revisions of each keyword, and numbers below SharedNumberCount, are shared
+		// instances which are allocated once, and must not be modified.
+		P4VFS_CORE_API DepotRevision ToRevision() const;
+
+	private:
+		static constexpr bool IsSpace(char c)
+		{
+			return c == ' ' || (c >= '\t' && c <= '\r');
+		}
+
+		static constexpr bool IsDigit(char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+
+		static constexpr char ToLower(char c)
+		{
+			return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+		}
+
+		static constexpr bool EqualsInsensitive(const char* a, const char* b, size_t length)
+		{
+			for (size_t i = 0; i < length; ++i)
+			{
+				if (ToLower(a[i]) != ToLower(b[i]))
+					return false;
+			}
+			return true;
+		}
+
+		static constexpr const char* Keyword(DepotRevisionType type)
+		{
+			switch (type)
+			{
+				case DepotRevisionType::Now:	return "@now";
+				case DepotRevisionType::None:	return "#none";
+				case DepotRevisionType::Have:	return "#have";
+				case DepotRevisionType::Head:	return "#head";
+				default:						return nullptr;
+			}
+		}
+	};
+
+	static_assert(sizeof(FDepotRevisionValue) == 8, "FDepotRevisionValue is expected to be stored inline");
 }}}
 
 #pragma managed(pop)
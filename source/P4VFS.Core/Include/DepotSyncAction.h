@@ -82,6 +82,7 @@ namespace P4 {
 
 	typedef std::shared_ptr<struct FDepotSyncActionInfo> DepotSyncActionInfo;
 	typedef std::shared_ptr<Array<DepotSyncActionInfo>> DepotSyncActionInfoArray;
+	typedef std::shared_ptr<struct FDepotSyncActionTable> DepotSyncActionTable;
 
 	struct FDepotSyncActionInfo
 	{
@@ -103,6 +104,7 @@ namespace P4 {
 		int64_t m_FlushTime;
 		int64_t m_SyncTime;
 		DepotString m_Message;
+		DepotString m_SymlinkTarget;
 		FileCore::Array<DepotSyncActionInfo> m_SubActions;
 
 		P4VFS_CORE_API FDepotSyncActionInfo();
@@ -137,11 +139,12 @@ namespace P4 {
 
 	struct FDepotSyncResult
 	{
-		P4VFS_CORE_API FDepotSyncResult(DepotSyncStatus::Enum status = DepotSyncStatus::Success, DepotSyncActionInfoArray modifications = nullptr);
+		P4VFS_CORE_API FDepotSyncResult(DepotSyncStatus::Enum status = DepotSyncStatus::Success, DepotSyncActionTable modifications = nullptr);
+		P4VFS_CORE_API FDepotSyncResult(DepotSyncStatus::Enum status, const DepotSyncActionInfoArray& modifications);
 		P4VFS_CORE_API ~FDepotSyncResult();
 
 		DepotSyncStatus::Enum m_Status;
-		DepotSyncActionInfoArray m_Modifications;
+		DepotSyncActionTable m_Modifications;
 	};
 
 	typedef std::shared_ptr<FDepotSyncResult> DepotSyncResult;
@@ -0,0 +1,48 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotSyncAction.h"
+#include <string_view>
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	// The fields of a line of untagged sync output, as views into the line
+	struct FDepotSyncActionScan
+	{
+		FDepotSyncActionScan() :
+			m_SyncActionType(DepotSyncActionType::None)
+		{}
+
+		DepotSyncActionType::Enum m_SyncActionType;
+		std::string_view m_DepotFile;
+		std::string_view m_Revision;
+		std::string_view m_ClientFile;
+	};
+
+	// Single pass parsers of the known shapes of untagged sync output, which neither allocate nor copy. Each one
+	// matches exactly what the regular expression named in its comment matches from the start of a line, and
+	// returns the same groups, so that a line is classified as it was when these were parsed with std::regex.
+	struct DepotSyncActionScanner
+	{
+		// The sync action of a line of info output, or None if it is not a known shape
+		P4VFS_CORE_API static FDepotSyncActionScan ScanInfoOutput(std::string_view text);
+
+		// The sync action of a line of error output, which is GenericError if it is not a known shape
+		P4VFS_CORE_API static FDepotSyncActionScan ScanErrorOutput(std::string_view text);
+
+		// ^([^#]*)(#\w+)? - (.+)
+		P4VFS_CORE_API static bool ScanFileRev(std::string_view text, std::string_view& depotFile, std::string_view& revision, std::string_view& action);
+
+		// ^(...\s+)*(.*) - must resolve( (#\w+))? before submitting
+		P4VFS_CORE_API static bool ScanNeedsResolve(std::string_view text, std::string_view& depotFile, std::string_view& revision);
+
+		// ^prefix, or else ^prefix(.+) returning the group if one is given
+		P4VFS_CORE_API static bool ScanPrefix(std::string_view text, std::string_view prefix, std::string_view* group = nullptr);
+	};
+
+}}}
+
+#pragma managed(pop)
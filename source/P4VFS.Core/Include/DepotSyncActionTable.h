@@ -0,0 +1,135 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotSyncAction.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	typedef std::shared_ptr<struct FDepotSyncActionTable> DepotSyncActionTable;
+
+	struct DepotSyncActionColumn
+	{
+		enum Enum
+		{
+			FileSize,
+			DiskFileSize,
+			VirtualFileSize,
+			PlaceholderTime,
+			FlushTime,
+			SyncTime,
+			Count,
+		};
+	};
+
+	// The modifications of a sync stored as parallel columns instead of one heap allocated FDepotSyncActionInfo
+	// each. Depot and client paths are split into a folder and a file name, which are interned once in a shared
+	// string arena. Revision numbers are stored inline, and any other revision is interned as a string. A row
+	// is only materialized as an FDepotSyncActionInfo when a caller asks for it.
+	//
+	// A sync applies its modifications from the rows of a table. Each row is checked out as a record which writes
+	// its changes back to the row once the last reference to it is released, so only the records in flight exist
+	// at any time. Rows may be appended, checked out and written back from any thread, while the other accessors
+	// are only safe once no checked out records remain.
+	struct FDepotSyncActionTable
+	{
+		typedef Array<uint32_t> IndexArray;
+
+		static const size_t InvalidRowIndex = size_t(-1);
+
+		P4VFS_CORE_API FDepotSyncActionTable();
+		P4VFS_CORE_API ~FDepotSyncActionTable();
+
+		P4VFS_CORE_API size_t Append(const FDepotSyncActionInfo& modification);
+		P4VFS_CORE_API void Update(size_t rowIndex, const FDepotSyncActionInfo& modification);
+		P4VFS_CORE_API void Reserve(size_t rowCount);
+		P4VFS_CORE_API size_t Count() const;
+		P4VFS_CORE_API size_t GetMemorySize() const;
+
+		P4VFS_CORE_API DepotString DepotFile(size_t rowIndex) const;
+		P4VFS_CORE_API DepotString ClientFile(size_t rowIndex) const;
+		P4VFS_CORE_API DepotRevision Revision(size_t rowIndex) const;
+		P4VFS_CORE_API DepotString RevisionString(size_t rowIndex) const;
+		P4VFS_CORE_API DepotString Message(size_t rowIndex) const;
+		P4VFS_CORE_API DepotString SymlinkTarget(size_t rowIndex) const;
+		P4VFS_CORE_API Array<DepotSyncActionInfo> SubActions(size_t rowIndex) const;
+		P4VFS_CORE_API DepotString ToFileSpecString(size_t rowIndex) const;
+		P4VFS_CORE_API DepotSyncActionType::Enum SyncActionType(size_t rowIndex) const;
+		P4VFS_CORE_API DepotSyncActionFlags::Enum SyncActionFlags(size_t rowIndex) const;
+		P4VFS_CORE_API DepotSyncFlags::Enum SyncFlags(size_t rowIndex) const;
+		P4VFS_CORE_API DepotFlushType::Enum FlushType(size_t rowIndex) const;
+		P4VFS_CORE_API bool IsAlwaysResident(size_t rowIndex) const;
+		P4VFS_CORE_API bool IsPreview(size_t rowIndex) const;
+		P4VFS_CORE_API int64_t Value(DepotSyncActionColumn::Enum column, size_t rowIndex) const;
+
+		P4VFS_CORE_API int64_t Sum(DepotSyncActionColumn::Enum column, const IndexArray* rowIndices = nullptr) const;
+		P4VFS_CORE_API IndexArray Select(const std::function<bool(const FDepotSyncActionTable& table, size_t rowIndex)>& predicate) const;
+
+		P4VFS_CORE_API DepotSyncActionInfo ToActionInfo(size_t rowIndex) const;
+		P4VFS_CORE_API DepotSyncActionInfoArray ToActionInfoArray(const IndexArray* rowIndices = nullptr) const;
+		P4VFS_CORE_API DepotSyncActionTable Slice(const IndexArray& rowIndices) const;
+
+		P4VFS_CORE_API static DepotSyncActionTable FromArray(const Array<DepotSyncActionInfo>& modifications);
+		P4VFS_CORE_API static DepotSyncActionInfo Checkout(const DepotSyncActionTable& table, size_t rowIndex);
+		P4VFS_CORE_API static DepotSyncActionInfo CheckoutAppend(const DepotSyncActionTable& table, const DepotSyncActionInfo& modification);
+		P4VFS_CORE_API static size_t GetRowIndex(const DepotSyncActionInfo& modification);
+
+	private:
+		// The deleter of a checked out record, which writes the record back to its row
+		struct FRowWriter
+		{
+			DepotSyncActionTable m_Table;
+			size_t m_RowIndex;
+			DepotSyncActionInfo m_Modification;
+
+			void operator()(FDepotSyncActionInfo* modification) const;
+		};
+
+		struct FPath
+		{
+			uint32_t m_Folder;
+			uint32_t m_Name;
+		};
+
+		enum : int32_t
+		{
+			RevisionNull = -1,
+			RevisionStringBase = -2,
+		};
+
+		enum : uint32_t
+		{
+			StringNull = 0,
+		};
+
+		void WriteRow(size_t rowIndex, const FDepotSyncActionInfo& modification);
+		FPath InternPath(const DepotString& path);
+		uint32_t InternString(const char* text, size_t length);
+		DepotString GetPath(const FPath& path) const;
+		DepotString GetString(uint32_t stringId) const;
+
+	private:
+		Array<char> m_StringArena;
+		Array<uint32_t> m_StringOffsets;
+		UnorderedMultiMap<size_t, uint32_t> m_StringIds;
+
+		Array<FPath> m_DepotFiles;
+		Array<FPath> m_ClientFiles;
+		Array<int32_t> m_Revisions;
+		Array<uint8_t> m_SyncActionTypes;
+		Array<uint8_t> m_SyncActionFlags;
+		Array<uint8_t> m_SyncFlags;
+		Array<uint8_t> m_FlushTypes;
+		Array<bool> m_IsAlwaysResident;
+		Array<int64_t> m_Values[DepotSyncActionColumn::Count];
+		HashMap<uint32_t, DepotString> m_Messages;
+		HashMap<uint32_t, DepotString> m_SymlinkTargets;
+		HashMap<uint32_t, Array<DepotSyncActionInfo>> m_SubActions;
+		mutable CriticalSection m_RowsLock;
+	};
+
+}}}
+
+#pragma managed(pop)
@@ -0,0 +1,61 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotSyncActionTable.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	// Schedules the rows of a sync table by client directory, so that each worker applies whole directories
+	// instead of interleaving files from the same directories with other workers. A directory with more than
+	// the maximum group size is split into several groups. Once every group of a directory has been applied,
+	// the directory is finalized a single time if any of its modifications removed a file.
+	struct FDepotSyncDirectoryScheduler
+	{
+		// Applies the modification of a row, returning true if a file was removed from its directory
+		typedef std::function<bool(size_t rowIndex)> ApplyCallback;
+
+		// Called once for each directory from which files were removed, after all of its modifications are applied
+		typedef std::function<void(const DepotString& folderPath)> FinalizeCallback;
+
+		static const size_t DefaultMaxGroupSize = 1024;
+
+		P4VFS_CORE_API FDepotSyncDirectoryScheduler(const FDepotSyncActionTable& modifications, size_t maxGroupSize = DefaultMaxGroupSize);
+		P4VFS_CORE_API ~FDepotSyncDirectoryScheduler();
+
+		P4VFS_CORE_API size_t Execute(size_t maxThreads, HANDLE cancelationEvent, const FileCore::UserContext* userContext, const ApplyCallback& apply, const FinalizeCallback& finalize);
+
+		P4VFS_CORE_API size_t GetDirectoryCount() const;
+		P4VFS_CORE_API size_t GetGroupCount() const;
+		P4VFS_CORE_API const FDepotSyncActionTable::IndexArray& GetGroupRowIndices(size_t groupIndex) const;
+		P4VFS_CORE_API const DepotString& GetGroupFolderPath(size_t groupIndex) const;
+
+		P4VFS_CORE_API static DepotString GetFolderPath(const DepotString& clientFile);
+
+	private:
+		struct FDirectory
+		{
+			DepotString m_FolderPath;
+			size_t m_PendingGroupCount;
+			size_t m_RemovedCount;
+		};
+
+		struct FGroup
+		{
+			size_t m_DirectoryIndex;
+			FDepotSyncActionTable::IndexArray m_RowIndices;
+		};
+
+		void ApplyGroup(FGroup& group, HANDLE cancelationEvent, const ApplyCallback& apply, const FinalizeCallback& finalize);
+
+	private:
+		Array<FDirectory> m_Directories;
+		Array<FGroup> m_Groups;
+		CriticalSection m_DirectoriesLock;
+	};
+
+}}}
+
+#pragma managed(pop)
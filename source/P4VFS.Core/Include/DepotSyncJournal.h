@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotClient.h"
+#include "DepotSyncOptions.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	// A memory mapped file recording the modifications of a virtual sync, with their messages and sub-actions, followed
+	// by a completion bit for each modification. The modifications are written once when the journal is created, and completion bits are
+	// set atomically from any thread. A later sync with the same key can resume from the incomplete modifications.
+	class DepotSyncJournal
+	{
+	public:
+		DepotSyncJournal();
+		~DepotSyncJournal();
+
+		bool Create(const FileCore::String& filePath, const DepotString& key, const DepotSyncActionInfoArray& modifications);
+		bool Open(const FileCore::String& filePath, const DepotString& key, DepotSyncActionInfoArray& remainingModifications);
+		void Close();
+		void Flush();
+
+		// Marks the modification at this index of the modifications given to Create, or returned by Open, as complete
+		void MarkComplete(size_t modificationIndex);
+		bool IsComplete(size_t recordIndex) const;
+		bool IsOpen() const;
+
+		size_t GetRecordCount() const;
+		size_t GetCompleteCount() const;
+		const FileCore::String& GetFilePath() const;
+
+		static DepotString CreateKey(DepotClient& depotClient, const FDepotSyncOptions& syncOptions, const DepotRevision& revision);
+		static FileCore::String GetJournalDirectory(DepotClient& depotClient);
+		static FileCore::String GetJournalFilePath(DepotClient& depotClient, const DepotString& key);
+		static void DeleteClientJournals(DepotClient& depotClient, const FileCore::String& keepFilePath = FileCore::String());
+
+	private:
+		struct FHeader
+		{
+			uint32_t m_Signature;
+			uint32_t m_Version;
+			uint64_t m_FileSize;
+			uint64_t m_KeyOffset;
+			uint64_t m_KeySize;
+			uint64_t m_RecordCount;
+			uint64_t m_CompletionOffset;
+			uint64_t m_RecordsOffset;
+		};
+
+		bool MapFile(const FileCore::String& filePath, DWORD creationDisposition, uint64_t fileSize);
+		volatile LONG* CompletionWords() const;
+
+	private:
+		FileCore::String m_FilePath;
+		FileCore::AutoHandle m_FileHandle;
+		FileCore::AutoHandle m_MappingHandle;
+		uint8_t* m_View;
+		uint64_t m_ViewSize;
+		Array<size_t>* m_RecordIndices;
+		std::atomic<size_t> m_CompleteCount;
+		std::atomic<size_t> m_UnflushedCount;
+	};
+
+}}}
+
+#pragma managed(pop)
@@ -0,0 +1,119 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotResult.h"
+#include "DepotSyncAction.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	struct DepotSyncPipelineStage
+	{
+		enum Enum
+		{
+			Preview,
+			Resolve,
+			Apply,
+		};
+	};
+
+	// A bounded queue between the stages of a pipeline, which is closed by the producer once it has pushed its last item
+	template <typename ItemType>
+	class DepotQueue
+	{
+	public:
+		DepotQueue(size_t capacity) :
+			m_Capacity(std::max<size_t>(1, std::min<size_t>(capacity, LONG_MAX))),
+			m_ItemSemaphore(CreateSemaphore(NULL, 0, LONG_MAX, NULL)),
+			m_SlotSemaphore(CreateSemaphore(NULL, LONG(m_Capacity), LONG(m_Capacity), NULL)),
+			m_ClosedEvent(CreateEvent(NULL, TRUE, FALSE, NULL))
+		{}
+
+		// Blocks while the queue is full. Returns false if the queue was closed or the cancelation event is set.
+		bool Push(const ItemType& item, HANDLE cancelationEvent = NULL)
+		{
+			// The closed event is first so that a push to a closed queue always fails
+			HANDLE handles[3] = { m_ClosedEvent.Handle(), m_SlotSemaphore.Handle(), cancelationEvent };
+			const DWORD handleCount = cancelationEvent != NULL ? 3 : 2;
+			if (WaitForMultipleObjects(handleCount, handles, FALSE, INFINITE) != WAIT_OBJECT_0+1)
+			{
+				return false;
+			}
+
+			{
+				AutoCriticalSection lock(m_ItemsLock);
+				m_Items.push_back(item);
+			}
+			ReleaseSemaphore(m_ItemSemaphore.Handle(), 1, NULL);
+			return true;
+		}
+
+		// Blocks while the queue is empty. Returns false once the queue is closed and drained, or the cancelation event is set,
+		// or with timedOut set if no item arrived within timeoutMs.
+		bool Pop(ItemType& item, HANDLE cancelationEvent = NULL, DWORD timeoutMs = INFINITE, bool* timedOut = nullptr)
+		{
+			// Pending items are preferred over the closed event so that the queue is drained after Close
+			HANDLE handles[3] = { cancelationEvent, m_ItemSemaphore.Handle(), m_ClosedEvent.Handle() };
+			const DWORD handleOffset = cancelationEvent != NULL ? 0 : 1;
+			const DWORD waitResult = WaitForMultipleObjects(3-handleOffset, handles+handleOffset, FALSE, timeoutMs);
+			if (timedOut != nullptr)
+			{
+				*timedOut = waitResult == WAIT_TIMEOUT;
+			}
+			if (waitResult != WAIT_OBJECT_0+1-handleOffset)
+			{
+				return false;
+			}
+
+			PopFront(item);
+			return true;
+		}
+
+		bool TryPop(ItemType& item)
+		{
+			if (WaitForSingleObject(m_ItemSemaphore.Handle(), 0) != WAIT_OBJECT_0)
+			{
+				return false;
+			}
+
+			PopFront(item);
+			return true;
+		}
+
+		void Close()
+		{
+			SetEvent(m_ClosedEvent.Handle());
+		}
+
+		size_t Capacity() const
+		{
+			return m_Capacity;
+		}
+
+	private:
+		void PopFront(ItemType& item)
+		{
+			{
+				AutoCriticalSection lock(m_ItemsLock);
+				item = m_Items.front();
+				m_Items.pop_front();
+			}
+			ReleaseSemaphore(m_SlotSemaphore.Handle(), 1, NULL);
+		}
+
+	private:
+		size_t m_Capacity;
+		CriticalSection m_ItemsLock;
+		List<ItemType> m_Items;
+		AutoHandle m_ItemSemaphore;
+		AutoHandle m_SlotSemaphore;
+		AutoHandle m_ClosedEvent;
+	};
+
+	typedef DepotQueue<DepotSyncActionInfo> DepotSyncActionQueue;
+
+}}}
+
+#pragma managed(pop)
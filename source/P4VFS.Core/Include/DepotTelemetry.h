@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DepotResult.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	// The measurements of one command run by a DepotClient. The client time is spent handling the output of the command,
+	// and the remainder of the total time is spent waiting on the server.
+	struct FDepotCommandSample
+	{
+		FDepotCommandSample() :
+			m_Name(nullptr),
+			m_ArgCount(0),
+			m_RecordCount(0),
+			m_ByteCount(0),
+			m_ErrorCount(0),
+			m_TotalUs(0),
+			m_ClientUs(0)
+		{}
+
+		const char* m_Name;
+		size_t m_ArgCount;
+		size_t m_RecordCount;
+		uint64_t m_ByteCount;
+		size_t m_ErrorCount;
+		int64_t m_TotalUs;
+		int64_t m_ClientUs;
+	};
+
+	// The sum of the samples of all commands with the same name. Bucket i of the histogram counts the commands which
+	// took at least 2^(i-1) and less than 2^i microseconds in total, and the last bucket counts any longer ones.
+	struct FDepotCommandStats
+	{
+		static const size_t HistogramBucketCount = 32;
+
+		FDepotCommandStats() :
+			m_Count(0),
+			m_ErrorCount(0),
+			m_ArgCount(0),
+			m_RecordCount(0),
+			m_ByteCount(0),
+			m_TotalUs(0),
+			m_ServerUs(0),
+			m_ClientUs(0),
+			m_MaxUs(0),
+			m_Histogram()
+		{}
+
+		DepotString m_Name;
+		uint64_t m_Count;
+		uint64_t m_ErrorCount;
+		uint64_t m_ArgCount;
+		uint64_t m_RecordCount;
+		uint64_t m_ByteCount;
+		uint64_t m_TotalUs;
+		uint64_t m_ServerUs;
+		uint64_t m_ClientUs;
+		uint64_t m_MaxUs;
+		std::array<uint64_t, HistogramBucketCount> m_Histogram;
+	};
+
+	typedef Array<FDepotCommandStats> DepotCommandStatsArray;
+
+	// Collects the samples of the commands run on every thread while DepotClientTelemetry is enabled. Each thread adds
+	// its samples to counters of its own without taking a lock, and GetStats sums the counters of all threads. The
+	// counters of a thread which has exited are kept, and are reused by the next thread which records a sample.
+	struct DepotTelemetry
+	{
+		P4VFS_CORE_API static bool IsEnabled();
+		P4VFS_CORE_API static void Record(const FDepotCommandSample& sample);
+		P4VFS_CORE_API static DepotCommandStatsArray GetStats();
+		P4VFS_CORE_API static void Reset();
+
+		// The stats added since a baseline taken with GetStats. The maximum time is kept from stats.
+		P4VFS_CORE_API static DepotCommandStatsArray Subtract(const DepotCommandStatsArray& stats, const DepotCommandStatsArray& baseline);
+
+		P4VFS_CORE_API static DepotString ToJson(const DepotCommandStatsArray& stats);
+		P4VFS_CORE_API static size_t GetHistogramBucket(int64_t timeUs);
+	};
+
+}}}
+
+#pragma managed(pop)
@@ -0,0 +1,119 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "FileCore.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+	struct FDepotTextEncoder
+	{
+		virtual ~FDepotTextEncoder() {}
+		virtual void Encode(const char** pdata, int32_t* plength) {}
+	};
+
+	struct DepotTextLineEnd
+	{
+		struct Method { enum Enum
+		{
+			Scalar,
+			Sse2,
+			Avx2,
+		};};
+
+		// Copies srcNum characters to dst with a carriage return inserted before each line feed, and returns the number
+		// of characters written. The dst buffer must have room for twice srcNum characters. Each block of 16 or 32 bytes
+		// without a line feed is copied whole, and the runs between line feeds are copied in bulk.
+		static size_t InsertCr(const char* src, size_t srcNum, char* dst, Method::Enum method);
+		static size_t InsertCr(const wchar_t* src, size_t srcNum, wchar_t* dst, Method::Enum method);
+
+		// The fastest method supported by this processor
+		static Method::Enum GetDefaultMethod();
+		static bool IsMethodSupported(Method::Enum method);
+	};
+
+	struct FDepotTextEncoderPlatformBase : FDepotTextEncoder
+	{
+		struct Flags { enum Enum
+		{
+			None		= 0,
+			CrLf		= 1<<0,
+			Bom			= 1<<1,
+			Utf8		= 1<<2,
+			Utf16		= 1<<3,
+			TextUtf8	= Utf8|Bom,
+			TextUtf16	= Utf16|Bom,
+		};};
+	};
+
+	DEFINE_ENUM_FLAG_OPERATORS(FDepotTextEncoderPlatformBase::Flags::Enum);
+
+	// Writes the byte order mark once at the start of the output, and converts line endings to CRLF. The output buffer is
+	// kept between calls, and only grows when a chunk needs more room than any before it.
+	template <typename CharType>
+	struct FDepotTextEncoderPlatform : FDepotTextEncoderPlatformBase
+	{
+		FDepotTextEncoderPlatform(Flags::Enum flags, DepotTextLineEnd::Method::Enum method = DepotTextLineEnd::GetDefaultMethod()) :
+			m_Flags(flags),
+			m_Method(method)
+		{
+		}
+
+		void Encode(const char** pdata, int32_t* plength) override
+		{
+			if (pdata != nullptr && *pdata != nullptr && plength != nullptr && *plength > 0)
+			{
+				uint8_t bom[3] = {};
+				size_t bomSize = 0;
+				if (m_Flags & Flags::Bom)
+				{
+					m_Flags &= ~Flags::Bom;
+					if (m_Flags & Flags::Utf8)
+					{
+						bom[0] = 0xEF; bom[1] = 0xBB; bom[2] = 0xBF;
+						bomSize = 3;
+					}
+					else if (m_Flags & Flags::Utf16)
+					{
+						bom[0] = 0xFF; bom[1] = 0xFE;
+						bomSize = 2;
+					}
+				}
+
+				if (bomSize == 0 && (m_Flags & Flags::CrLf) == 0)
+					return;
+
+				const size_t srcNum = size_t(*plength) / sizeof(CharType);
+				const CharType* src = reinterpret_cast<const CharType*>(*pdata);
+				const size_t maxSize = bomSize + srcNum*sizeof(CharType)*(m_Flags & Flags::CrLf ? 2 : 1);
+				if (m_Buffer.size() < maxSize)
+					m_Buffer.resize(maxSize);
+
+				memcpy(m_Buffer.data(), bom, bomSize);
+				CharType* dst = reinterpret_cast<CharType*>(m_Buffer.data() + bomSize);
+				size_t dstNum = srcNum;
+				if (m_Flags & Flags::CrLf)
+					dstNum = DepotTextLineEnd::InsertCr(src, srcNum, dst, m_Method);
+				else
+					memcpy(dst, src, srcNum*sizeof(CharType));
+
+				const size_t dstSize = bomSize + dstNum*sizeof(CharType);
+				if (dstSize > 0)
+				{
+					*pdata = reinterpret_cast<const char*>(m_Buffer.data());
+					*plength = int32_t(dstSize);
+				}
+			}
+		}
+
+	private:
+		int32_t m_Flags;
+		DepotTextLineEnd::Method::Enum m_Method;
+		Array<uint8_t> m_Buffer;
+	};
+
+}}}
+
+#pragma managed(pop)
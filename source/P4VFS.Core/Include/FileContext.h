@@ -9,6 +9,7 @@ namespace Microsoft {
 namespace P4VFS {
 namespace P4 {
 	class DepotClientCache;
+	class DepotContentCache;
 }}};
 
 namespace Microsoft {
@@ -33,11 +34,13 @@ namespace FileCore {
 		LogDevice* m_LogDevice;
 		UserContext* m_UserContext;
 		P4::DepotClientCache* m_DepotClientCache;
+		P4::DepotContentCache* m_DepotContentCache;
 
 		FileContext() :
 			m_LogDevice(nullptr),
 			m_UserContext(nullptr),
-			m_DepotClientCache(nullptr)
+			m_DepotClientCache(nullptr),
+			m_DepotContentCache(nullptr)
 		{}
 
 		ULONG SessionId() const { return m_UserContext ? m_UserContext->m_SessionId : 0; }
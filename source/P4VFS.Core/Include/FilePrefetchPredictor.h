@@ -0,0 +1,164 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "FileCore.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace FileSystem {
+
+	struct FFilePrefetchPredictorOptions
+	{
+		FFilePrefetchPredictorOptions() :
+			m_WindowMs(10000),
+			m_WindowMaxFiles(32),
+			m_MaxLinks(16),
+			m_MaxNodes(100000),
+			m_MinLinkCount(2),
+			m_DirectoryMinFiles(2)
+		{}
+
+		// Files hydrated within this window of each other are linked as accessed together
+		int64_t m_WindowMs;
+		size_t m_WindowMaxFiles;
+		// The most links kept from a file, replacing the least counted one, and the most files with links
+		size_t m_MaxLinks;
+		size_t m_MaxNodes;
+		// The times a link must be seen before it is predicted
+		uint32_t m_MinLinkCount;
+		// The distinct files of a folder which must be hydrated within the window for it to be read as a directory
+		size_t m_DirectoryMinFiles;
+	};
+
+	struct FFilePrefetchPrediction
+	{
+		FFilePrefetchPrediction() :
+			m_IsDirectoryAccess(false)
+		{}
+
+		// The files previously hydrated after this one, most often first
+		FileCore::StringArray m_FilePaths;
+		// Whether the folder of this file is being read through, so that its other placeholders are likely next
+		bool m_IsDirectoryAccess;
+	};
+
+	// A hydration request recorded in a trace file as a line of "<time ms>\t<file size>\t<file path>"
+	struct FFilePrefetchTraceEntry
+	{
+		FFilePrefetchTraceEntry() :
+			m_TimeMs(0),
+			m_FileSize(0)
+		{}
+
+		int64_t m_TimeMs;
+		int64_t m_FileSize;
+		FileCore::String m_FilePath;
+	};
+
+	struct FFilePrefetchBudget
+	{
+		FFilePrefetchBudget() :
+			m_MaxFiles(16),
+			m_MaxBytes(64*1024*1024),
+			m_MaxFileSize(16*1024*1024)
+		{}
+
+		// The most files and bytes prefetched for one request, and the largest file which is prefetched at all
+		size_t m_MaxFiles;
+		int64_t m_MaxBytes;
+		int64_t m_MaxFileSize;
+	};
+
+	struct FFilePrefetchReplayOptions
+	{
+		FFilePrefetchReplayOptions() :
+			m_CoAccess(true),
+			m_Directory(true)
+		{}
+
+		FFilePrefetchBudget m_Budget;
+		bool m_CoAccess;
+		bool m_Directory;
+		// The placeholders which may be prefetched besides the files of the trace, such as a listing of the workspace.
+		// Their times are ignored.
+		FileCore::Array<FFilePrefetchTraceEntry> m_Placeholders;
+	};
+
+	struct FFilePrefetchReplayStats
+	{
+		FFilePrefetchReplayStats() :
+			m_RequestCount(0),
+			m_RequestBytes(0),
+			m_HitCount(0),
+			m_HitBytes(0),
+			m_PrefetchCount(0),
+			m_PrefetchBytes(0),
+			m_WastedCount(0),
+			m_WastedBytes(0)
+		{}
+
+		// The first access of each file in the trace, of which hits were prefetched before they were accessed
+		uint64_t m_RequestCount;
+		uint64_t m_RequestBytes;
+		uint64_t m_HitCount;
+		uint64_t m_HitBytes;
+		uint64_t m_PrefetchCount;
+		uint64_t m_PrefetchBytes;
+		// Prefetched files which were never accessed
+		uint64_t m_WastedCount;
+		uint64_t m_WastedBytes;
+
+		P4VFS_CORE_API double HitRate() const;
+		P4VFS_CORE_API FileCore::String ToString() const;
+	};
+
+	// Learns which files are hydrated together from the order of hydration requests, in order to predict the files
+	// likely to be hydrated next. Each file links to the files hydrated within a short window after it, counting how
+	// often each link is seen, and the links are saved to a history file so that they are kept across runs. A folder
+	// whose files are hydrated one after another is also reported, since its remaining placeholders are likely next.
+	class P4VFS_CORE_API FilePrefetchPredictor
+	{
+	public:
+		FilePrefetchPredictor(const FFilePrefetchPredictorOptions& options = FFilePrefetchPredictorOptions());
+		~FilePrefetchPredictor();
+
+		// Records the hydration of a file at a time in milliseconds, linking it from the files hydrated before it
+		void Observe(const FileCore::String& filePath, int64_t timeMs);
+
+		// The files likely to follow a file, as of the last time it was observed
+		FFilePrefetchPrediction Predict(const FileCore::String& filePath, int64_t timeMs) const;
+
+		void Clear();
+		size_t GetFileCount() const;
+		size_t GetLinkCount() const;
+
+		// The links are saved as lines of "<count>\t<file path>\t<linked file path>"
+		bool Save(const FileCore::String& filePath) const;
+		bool Load(const FileCore::String& filePath);
+
+		// Replays a trace against this predictor as the service would, prefetching the predicted files after each
+		// request for a file which was not already prefetched. Only those requests are observed, since a prefetched file
+		// is no longer a placeholder and is not requested again. The placeholders of a folder are taken to be the files
+		// of that folder in the trace and in m_Placeholders, and each prefetch is taken to complete before the next
+		// request.
+		FFilePrefetchReplayStats Replay(const FileCore::Array<FFilePrefetchTraceEntry>& trace, const FFilePrefetchReplayOptions& options);
+
+		static bool LoadTrace(const FileCore::String& filePath, FileCore::Array<FFilePrefetchTraceEntry>& trace);
+		static FileCore::String FormatTraceEntry(const FFilePrefetchTraceEntry& entry);
+
+		// Orders the other files of a folder by name, starting with the first one after filePath, since a folder is
+		// most often read through in order
+		static void SortSiblings(FileCore::StringArray& siblingPaths, const FileCore::String& filePath);
+
+	private:
+		struct Model;
+
+	private:
+		mutable FileCore::CriticalSection m_Lock;
+		Model* m_Model;
+	};
+
+}}}
+
+#pragma managed(pop)
@@ -0,0 +1,119 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "FileCore.h"
+#pragma managed(push, off)
+
+namespace Microsoft {
+namespace P4VFS {
+namespace FileSystem {
+
+	// Coalesces concurrent requests to resolve the same file. The first request for a file begins its resolve, and any
+	// request for the file which arrives before the resolve ends is attached to it instead of being resolved again. The
+	// attached requests are handed back when the resolve ends, so that they are all given its result at once. Files are
+	// keyed by path without regard to case.
+	template <typename RequestType>
+	class FileResolveCoalescer
+	{
+	public:
+		typedef FileCore::Array<RequestType> RequestArray;
+
+		FileResolveCoalescer() :
+			m_WaiterCount(0)
+		{}
+
+		// Begins the resolve of a file, returning true if the caller is to resolve it, or false if the request was
+		// attached to the resolve already in progress
+		bool Begin(const FileCore::String& filePath, const RequestType& request)
+		{
+			FileCore::AutoCriticalSection lock(m_Lock);
+			std::pair<typename ResolveMap::iterator, bool> resolve = m_Resolves.insert(std::make_pair(CreateKey(filePath), RequestArray()));
+			if (resolve.second)
+			{
+				return true;
+			}
+
+			resolve.first->second.push_back(request);
+			m_WaiterCount++;
+			return false;
+		}
+
+		// Attaches a request to the resolve of a file in progress, returning false if the file is not being resolved
+		bool Attach(const FileCore::String& filePath, const RequestType& request)
+		{
+			FileCore::AutoCriticalSection lock(m_Lock);
+			typename ResolveMap::iterator resolve = m_Resolves.find(CreateKey(filePath));
+			if (resolve == m_Resolves.end())
+			{
+				return false;
+			}
+
+			resolve->second.push_back(request);
+			m_WaiterCount++;
+			return true;
+		}
+
+		// Ends the resolve of a file, returning the requests which were attached to it
+		RequestArray End(const FileCore::String& filePath)
+		{
+			RequestArray waiters;
+			FileCore::AutoCriticalSection lock(m_Lock);
+			typename ResolveMap::iterator resolve = m_Resolves.find(CreateKey(filePath));
+			if (resolve != m_Resolves.end())
+			{
+				waiters.swap(resolve->second);
+				m_Resolves.erase(resolve);
+				m_WaiterCount -= waiters.size();
+			}
+			return waiters;
+		}
+
+		// Ends every resolve, returning all of the attached requests
+		RequestArray Clear()
+		{
+			RequestArray waiters;
+			FileCore::AutoCriticalSection lock(m_Lock);
+			for (typename ResolveMap::value_type& resolve : m_Resolves)
+			{
+				waiters.insert(waiters.end(), resolve.second.begin(), resolve.second.end());
+			}
+			m_Resolves.clear();
+			m_WaiterCount = 0;
+			return waiters;
+		}
+
+		bool IsResolving(const FileCore::String& filePath) const
+		{
+			FileCore::AutoCriticalSection lock(m_Lock);
+			return m_Resolves.find(CreateKey(filePath)) != m_Resolves.end();
+		}
+
+		size_t GetResolveCount() const
+		{
+			FileCore::AutoCriticalSection lock(m_Lock);
+			return m_Resolves.size();
+		}
+
+		size_t GetWaiterCount() const
+		{
+			FileCore::AutoCriticalSection lock(m_Lock);
+			return m_WaiterCount;
+		}
+
+	private:
+		typedef FileCore::HashMap<FileCore::String, RequestArray> ResolveMap;
+
+		static FileCore::String CreateKey(const FileCore::String& filePath)
+		{
+			return FileCore::StringInfo::ToLower(filePath.c_str());
+		}
+
+	private:
+		mutable FileCore::CriticalSection m_Lock;
+		ResolveMap m_Resolves;
+		size_t m_WaiterCount;
+	};
+
+}}}
+
+#pragma managed(pop)
@@ -51,6 +51,14 @@ namespace FileSystem {
 		BYTE* fileResidencyPolicy
 		);
 
+	// Hydrates a placeholder ahead of a request for it, using only an idle pooled client. Returns S_FALSE if the file is
+	// not a resident placeholder or there is no idle client.
+	P4VFS_CORE_API HRESULT 
+	PrefetchFileResidency(
+		FileCore::FileContext& context,
+		const WCHAR* filePath
+		);
+
 	P4VFS_CORE_API bool
 	IsExcludedProcessId(
 		ULONG processId
@@ -172,16 +172,24 @@ namespace FileCore {
 		bool m_HeaderWritten;
 	};
 
+	// Keeps the elements written at or above a level, up to an optional maximum count. Every element
+	// is counted by channel, including those which are not kept.
 	struct LogDeviceMemory : LogDevice
 	{
-		LogDeviceMemory();
+		LogDeviceMemory(LogChannel::Enum level = LogChannel::Verbose, size_t maxElements = 0);
 
 		virtual void Write(const LogElement& element) override;
 		const List<LogElement>& GetElements() const;
+		size_t GetChannelCount(LogChannel::Enum channel) const;
+		size_t GetDroppedCount() const;
 
 	private:
 		List<LogElement> m_Elements;
 		AutoHandle m_ElementsMutex;
+		LogChannel::Enum m_Level;
+		size_t m_MaxElements;
+		size_t m_ChannelCounts[LogChannel::Error+1];
+		size_t m_DroppedCount;
 	};
 
 	struct LogDeviceAggregate : LogDevice
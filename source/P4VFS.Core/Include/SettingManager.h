@@ -32,6 +32,39 @@ namespace FileCore {
 		_N( int32_t,  GarbageCollectPeriodMs,          5*60*1000 ) \
 		_N( int32_t,  DepotClientCacheIdleTimeoutMs,   5*60*1000 ) \
 		_N( int32_t,  MaxDiff2StatFileCount,           0 ) \
+		_N( int32_t,  SyncFlushBatchSize,              500 ) \
+		_N( int32_t,  SyncFlushBatchDeadlineMs,        2000 ) \
+		_N( bool,     SyncPipeline,                    false ) \
+		_N( int32_t,  SyncPipelineQueueSize,           4096 ) \
+		_N( int32_t,  SyncPipelineResolveBatchSize,    1000 ) \
+		_N( String,   SyncJournalDirectory,            L"" ) \
+		_N( bool,     SyncStreaming,                   false ) \
+		_N( int32_t,  SyncStreamingMaxLogElements,     1000 ) \
+		_N( bool,     SyncDirectoryScheduling,         true ) \
+		_N( int32_t,  SyncResidentBatchSizeMB,         64 ) \
+		_N( int32_t,  SyncResidentBatchMaxFiles,       500 ) \
+		_N( bool,     AdaptiveConcurrency,             false ) \
+		_N( int32_t,  AdaptiveConcurrencyMin,          2 ) \
+		_N( int32_t,  AdaptiveConcurrencyMax,          32 ) \
+		_N( bool,     DepotResultArenaTags,            true ) \
+		_N( int32_t,  DepotClientPipelineDepth,        32 ) \
+		_N( int32_t,  HydratePrintBatchSize,           0 ) \
+		_N( int32_t,  DepotConnectionCacheTimeoutMs,   60*1000 ) \
+		_N( int32_t,  DepotClientCacheWarmCount,       1 ) \
+		_N( int32_t,  DepotClientCachePeriodMs,        10*1000 ) \
+		_N( bool,     DepotClientTelemetry,            false ) \
+		_N( String,   DepotContentCacheDirectory,      L"" ) \
+		_N( int32_t,  DepotContentCacheSizeMB,         10*1024 ) \
+		_N( String,   PopulateShareDirectory,          L"" ) \
+		_N( bool,     PopulateShareWriteBack,          false ) \
+		_N( bool,     Prefetch,                        false ) \
+		_N( int32_t,  PrefetchMaxFiles,                16 ) \
+		_N( int32_t,  PrefetchMaxBytesMB,              64 ) \
+		_N( int32_t,  PrefetchMaxFileSizeMB,           16 ) \
+		_N( int32_t,  PrefetchMaxConcurrency,          2 ) \
+		_N( int32_t,  PrefetchCancelLoad,              4 ) \
+		_N( String,   PrefetchHistoryFile,             L"%ProgramData%\\P4VFS\\PrefetchHistory.txt" ) \
+		_N( String,   PrefetchTraceFile,               L"" ) \
 
 
 	class SettingManager;
@@ -2,8 +2,11 @@
 // Licensed under the MIT license.
 #include "Pch.h"
 #include "DepotClient.h"
+#include "DepotConnectionCache.h"
 #include "DepotDateTime.h"
+#include "DepotTelemetry.h"
 #include "DepotConstants.h"
+#include "DepotTextEncoder.h"
 #include "FileOperations.h"
 #include "SettingManager.h"
 #include "DriverVersion.h"
@@ -26,12 +29,6 @@ namespace Microsoft {
 namespace P4VFS {
 namespace P4 {
 
-struct FDepotTextEncoder
-{
-	virtual ~FDepotTextEncoder() {}
-	virtual void Encode(const char** pdata, int32_t* plength) {}
-};
-
 struct FDepotTextEncoderCharSet : FDepotTextEncoder
 {
 	FDepotTextEncoderCharSet(CharSetApi::CharSet toCharSet)
@@ -62,98 +59,21 @@ private:
 	CharSetCvt* m_Cvt;
 };
 
-struct FDepotTextEncoderPlatformBase : FDepotTextEncoder
-{
-	struct Flags { enum Enum
-	{
-		None		= 0,
-		CrLf		= 1<<0,
-		Bom			= 1<<1,
-		Utf8		= 1<<2,
-		Utf16		= 1<<3,
-		TextUtf8	= Utf8|Bom,
-		TextUtf16	= Utf16|Bom,
-	};};
-};
-
-DEFINE_ENUM_FLAG_OPERATORS(FDepotTextEncoderPlatformBase::Flags::Enum);
-
-template <typename CharType>
-struct FDepotTextEncoderPlatform : FDepotTextEncoderPlatformBase
-{
-	FDepotTextEncoderPlatform(Flags::Enum flags) :
-		m_Flags(flags)
-	{
-	}
-
-	void Encode(const char** pdata, int32_t* plength) override
-	{
-		if (pdata != nullptr && *pdata != nullptr && plength != nullptr && *plength > 0)
-		{
-			m_Buffer.clear();
-			if (m_Flags & Flags::Bom)
-			{
-				m_Flags &= ~Flags::Bom;
-				if (m_Flags & Flags::Utf8)
-					Write({ 0xEF, 0xBB, 0xBF });
-				else if (m_Flags & Flags::Utf16)
-					Write({ 0xFF, 0xFE });
-			}
-			
-			if (m_Buffer.size() == 0 && (m_Flags & Flags::CrLf) == 0)
-				return;
-
-			const size_t srcNum = size_t(*plength) / sizeof(CharType);
-			const CharType* src = reinterpret_cast<const CharType*>(*pdata);
-			m_Buffer.reserve(std::max(m_Buffer.size(), ((srcNum*4)/3)*sizeof(CharType)));
-
-			for (size_t srcIndex = 0; srcIndex < srcNum; ++srcIndex)
-			{
-				const CharType c = src[srcIndex];
-				if (c == LITERAL(CharType, '\n') && (m_Flags & Flags::CrLf) != 0)
-					Write(LITERAL(CharType, '\r'));
-				Write(c);
-			}
-
-			if (m_Buffer.size() > 0)
-			{
-				*pdata = reinterpret_cast<const char*>(m_Buffer.data());
-				*plength = int32_t(m_Buffer.size());
-			}
-		}
-	}
-
-private:
-	void Write(const std::initializer_list<uint8_t>& data)
-	{
-		FileCore::Algo::Append(m_Buffer, data);
-	}
-
-	void Write(char data)
-	{
-		m_Buffer.push_back(uint8_t(data));
-	}
-
-	void Write(wchar_t data)
-	{
-		m_Buffer.push_back(((uint8_t*)&data)[0]);
-		m_Buffer.push_back(((uint8_t*)&data)[1]);
-	}
-
-private:
-	int32_t m_Flags;
-	Array<uint8_t> m_Buffer;
-};
-
 class DepotClientCommand : public ClientUser, IDepotClientCommand
 {
 public:
-	DepotClientCommand(FDepotClient* client, const DepotCommand* cmd, FDepotResult* result) :
+	DepotClientCommand(FDepotClient* client, const DepotCommand* cmd, FDepotResult* result, bool telemetry = false) :
 		m_TagLevel('0'),
 		m_Client(client),
 		m_Command(cmd),
 		m_Result(result)
 	{
+		if (telemetry)
+		{
+			m_Telemetry = std::make_unique<FTelemetry>();
+			m_Telemetry->m_Sample.m_Name = cmd->m_Name.c_str();
+			m_Telemetry->m_Sample.m_ArgCount = cmd->m_Args.size();
+		}
 	}
 
 	virtual ~DepotClientCommand()
@@ -172,8 +92,10 @@ public:
 
 	virtual void HandleError(Error* err) override
 	{
+		FClientTimeScope clientTime(this);
 		if (err && err->GetSeverity() != E_EMPTY)
 		{
+			AddError();
 			StrBuf buf;
 			err->Fmt(buf, EF_NEWLINE);
 			TextList().push_back(std::make_shared<FDepotResultText>(DepotResultChannel::StdErr, buf.Text()));
@@ -184,12 +106,14 @@ public:
 
 	virtual void Message(Error* err) override
 	{
+		FClientTimeScope clientTime(this);
 		if (err && err->GetSeverity() != E_EMPTY)
 		{
 			StrBuf buf;
 			err->Fmt(buf, EF_NEWLINE);
 			if (err->GetSeverity() >= E_WARN)
 			{
+				AddError();
 				TextList().push_back(std::make_shared<FDepotResultText>(DepotResultChannel::StdErr, buf.Text()));
 			}
 			else if (err->GetSeverity() >= E_INFO)
@@ -203,11 +127,16 @@ public:
 
 	virtual void OutputError(const char* errBuf) override
 	{
+		FClientTimeScope clientTime(this);
+		AddError();
 		TextList().push_back(std::make_shared<FDepotResultText>(DepotResultChannel::StdErr, errBuf ? errBuf : ""));
 	}
 
 	virtual void OutputText(const char* data, int length) override
 	{
+		FClientTimeScope clientTime(this);
+		AddRecord(data, length);
+
 		for (std::shared_ptr<FDepotTextEncoder>& encoder : m_Encoders)
 			encoder->Encode(&data, &length);
 		
@@ -224,6 +153,9 @@ public:
 
 	virtual void OutputInfo(char level, const char* data) override
 	{
+		FClientTimeScope clientTime(this);
+		AddRecord(data, -1);
+
 		if (m_Result->OnStreamInfo(this, level, data) == DepotResultReply::Handled)
 			return;
 
@@ -241,6 +173,9 @@ public:
 
 	virtual void OutputBinary(const char* data, int length) override
 	{
+		FClientTimeScope clientTime(this);
+		AddRecord(data, std::max(length, 0));
+
 		for (std::shared_ptr<FDepotTextEncoder>& encoder : m_Encoders)
 			encoder->Encode(&data, &length);
 
@@ -265,15 +200,20 @@ public:
 		if (varList == nullptr)
 			return;
 
-		TagList().push_back(std::make_shared<FDepotResultTag>());
+		FClientTimeScope clientTime(this);
+		AddRecord(nullptr, 0);
+
+		m_Result->BeginTag();
 		StrRef var, val;
 		for (int32_t varIndex = 0; varList->GetVar(varIndex, var, val); ++varIndex)
 		{
+			if (m_Telemetry)
+				m_Telemetry->m_Sample.m_ByteCount += var.Length() + val.Length();
 			if (var != P4Tag::v_specdef && var != P4Tag::v_specFormatted && var != P4Tag::v_func)
-				TagList().back()->m_Fields.insert(Map<DepotString, DepotString>::value_type(var.Text(), val.Text()));
+				m_Result->AddTagField(var.Text(), val.Text());
 		}
 
-		m_Result->OnStreamStat(this, TagList().back());
+		m_Result->OnStreamStat(this, m_Result->EndTag());
 	}
 
 	virtual void Prompt(const StrPtr& msg, StrBuf& rsp, int noEcho, Error* e)
@@ -362,7 +302,59 @@ public:
 			m_Encoders.push_back(std::make_shared<FDepotTextEncoderPlatform<wchar_t>>(platform|FDepotTextEncoderPlatformBase::Flags::TextUtf16));
 	}
 
+	// Records the sample of this command, given the time since it was sent
+	void RecordTelemetry(int64_t totalUs)
+	{
+		if (m_Telemetry)
+		{
+			m_Telemetry->m_Sample.m_TotalUs = totalUs;
+			m_Telemetry->m_Sample.m_ClientUs = m_Telemetry->m_ClientTimer.TotalMicroseconds();
+			DepotTelemetry::Record(m_Telemetry->m_Sample);
+		}
+	}
+
 private:
+	struct FTelemetry
+	{
+		FDepotCommandSample m_Sample;
+		DepotStopwatch m_ClientTimer;
+	};
+
+	// Adds the time spent in a callback to the client time of the command
+	struct FClientTimeScope
+	{
+		FClientTimeScope(DepotClientCommand* cmd) :
+			m_Timer(cmd->m_Telemetry ? &cmd->m_Telemetry->m_ClientTimer : nullptr)
+		{
+			if (m_Timer)
+				m_Timer->Start();
+		}
+
+		~FClientTimeScope()
+		{
+			if (m_Timer)
+				m_Timer->Stop();
+		}
+
+		DepotStopwatch* m_Timer;
+	};
+
+	// Counts a record of length bytes, or of a null terminated string if length is negative
+	void AddRecord(const char* data, int length)
+	{
+		if (m_Telemetry)
+		{
+			m_Telemetry->m_Sample.m_RecordCount++;
+			m_Telemetry->m_Sample.m_ByteCount += length >= 0 ? size_t(length) : (data ? strlen(data) : 0);
+		}
+	}
+
+	void AddError()
+	{
+		if (m_Telemetry)
+			m_Telemetry->m_Sample.m_ErrorCount++;
+	}
+
 	static LogChannel::Enum GetErrorLogChannel(Error* err)
 	{
 		if (err->IsInfo())
@@ -378,6 +370,7 @@ public:
 	const DepotCommand* m_Command;
 	FDepotResult* m_Result;
 	Array<std::shared_ptr<FDepotTextEncoder>> m_Encoders;
+	std::unique_ptr<FTelemetry> m_Telemetry;
 };
 
 struct FDepotClient::Api
@@ -386,6 +379,7 @@ struct FDepotClient::Api
 	std::shared_ptr<ClientApi> m_ClientApi;
 	std::shared_ptr<Error> m_Error;
 	std::shared_ptr<FDepotResultClient> m_Connection;
+	DepotString m_ConnectionKey;
 	DepotTimer m_AccessTime;
 	FileContext* m_FileContext;
 	Flags::Enum m_Flags;
@@ -479,8 +473,8 @@ bool FDepotClient::Connect(const DepotConfig& config)
 	m_P4->m_Config.SetUser(m_P4->m_ClientApi->GetUser().Text());
 	m_P4->m_Config.SetPort(m_P4->m_ClientApi->GetPort().Text());
 	m_P4->m_Config.SetDirectory(m_P4->m_ClientApi->GetCwd().Text());
-	m_P4->m_IsServerUnicode = !!GetProtocol(P4Tag::v_unicode);
-	m_P4->m_ServerApiLevel = GetProtocol(P4Tag::v_server2);
+	m_P4->m_IsServerUnicode = !!GetProtocol(P4Tag::v_unicode, m_P4->m_IsServerUnicode);
+	m_P4->m_ServerApiLevel = GetProtocol(P4Tag::v_server2, m_P4->m_ServerApiLevel);
 	return IsConnected();
 }
 
@@ -494,7 +488,10 @@ void FDepotClient::Reset()
 	m_P4->m_Config.Reset();
 	m_P4->m_Error.reset();
 	m_P4->m_Connection.reset();
+	m_P4->m_ConnectionKey.clear();
 	m_P4->m_AccessTime.Reset();
+	m_P4->m_IsServerUnicode = false;
+	m_P4->m_ServerApiLevel = 0;
 	if (m_P4->m_ClientApi.get())
 	{
 		m_P4->m_Error = std::make_shared<Error>();
@@ -525,24 +522,25 @@ bool FDepotClient::IsLoginRequired()
 		return false;
 	}
 
-	m_P4->m_Connection = Client();
-	if (m_P4->m_Connection->HasErrorRegex("use the 'p4 trust' command"))
-	{
-		Trust();
-		m_P4->m_Connection = Client();
-	}
+	// A connection to the same port, user and client as an earlier one reuses its client spec and login state, as long as
+	// it also has the same tickets and trust files, which come from the environment of the impersonated user
+	m_P4->m_ConnectionKey = DepotConnectionCache::CreateKey(m_P4->m_ClientApi->GetPort().Text(), m_P4->m_ClientApi->GetUser().Text(), m_P4->m_ClientApi->GetClient().Text(), GetTicketsFilePath(), GetTrustFilePath());
+	const DepotConnectionMetadata metadata = DepotConnectionCache::StaticInstance().Query(m_P4->m_ConnectionKey,
+		[this](const DepotCommand& cmd, FDepotResult& result) -> void
+		{
+			Run(cmd, result);
+		},
+		[this](DepotConnectionMetadata& protocol) -> void
+		{
+			protocol.m_IsServerUnicode = !!GetProtocol(P4Tag::v_unicode);
+			protocol.m_ServerApiLevel = GetProtocol(P4Tag::v_server2);
+		});
 
+	m_P4->m_Connection = metadata.m_Client;
+	m_P4->m_IsServerUnicode = metadata.m_IsServerUnicode;
+	m_P4->m_ServerApiLevel = metadata.m_ServerApiLevel;
 	m_P4->m_Config.Apply(m_P4->m_Connection->Config());
-	if (m_P4->m_Connection->Access().empty() == false)
-	{
-		return false;
-	}
-
-	if (Run("login", DepotStringArray{"-s"})->HasError() == false)
-	{
-		return false;
-	}
-	return true;
+	return metadata.m_IsLoginRequired;
 }
 
 bool FDepotClient::Login(DepotClientPromptCallback prompt)
@@ -954,6 +952,66 @@ void FDepotClient::Run(const DepotCommand& cmd, FDepotResult& result)
 		return;
 	}
 
+	const bool telemetry = DepotTelemetry::IsEnabled();
+	DepotStopwatch totalTimer(telemetry ? DepotStopwatch::Init::Start : DepotStopwatch::Init::Stop);
+
+	DepotClientCommand clientCmd(this, &cmd, &result, telemetry);
+	SetCommandArgs(cmd);
+	m_P4->m_ClientApi->Run(cmd.m_Name.c_str(), &clientCmd);
+	m_P4->m_AccessTime.Reset();
+
+	result.OnComplete();
+	clientCmd.RecordTelemetry(totalTimer.TotalMicroseconds());
+	InvalidateConnectionCache(result);
+}
+
+void FDepotClient::RunBatch(const Array<DepotCommand>& cmds, const Array<FDepotResult*>& results)
+{
+	Assert(cmds.size() == results.size());
+	if (m_P4->m_ClientApi.get() == nullptr || IsConnected() == false)
+	{
+		for (FDepotResult* result : results)
+		{
+			result->SetError(m_P4->m_ClientApi.get() == nullptr ? "DepotClient invalid ClientApi" : "DepotClient not connected");
+		}
+		return;
+	}
+
+	// The handler of each command is kept until the replies to its window have been received. The commands of a
+	// window share its time equally, since the replies to each of them are not told apart in time.
+	const bool telemetry = DepotTelemetry::IsEnabled();
+	DepotStopwatch windowTimer;
+	List<DepotClientCommand> clientCmds;
+	DepotCommandPipeline::Run(cmds, results, DepotCommandPipeline::GetDefaultDepth(), 
+		[this, &clientCmds, &windowTimer, telemetry](const DepotCommand& cmd, FDepotResult& result) -> void
+		{
+			if (telemetry && clientCmds.empty())
+				windowTimer.Restart();
+			clientCmds.emplace_back(this, &cmd, &result, telemetry);
+			SetCommandArgs(cmd);
+			m_P4->m_ClientApi->RunTag(cmd.m_Name.c_str(), &clientCmds.back());
+		},
+		[this, &clientCmds, &windowTimer, telemetry]() -> void
+		{
+			m_P4->m_ClientApi->WaitTag();
+			m_P4->m_AccessTime.Reset();
+			if (telemetry && clientCmds.size())
+			{
+				const int64_t windowUs = windowTimer.TotalMicroseconds();
+				for (DepotClientCommand& clientCmd : clientCmds)
+					clientCmd.RecordTelemetry(windowUs / int64_t(clientCmds.size()));
+			}
+			clientCmds.clear();
+		});
+
+	for (const FDepotResult* result : results)
+	{
+		InvalidateConnectionCache(*result);
+	}
+}
+
+void FDepotClient::SetCommandArgs(const DepotCommand& cmd)
+{
 	Array<const char*> argv;
 	if (cmd.m_Args.size())
 	{
@@ -962,13 +1020,42 @@ void FDepotClient::Run(const DepotCommand& cmd, FDepotResult& result)
 			argv.push_back(arg.c_str());
 	}
 
-	DepotClientCommand clientCmd(this, &cmd, &result);
 	m_P4->m_ClientApi->SetArgv(int32_t(argv.size()), argv.size() ? const_cast<char* const*>(argv.data()) : nullptr);
 	m_P4->m_ClientApi->SetVar(P4Tag::v_tag, cmd.m_Flags & DepotCommand::Flags::UnTagged ? 0 : "yes");
-	m_P4->m_ClientApi->Run(cmd.m_Name.c_str(), &clientCmd);
-	m_P4->m_AccessTime.Reset();
+}
 
-	result.OnComplete();
+void FDepotClient::InvalidateConnectionCache(const FDepotResult& result)
+{
+	if (m_P4->m_ConnectionKey.empty() == false && DepotConnectionCache::IsInvalidatingError(result))
+	{
+		DepotConnectionCache::StaticInstance().Invalidate(m_P4->m_ConnectionKey);
+	}
+}
+
+void DepotCommandPipeline::Run(const Array<DepotCommand>& cmds, const Array<FDepotResult*>& results, size_t depth, const SendCommand& send, const WaitCommand& wait)
+{
+	Assert(cmds.size() == results.size());
+	depth = std::max<size_t>(1, depth);
+
+	for (size_t windowBegin = 0; windowBegin < cmds.size(); windowBegin += depth)
+	{
+		const size_t windowEnd = std::min(cmds.size(), windowBegin + depth);
+		for (size_t cmdIndex = windowBegin; cmdIndex < windowEnd; ++cmdIndex)
+		{
+			send(cmds[cmdIndex], *results[cmdIndex]);
+		}
+
+		wait();
+		for (size_t cmdIndex = windowBegin; cmdIndex < windowEnd; ++cmdIndex)
+		{
+			results[cmdIndex]->OnComplete();
+		}
+	}
+}
+
+size_t DepotCommandPipeline::GetDefaultDepth()
+{
+	return size_t(std::max(1, FileCore::SettingManager::StaticInstance().DepotClientPipelineDepth.GetValue()));
 }
 
 bool FDepotClient::RequestInteractivePassword(DepotString& passwd)
@@ -8,63 +8,45 @@ namespace Microsoft {
 namespace P4VFS {
 namespace P4 {
 
+struct DepotClientCache::Pool
+{
+	Pool() :
+		m_UsedTime(0),
+		m_ConnectingCount(0)
+	{}
+
+	CriticalSection m_Lock;
+	DepotConfig m_Config;
+	UserContext m_UserContext;
+	List<DepotClient> m_FreeList;
+	uint64_t m_UsedTime;
+	size_t m_ConnectingCount;
+};
+
 DepotClientCache::DepotClientCache() :
-	m_FreeMap(new FreeMapType)
+	m_PoolMap(new PoolMapType),
+	m_ConnectCommand(new ConnectCommand(ConnectCommandDefault())),
+	m_ValidateCommand(new ValidateCommand(ValidateCommandDefault())),
+	m_MaintainThread(NULL)
 {
 }
 
 DepotClientCache::~DepotClientCache()
 {
-	SafeDeletePointer(m_FreeMap);
+	Stop();
+	SafeDeletePointer(m_PoolMap);
+	SafeDeletePointer(m_ConnectCommand);
+	SafeDeletePointer(m_ValidateCommand);
 }
 
 DepotClient DepotClientCache::Alloc(const DepotConfig& config, FileContext& fileContext)
 {
-	AutoCriticalSection lock(m_FreeMapLock);
-
 	const DepotString key = CreateKey(config);
-	while (true)
+	PoolPtr pool = FindPool(key, config, fileContext.m_UserContext);
+	DepotClient client = PopValidClient(*pool, true);
+	if (client.get())
 	{
-		FreeMapType::iterator clientIt = m_FreeMap->find(key);
-		if (clientIt == m_FreeMap->end())
-		{
-			break;
-		}
-
-		DepotClient client = clientIt->second;
-		m_FreeMap->erase(clientIt);
 		client->SetContext(&fileContext);
-
-		if (client->HasError())
-		{
-			if (fileContext.m_LogDevice)
-			{
-				fileContext.m_LogDevice->Info(StringInfo::Format(L"Existing client in error state, discarding [%s]", CSTR_ATOW(key)));
-			}
-			// Discard this client
-			continue;
-		}
-
-		if (client->IsConnected() == false)
-		{
-			if (fileContext.m_LogDevice)
-			{
-				fileContext.m_LogDevice->Info(StringInfo::Format(L"Existing client disconnected, discarding [%s]", CSTR_ATOW(key)));
-			}
-			// Discard this client
-			continue;
-		}
-
-		if (client->GetAccessTimeSpan() >= GetIdleTimeoutSeconds())
-		{
-			if (fileContext.m_LogDevice)
-			{
-				fileContext.m_LogDevice->Info(StringInfo::Format(L"Existing client keepalive expired, discarding [%s]", CSTR_ATOW(key)));
-			}
-			// Discard this client
-			continue;
-		}
-
 		return client;
 	}
 
@@ -73,8 +55,9 @@ DepotClient DepotClientCache::Alloc(const DepotConfig& config, FileContext& file
 		fileContext.m_LogDevice->Info(StringInfo::Format(L"Creating new client for [%s]", CSTR_ATOW(key)));
 	}
 
-	DepotClient client = FDepotClient::New(&fileContext);
-	if (client->Connect(config))
+	// The new client is connected without holding the lock of any pool
+	client = FDepotClient::New(&fileContext);
+	if ((*m_ConnectCommand)(*client, config))
 	{
 		if (fileContext.m_LogDevice)
 		{
@@ -90,50 +73,273 @@ DepotClient DepotClientCache::Alloc(const DepotConfig& config, FileContext& file
 	return nullptr;
 }
 
+DepotClient DepotClientCache::AllocIdle(const DepotConfig& config, FileContext& fileContext)
+{
+	PoolPtr pool;
+	{
+		AutoCriticalSection lock(m_PoolMapLock);
+		PoolMapType::const_iterator poolIt = m_PoolMap->find(CreateKey(config));
+		if (poolIt == m_PoolMap->end())
+		{
+			return nullptr;
+		}
+		pool = poolIt->second;
+	}
+
+	DepotClient client = PopValidClient(*pool, false);
+	if (client.get())
+	{
+		client->SetContext(&fileContext);
+	}
+	return client;
+}
+
 void DepotClientCache::Free(const DepotConfig& config, DepotClient client)
 {
 	if (client.get())
 	{
-		AutoCriticalSection lock(m_FreeMapLock);
+		PoolPtr pool = FindPool(CreateKey(config), config, client->GetUserContext());
 		client->SetContext(nullptr);
-		m_FreeMap->insert(FreeMapType::value_type(CreateKey(config), client));
+		AutoCriticalSection lock(pool->m_Lock);
+		pool->m_FreeList.push_back(client);
 	}
 }
 
 void DepotClientCache::Clear()
 {
-	AutoCriticalSection lock(m_FreeMapLock);
-	m_FreeMap->clear();
+	Array<PoolPtr> pools;
+	{
+		AutoCriticalSection lock(m_PoolMapLock);
+		for (const PoolMapType::value_type& poolPair : *m_PoolMap)
+		{
+			pools.push_back(poolPair.second);
+		}
+		m_PoolMap->clear();
+	}
+
+	// Clients are disconnected after the locks are released
+	List<DepotClient> clients;
+	for (const PoolPtr& pool : pools)
+	{
+		AutoCriticalSection lock(pool->m_Lock);
+		clients.splice(clients.end(), pool->m_FreeList);
+	}
 }
 
 void DepotClientCache::GarbageCollect(int64_t timeoutSeconds)
 {
-	if (timeoutSeconds >= 0)
+	if (timeoutSeconds < 0)
+	{
+		return;
+	}
+
+	List<DepotClient> discarded;
 	{
-		AutoCriticalSection lock(m_FreeMapLock);
-		for (FreeMapType::iterator clientIt = m_FreeMap->begin(); clientIt != m_FreeMap->end();)
+		Array<PoolPtr> pools = GetPools();
+		for (const PoolPtr& pool : pools)
 		{
-			DepotClient client = clientIt->second;
-			if (client->GetAccessTimeSpan() >= timeoutSeconds)
+			AutoCriticalSection lock(pool->m_Lock);
+			for (List<DepotClient>::iterator clientIt = pool->m_FreeList.begin(); clientIt != pool->m_FreeList.end();)
 			{
-				clientIt = m_FreeMap->erase(clientIt);
+				if ((*m_ValidateCommand)(*(*clientIt), timeoutSeconds) == false)
+				{
+					discarded.push_back(*clientIt);
+					clientIt = pool->m_FreeList.erase(clientIt);
+				}
+				else
+				{
+					++clientIt;
+				}
 			}
-			else
+		}
+	}
+
+	// A pool which is empty and unused for the timeout is removed, unless an allocation is still holding it
+	const uint64_t timeNow = GetTickCount64();
+	AutoCriticalSection lock(m_PoolMapLock);
+	for (PoolMapType::iterator poolIt = m_PoolMap->begin(); poolIt != m_PoolMap->end();)
+	{
+		const PoolPtr& pool = poolIt->second;
+		if (pool.use_count() == 1 && pool->m_FreeList.empty() && pool->m_ConnectingCount == 0 && timeNow - pool->m_UsedTime >= uint64_t(timeoutSeconds)*1000)
+		{
+			poolIt = m_PoolMap->erase(poolIt);
+		}
+		else
+		{
+			++poolIt;
+		}
+	}
+}
+
+void DepotClientCache::Maintain(size_t warmCount, int64_t timeoutSeconds)
+{
+	GarbageCollect(timeoutSeconds);
+	if (warmCount == 0 || timeoutSeconds <= 0)
+	{
+		return;
+	}
+
+	const uint64_t timeNow = GetTickCount64();
+	for (const PoolPtr& pool : GetPools())
+	{
+		size_t connectCount = 0;
+		{
+			AutoCriticalSection lock(pool->m_Lock);
+			const size_t idleCount = pool->m_FreeList.size() + pool->m_ConnectingCount;
+			if (pool->m_UsedTime != 0 && timeNow - pool->m_UsedTime < uint64_t(timeoutSeconds)*1000 && idleCount < warmCount)
 			{
-				++clientIt;
+				connectCount = warmCount - idleCount;
+				pool->m_ConnectingCount += connectCount;
 			}
 		}
+		Preconnect(pool, connectCount);
+	}
+}
+
+void DepotClientCache::Preconnect(const PoolPtr& pool, size_t connectCount)
+{
+	if (connectCount == 0)
+	{
+		return;
+	}
+
+	DepotConfig config;
+	UserContext userContext;
+	{
+		AutoCriticalSection lock(pool->m_Lock);
+		config = pool->m_Config;
+		userContext = pool->m_UserContext;
+	}
+
+	// Connects as the user of the most recent allocation from the pool
+	FileContext fileContext;
+	fileContext.m_UserContext = &userContext;
+	fileContext.m_DepotClientCache = this;
+
+	for (size_t connectIndex = 0; connectIndex < connectCount; ++connectIndex)
+	{
+		DepotClient client = FDepotClient::New(&fileContext);
+		const bool connected = (*m_ConnectCommand)(*client, config);
+		client->SetContext(nullptr);
+
+		AutoCriticalSection lock(pool->m_Lock);
+		pool->m_ConnectingCount--;
+		if (connected)
+		{
+			pool->m_FreeList.push_front(client);
+		}
+	}
+}
+
+bool DepotClientCache::Start()
+{
+	if (m_MaintainThread == NULL)
+	{
+		m_MaintainStopEvent.Reset(CreateEvent(NULL, TRUE, FALSE, NULL));
+		if (m_MaintainStopEvent.IsValid() == false)
+		{
+			return false;
+		}
+		m_MaintainThread = CreateThread(NULL, 0, &MaintainThreadEntry, this, 0, NULL);
+	}
+	return m_MaintainThread != NULL;
+}
+
+void DepotClientCache::Stop()
+{
+	if (m_MaintainThread != NULL)
+	{
+		SetEvent(m_MaintainStopEvent.Handle());
+		WaitForSingleObject(m_MaintainThread, INFINITE);
+		SafeCloseHandle(m_MaintainThread);
 	}
 }
 
-size_t DepotClientCache::GetFreeCount() const 
-{ 
-	return m_FreeMap->size(); 
+DWORD DepotClientCache::MaintainThreadEntry(void* data)
+{
+	DepotClientCache* cache = reinterpret_cast<DepotClientCache*>(data);
+	Assert(cache != nullptr);
+
+	while (WaitForSingleObject(cache->m_MaintainStopEvent.Handle(), GetMaintainPeriodMs()) != WAIT_OBJECT_0)
+	{
+		cache->Maintain(GetWarmCount(), GetIdleTimeoutSeconds());
+	}
+	return 0;
 }
 
-time_t DepotClientCache::GetIdleTimeoutSeconds()
+void DepotClientCache::SetConnectCommand(const ConnectCommand& connectCommand)
 {
-	return std::max<time_t>(0, FileCore::SettingManager::StaticInstance().DepotClientCacheIdleTimeoutMs.GetValue()/1000);
+	*m_ConnectCommand = connectCommand ? connectCommand : ConnectCommandDefault();
+}
+
+void DepotClientCache::SetValidateCommand(const ValidateCommand& validateCommand)
+{
+	*m_ValidateCommand = validateCommand ? validateCommand : ValidateCommandDefault();
+}
+
+size_t DepotClientCache::GetFreeCount() const
+{
+	size_t freeCount = 0;
+	for (const PoolPtr& pool : GetPools())
+	{
+		AutoCriticalSection lock(pool->m_Lock);
+		freeCount += pool->m_FreeList.size();
+	}
+	return freeCount;
+}
+
+size_t DepotClientCache::GetFreeCount(const DepotConfig& config) const
+{
+	PoolPtr pool;
+	{
+		AutoCriticalSection lock(m_PoolMapLock);
+		PoolMapType::const_iterator poolIt = m_PoolMap->find(CreateKey(config));
+		if (poolIt == m_PoolMap->end())
+		{
+			return 0;
+		}
+		pool = poolIt->second;
+	}
+
+	AutoCriticalSection lock(pool->m_Lock);
+	return pool->m_FreeList.size();
+}
+
+size_t DepotClientCache::GetPoolCount() const
+{
+	AutoCriticalSection lock(m_PoolMapLock);
+	return m_PoolMap->size();
+}
+
+int64_t DepotClientCache::GetIdleTimeoutSeconds()
+{
+	return std::max<int64_t>(0, FileCore::SettingManager::StaticInstance().DepotClientCacheIdleTimeoutMs.GetValue()/1000);
+}
+
+size_t DepotClientCache::GetWarmCount()
+{
+	return size_t(std::max<int32_t>(0, FileCore::SettingManager::StaticInstance().DepotClientCacheWarmCount.GetValue()));
+}
+
+DWORD DepotClientCache::GetMaintainPeriodMs()
+{
+	return DWORD(std::max<int32_t>(100, FileCore::SettingManager::StaticInstance().DepotClientCachePeriodMs.GetValue()));
+}
+
+DepotClientCache::ConnectCommand DepotClientCache::ConnectCommandDefault()
+{
+	return [](FDepotClient& client, const DepotConfig& config) -> bool
+	{
+		return client.Connect(config);
+	};
+}
+
+DepotClientCache::ValidateCommand DepotClientCache::ValidateCommandDefault()
+{
+	return [](FDepotClient& client, int64_t timeoutSeconds) -> bool
+	{
+		return client.HasError() == false && client.IsConnected() && client.GetAccessTimeSpan() < timeoutSeconds;
+	};
 }
 
 DepotString DepotClientCache::CreateKey(const DepotConfig& config)
@@ -141,5 +347,61 @@ DepotString DepotClientCache::CreateKey(const DepotConfig& config)
 	return StringInfo::Format("%s,%s,%s", config.m_Port.c_str(), config.m_User.c_str(), config.m_Client.c_str());
 }
 
-}}}
+DepotClientCache::PoolPtr DepotClientCache::FindPool(const DepotString& key, const DepotConfig& config, const UserContext* userContext)
+{
+	AutoCriticalSection lock(m_PoolMapLock);
+	PoolMapType::iterator poolIt = m_PoolMap->find(key);
+	if (poolIt != m_PoolMap->end())
+	{
+		return poolIt->second;
+	}
 
+	// The config and user of a pool are those it was created with, which Preconnect connects its idle clients as
+	PoolPtr pool = std::make_shared<Pool>();
+	pool->m_Config = config;
+	pool->m_UserContext = userContext ? *userContext : UserContext();
+	m_PoolMap->insert(PoolMapType::value_type(key, pool));
+	return pool;
+}
+
+DepotClient DepotClientCache::PopValidClient(Pool& pool, bool isUse)
+{
+	// An idle client is checked without a round trip to the server, since it may have been disconnected or have gone
+	// idle past the timeout since it was last maintained. Discarded clients are disconnected after the lock is released.
+	const int64_t timeoutSeconds = GetIdleTimeoutSeconds();
+	List<DepotClient> discarded;
+	DepotClient client;
+	{
+		AutoCriticalSection lock(pool.m_Lock);
+		if (isUse)
+		{
+			pool.m_UsedTime = GetTickCount64();
+		}
+		while (pool.m_FreeList.size())
+		{
+			client = pool.m_FreeList.back();
+			pool.m_FreeList.pop_back();
+			if ((*m_ValidateCommand)(*client, timeoutSeconds))
+			{
+				break;
+			}
+			discarded.push_back(client);
+			client = nullptr;
+		}
+	}
+	return client;
+}
+
+Array<DepotClientCache::PoolPtr> DepotClientCache::GetPools() const
+{
+	Array<PoolPtr> pools;
+	AutoCriticalSection lock(m_PoolMapLock);
+	pools.reserve(m_PoolMap->size());
+	for (const PoolMapType::value_type& poolPair : *m_PoolMap)
+	{
+		pools.push_back(poolPair.second);
+	}
+	return pools;
+}
+
+}}}
@@ -0,0 +1,240 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotConcurrencyController.h"
+#include "DepotOperations.h"
+#include "SettingManager.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+DepotString DepotConcurrencyDecision::ToString(DepotConcurrencyDecision::Enum value)
+{
+	P4VFS_ENUM_TO_STRING_RETURN(DepotString, value, DepotConcurrencyDecision, Hold);
+	P4VFS_ENUM_TO_STRING_RETURN(DepotString, value, DepotConcurrencyDecision, Increase);
+	P4VFS_ENUM_TO_STRING_RETURN(DepotString, value, DepotConcurrencyDecision, Decrease);
+	return DepotString();
+}
+
+FDepotConcurrencyOptions FDepotConcurrencyOptions::FromSettings(size_t initialConcurrency)
+{
+	FDepotConcurrencyOptions options;
+	options.m_InitialConcurrency = std::max<size_t>(1, initialConcurrency);
+	options.m_MinConcurrency = options.m_InitialConcurrency;
+	options.m_MaxConcurrency = options.m_InitialConcurrency;
+
+	const FileCore::SettingManager& settings = FileCore::SettingManager::StaticInstance();
+	if (settings.AdaptiveConcurrency.GetValue())
+	{
+		options.m_MinConcurrency = size_t(std::max(1, settings.AdaptiveConcurrencyMin.GetValue()));
+		options.m_MaxConcurrency = std::max(options.m_MinConcurrency, size_t(std::max(1, settings.AdaptiveConcurrencyMax.GetValue())));
+		options.m_InitialConcurrency = std::min(std::max(options.m_InitialConcurrency, options.m_MinConcurrency), options.m_MaxConcurrency);
+	}
+	return options;
+}
+
+DepotConcurrencyController::DepotConcurrencyController(const FDepotConcurrencyOptions& options, const ClockFunction& clock) :
+	m_Options(options),
+	m_Clock(new ClockFunction(clock)),
+	m_Stopwatch(DepotStopwatch::Init::Start),
+	m_ReleasedEvent(CreateEvent(NULL, FALSE, FALSE, NULL)),
+	m_Concurrency(0),
+	m_ActiveCount(0),
+	m_CompletedCount(0),
+	m_IncreaseCount(0),
+	m_DecreaseCount(0),
+	m_WindowCount(0),
+	m_WindowMaxActiveCount(0),
+	m_WindowLatencyUs(0),
+	m_WindowStartUs(0),
+	m_BaselineLatencyUs(-1),
+	m_PreviousItemsPerSecond(0),
+	m_Decisions(new Array<FDepotConcurrencyDecisionRecord>)
+{
+	m_Options.m_MinConcurrency = std::max<size_t>(1, m_Options.m_MinConcurrency);
+	m_Options.m_MaxConcurrency = std::max(m_Options.m_MinConcurrency, m_Options.m_MaxConcurrency);
+	m_Options.m_SampleCount = std::max<size_t>(1, m_Options.m_SampleCount);
+	m_Concurrency = std::min(std::max(m_Options.m_InitialConcurrency, m_Options.m_MinConcurrency), m_Options.m_MaxConcurrency);
+	if (*m_Clock == nullptr)
+	{
+		*m_Clock = [this]() -> int64_t { return m_Stopwatch.TotalMicroseconds(); };
+	}
+	m_WindowStartUs = (*m_Clock)();
+}
+
+DepotConcurrencyController::~DepotConcurrencyController()
+{
+	SafeDeletePointer(m_Decisions);
+	SafeDeletePointer(m_Clock);
+}
+
+bool DepotConcurrencyController::Acquire(HANDLE cancelationEvent)
+{
+	while (TryAcquire() == false)
+	{
+		// The wait is bounded since a released slot may be taken by another worker before this one wakes
+		HANDLE handles[2] = { cancelationEvent, m_ReleasedEvent.Handle() };
+		const DWORD handleOffset = cancelationEvent != NULL ? 0 : 1;
+		if (WaitForMultipleObjects(2-handleOffset, handles+handleOffset, FALSE, 100) == WAIT_OBJECT_0 && handleOffset == 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool DepotConcurrencyController::TryAcquire()
+{
+	AutoCriticalSection lock(m_Lock);
+	if (m_ActiveCount >= m_Concurrency)
+	{
+		return false;
+	}
+
+	m_ActiveCount++;
+	m_WindowMaxActiveCount = std::max(m_WindowMaxActiveCount, m_ActiveCount);
+	return true;
+}
+
+void DepotConcurrencyController::Release(int64_t latencyUs)
+{
+	{
+		AutoCriticalSection lock(m_Lock);
+		m_ActiveCount = m_ActiveCount > 0 ? m_ActiveCount-1 : 0;
+		m_CompletedCount++;
+		m_WindowCount++;
+		m_WindowLatencyUs += std::max<int64_t>(0, latencyUs);
+
+		if (IsAdaptive() && m_WindowCount >= std::max(m_Options.m_SampleCount, m_Concurrency))
+		{
+			Evaluate((*m_Clock)());
+		}
+	}
+	SetEvent(m_ReleasedEvent.Handle());
+}
+
+void DepotConcurrencyController::Evaluate(int64_t timeUs)
+{
+	const int64_t latencyUs = m_WindowLatencyUs / int64_t(m_WindowCount);
+	const double itemsPerSecond = double(m_WindowCount) * 1000000.0 / double(std::max<int64_t>(1, timeUs - m_WindowStartUs));
+	if (m_BaselineLatencyUs < 0 || latencyUs < m_BaselineLatencyUs)
+	{
+		m_BaselineLatencyUs = latencyUs;
+	}
+
+	// Rising latency means the server or disk is saturated, so back off. Otherwise probe for more throughput, but only
+	// when the workers were actually held at the limit, and throughput has not fallen since the last window.
+	DepotConcurrencyDecision::Enum decision = DepotConcurrencyDecision::Hold;
+	size_t concurrency = m_Concurrency;
+	const int64_t baselineLatencyUs = std::max<int64_t>(1, m_BaselineLatencyUs);
+	if (latencyUs * 100 > baselineLatencyUs * (100 + m_Options.m_LatencyTolerancePercent))
+	{
+		concurrency = std::max(m_Options.m_MinConcurrency, std::min(m_Concurrency-1, m_Concurrency * size_t(std::max(0, m_Options.m_DecreasePercent)) / 100));
+		decision = concurrency < m_Concurrency ? DepotConcurrencyDecision::Decrease : DepotConcurrencyDecision::Hold;
+	}
+	else if (m_WindowMaxActiveCount >= m_Concurrency && itemsPerSecond >= m_PreviousItemsPerSecond * 0.95)
+	{
+		concurrency = std::min(m_Options.m_MaxConcurrency, m_Concurrency+1);
+		decision = concurrency > m_Concurrency ? DepotConcurrencyDecision::Increase : DepotConcurrencyDecision::Hold;
+	}
+
+	if (decision != DepotConcurrencyDecision::Hold)
+	{
+		FDepotConcurrencyDecisionRecord record;
+		record.m_Decision = decision;
+		record.m_PreviousConcurrency = m_Concurrency;
+		record.m_Concurrency = concurrency;
+		record.m_TimeUs = timeUs;
+		record.m_LatencyUs = latencyUs;
+		record.m_ItemsPerSecond = itemsPerSecond;
+		m_Decisions->push_back(record);
+
+		m_IncreaseCount += decision == DepotConcurrencyDecision::Increase ? 1 : 0;
+		m_DecreaseCount += decision == DepotConcurrencyDecision::Decrease ? 1 : 0;
+		m_Concurrency = concurrency;
+	}
+
+	m_PreviousItemsPerSecond = itemsPerSecond;
+	m_WindowCount = 0;
+	m_WindowLatencyUs = 0;
+	m_WindowStartUs = timeUs;
+	m_WindowMaxActiveCount = m_ActiveCount;
+}
+
+bool DepotConcurrencyController::IsAdaptive() const
+{
+	return m_Options.m_MinConcurrency < m_Options.m_MaxConcurrency;
+}
+
+size_t DepotConcurrencyController::GetConcurrency() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_Concurrency;
+}
+
+size_t DepotConcurrencyController::GetMinConcurrency() const
+{
+	return m_Options.m_MinConcurrency;
+}
+
+size_t DepotConcurrencyController::GetMaxConcurrency() const
+{
+	return m_Options.m_MaxConcurrency;
+}
+
+size_t DepotConcurrencyController::GetActiveCount() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_ActiveCount;
+}
+
+size_t DepotConcurrencyController::GetCompletedCount() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_CompletedCount;
+}
+
+size_t DepotConcurrencyController::GetIncreaseCount() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_IncreaseCount;
+}
+
+size_t DepotConcurrencyController::GetDecreaseCount() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_DecreaseCount;
+}
+
+Array<FDepotConcurrencyDecisionRecord> DepotConcurrencyController::GetDecisions() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return *m_Decisions;
+}
+
+void DepotConcurrencyController::LogSummary(DepotClient& depotClient) const
+{
+	const Array<FDepotConcurrencyDecisionRecord> decisions = GetDecisions();
+	depotClient->Log(LogChannel::Info, StringInfo::Format("Concurrency:         %I64u [%I64u-%I64u] %I64u increase%s %I64u decrease%s",
+		uint64_t(GetConcurrency()),
+		uint64_t(GetMinConcurrency()),
+		uint64_t(GetMaxConcurrency()),
+		uint64_t(GetIncreaseCount()),
+		GetIncreaseCount() == 1 ? "" : "s",
+		uint64_t(GetDecreaseCount()),
+		GetDecreaseCount() == 1 ? "" : "s"));
+
+	for (const FDepotConcurrencyDecisionRecord& record : decisions)
+	{
+		depotClient->Log(LogChannel::Verbose, StringInfo::Format("Concurrency %s:  %I64u -> %I64u at %s, %.1f files/sec, %.3f ms latency",
+			DepotConcurrencyDecision::ToString(record.m_Decision).c_str(),
+			uint64_t(record.m_PreviousConcurrency),
+			uint64_t(record.m_Concurrency),
+			DepotOperations::ToDisplayStringMilliseconds(record.m_TimeUs / 1000).c_str(),
+			record.m_ItemsPerSecond,
+			double(record.m_LatencyUs) / 1000.0));
+	}
+}
+
+}}}
@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotConnectionCache.h"
+#include "SettingManager.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+DepotConnectionCache::DepotConnectionCache() :
+	m_EntryMap(new EntryMapType)
+{
+}
+
+DepotConnectionCache::~DepotConnectionCache()
+{
+	SafeDeletePointer(m_EntryMap);
+}
+
+DepotConnectionMetadata DepotConnectionCache::Query(const DepotString& key, const RunCommand& run, const ReadProtocol& protocol)
+{
+	DepotConnectionMetadata metadata;
+	if (Find(key, metadata))
+	{
+		return metadata;
+	}
+
+	auto runClient = [&run]() -> DepotResultClient
+	{
+		DepotResultClient client = MakeResult<DepotResultClient>();
+		run(DepotCommand("client", DepotStringArray{"-o"}), *client);
+		return client;
+	};
+
+	metadata.m_Client = runClient();
+	if (metadata.m_Client->HasErrorText("use the 'p4 trust' command"))
+	{
+		DepotResult trust = MakeResult<DepotResult>();
+		run(DepotCommand("trust", DepotStringArray{"-y", "-f"}), *trust);
+		metadata.m_Client = runClient();
+	}
+
+	int64_t validSeconds = -1;
+	if (metadata.m_Client->Access().empty())
+	{
+		DepotResult login = MakeResult<DepotResult>();
+		run(DepotCommand("login", DepotStringArray{"-s"}), *login);
+		if (login->HasError())
+		{
+			metadata.m_IsLoginRequired = true;
+		}
+		else if (login->TagList().size())
+		{
+			validSeconds = login->TagList()[0]->GetValueInt64("TicketExpiration", -1);
+		}
+	}
+
+	protocol(metadata);
+	if (metadata.m_IsLoginRequired == false)
+	{
+		Store(key, metadata, validSeconds);
+	}
+	return metadata;
+}
+
+bool DepotConnectionCache::Find(const DepotString& key, DepotConnectionMetadata& metadata)
+{
+	AutoCriticalSection lock(m_EntryMapLock);
+	EntryMapType::iterator entryIt = m_EntryMap->find(key);
+	if (entryIt == m_EntryMap->end())
+	{
+		return false;
+	}
+	if (GetTickCount64() >= entryIt->second.m_ExpireTime)
+	{
+		m_EntryMap->erase(entryIt);
+		return false;
+	}
+	metadata = entryIt->second.m_Metadata;
+	metadata.m_Client = CopyClient(metadata.m_Client);
+	return true;
+}
+
+void DepotConnectionCache::Store(const DepotString& key, const DepotConnectionMetadata& metadata, int64_t validSeconds)
+{
+	int64_t timeoutMs = GetTimeoutMs();
+	if (validSeconds >= 0)
+	{
+		timeoutMs = std::min(timeoutMs, validSeconds*1000);
+	}
+	if (timeoutMs <= 0 || metadata.m_Client.get() == nullptr)
+	{
+		return;
+	}
+
+	AutoCriticalSection lock(m_EntryMapLock);
+	Entry& entry = (*m_EntryMap)[key];
+	entry.m_Metadata = metadata;
+	entry.m_Metadata.m_Client = CopyClient(metadata.m_Client);
+	entry.m_ExpireTime = GetTickCount64() + uint64_t(timeoutMs);
+}
+
+void DepotConnectionCache::Invalidate(const DepotString& key)
+{
+	AutoCriticalSection lock(m_EntryMapLock);
+	m_EntryMap->erase(key);
+}
+
+void DepotConnectionCache::Clear()
+{
+	AutoCriticalSection lock(m_EntryMapLock);
+	m_EntryMap->clear();
+}
+
+size_t DepotConnectionCache::GetCount() const
+{
+	AutoCriticalSection lock(m_EntryMapLock);
+	return m_EntryMap->size();
+}
+
+DepotString DepotConnectionCache::CreateKey(const DepotString& port, const DepotString& user, const DepotString& client, const DepotString& ticketsFile, const DepotString& trustFile)
+{
+	return StringInfo::Format("%s,%s,%s,%s,%s", port.c_str(), user.c_str(), client.c_str(), ticketsFile.c_str(), trustFile.c_str());
+}
+
+DepotResultClient DepotConnectionCache::CopyClient(const DepotResultClient& src)
+{
+	if (src.get() == nullptr)
+	{
+		return nullptr;
+	}
+
+	DepotResultClient client = MakeResult<DepotResultClient>();
+	for (const DepotResultTag& tag : src->TagList())
+	{
+		client->Append(std::make_shared<FDepotResultTag>(*tag));
+	}
+	for (const DepotResultText& text : src->TextList())
+	{
+		client->Append(Array<DepotResultText>{ std::make_shared<FDepotResultText>(*text) });
+	}
+	return client;
+}
+
+bool DepotConnectionCache::IsInvalidatingError(const FDepotResult& result)
+{
+	static const char* patterns[] = {
+		"session has expired",
+		"please login again",
+		"P4PASSWD",
+		"use the 'p4 trust' command",
+		"unknown - use 'client' command",
+	};
+
+	if (result.HasError())
+	{
+		const DepotString errorText = result.GetError();
+		for (const char* pattern : patterns)
+		{
+			if (StringInfo::Contains(errorText.c_str(), pattern, StringInfo::SearchCase::Insensitive))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+int64_t DepotConnectionCache::GetTimeoutMs()
+{
+	return std::max<int64_t>(0, FileCore::SettingManager::StaticInstance().DepotConnectionCacheTimeoutMs.GetValue());
+}
+
+DepotConnectionCache& DepotConnectionCache::StaticInstance()
+{
+	static DepotConnectionCache instance;
+	return instance;
+}
+
+}}}
@@ -0,0 +1,479 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotContentCache.h"
+#include "FileOperations.h"
+#include "SettingManager.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+namespace DepotContentCacheInternal {
+
+	static const wchar_t* KeyStreamName = L":P4VFS.Key";
+	static const wchar_t* TempFolderName = L"Temp";
+	static const uint64_t TempFileTimeoutSeconds = 24*60*60;
+
+	uint64_t HashKey(const DepotString& key)
+	{
+		return StringInfo::HashMd5(key.data(), key.size());
+	}
+
+	bool ParseHex(const wchar_t* text, size_t digitCount, uint64_t& value)
+	{
+		value = 0;
+		for (size_t digitIndex = 0; digitIndex < digitCount; ++digitIndex)
+		{
+			const wchar_t c = text[digitIndex];
+			if (c >= L'0' && c <= L'9')
+				value = (value << 4) | uint64_t(c - L'0');
+			else if (c >= L'a' && c <= L'f')
+				value = (value << 4) | uint64_t(c - L'a' + 10);
+			else if (c >= L'A' && c <= L'F')
+				value = (value << 4) | uint64_t(c - L'A' + 10);
+			else
+				return false;
+		}
+		return text[digitCount] == L'\0';
+	}
+
+	uint64_t FileTimeSeconds(const FILETIME& fileTime)
+	{
+		return TimeInfo::FileTimeToUInt64(fileTime) / 10000000;
+	}
+
+	// Calls visitor with the find data of each entry in a folder other than "." and ".."
+	template <typename VisitorType>
+	void ForEachFolderEntry(const FileCore::String& folderPath, VisitorType visitor)
+	{
+		WIN32_FIND_DATA findData = {0};
+		HANDLE hFind = FindFirstFile(StringInfo::Format(L"%s\\*", folderPath.c_str()).c_str(), &findData);
+		if (hFind != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				if (StringInfo::Strcmp(findData.cFileName, L".") != 0 && StringInfo::Strcmp(findData.cFileName, L"..") != 0)
+				{
+					visitor(findData);
+				}
+			}
+			while (FindNextFile(hFind, &findData));
+			FindClose(hFind);
+		}
+	}
+}
+
+using namespace DepotContentCacheInternal;
+
+struct DepotContentCache::Index
+{
+	struct Entry
+	{
+		uint64_t m_Size;
+		List<uint64_t>::iterator m_RecentIt;
+	};
+
+	Index() :
+		m_MaxBytes(0)
+	{}
+
+	// Moves a file to the most recently used end of the list, adding it if it is not yet indexed
+	void Touch(uint64_t hash, uint64_t size)
+	{
+		HashMap<uint64_t, Entry>::iterator entryIt = m_Entries.find(hash);
+		if (entryIt == m_Entries.end())
+		{
+			Entry entry;
+			entry.m_Size = size;
+			entry.m_RecentIt = m_RecentList.insert(m_RecentList.end(), hash);
+			m_Entries.insert(HashMap<uint64_t, Entry>::value_type(hash, entry));
+			m_Stats.m_FileCount++;
+			m_Stats.m_TotalBytes += size;
+			return;
+		}
+
+		m_RecentList.splice(m_RecentList.end(), m_RecentList, entryIt->second.m_RecentIt);
+		m_Stats.m_TotalBytes += size - entryIt->second.m_Size;
+		entryIt->second.m_Size = size;
+	}
+
+	FileCore::String m_FolderPath;
+	uint64_t m_MaxBytes;
+	HashMap<uint64_t, Entry> m_Entries;
+	List<uint64_t> m_RecentList;
+	FDepotContentCacheStats m_Stats;
+};
+
+DepotString FDepotContentCacheStats::ToString() const
+{
+	const uint64_t lookupCount = m_HitCount + m_MissCount;
+	return StringInfo::Format("hits=%I64u misses=%I64u hitRate=%.1f%% bytesSaved=%I64u published=%I64u publishedBytes=%I64u evicted=%I64u evictedBytes=%I64u files=%I64u bytes=%I64u",
+		m_HitCount,
+		m_MissCount,
+		lookupCount ? double(m_HitCount) * 100.0 / lookupCount : 0.0,
+		m_HitBytes,
+		m_PublishCount,
+		m_PublishBytes,
+		m_EvictCount,
+		m_EvictBytes,
+		m_FileCount,
+		m_TotalBytes);
+}
+
+DepotContentCache::DepotContentCache() :
+	m_Index(nullptr)
+{
+}
+
+DepotContentCache::~DepotContentCache()
+{
+	Close();
+}
+
+bool DepotContentCache::Open(const FileCore::String& folderPath, uint64_t maxBytes)
+{
+	Close();
+	if (folderPath.empty())
+	{
+		return false;
+	}
+
+	Index* index = new Index;
+	index->m_FolderPath = FileInfo::FullPath(folderPath.c_str());
+	index->m_MaxBytes = maxBytes;
+
+	const FileCore::String tempFolderPath = StringInfo::Format(L"%s\\%s", index->m_FolderPath.c_str(), TempFolderName);
+	if (FileInfo::CreateDirectory(tempFolderPath.c_str()) == false)
+	{
+		SafeDeletePointer(index);
+		return false;
+	}
+
+	// Files are indexed from the least recently used, by the time they were last published or opened
+	struct FFoundFile
+	{
+		uint64_t m_Hash;
+		uint64_t m_Size;
+		uint64_t m_Time;
+	};
+
+	Array<FFoundFile> foundFiles;
+	ForEachFolderEntry(index->m_FolderPath, [&index, &foundFiles](const WIN32_FIND_DATA& folderData) -> void
+	{
+		uint64_t folderHash = 0;
+		if ((folderData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 || ParseHex(folderData.cFileName, 2, folderHash) == false)
+		{
+			return;
+		}
+
+		ForEachFolderEntry(StringInfo::Format(L"%s\\%s", index->m_FolderPath.c_str(), folderData.cFileName), [folderHash, &foundFiles](const WIN32_FIND_DATA& fileData) -> void
+		{
+			FFoundFile file;
+			if ((fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 && ParseHex(fileData.cFileName, 16, file.m_Hash) && (file.m_Hash >> 56) == folderHash)
+			{
+				file.m_Size = (uint64_t(fileData.nFileSizeHigh) << 32) | fileData.nFileSizeLow;
+				file.m_Time = TimeInfo::FileTimeToUInt64(fileData.ftLastWriteTime);
+				foundFiles.push_back(file);
+			}
+		});
+	});
+
+	std::sort(foundFiles.begin(), foundFiles.end(), [](const FFoundFile& a, const FFoundFile& b) -> bool { return a.m_Time < b.m_Time; });
+	for (const FFoundFile& file : foundFiles)
+	{
+		index->Touch(file.m_Hash, file.m_Size);
+	}
+
+	// Temp files are left behind by a process which exits while printing, and are removed once they are old enough
+	// that they are not still being printed by another process
+	const uint64_t nowSeconds = FileTimeSeconds(TimeInfo::GetUtcFileTime());
+	ForEachFolderEntry(tempFolderPath, [&tempFolderPath, nowSeconds](const WIN32_FIND_DATA& fileData) -> void
+	{
+		if ((fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 && FileTimeSeconds(fileData.ftLastWriteTime) + TempFileTimeoutSeconds < nowSeconds)
+		{
+			const FileCore::String tempFilePath = StringInfo::Format(L"%s\\%s", tempFolderPath.c_str(), fileData.cFileName);
+			FileInfo::SetReadOnly(tempFilePath.c_str(), false);
+			FileInfo::Delete(tempFilePath.c_str());
+		}
+	});
+
+	AutoCriticalSection lock(m_Lock);
+	Index* previousIndex = m_Index;
+	m_Index = index;
+	TrimIndex(*m_Index);
+	SafeDeletePointer(previousIndex);
+	return true;
+}
+
+void DepotContentCache::Close()
+{
+	AutoCriticalSection lock(m_Lock);
+	SafeDeletePointer(m_Index);
+}
+
+bool DepotContentCache::IsOpen() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_Index != nullptr;
+}
+
+bool DepotContentCache::Configure()
+{
+	const FileCore::String folderPath = GetConfiguredFolderPath();
+	const uint64_t maxBytes = GetConfiguredMaxBytes();
+	if (folderPath.empty())
+	{
+		Close();
+		return false;
+	}
+
+	{
+		AutoCriticalSection lock(m_Lock);
+		if (m_Index != nullptr && StringInfo::Stricmp(m_Index->m_FolderPath.c_str(), folderPath.c_str()) == 0)
+		{
+			m_Index->m_MaxBytes = maxBytes;
+			TrimIndex(*m_Index);
+			return true;
+		}
+	}
+	return Open(folderPath, maxBytes);
+}
+
+bool DepotContentCache::OpenFile(const DepotString& key, FileCore::AutoHandle& fileHandle)
+{
+	fileHandle.Close();
+
+	const uint64_t hash = HashKey(key);
+	FileCore::String filePath;
+	{
+		AutoCriticalSection lock(m_Lock);
+		if (m_Index == nullptr)
+		{
+			return false;
+		}
+		filePath = GetFilePath(*m_Index, hash);
+	}
+
+	// The file is looked for even if it is not indexed, since it may have been published by another process. Deletion
+	// is not shared, so that the file cannot be evicted while it is being read.
+	fileHandle.Reset(CreateFile(filePath.c_str(), GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+	LARGE_INTEGER fileSize = {0};
+	if (fileHandle.IsValid() && (GetFileSizeEx(fileHandle.Handle(), &fileSize) == FALSE || IsKeyMatch(filePath, key) == false))
+	{
+		fileHandle.Close();
+	}
+
+	if (fileHandle.IsValid())
+	{
+		// The write time orders the files by their last use when the cache is next opened
+		const FILETIME now = TimeInfo::GetUtcFileTime();
+		SetFileTime(fileHandle.Handle(), NULL, NULL, &now);
+	}
+
+	AutoCriticalSection lock(m_Lock);
+	if (m_Index != nullptr)
+	{
+		if (fileHandle.IsValid())
+		{
+			m_Index->Touch(hash, uint64_t(fileSize.QuadPart));
+			m_Index->m_Stats.m_HitCount++;
+			m_Index->m_Stats.m_HitBytes += uint64_t(fileSize.QuadPart);
+		}
+		else
+		{
+			m_Index->m_Stats.m_MissCount++;
+		}
+	}
+	return fileHandle.IsValid();
+}
+
+FileCore::String DepotContentCache::CreateTempFile()
+{
+	FileCore::String tempFolderPath;
+	{
+		AutoCriticalSection lock(m_Lock);
+		if (m_Index == nullptr)
+		{
+			return FileCore::String();
+		}
+		tempFolderPath = StringInfo::Format(L"%s\\%s", m_Index->m_FolderPath.c_str(), TempFolderName);
+	}
+	return FileInfo::CreateTempFile(tempFolderPath.c_str());
+}
+
+bool DepotContentCache::Publish(const DepotString& key, const FileCore::String& tempFilePath, FileCore::AutoHandle* fileHandle)
+{
+	AutoTempFile tempFile(tempFilePath.c_str());
+	if (fileHandle != nullptr)
+	{
+		fileHandle->Close();
+	}
+
+	// A printed file may be read only, which would prevent it from being evicted
+	if (FileInfo::IsRegular(tempFilePath.c_str()) == false || FileInfo::SetReadOnly(tempFilePath.c_str(), false) == false)
+	{
+		return false;
+	}
+
+	int64_t fileSize = FileInfo::FileSize(tempFilePath.c_str());
+	if (fileSize < 0)
+	{
+		return false;
+	}
+
+	// The key is written to a stream of the temp file, so that it is published along with the content by the rename
+	{
+		FileCore::AutoHandle keyStream = CreateFile((tempFilePath + KeyStreamName).c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		DWORD bytesWritten = 0;
+		if (keyStream.IsValid() == false || WriteFile(keyStream.Handle(), key.data(), DWORD(key.size()), &bytesWritten, NULL) == FALSE || bytesWritten != key.size())
+		{
+			return false;
+		}
+	}
+
+	const uint64_t hash = HashKey(key);
+	FileCore::String filePath;
+	{
+		AutoCriticalSection lock(m_Lock);
+		if (m_Index == nullptr)
+		{
+			return false;
+		}
+		filePath = GetFilePath(*m_Index, hash);
+	}
+
+	// Another process may have published the same key first, in which case its file is kept
+	if (FileInfo::CreateFileDirectory(filePath.c_str()) == false || MoveFileEx(tempFilePath.c_str(), filePath.c_str(), 0) == FALSE)
+	{
+		const DWORD error = GetLastError();
+		if ((error != ERROR_ALREADY_EXISTS && error != ERROR_FILE_EXISTS) || IsKeyMatch(filePath, key) == false)
+		{
+			return false;
+		}
+		fileSize = FileInfo::FileSize(filePath.c_str());
+		if (fileSize < 0)
+		{
+			return false;
+		}
+	}
+
+	// The file is opened before the cache is trimmed, so that it cannot be evicted before it is read
+	if (fileHandle != nullptr)
+	{
+		fileHandle->Reset(CreateFile(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+	}
+
+	AutoCriticalSection lock(m_Lock);
+	if (m_Index != nullptr)
+	{
+		m_Index->Touch(hash, uint64_t(fileSize));
+		m_Index->m_Stats.m_PublishCount++;
+		m_Index->m_Stats.m_PublishBytes += uint64_t(fileSize);
+		TrimIndex(*m_Index);
+	}
+	return fileHandle == nullptr || fileHandle->IsValid();
+}
+
+void DepotContentCache::Trim()
+{
+	AutoCriticalSection lock(m_Lock);
+	if (m_Index != nullptr)
+	{
+		TrimIndex(*m_Index);
+	}
+}
+
+FDepotContentCacheStats DepotContentCache::GetStats() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_Index != nullptr ? m_Index->m_Stats : FDepotContentCacheStats();
+}
+
+FileCore::String DepotContentCache::GetFolderPath() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_Index != nullptr ? m_Index->m_FolderPath : FileCore::String();
+}
+
+uint64_t DepotContentCache::GetMaxBytes() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_Index != nullptr ? m_Index->m_MaxBytes : 0;
+}
+
+DepotString DepotContentCache::CreateKey(FDepotClient& depotClient, const DepotString& depotFile, int32_t revision)
+{
+	// Text files are printed with the line endings of the client
+	const DepotResultClient clientSpec = depotClient.Connection();
+	const bool isUnixLineEnd = clientSpec.get() && StringInfo::Stricmp(clientSpec->LineEnd().c_str(), FDepotResultLineEnd::Unix) == 0;
+
+	const DepotConfig& config = depotClient.Config();
+	return StringInfo::Format("%s\n%s\n%s\n%s#%d", config.m_Port.c_str(), config.m_User.c_str(), isUnixLineEnd ? "lf" : "crlf", depotFile.c_str(), revision);
+}
+
+FileCore::String DepotContentCache::GetConfiguredFolderPath()
+{
+	const FileCore::String folderPath = SettingManager::StaticInstance().DepotContentCacheDirectory.GetValue();
+	if (folderPath.empty())
+	{
+		return FileCore::String();
+	}
+	return FileInfo::FullPath(FileOperations::GetImpersonatedEnvironmentStrings(folderPath.c_str(), nullptr).c_str());
+}
+
+uint64_t DepotContentCache::GetConfiguredMaxBytes()
+{
+	return uint64_t(std::max(0, SettingManager::StaticInstance().DepotContentCacheSizeMB.GetValue())) * 1024 * 1024;
+}
+
+FileCore::String DepotContentCache::GetFilePath(const Index& index, uint64_t hash)
+{
+	return StringInfo::Format(L"%s\\%02I64x\\%016I64x", index.m_FolderPath.c_str(), hash >> 56, hash);
+}
+
+bool DepotContentCache::IsKeyMatch(const FileCore::String& filePath, const DepotString& key)
+{
+	FileCore::AutoHandle keyStream = CreateFile((filePath + KeyStreamName).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (keyStream.IsValid() == false)
+	{
+		return false;
+	}
+
+	// One more byte than the key is read, so that a longer key does not match
+	DepotString fileKey(key.size() + 1, '\0');
+	DWORD bytesRead = 0;
+	if (ReadFile(keyStream.Handle(), &fileKey[0], DWORD(fileKey.size()), &bytesRead, NULL) == FALSE)
+	{
+		return false;
+	}
+	return bytesRead == key.size() && fileKey.compare(0, bytesRead, key) == 0;
+}
+
+void DepotContentCache::TrimIndex(Index& index)
+{
+	// A file which cannot be deleted is still open, and is skipped until a later trim
+	for (List<uint64_t>::iterator recentIt = index.m_RecentList.begin(); recentIt != index.m_RecentList.end() && index.m_Stats.m_TotalBytes > index.m_MaxBytes;)
+	{
+		const uint64_t hash = *recentIt;
+		const FileCore::String filePath = GetFilePath(index, hash);
+		if (DeleteFile(filePath.c_str()) == FALSE && GetLastError() != ERROR_FILE_NOT_FOUND)
+		{
+			++recentIt;
+			continue;
+		}
+
+		HashMap<uint64_t, Index::Entry>::iterator entryIt = index.m_Entries.find(hash);
+		if (entryIt != index.m_Entries.end())
+		{
+			index.m_Stats.m_FileCount--;
+			index.m_Stats.m_TotalBytes -= entryIt->second.m_Size;
+			index.m_Stats.m_EvictCount++;
+			index.m_Stats.m_EvictBytes += entryIt->second.m_Size;
+			index.m_Entries.erase(entryIt);
+		}
+		recentIt = index.m_RecentList.erase(recentIt);
+	}
+}
+
+}}}
@@ -0,0 +1,296 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotContentShare.h"
+#include "DepotOperations.h"
+#include "FileOperations.h"
+#include "SettingManager.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+namespace DepotContentShareInternal {
+
+	static const wchar_t* TempFolderName = L"Temp";
+	static const DWORD CopyBufferSize = 64*1024;
+
+	// The file types which are printed as they are stored, and the text types which are only translated for line endings
+	static const char* BinaryFileTypes[] = { "binary", "xbinary", "ubinary", "uxbinary", "tempobj" };
+	static const char* TextFileTypes[] = { "text", "xtext", "ctext", "cxtext", "ltext", "xltext" };
+
+	bool IsFileTypeIn(const DepotString& baseType, const char* const* fileTypes, size_t fileTypeCount)
+	{
+		for (size_t fileTypeIndex = 0; fileTypeIndex < fileTypeCount; ++fileTypeIndex)
+		{
+			if (StringInfo::Stricmp(baseType.c_str(), fileTypes[fileTypeIndex]) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	// The MD5 digest of data as it is read, formatted as the digest field of fstat
+	class FDigestMd5
+	{
+	public:
+		FDigestMd5() :
+			m_Alg(NULL),
+			m_Hash(NULL)
+		{
+			if (BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&m_Alg, BCRYPT_MD5_ALGORITHM, NULL, 0)) == false ||
+				BCRYPT_SUCCESS(BCryptCreateHash(m_Alg, &m_Hash, NULL, 0, NULL, 0, 0)) == false)
+			{
+				m_Hash = NULL;
+			}
+		}
+
+		~FDigestMd5()
+		{
+			if (m_Hash != NULL)
+				BCryptDestroyHash(m_Hash);
+			if (m_Alg != NULL)
+				BCryptCloseAlgorithmProvider(m_Alg, 0);
+		}
+
+		bool Update(const void* data, ULONG dataSize)
+		{
+			return m_Hash != NULL && BCRYPT_SUCCESS(BCryptHashData(m_Hash, reinterpret_cast<PUCHAR>(const_cast<void*>(data)), dataSize, 0));
+		}
+
+		DepotString Finish()
+		{
+			uint8_t hashValue[16] = {0};
+			if (m_Hash == NULL || BCRYPT_SUCCESS(BCryptFinishHash(m_Hash, hashValue, sizeof(hashValue), 0)) == false)
+			{
+				return DepotString();
+			}
+
+			DepotString digest;
+			for (uint8_t hashByte : hashValue)
+			{
+				digest += StringInfo::Format("%02X", uint32_t(hashByte));
+			}
+			return digest;
+		}
+
+	private:
+		BCRYPT_ALG_HANDLE m_Alg;
+		BCRYPT_HASH_HANDLE m_Hash;
+	};
+
+	bool IsFileSize(HANDLE hFile, int64_t fileSize)
+	{
+		LARGE_INTEGER size = {0};
+		return GetFileSizeEx(hFile, &size) && size.QuadPart == fileSize;
+	}
+}
+
+using namespace DepotContentShareInternal;
+
+bool DepotContentShare::GetShareFile(FDepotClient& depotClient, const DepotString& depotFile, int32_t revision, FDepotContentShareFile& shareFile)
+{
+	shareFile = FDepotContentShareFile();
+
+	const DepotResultClient clientSpec = depotClient.Connection();
+	if (clientSpec.get() == nullptr)
+	{
+		return false;
+	}
+
+	const DepotString fileSpec = StringInfo::Format("%s#%d", depotFile.c_str(), revision);
+	const FDepotResultFStatField::Enum fields = FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadType | FDepotResultFStatField::FileSize | FDepotResultFStatField::Digest;
+	DepotResultFStat fstat = depotClient.Run<DepotResultFStat>(DepotOperations::CreateFStatCommand(DepotStringArray{ fileSpec }, DepotString(), fields));
+	if (fstat.get() == nullptr || fstat->HasError())
+	{
+		return false;
+	}
+
+	const FDepotResultFStatNode node = fstat->Node();
+	if (node.InDepot() == false || node.Digest().empty() || node.FileSize() < 0 || IsDigestOfPrintedFile(node.HeadType(), clientSpec->LineEnd()) == false)
+	{
+		return false;
+	}
+
+	shareFile.m_DepotFile = node.DepotFile();
+	shareFile.m_Revision = revision;
+	shareFile.m_Digest = node.Digest();
+	shareFile.m_FileSize = node.FileSize();
+	return true;
+}
+
+bool DepotContentShare::IsDigestOfPrintedFile(const DepotString& fileType, const DepotString& lineEnd)
+{
+	const size_t modifiersPos = fileType.find('+');
+	const DepotString baseType = fileType.substr(0, modifiersPos);
+	if (modifiersPos != DepotString::npos && StringInfo::Stristr(fileType.c_str() + modifiersPos, "k") != nullptr)
+	{
+		return false;
+	}
+
+	if (IsFileTypeIn(baseType, BinaryFileTypes, _countof(BinaryFileTypes)))
+	{
+		return true;
+	}
+
+	// Text is stored with LF line endings, and only a unix client prints it unconverted
+	if (IsFileTypeIn(baseType, TextFileTypes, _countof(TextFileTypes)))
+	{
+		return StringInfo::Stricmp(lineEnd.c_str(), FDepotResultLineEnd::Unix) == 0;
+	}
+	return false;
+}
+
+bool DepotContentShare::OpenFile(const FileCore::String& shareFolderPath, const FDepotContentShareFile& shareFile, FileCore::AutoHandle& fileHandle)
+{
+	fileHandle.Close();
+	if (shareFolderPath.empty() || shareFile.m_Digest.empty())
+	{
+		return false;
+	}
+
+	// A file of the wrong size is skipped here, since it cannot be verified
+	const FileCore::String filePaths[] = {
+		GetDigestFilePath(shareFolderPath, shareFile.m_Digest),
+		GetDepotFilePath(shareFolderPath, shareFile.m_DepotFile, shareFile.m_Revision),
+	};
+
+	for (const FileCore::String& filePath : filePaths)
+	{
+		if (filePath.empty())
+		{
+			continue;
+		}
+
+		fileHandle.Reset(CreateFile(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+		if (fileHandle.IsValid() && IsFileSize(fileHandle.Handle(), shareFile.m_FileSize))
+		{
+			return true;
+		}
+		fileHandle.Close();
+	}
+	return false;
+}
+
+HRESULT DepotContentShare::CopyVerified(HANDLE hReadHandle, HANDLE hWriteHandle, const FDepotContentShareFile& shareFile, UINT64* bytesWritten)
+{
+	FDigestMd5 digest;
+	Array<BYTE> buffer(CopyBufferSize);
+	DWORD nBytesRead = 0;
+	DWORD nBytesWritten = 0;
+	UINT64 totalBytesWritten = 0;
+
+	do
+	{
+		if (ReadFile(hReadHandle, buffer.data(), CopyBufferSize, &nBytesRead, NULL) == FALSE)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+		if (totalBytesWritten + nBytesRead > UINT64(shareFile.m_FileSize) || digest.Update(buffer.data(), nBytesRead) == false)
+		{
+			return HRESULT_FROM_WIN32(ERROR_FILE_CORRUPT);
+		}
+		if (nBytesRead > 0 && (WriteFile(hWriteHandle, buffer.data(), nBytesRead, &nBytesWritten, NULL) == FALSE || nBytesWritten != nBytesRead))
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+		totalBytesWritten += nBytesRead;
+	}
+	while (nBytesRead > 0);
+
+	if (bytesWritten != nullptr)
+	{
+		*bytesWritten = totalBytesWritten;
+	}
+
+	if (totalBytesWritten != UINT64(shareFile.m_FileSize) || StringInfo::Stricmp(digest.Finish().c_str(), shareFile.m_Digest.c_str()) != 0)
+	{
+		return HRESULT_FROM_WIN32(ERROR_FILE_CORRUPT);
+	}
+	return S_OK;
+}
+
+bool DepotContentShare::Publish(const FileCore::String& shareFolderPath, const FDepotContentShareFile& shareFile, const FileCore::String& filePath)
+{
+	const FileCore::String shareFilePath = GetDigestFilePath(shareFolderPath, shareFile.m_Digest);
+	if (shareFilePath.empty())
+	{
+		return false;
+	}
+
+	if (FileInfo::IsRegular(shareFilePath.c_str()))
+	{
+		return true;
+	}
+
+	const FileCore::String tempFolderPath = StringInfo::Format(L"%s\\%s", shareFolderPath.c_str(), TempFolderName);
+	if (FileInfo::CreateDirectory(tempFolderPath.c_str()) == false)
+	{
+		return false;
+	}
+
+	AutoTempFile tempFile(FileInfo::CreateTempFile(tempFolderPath.c_str()).c_str());
+	if (FileInfo::IsRegular(tempFile.GetFilePath().c_str()) == false)
+	{
+		return false;
+	}
+
+	{
+		FileCore::AutoHandle srcFile = CreateFile(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		FileCore::AutoHandle dstFile = CreateFile(tempFile.GetFilePath().c_str(), GENERIC_WRITE, 0, NULL, TRUNCATE_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (srcFile.IsValid() == false || dstFile.IsValid() == false || FAILED(CopyVerified(srcFile.Handle(), dstFile.Handle(), shareFile)))
+		{
+			return false;
+		}
+	}
+
+	// Another machine may have published the same digest first, which is just as good
+	if (FileInfo::CreateFileDirectory(shareFilePath.c_str()) == false || MoveFileEx(tempFile.GetFilePath().c_str(), shareFilePath.c_str(), 0) == FALSE)
+	{
+		return FileInfo::IsRegular(shareFilePath.c_str());
+	}
+	return true;
+}
+
+FileCore::String DepotContentShare::GetDigestFilePath(const FileCore::String& shareFolderPath, const DepotString& digest)
+{
+	if (shareFolderPath.empty() || digest.size() != 32 || std::all_of(digest.begin(), digest.end(), [](char c) -> bool { return isxdigit(uint8_t(c)) != 0; }) == false)
+	{
+		return FileCore::String();
+	}
+
+	const FileCore::String upperDigest = StringInfo::ToWide(StringInfo::ToUpper(digest.c_str()));
+	return StringInfo::Format(L"%s\\%s\\%s", shareFolderPath.c_str(), upperDigest.substr(0, 2).c_str(), upperDigest.c_str());
+}
+
+FileCore::String DepotContentShare::GetDepotFilePath(const FileCore::String& shareFolderPath, const DepotString& depotFile, int32_t revision)
+{
+	if (shareFolderPath.empty() || revision <= 0 || StringInfo::StartsWith(depotFile.c_str(), "//") == false || depotFile.find_first_of("\\:*?\"<>|") != DepotString::npos)
+	{
+		return FileCore::String();
+	}
+
+	// The depot path must not be able to name a file outside of the share
+	const AStringArray pathNames = StringInfo::Split(depotFile.c_str() + 2, "/", StringInfo::SplitFlags::None);
+	for (const AString& pathName : pathNames)
+	{
+		if (pathName.empty() || pathName == "." || pathName == "..")
+		{
+			return FileCore::String();
+		}
+	}
+
+	const DepotString relativePath = StringInfo::Join(pathNames, "\\");
+	return StringInfo::Format(L"%s\\%s#%d", shareFolderPath.c_str(), CSTR_ATOW(relativePath), revision);
+}
+
+FileCore::String DepotContentShare::GetConfiguredFolderPath()
+{
+	const FileCore::String folderPath = SettingManager::StaticInstance().PopulateShareDirectory.GetValue();
+	if (folderPath.empty())
+	{
+		return FileCore::String();
+	}
+	return FileInfo::FullPath(FileOperations::GetImpersonatedEnvironmentStrings(folderPath.c_str(), nullptr).c_str());
+}
+
+}}}
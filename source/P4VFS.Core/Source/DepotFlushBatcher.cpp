@@ -0,0 +1,298 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotFlushBatcher.h"
+#include "SettingManager.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+DepotFlushBatcher::DepotFlushBatcher(LogDevice* log, size_t batchSize, int64_t deadlineMs, const FlushCommand& flushCommand) :
+	m_Log(log),
+	m_BatchSize(std::max<size_t>(1, batchSize)),
+	m_DeadlineMs(deadlineMs),
+	m_FlushCommand(new FlushCommand(flushCommand ? flushCommand : FlushCommand(&FlushCommandSync))),
+	m_FlushedCallback(new FlushedCallback),
+	m_Pending(new EntryArray),
+	m_BatchCount(0),
+	m_FileCount(0),
+	m_ErrorCount(0),
+	m_FlushTime(0)
+{
+	m_Pending->reserve(m_BatchSize);
+}
+
+DepotFlushBatcher::~DepotFlushBatcher()
+{
+	SafeDeletePointer(m_Pending);
+	SafeDeletePointer(m_FlushCommand);
+	SafeDeletePointer(m_FlushedCallback);
+}
+
+void DepotFlushBatcher::SetFlushedCallback(const FlushedCallback& flushedCallback)
+{
+	*m_FlushedCallback = flushedCallback;
+}
+
+void DepotFlushBatcher::Add(DepotClient& depotClient, const DepotSyncActionInfo& modification, const DepotString& fileSpec)
+{
+	EntryArray batch;
+	{
+		AutoCriticalSection lock(m_PendingLock);
+		if (m_Pending->empty())
+		{
+			m_PendingTimer.Restart();
+		}
+
+		FDepotFlushBatchEntry entry;
+		entry.m_Modification = modification;
+		entry.m_FileSpec = fileSpec;
+		m_Pending->push_back(entry);
+
+		// The calling worker takes ownership of the batch once it is full, or once the oldest
+		// pending entry has waited past the deadline. The batch is executed outside of the lock.
+		if (m_Pending->size() >= m_BatchSize || IsPendingExpired())
+		{
+			batch.swap(*m_Pending);
+			m_Pending->reserve(m_BatchSize);
+		}
+	}
+
+	if (batch.size())
+	{
+		ExecuteBatch(depotClient, batch);
+	}
+}
+
+void DepotFlushBatcher::FlushExpired(DepotClient& depotClient)
+{
+	EntryArray batch;
+	{
+		AutoCriticalSection lock(m_PendingLock);
+		if (IsPendingExpired())
+		{
+			batch.swap(*m_Pending);
+			m_Pending->reserve(m_BatchSize);
+		}
+	}
+
+	if (batch.size())
+	{
+		ExecuteBatch(depotClient, batch);
+	}
+}
+
+DWORD DepotFlushBatcher::GetExpireWaitMs() const
+{
+	AutoCriticalSection lock(m_PendingLock);
+	if (m_Pending->empty() || m_DeadlineMs < 0)
+	{
+		return INFINITE;
+	}
+	// A waiter which could not flush an expired batch waits at least a little before trying again
+	return DWORD(std::max<int64_t>(1, std::min<int64_t>(m_DeadlineMs - m_PendingTimer.TotalMilliseconds(), INFINITE-1)));
+}
+
+bool DepotFlushBatcher::IsPendingExpired() const
+{
+	return m_Pending->size() && m_DeadlineMs >= 0 && m_PendingTimer.TotalMilliseconds() >= m_DeadlineMs;
+}
+
+void DepotFlushBatcher::Flush(DepotClient& depotClient)
+{
+	EntryArray batch;
+	{
+		AutoCriticalSection lock(m_PendingLock);
+		batch.swap(*m_Pending);
+	}
+
+	for (size_t batchIndex = 0; batchIndex < batch.size(); batchIndex += m_BatchSize)
+	{
+		EntryArray entries(batch.begin() + batchIndex, batch.begin() + std::min(batch.size(), batchIndex + m_BatchSize));
+		ExecuteBatch(depotClient, entries);
+	}
+}
+
+void DepotFlushBatcher::ExecuteBatch(DepotClient& depotClient, EntryArray& batch)
+{
+	DepotStringArray fileSpecs;
+	fileSpecs.reserve(batch.size());
+	for (const FDepotFlushBatchEntry& entry : batch)
+	{
+		fileSpecs.push_back(entry.m_FileSpec);
+	}
+
+	DepotStopwatch timer(DepotStopwatch::Init::Start);
+	DepotSyncActionInfoArray errors = (*m_FlushCommand)(depotClient, fileSpecs);
+	const int64_t batchTime = timer.TotalMilliseconds();
+
+	m_BatchCount++;
+	m_FileCount += batch.size();
+	m_FlushTime += batchTime;
+
+	// Divide the round trip time between the files of the batch, so that the sum of all m_FlushTime
+	// remains the total time spent flushing
+	const int64_t batchSize = int64_t(batch.size());
+	for (int64_t entryIndex = 0; entryIndex < batchSize; ++entryIndex)
+	{
+		batch[entryIndex].m_Modification->m_FlushTime = batchTime/batchSize + (entryIndex < batchTime%batchSize ? 1 : 0);
+	}
+
+	if (errors.get() == nullptr)
+	{
+		for (const FDepotFlushBatchEntry& entry : batch)
+		{
+			LogDevice::WriteLine(m_Log, LogChannel::Error, StringInfo::Format("Failed to flush %s", entry.m_FileSpec.c_str()));
+		}
+		m_ErrorCount += batch.size();
+		return;
+	}
+
+	if (errors->empty())
+	{
+		if (*m_FlushedCallback)
+		{
+			for (const FDepotFlushBatchEntry& entry : batch)
+			{
+				(*m_FlushedCallback)(entry.m_Modification);
+			}
+		}
+		return;
+	}
+
+	typedef HashMap<DepotString, FDepotFlushBatchEntry*, StringInfo::Hash, StringInfo::EqualInsensitive> EntryMapType;
+	EntryMapType depotFileEntries;
+	EntryMapType clientFileEntries;
+	for (FDepotFlushBatchEntry& entry : batch)
+	{
+		depotFileEntries.insert(EntryMapType::value_type(entry.m_Modification->m_DepotFile, &entry));
+		clientFileEntries.insert(EntryMapType::value_type(entry.m_Modification->m_ClientFile, &entry));
+	}
+
+	HashSet<const FDepotFlushBatchEntry*> failedEntries;
+	bool isBatchFailed = false;
+	for (const DepotSyncActionInfo& error : *errors)
+	{
+		if (error->m_SyncActionType == DepotSyncActionType::UpToDate)
+		{
+			continue;
+		}
+
+		FDepotFlushBatchEntry* const* entry = nullptr;
+		if (error->m_DepotFile.empty() == false)
+		{
+			entry = Algo::Find(depotFileEntries, error->m_DepotFile);
+		}
+		if (entry == nullptr && error->m_ClientFile.empty() == false)
+		{
+			entry = Algo::Find(clientFileEntries, error->m_ClientFile);
+		}
+
+		if (entry != nullptr)
+		{
+			const DepotSyncActionInfo& modification = (*entry)->m_Modification;
+			modification->m_Message = error->m_Message;
+			failedEntries.insert(*entry);
+			LogDevice::WriteLine(m_Log, LogChannel::Error, StringInfo::Format("Failed to flush %s -> %s. %s", (*entry)->m_FileSpec.c_str(), modification->m_ClientFile.c_str(), error->m_Message.c_str()));
+		}
+		else
+		{
+			LogDevice::WriteLine(m_Log, LogChannel::Error, error->m_Message.c_str());
+			isBatchFailed = true;
+		}
+		m_ErrorCount++;
+	}
+
+	// An error which names no file of the batch, such as an expired session, may have prevented any of them from being
+	// flushed, so none of the batch is reported as flushed
+	if (isBatchFailed)
+	{
+		for (const FDepotFlushBatchEntry& entry : batch)
+		{
+			if (failedEntries.find(&entry) == failedEntries.end())
+			{
+				LogDevice::WriteLine(m_Log, LogChannel::Error, StringInfo::Format("Failed to flush %s", entry.m_FileSpec.c_str()));
+				m_ErrorCount++;
+			}
+		}
+		return;
+	}
+
+	if (*m_FlushedCallback)
+	{
+		for (const FDepotFlushBatchEntry& entry : batch)
+		{
+			if (failedEntries.find(&entry) == failedEntries.end())
+			{
+				(*m_FlushedCallback)(entry.m_Modification);
+			}
+		}
+	}
+}
+
+size_t DepotFlushBatcher::GetBatchCount() const
+{
+	return m_BatchCount;
+}
+
+size_t DepotFlushBatcher::GetFileCount() const
+{
+	return m_FileCount;
+}
+
+size_t DepotFlushBatcher::GetErrorCount() const
+{
+	return m_ErrorCount;
+}
+
+int64_t DepotFlushBatcher::GetFlushTime() const
+{
+	return m_FlushTime;
+}
+
+DepotSyncActionInfoArray DepotFlushBatcher::FlushCommandSync(DepotClient& depotClient, const DepotStringArray& fileSpecs)
+{
+	if (depotClient.get() == nullptr || depotClient->IsConnected() == false)
+	{
+		return nullptr;
+	}
+
+	DepotCommand syncCmd;
+	syncCmd.m_Name = "sync";
+	syncCmd.m_Args.reserve(fileSpecs.size() + 1);
+	syncCmd.m_Args.push_back("-k");
+	Algo::Append(syncCmd.m_Args, fileSpecs);
+
+	DepotResult syncResult = depotClient->Run(syncCmd);
+	if (depotClient->IsFaulted())
+	{
+		return nullptr;
+	}
+
+	DepotSyncActionInfoArray errors = std::make_shared<DepotSyncActionInfoArray::element_type>();
+	for (const DepotResultText& text : syncResult->TextList())
+	{
+		if (text->m_Channel == DepotResultChannel::StdErr)
+		{
+			DepotSyncActionInfo error = FDepotSyncActionInfo::FromErrorOutput(text->m_Value, nullptr);
+			if (error.get() != nullptr)
+			{
+				errors->push_back(error);
+			}
+		}
+	}
+	return errors;
+}
+
+size_t DepotFlushBatcher::GetDefaultBatchSize()
+{
+	return size_t(std::max(0, FileCore::SettingManager::StaticInstance().SyncFlushBatchSize.GetValue()));
+}
+
+int64_t DepotFlushBatcher::GetDefaultDeadlineMs()
+{
+	return FileCore::SettingManager::StaticInstance().SyncFlushBatchDeadlineMs.GetValue();
+}
+
+}}}
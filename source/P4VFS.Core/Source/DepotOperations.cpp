@@ -4,6 +4,7 @@
 #include "DepotOperations.h"
 #include "DepotDateTime.h"
 #include "DepotResultPrint.h"
+#include "DepotTelemetry.h"
 #include "DepotConstants.h"
 #include "DriverVersion.h"
 #include "FileSystem.h"
@@ -60,6 +61,8 @@ DepotOperations::SyncVirtual(
 	)
 {
 	DepotStopwatch totalTimer(DepotStopwatch::Init::Start);
+	const bool telemetry = DepotTelemetry::IsEnabled();
+	const DepotCommandStatsArray telemetryBaseline = telemetry ? DepotTelemetry::GetStats() : DepotCommandStatsArray();
 
 	DepotRevision revision = syncOptions.m_Revision;
 	if (revision.get() == nullptr || revision->IsHeadRevision())
@@ -89,133 +92,232 @@ DepotOperations::SyncVirtual(
 		primarySyncFlags |= DepotSyncFlags::Preview;
 	}
 
-	// Retrieve a list of files to be added, deleted, and updated
-	DepotStopwatch previewTime(DepotStopwatch::Init::Start);
-	DepotSyncActionInfoArray modifications = SyncCommand(depotClient, syncOptions.m_Files, revision, primarySyncFlags | DepotSyncFlags::Quiet);
-	if (modifications.get() == nullptr)
-	{
-		return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error);
-	}
+	// The rows of the modification table which were applied are returned as the result
+	const bool isResultRequired = (syncOptions.m_SyncFlags & DepotSyncFlags::IgnoreOutput) == 0;
+	FDepotSyncActionTable::IndexArray resultRows;
 
-	previewTime.Stop();
-	depotClient->Log(LogChannel::Info, StringInfo::Format("%I64u Modification message%s to act on.", uint64_t(modifications->size()), modifications->size() ? "s" : ""));
+	// A streaming sync applies the preview as it arrives without keeping the modifications, and keeps only totals and a
+	// bounded number of warnings and errors. This is only possible when the caller does not want the modifications returned.
+	const bool isStreaming = SettingManager::StaticInstance().SyncStreaming.GetValue() && (syncOptions.m_SyncFlags & DepotSyncFlags::IgnoreOutput) != 0;
+	const size_t maxLogElements = isStreaming ? size_t(std::max(1, SettingManager::StaticInstance().SyncStreamingMaxLogElements.GetValue())) : 0;
 
-	ThreadPool::ForEach::Execute(
-		modifications->data(), 
-		modifications->size(), 
-		[&syncOptions, primarySyncFlags](DepotSyncActionInfo& modification) -> void
-		{
-			modification->m_SyncFlags = syncOptions.m_SyncFlags;
-			modification->m_FlushType = syncOptions.m_FlushType;
-			modification->m_IsAlwaysResident = IsFileTypeAlwaysResident(syncOptions.m_SyncResident, modification->m_DepotFile);
-
-			if (primarySyncFlags & DepotSyncFlags::Writeable)
-			{
-				modification->m_SyncActionFlags |= DepotSyncActionFlags::ClientClobber;
-			}
-		});
+	LogDeviceMemory memoryLog(isStreaming ? LogChannel::Warning : LogChannel::Verbose, maxLogElements);
+	LogDeviceAggregate aggregateLog;
+	LogDevice* log = &memoryLog;
 
-	if (depotClient->IsFaulted())
+	if (depotClient->Log() != nullptr)
 	{
-		return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error);
+		aggregateLog.AddDevice(depotClient->Log());
+		aggregateLog.AddDevice(&memoryLog);
+		log = &aggregateLog;
 	}
 
-	Array<DepotSyncActionInfo> virtualModifications;
-	Array<DepotSyncActionInfo> residentModifications;
-	if (syncOptions.m_FlushType == DepotFlushType::Single)
+	// Placeholder workers push their 'sync -k' file specs into a shared batcher instead of flushing each file separately
+	DepotFlushBatcher flushBatcher(log, DepotFlushBatcher::GetDefaultBatchSize(), DepotFlushBatcher::GetDefaultDeadlineMs());
+	const bool useFlushBatcher = syncOptions.m_FlushType == DepotFlushType::Atomic && DepotFlushBatcher::GetDefaultBatchSize() > 1;
+
+	// A journal of the preview and of each completed modification allows an interrupted sync to resume without a new preview.
+	// A streaming sync has no complete preview to record.
+	DepotSyncJournal journal;
+	DepotSyncActionInfoArray journalModifications;
+	const DepotString journalKey = DepotSyncJournal::CreateKey(depotClient, syncOptions, revision);
+	const String journalFilePath = isStreaming ? String() : DepotSyncJournal::GetJournalFilePath(depotClient, journalKey);
+	if (journalFilePath.empty() == false)
 	{
-		virtualModifications.reserve(modifications->size());
-		residentModifications.reserve(modifications->size());
-		for (const DepotSyncActionInfo& modification : *modifications)
+		DepotSyncJournal::DeleteClientJournals(depotClient, journalFilePath);
+		if (journal.Open(journalFilePath, journalKey, journalModifications))
 		{
-			if ((modification->m_SyncActionFlags & DepotSyncActionFlags::FileSymlink) == 0 && modification->m_IsAlwaysResident)
-			{
-				residentModifications.push_back(modification);
-			}
-			else
-			{
-				virtualModifications.push_back(modification);
-			}
+			depotClient->Log(LogChannel::Info, StringInfo::Format("Resuming from journal [%s] with %I64u of %I64u modifications remaining", CSTR_WTOA(journalFilePath), uint64_t(journalModifications->size()), uint64_t(journal.GetRecordCount())));
 		}
 	}
-	else
+
+	FSyncVirtualModificationParams params(log, depotClient, isResultRequired ? &resultRows : nullptr);
+	params.m_FlushBatcher = useFlushBatcher ? &flushBatcher : nullptr;
+	params.m_Journal = &journal;
+	FSyncVirtualSummary summary;
+	params.m_Summary = isStreaming ? &summary : nullptr;
+	flushBatcher.SetFlushedCallback([&journal](const DepotSyncActionInfo& modification) -> void
 	{
-		virtualModifications = *modifications;
-	}
+		journal.MarkComplete(FDepotSyncActionTable::GetRowIndex(modification));
+	});
 
-	DepotSyncActionInfoArray resultModifications;
-	if ((syncOptions.m_SyncFlags & DepotSyncFlags::IgnoreOutput) == 0)
+	// Always resident files are downloaded in batches of a similar total size across pooled connections, starting while the
+	// placeholders are still being installed
+	const size_t maxSyncConnections = size_t(std::max(1, SettingManager::StaticInstance().MaxSyncConnections.GetValue()));
+	const bool useResidentDownloader = syncOptions.m_SyncResident.empty() == false && DepotResidentDownloader::GetDefaultBatchBytes() > 0;
+	DepotResidentDownloader residentDownloader(
+		log, 
+		maxSyncConnections, 
+		DepotResidentDownloader::GetDefaultBatchBytes(), 
+		DepotResidentDownloader::GetDefaultMaxBatchFiles(), 
+		[log, &revision](DepotClient& downloadClient, const DepotStringArray& fileSpecs) -> bool
+		{
+			SyncCommand(downloadClient, fileSpecs, revision, DepotSyncFlags::Force | DepotSyncFlags::IgnoreOutput | DepotSyncFlags::Quiet, log);
+			return downloadClient->IsFaulted() == false;
+		},
+		DepotResidentDownloader::ConnectCommandPooled(depotClient));
+	residentDownloader.SetDownloadedCallback([&journal](const DepotSyncActionInfo& modification) -> void
 	{
-		resultModifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+		journal.MarkComplete(FDepotSyncActionTable::GetRowIndex(modification));
+	});
+	if (useResidentDownloader)
+	{
+		residentDownloader.Start(params.m_CancelationEvent.Handle(), depotClient->GetUserContext());
+		params.m_ResidentDownloader = &residentDownloader;
 	}
 
-	LogDeviceMemory memoryLog;
-	LogDeviceAggregate aggregateLog;
-	LogDevice* log = &memoryLog;
+	// Workers are started up to the maximum concurrency, and the number applying modifications at once adapts within the
+	// AdaptiveConcurrency bounds when enabled
+	DepotConcurrencyController concurrency(FDepotConcurrencyOptions::FromSettings(maxSyncConnections));
+	params.m_Concurrency = &concurrency;
 
-	if (depotClient->Log() != nullptr)
+	DepotStopwatch previewTime(DepotStopwatch::Init::Start);
+	DepotStopwatch virtualModTimer(DepotStopwatch::Init::Stop);
+
+	if (journal.IsOpen() == false && (isStreaming || SettingManager::StaticInstance().SyncPipeline.GetValue()))
 	{
-		aggregateLog.AddDevice(depotClient->Log());
-		aggregateLog.AddDevice(&memoryLog);
-		log = &aggregateLog;
+		// Modifications are applied as the preview records arrive, so the virtual mod time includes the preview time. A
+		// streaming sync keeps no table of the modifications.
+		virtualModTimer.Start();
+		params.m_Table = isStreaming ? nullptr : std::make_shared<FDepotSyncActionTable>();
+		if (SyncVirtualPipeline(params, syncOptions, revision, primarySyncFlags, previewTime) == false)
+		{
+			return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error);
+		}
 	}
-
-	DepotStopwatch virtualModTimer(DepotStopwatch::Init::Start);
-	if (modifications->size() > 0)
+	else
 	{
-		Array<DepotClient> depotClientList;
-		depotClientList.push_back(depotClient);
+		DepotSyncActionInfoArray modifications;
+		if (journal.IsOpen())
+		{
+			modifications = journalModifications;
+			previewTime.Stop();
+		}
+		else
+		{
+			// Retrieve a list of files to be added, deleted, and updated
+			modifications = SyncCommand(depotClient, syncOptions.m_Files, revision, primarySyncFlags | DepotSyncFlags::Quiet);
+			if (modifications.get() == nullptr)
+			{
+				return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error);
+			}
 
-		size_t maxThreads = size_t(std::max(1, SettingManager::StaticInstance().MaxSyncConnections.GetValue()));
-		FSyncVirtualModificationParams params(log, depotClient, resultModifications);
+			previewTime.Stop();
+			depotClient->Log(LogChannel::Info, StringInfo::Format("%I64u Modification message%s to act on.", uint64_t(modifications->size()), modifications->size() ? "s" : ""));
 
-		ThreadPool::ForEach::ExecuteImpersonated(
-			maxThreads, 
+			if (journalFilePath.empty() == false && journal.Create(journalFilePath, journalKey, modifications) == false)
+			{
+				depotClient->Log(LogChannel::Info, StringInfo::Format("Failed to create journal [%s]", CSTR_WTOA(journalFilePath)));
+			}
+		}
+
+		// The SyncResident pattern is compiled once and shared by all of the workers
+		const DepotResidentMatcher residentMatcher = FDepotResidentMatcher::FromPattern(syncOptions.m_SyncResident);
+		ThreadPool::ForEach::Execute(
 			modifications->data(), 
 			modifications->size(), 
-			params.m_CancelationEvent.Handle(), 
-			params.m_DepotClient->GetUserContext(), 
-			[&params](const DepotSyncActionInfo& modification) -> void
+			[&syncOptions, &residentMatcher, primarySyncFlags](DepotSyncActionInfo& modification) -> void
 			{
-				if (params.m_Results.get())
-				{
-					AutoMutex resultslock(params.m_ResultsMutex);
-					params.m_Results->push_back(modification);
-				}
+				PrepareVirtualModification(modification, syncOptions, *residentMatcher, primarySyncFlags);
+			});
 
-				if (SyncVirtualModification(modification, params) == false)
-				{
-					params.m_DepotClient->Log(LogChannel::Info, "Aborting Sync from SyncVirtualModification");
-					SetEvent(params.m_CancelationEvent.Handle());
-					return;
-				}
+		ResolveSymlinkTargets(depotClient, *modifications);
+		if (depotClient->IsFaulted())
+		{
+			return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error);
+		}
 
-				if (params.m_DepotClient->IsFaulted())
+		// The preview is compacted into the table, and its records are released before the modifications are applied. Each
+		// worker checks out the row it applies, so only the records in flight exist during the apply phase.
+		params.m_Table = FDepotSyncActionTable::FromArray(*modifications);
+		modifications.reset();
+		journalModifications.reset();
+
+		virtualModTimer.Start();
+		const size_t rowCount = params.m_Table->Count();
+		if (rowCount > 0)
+		{
+			size_t maxThreads = concurrency.GetMaxConcurrency();
+
+			if (SettingManager::StaticInstance().SyncDirectoryScheduling.GetValue())
+			{
+				// Each worker applies whole client directories, and the empty directories left by deletes are removed once per directory
+				FDepotSyncDirectoryScheduler scheduler(*params.m_Table);
+				params.m_DeleteEmptyDirectories = false;
+				scheduler.Execute(
+					maxThreads, 
+					params.m_CancelationEvent.Handle(), 
+					params.m_DepotClient->GetUserContext(), 
+					[&params](size_t rowIndex) -> bool
+					{
+						const DepotSyncActionInfo modification = FDepotSyncActionTable::Checkout(params.m_Table, rowIndex);
+						ExecuteVirtualModification(modification, params);
+						return modification->m_SyncActionType == DepotSyncActionType::Deleted && modification->IsPreview() == false;
+					},
+					[](const DepotString& folderPath) -> void
+					{
+						if (StringInfo::IsNullOrWhiteSpace(folderPath.c_str()) == false)
+						{
+							FileInfo::DeleteEmptyDirectories(CSTR_ATOW(folderPath));
+						}
+					}
+				);
+				params.m_DeleteEmptyDirectories = true;
+			}
+			else
+			{
+				FDepotSyncActionTable::IndexArray rowIndices(rowCount);
+				for (size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex)
 				{
-					params.m_DepotClient->Log(LogChannel::Info, "Aborting Sync from DepotClient fault");
-					SetEvent(params.m_CancelationEvent.Handle());
-					return;
+					rowIndices[rowIndex] = uint32_t(rowIndex);
 				}
+
+				ThreadPool::ForEach::ExecuteImpersonated(
+					maxThreads, 
+					rowIndices.data(), 
+					rowIndices.size(), 
+					params.m_CancelationEvent.Handle(), 
+					params.m_DepotClient->GetUserContext(), 
+					[&params](uint32_t rowIndex) -> void
+					{
+						ExecuteVirtualModification(FDepotSyncActionTable::Checkout(params.m_Table, rowIndex), params);
+					}
+				);
 			}
-		);
+		}
+	}
+
+	// Flush the remaining partial batch of placeholders installed by the workers
+	if (params.m_FlushBatcher != nullptr)
+	{
+		params.m_FlushBatcher->Flush(depotClient);
 	}
 
 	virtualModTimer.Stop();
 	DepotStopwatch residentModTimer(DepotStopwatch::Init::Start);
 
-	// Force sync the always resident modifications
-	if (residentModifications.size())
+	// Wait for the remaining batches of always resident files which were queued as the modifications were applied. Once
+	// they are complete, no checked out records remain and the table can be read directly.
+	if (params.m_ResidentDownloader != nullptr)
 	{
-		if (resultModifications.get())
+		params.m_ResidentDownloader->Complete(depotClient);
+	}
+
+	// Force sync the always resident modifications, unless the resident downloader has already downloaded them. They are
+	// selected through an index view of the table. A streaming sync keeps no table for this, since each always resident
+	// file was already downloaded when it was applied.
+	if (syncOptions.m_FlushType == DepotFlushType::Single && params.m_Table.get() != nullptr && params.m_ResidentDownloader == nullptr)
+	{
+		const FDepotSyncActionTable& table = *params.m_Table;
+		const FDepotSyncActionTable::IndexArray residentIndices = table.Select([](const FDepotSyncActionTable& t, size_t rowIndex) -> bool
 		{
-			Algo::Append(*resultModifications, residentModifications);
-		}
+			return (t.SyncActionFlags(rowIndex) & DepotSyncActionFlags::FileSymlink) == 0 && t.IsAlwaysResident(rowIndex) && t.IsPreview(rowIndex) == false;
+		});
 
 		DepotStringArray residentFileSpecs;
-		for (const DepotSyncActionInfo& modification : residentModifications)
+		for (uint32_t rowIndex : residentIndices)
 		{
-			if (modification->IsPreview() == false)
-				residentFileSpecs.push_back(modification->ToFileSpecString());
+			residentFileSpecs.push_back(table.ToFileSpecString(rowIndex));
 		}
 		if (residentFileSpecs.size())
 		{
@@ -223,8 +325,21 @@ DepotOperations::SyncVirtual(
 		}
 	}
 
+	// The journal is only kept for a sync which was interrupted before all of the modifications were applied. A resumed
+	// sync still counts all of the modifications recorded in the journal.
+	const size_t journalRecordCount = journal.GetRecordCount();
+	if (journal.IsOpen())
+	{
+		const bool isInterrupted = depotClient->IsFaulted() || WaitForSingleObject(params.m_CancelationEvent.Handle(), 0) == WAIT_OBJECT_0;
+		journal.Close();
+		if (isInterrupted == false)
+		{
+			FileInfo::Delete(journalFilePath.c_str());
+		}
+	}
+
 	// Exit early if we havn't gathered any results
-	if (resultModifications.get() == nullptr)
+	if (isResultRequired == false && isStreaming == false)
 	{
 		return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Success);
 	}
@@ -232,9 +347,37 @@ DepotOperations::SyncVirtual(
 	residentModTimer.Stop();
 	totalTimer.Stop();
 
+	// The applied rows are returned in preview order, which is the whole table unless the sync was interrupted
+	DepotSyncActionTable resultTable;
+	if (isStreaming == false)
+	{
+		summary.m_ModificationCount = std::max(params.m_Table->Count(), journalRecordCount);
+		std::sort(resultRows.begin(), resultRows.end());
+		resultTable = resultRows.size() == params.m_Table->Count() ? params.m_Table : params.m_Table->Slice(resultRows);
+		params.m_Table.reset();
+
+		summary.m_AppliedCount = resultTable->Count();
+		summary.m_VirtualFileSize = resultTable->Sum(DepotSyncActionColumn::VirtualFileSize);
+		summary.m_DiskFileSize = resultTable->Sum(DepotSyncActionColumn::DiskFileSize);
+		summary.m_FlushTime = resultTable->Sum(DepotSyncActionColumn::FlushTime);
+		summary.m_PlaceholderTime = resultTable->Sum(DepotSyncActionColumn::PlaceholderTime);
+		summary.m_SyncTime = resultTable->Sum(DepotSyncActionColumn::SyncTime);
+	}
+	else
+	{
+		if (params.m_FlushBatcher != nullptr)
+		{
+			summary.m_FlushTime += params.m_FlushBatcher->GetFlushTime();
+		}
+		if (params.m_ResidentDownloader != nullptr)
+		{
+			summary.m_SyncTime += params.m_ResidentDownloader->GetDownloadTime();
+		}
+	}
+
 	if (depotClient->IsFaulted())
 	{
-		return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error, resultModifications);
+		return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error, resultTable);
 	}
 
 	// Derive a DepotSyncStatus from the log output for this operation
@@ -246,26 +389,398 @@ DepotOperations::SyncVirtual(
 
 	int64_t totalTime = totalTimer.TotalMilliseconds();
 	int64_t fileModTime = virtualModTimer.TotalMilliseconds() + residentModTimer.TotalMilliseconds();
-	int64_t virtualFileSize = Algo::Sum<int64_t>(*resultModifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_VirtualFileSize; });
-	int64_t diskFileSize = Algo::Sum<int64_t>(*resultModifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_DiskFileSize; });
-	int64_t flushTime = Algo::Sum<int64_t>(*resultModifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_FlushTime; });
-	int64_t placeholderTime = Algo::Sum<int64_t>(*resultModifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_PlaceholderTime; });
-	int64_t syncTime = Algo::Sum<int64_t>(*resultModifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_SyncTime; });
+	int64_t virtualFileSize = summary.m_VirtualFileSize;
+	int64_t diskFileSize = summary.m_DiskFileSize;
+	int64_t flushTime = summary.m_FlushTime;
+	int64_t placeholderTime = summary.m_PlaceholderTime;
+	int64_t syncTime = summary.m_SyncTime;
 
 	depotClient->Log(LogChannel::Info, "Virtual Sync Summary:");
-	depotClient->Log(LogChannel::Info,    StringInfo::Format("Total Files:         %u / %u", resultModifications->size(), modifications->size()));
+	depotClient->Log(LogChannel::Info,    StringInfo::Format("Total Files:         %I64u / %I64u", uint64_t(summary.m_AppliedCount), uint64_t(summary.m_ModificationCount)));
 	depotClient->Log(LogChannel::Info,    StringInfo::Format("Total Time:          %s", ToDisplayStringMilliseconds(totalTime).c_str()));
 	depotClient->Log(LogChannel::Info,    StringInfo::Format("Virtual Mod Time:    %s", ToDisplayStringMilliseconds(virtualModTimer.TotalMilliseconds()).c_str()));
 	depotClient->Log(LogChannel::Info,    StringInfo::Format("Resident Mod Time:   %s", ToDisplayStringMilliseconds(residentModTimer.TotalMilliseconds()).c_str()));
 	depotClient->Log(LogChannel::Info,    StringInfo::Format("Virtual File Size:   %s", ToDisplayStringBytes(virtualFileSize).c_str()));
 	depotClient->Log(LogChannel::Info,    StringInfo::Format("Disk File Size:      %s", ToDisplayStringBytes(diskFileSize).c_str()));
+	concurrency.LogSummary(depotClient);
 	depotClient->Log(LogChannel::Verbose, StringInfo::Format("File Time:           %s", ToDisplayStringMilliseconds(fileModTime).c_str()));
 	depotClient->Log(LogChannel::Verbose, StringInfo::Format("Flush Time:          %s", ToDisplayStringMilliseconds(flushTime).c_str()));
+	depotClient->Log(LogChannel::Verbose, StringInfo::Format("Flush Commands:      %I64u / %I64u", uint64_t(flushBatcher.GetBatchCount()), uint64_t(flushBatcher.GetFileCount())));
+	depotClient->Log(LogChannel::Verbose, StringInfo::Format("Resident Commands:   %I64u / %I64u / %I64u", uint64_t(residentDownloader.GetBatchCount()), uint64_t(residentDownloader.GetFileCount()), uint64_t(residentDownloader.GetConnectionCount())));
 	depotClient->Log(LogChannel::Verbose, StringInfo::Format("Placeholder Time:    %s", ToDisplayStringMilliseconds(placeholderTime).c_str()));
 	depotClient->Log(LogChannel::Verbose, StringInfo::Format("Sync Time:           %s", ToDisplayStringMilliseconds(syncTime).c_str()));
 	depotClient->Log(LogChannel::Verbose, StringInfo::Format("Preview Time:        %s", ToDisplayStringMilliseconds(previewTime.TotalMilliseconds()).c_str()));
+	// The telemetry is collected for the whole process, so it also includes the commands of any other sync or hydration
+	// which ran at the same time, such as in the service
+	if (telemetry)
+	{
+		depotClient->Log(LogChannel::Info, StringInfo::Format("Process Telemetry:   %s", DepotTelemetry::ToJson(DepotTelemetry::Subtract(DepotTelemetry::GetStats(), telemetryBaseline)).c_str()));
+	}
+
+	return std::make_shared<FDepotSyncResult>(status, resultTable);
+}
+
+bool
+DepotOperations::SyncVirtualPipeline(
+	FSyncVirtualModificationParams& params,
+	const FDepotSyncOptions& syncOptions,
+	const DepotRevision& revision,
+	DepotSyncFlags::Enum primarySyncFlags,
+	DepotStopwatch& previewTime
+	)
+{
+	DepotClient& depotClient = params.m_DepotClient;
+	const DepotSyncFlags::Enum syncFlags = primarySyncFlags | DepotSyncFlags::Quiet;
+
+	DepotStringArray fileSpecs = CreateFileSpecs(depotClient, syncOptions.m_Files, revision);
+	if (fileSpecs.size() == 0)
+	{
+		depotClient->Log(LogChannel::Error, "No files specified to sync to");
+		return false;
+	}
+
+	// The client options are the only sync action flags known before the records arrive
+	DepotSyncActionFlags::Enum commonSyncActionFlags = DepotSyncActionFlags::None;
+	FDepotResultClientOption::Enum clientOptions = depotClient->Client()->OptionFlags();
+	if (clientOptions & FDepotResultClientOption::Clobber)
+	{
+		commonSyncActionFlags |= DepotSyncActionFlags::ClientClobber;
+	}
+	if (clientOptions & FDepotResultClientOption::AllWrite)
+	{
+		commonSyncActionFlags |= DepotSyncActionFlags::ClientWrite;
+	}
+
+	if (depotClient->IsFaulted())
+	{
+		return false;
+	}
+
+	const size_t queueSize = size_t(std::max(1, SettingManager::StaticInstance().SyncPipelineQueueSize.GetValue()));
+	const size_t resolveBatchSize = size_t(std::max(1, SettingManager::StaticInstance().SyncPipelineResolveBatchSize.GetValue()));
+	const size_t maxThreads = params.m_Concurrency != nullptr ? params.m_Concurrency->GetMaxConcurrency() : size_t(std::max(1, SettingManager::StaticInstance().MaxSyncConnections.GetValue()));
+	const HANDLE cancelationEvent = params.m_CancelationEvent.Handle();
+
+	const DepotResidentMatcher residentMatcher = FDepotResidentMatcher::FromPattern(syncOptions.m_SyncResident);
+	DepotSyncActionQueue resolveQueue(queueSize);
+	DepotSyncActionQueue applyQueue(queueSize);
+	size_t previewCount = 0;
+	std::atomic<size_t> abandonedCount(0);
+
+	// A record which is never applied after the sync is canceled is returned as an error, so that it is not mistaken
+	// for a modification which was applied
+	auto abandonModification = [&](const DepotSyncActionInfo& modification, const char* message) -> void
+	{
+		modification->m_SyncActionType = DepotSyncActionType::GenericError;
+		modification->m_Message = message;
+		abandonedCount++;
+
+		const size_t rowIndex = FDepotSyncActionTable::GetRowIndex(modification);
+		if (params.m_ResultRows != nullptr && rowIndex != FDepotSyncActionTable::InvalidRowIndex)
+		{
+			AutoMutex resultslock(params.m_ResultsMutex);
+			params.m_ResultRows->push_back(uint32_t(rowIndex));
+		}
+	};
+
+	const char* canceledMessage = "Sync was canceled before the modification was applied";
+	auto isCanceled = [cancelationEvent]() -> bool
+	{
+		return WaitForSingleObject(cancelationEvent, 0) == WAIT_OBJECT_0;
+	};
+
+	// Records which depend on filetype, writable, or opened revision information wait for the resolver. Unless the sync
+	// is streaming, each record is appended to the table and travels through the queues checked out from its row. Once
+	// the sync is canceled, the remaining preview records are no longer queued.
+	auto enqueueModification = [&](const DepotSyncActionInfo& previewModification) -> void
+	{
+		previewModification->m_SyncActionFlags |= commonSyncActionFlags;
+		PrepareVirtualModification(previewModification, syncOptions, *residentMatcher, primarySyncFlags);
+		DepotSyncActionInfo modification = previewModification;
+		if (params.m_Summary != nullptr)
+		{
+			params.m_Summary->m_ModificationCount++;
+		}
+		else
+		{
+			modification = FDepotSyncActionTable::CheckoutAppend(params.m_Table, previewModification);
+		}
+		previewCount++;
+
+		if (isCanceled())
+		{
+			abandonModification(modification, canceledMessage);
+			return;
+		}
+
+		bool requiresResolve = false;
+		switch (modification->m_SyncActionType)
+		{
+			case DepotSyncActionType::Added:
+			case DepotSyncActionType::Updated:
+			case DepotSyncActionType::Refreshed:
+			case DepotSyncActionType::Replaced:
+			case DepotSyncActionType::OpenedNotChanged:
+			{
+				requiresResolve = true;
+				break;
+			}
+			case DepotSyncActionType::Deleted:
+			{
+				const DWORD clientFileAttributes = FileInfo::FileAttributes(CSTR_ATOW(modification->m_ClientFile));
+				requiresResolve = clientFileAttributes != INVALID_FILE_ATTRIBUTES && (clientFileAttributes & FILE_ATTRIBUTE_READONLY) == 0 && modification->CanModifyWritableFile() == false;
+				break;
+			}
+		}
+
+		DepotSyncActionQueue& queue = requiresResolve ? resolveQueue : applyQueue;
+		if (queue.Push(modification, cancelationEvent) == false)
+		{
+			abandonModification(modification, canceledMessage);
+		}
+	};
+
+	// The primary client is reserved for the preview until all of the records have arrived
+	{
+		AutoMutex clientListlock(params.m_ClientListMutex);
+		params.m_DepotClientList.clear();
+	}
+
+	Array<DepotSyncPipelineStage::Enum> stages = { DepotSyncPipelineStage::Preview, DepotSyncPipelineStage::Resolve };
+	stages.resize(stages.size() + maxThreads, DepotSyncPipelineStage::Apply);
+
+	ThreadPool::ForEach::ExecuteImpersonated(
+		stages.size(), 
+		stages.data(), 
+		stages.size(), 
+		NULL, 
+		params.m_DepotClient->GetUserContext(), 
+		[&](DepotSyncPipelineStage::Enum stage) -> void
+		{
+			switch (stage)
+			{
+				case DepotSyncPipelineStage::Preview:
+				{
+					LogDeviceFilter quietLog(params.m_Log, syncFlags & DepotSyncFlags::Flush ? LogChannel::Error : LogChannel::Warning);
+					DepotClientLogCallback onClientLogCallback = std::make_shared<FDepotClientLogCallback>([&quietLog](LogChannel::Enum channel, const char* severity, const char* text) -> void
+					{
+						quietLog.Write(channel, StringInfo::ToWide(text));
+					});
+
+					DepotCommand syncCmd;
+					syncCmd.m_Name = "sync";
+					if (syncFlags & DepotSyncFlags::Force)
+						syncCmd.m_Args.push_back("-f");
+					if (syncFlags & DepotSyncFlags::Flush)
+						syncCmd.m_Args.push_back("-k");
+					if (syncFlags & DepotSyncFlags::Preview)
+						syncCmd.m_Args.push_back("-n");
+					Algo::Append(syncCmd.m_Args, fileSpecs);
+
+					FDepotResultStream syncResult([&quietLog, &enqueueModification](const DepotResultTag& tag) -> void
+					{
+						DepotSyncActionInfo modification = FDepotSyncActionInfo::FromTaggedOutput(*tag, &quietLog);
+						if (modification.get() != nullptr)
+						{
+							enqueueModification(modification);
+						}
+					});
+
+					depotClient->SetMessageCallback(onClientLogCallback);
+					depotClient->SetErrorCallback(onClientLogCallback);
+					depotClient->Run(syncCmd, syncResult);
+					depotClient->SetMessageCallback(nullptr);
+					depotClient->SetErrorCallback(nullptr);
+
+					// Untagged records such as opened files and errors are only known once the command completes
+					DepotSyncActionInfoArray textModifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+					AppendSyncTextOutput(syncResult, textModifications, &quietLog);
+					for (const DepotSyncActionInfo& modification : *textModifications)
+					{
+						enqueueModification(modification);
+					}
 
-	return std::make_shared<FDepotSyncResult>(status, resultModifications);
+					previewTime.Stop();
+					resolveQueue.Close();
+					depotClient->Log(LogChannel::Info, StringInfo::Format("%I64u Modification message%s to act on.", uint64_t(previewCount), previewCount ? "s" : ""));
+
+					AutoMutex clientListlock(params.m_ClientListMutex);
+					params.m_DepotClientList.push_back(depotClient);
+					break;
+				}
+				case DepotSyncPipelineStage::Resolve:
+				{
+					DepotClient resolveClient = FDepotClient::New(depotClient->GetContext());
+					if (resolveClient->Connect(params.m_Config) == false)
+					{
+						LogDevice::WriteLine(params.m_Log, LogChannel::Error, "DepotClient failed to connect");
+						resolveClient = nullptr;
+					}
+
+					// Resolve whatever has accumulated while the previous batch was resolving, up to the batch size
+					Array<DepotSyncActionInfo> resolveModifications;
+					DepotSyncActionInfo modification;
+					while (resolveQueue.Pop(modification, cancelationEvent))
+					{
+						resolveModifications.push_back(modification);
+						while (resolveModifications.size() < resolveBatchSize && resolveQueue.TryPop(modification))
+						{
+							resolveModifications.push_back(modification);
+						}
+
+						if (resolveClient.get() == nullptr || ResolveSyncModifications(resolveClient, syncFlags, resolveModifications) == false)
+						{
+							LogDevice::WriteLine(params.m_Log, LogChannel::Error, "Failed to resolve sync modifications");
+							SetEvent(cancelationEvent);
+							for (const DepotSyncActionInfo& resolveModification : resolveModifications)
+							{
+								abandonModification(resolveModification, "Failed to resolve the sync modification");
+							}
+						}
+						else
+						{
+							ResolveSymlinkTargets(resolveClient, resolveModifications);
+							for (const DepotSyncActionInfo& resolveModification : resolveModifications)
+							{
+								if (applyQueue.Push(resolveModification, cancelationEvent) == false)
+								{
+									abandonModification(resolveModification, canceledMessage);
+								}
+							}
+						}
+						resolveModifications.clear();
+					}
+
+					applyQueue.Close();
+					if (resolveClient.get() != nullptr)
+					{
+						AutoMutex clientListlock(params.m_ClientListMutex);
+						params.m_DepotClientList.push_back(resolveClient);
+					}
+					break;
+				}
+				case DepotSyncPipelineStage::Apply:
+				{
+					// A partial batch of placeholders to flush is executed once it expires while the workers wait for more records
+					DepotSyncActionInfo modification;
+					bool timedOut = false;
+					while (applyQueue.Pop(modification, cancelationEvent, params.m_FlushBatcher != nullptr ? params.m_FlushBatcher->GetExpireWaitMs() : INFINITE, &timedOut) || timedOut)
+					{
+						if (timedOut)
+						{
+							FlushExpiredBatch(params);
+							continue;
+						}
+						if (ExecuteVirtualModification(modification, params) == false)
+						{
+							abandonModification(modification, canceledMessage);
+						}
+					}
+					break;
+				}
+			}
+		}
+	);
+
+	// The records left in the queues by a canceled sync were never applied
+	DepotSyncActionInfo remainingModification;
+	while (resolveQueue.TryPop(remainingModification) || applyQueue.TryPop(remainingModification))
+	{
+		abandonModification(remainingModification, canceledMessage);
+	}
+	remainingModification.reset();
+
+	if (abandonedCount > 0)
+	{
+		LogDevice::WriteLine(params.m_Log, LogChannel::Error, StringInfo::Format("%I64u modification%s not applied", uint64_t(abandonedCount), abandonedCount > 1 ? "s were" : " was"));
+	}
+	return true;
+}
+
+void
+DepotOperations::PrepareVirtualModification(
+	const DepotSyncActionInfo& modification,
+	const FDepotSyncOptions& syncOptions,
+	const FDepotResidentMatcher& residentMatcher,
+	DepotSyncFlags::Enum primarySyncFlags
+	)
+{
+	modification->m_SyncFlags = syncOptions.m_SyncFlags;
+	modification->m_FlushType = syncOptions.m_FlushType;
+	modification->m_IsAlwaysResident = residentMatcher.IsMatch(modification->m_DepotFile);
+
+	if (primarySyncFlags & DepotSyncFlags::Writeable)
+	{
+		modification->m_SyncActionFlags |= DepotSyncActionFlags::ClientClobber;
+	}
+}
+
+bool
+DepotOperations::ExecuteVirtualModification(
+	const DepotSyncActionInfo& modification,
+	FSyncVirtualModificationParams& params
+	)
+{
+	// Wait for the concurrency limit, which is adjusted from how long each modification takes to apply
+	if (params.m_Concurrency != nullptr && params.m_Concurrency->Acquire(params.m_CancelationEvent.Handle()) == false)
+	{
+		return false;
+	}
+
+	if (params.m_ResultRows != nullptr)
+	{
+		AutoMutex resultslock(params.m_ResultsMutex);
+		params.m_ResultRows->push_back(uint32_t(FDepotSyncActionTable::GetRowIndex(modification)));
+	}
+
+	DepotStopwatch timer(DepotStopwatch::Init::Start);
+	const bool isApplied = SyncVirtualModification(modification, params);
+	if (params.m_Concurrency != nullptr)
+	{
+		params.m_Concurrency->Release(timer.TotalMicroseconds());
+	}
+	if (params.m_Summary != nullptr)
+	{
+		params.m_Summary->Add(*modification, params.m_FlushBatcher != nullptr, params.m_ResidentDownloader != nullptr);
+	}
+
+	if (isApplied == false)
+	{
+		params.m_DepotClient->Log(LogChannel::Info, "Aborting Sync from SyncVirtualModification");
+		SetEvent(params.m_CancelationEvent.Handle());
+		return true;
+	}
+
+	if (params.m_DepotClient->IsFaulted())
+	{
+		params.m_DepotClient->Log(LogChannel::Info, "Aborting Sync from DepotClient fault");
+		SetEvent(params.m_CancelationEvent.Handle());
+	}
+	return true;
+}
+
+void
+DepotOperations::FSyncVirtualSummary::Add(
+	const FDepotSyncActionInfo& modification,
+	bool isFlushBatched,
+	bool isDownloadBatched
+	)
+{
+	m_AppliedCount++;
+	m_VirtualFileSize += modification.m_VirtualFileSize;
+	m_DiskFileSize += modification.m_DiskFileSize;
+	m_PlaceholderTime += modification.m_PlaceholderTime;
+
+	// A batched flush or download completes after the modification is applied, so its time is taken from the batcher
+	// or downloader instead
+	if (isFlushBatched == false)
+	{
+		m_FlushTime += modification.m_FlushTime;
+	}
+	if (isDownloadBatched == false)
+	{
+		m_SyncTime += modification.m_SyncTime;
+	}
 }
 
 bool
@@ -278,7 +793,7 @@ DepotOperations::SyncVirtualModification(
 		(modification->m_SyncActionFlags & DepotSyncActionFlags::FileSymlink) == 0 &&
 		(modification->m_FlushType == DepotFlushType::Single))
 	{
-		ApplyVirtualModification(DepotClient(), params.m_Config, modification, params.m_Log);
+		ApplyVirtualModification(DepotClient(), params.m_Config, modification, params.m_Log, params.m_FlushBatcher, params.m_Journal, params.m_DeleteEmptyDirectories, params.m_ResidentDownloader);
 		return true;
 	}
 
@@ -314,7 +829,11 @@ DepotOperations::SyncVirtualModification(
 		return false;
 	}
 
-	ApplyVirtualModification(depotClient, params.m_Config, modification, params.m_Log);
+	ApplyVirtualModification(depotClient, params.m_Config, modification, params.m_Log, params.m_FlushBatcher, params.m_Journal, params.m_DeleteEmptyDirectories, params.m_ResidentDownloader);
+	if (params.m_FlushBatcher != nullptr)
+	{
+		params.m_FlushBatcher->FlushExpired(depotClient);
+	}
 	{
 		AutoMutex clientListlock(params.m_ClientListMutex);
 		params.m_DepotClientList.push_back(depotClient);
@@ -322,17 +841,74 @@ DepotOperations::SyncVirtualModification(
 	return true;
 }
 
+void
+DepotOperations::FlushExpiredBatch(
+	FSyncVirtualModificationParams& params
+	)
+{
+	// A worker which is busy applying a modification checks the deadline itself, so there is no need to wait for a client
+	DepotClient depotClient;
+	{
+		AutoMutex clientListlock(params.m_ClientListMutex);
+		if (params.m_DepotClientList.size())
+		{
+			depotClient = params.m_DepotClientList.back();
+			params.m_DepotClientList.pop_back();
+		}
+	}
+
+	if (depotClient.get() != nullptr)
+	{
+		params.m_FlushBatcher->FlushExpired(depotClient);
+		AutoMutex clientListlock(params.m_ClientListMutex);
+		params.m_DepotClientList.push_back(depotClient);
+	}
+}
+
 void
 DepotOperations::ApplyVirtualModification(
 	DepotClient& depotClient,
 	const DepotConfig& depotConfig,
 	const DepotSyncActionInfo& modification,
-	LogDevice* parentLog)
+	LogDevice* parentLog,
+	DepotFlushBatcher* flushBatcher,
+	DepotSyncJournal* journal,
+	bool deleteEmptyDirectories,
+	DepotResidentDownloader* residentDownloader)
 {
 	// If we have nested actions, buffer up the output.
 	LogDeviceMemory memoryLog;
 	LogDevice* log = modification->m_SubActions.size() > 0 ? &memoryLog : parentLog;
 
+	// Record that this modification does not need to be applied again if the sync is resumed
+	auto markComplete = [&modification, journal]() -> void
+	{
+		if (journal != nullptr)
+		{
+			journal->MarkComplete(FDepotSyncActionTable::GetRowIndex(modification));
+		}
+	};
+
+	// Flush the have revision of this file to the server, either immediately or with the next batch. A batched
+	// modification is marked complete by the batcher once its batch has been flushed.
+	auto flushModification = [&depotClient, &modification, flushBatcher, &markComplete](const DepotRevision& revision) -> void
+	{
+		if (flushBatcher != nullptr && revision.get() != nullptr && revision->IsHeadRevision() == false)
+		{
+			const DepotString fileSpec = CreateFileSpec(modification->m_DepotFile, revision);
+			if (fileSpec.empty() == false)
+			{
+				flushBatcher->Add(depotClient, modification, fileSpec);
+				return;
+			}
+		}
+
+		DepotStopwatch timer(DepotStopwatch::Init::Start);
+		SyncCommand(depotClient, DepotStringArray{ modification->m_DepotFile }, revision, DepotSyncFlags::Flush | DepotSyncFlags::IgnoreOutput | DepotSyncFlags::Quiet);
+		modification->m_FlushTime = timer.TotalMilliseconds();
+		markComplete();
+	};
+
 	// We only handle the Added, Updated, or Deleted events from Perforce
 	switch (modification->m_SyncActionType)
 	{
@@ -359,7 +935,16 @@ DepotOperations::ApplyVirtualModification(
 					modification->m_DiskFileSize = modification->m_FileSize;
 					if (modification->IsPreview() == false)
 					{
-						SyncCommand(depotClient, DepotStringArray{ modification->m_DepotFile }, modification->m_Revision, DepotSyncFlags::Force | DepotSyncFlags::IgnoreOutput | DepotSyncFlags::Quiet);
+						// A batched download is marked complete by the downloader once its batch has been downloaded
+						if (residentDownloader != nullptr)
+						{
+							residentDownloader->Add(modification);
+						}
+						else
+						{
+							SyncCommand(depotClient, DepotStringArray{ modification->m_DepotFile }, modification->m_Revision, DepotSyncFlags::Force | DepotSyncFlags::IgnoreOutput | DepotSyncFlags::Quiet);
+							markComplete();
+						}
 					}
 				}
 				else
@@ -371,10 +956,7 @@ DepotOperations::ApplyVirtualModification(
 						if (InstallPlaceholderFile(depotClient, depotConfig, modification))
 						{
 							modification->m_PlaceholderTime = timer.TotalMilliseconds();
-							timer.Restart();
-
-							SyncCommand(depotClient, DepotStringArray{ modification->m_DepotFile }, modification->m_Revision, DepotSyncFlags::Flush | DepotSyncFlags::IgnoreOutput | DepotSyncFlags::Quiet);
-							modification->m_FlushTime = timer.TotalMilliseconds();
+							flushModification(modification->m_Revision);
 						}
 						else
 						{
@@ -400,13 +982,10 @@ DepotOperations::ApplyVirtualModification(
 				if (modification->IsPreview() == false)
 				{
 					DepotStopwatch timer(DepotStopwatch::Init::Start);
-					if (UninstallPlaceholderFile(modification))
+					if (UninstallPlaceholderFile(modification, deleteEmptyDirectories))
 					{
 						modification->m_PlaceholderTime = timer.TotalMilliseconds();
-						timer.Restart();
-
-						SyncCommand(depotClient, DepotStringArray{ modification->m_DepotFile }, FDepotRevision::New<FDepotRevisionNone>(), DepotSyncFlags::Flush | DepotSyncFlags::IgnoreOutput | DepotSyncFlags::Quiet);
-						modification->m_FlushTime = timer.TotalMilliseconds();
+						flushModification(FDepotRevision::New<FDepotRevisionNone>());
 					}
 					else
 					{
@@ -422,9 +1001,7 @@ DepotOperations::ApplyVirtualModification(
 		}
 		case DepotSyncActionType::OpenedNotChanged:
 		{
-			DepotStopwatch timer(DepotStopwatch::Init::Start);
-			SyncCommand(depotClient, DepotStringArray{ modification->m_DepotFile }, modification->m_Revision, DepotSyncFlags::Flush | DepotSyncFlags::IgnoreOutput | DepotSyncFlags::Quiet);
-			modification->m_FlushTime = timer.TotalMilliseconds();
+			flushModification(modification->m_Revision);
 			LogDevice::WriteLine(log, LogChannel::Warning, StringInfo::Format("%s - is opened and not being changed", modification->ToFileSpecString().c_str()));
 			break;
 		}
@@ -475,9 +1052,15 @@ DepotOperations::ApplyVirtualModification(
 		}
 	}
 
+	// Up-to-date and error records have nothing to apply, so they are not repeated when resuming
+	if (DepotSyncActionType::IsError(modification->m_SyncActionType))
+	{
+		markComplete();
+	}
+
 	for (const DepotSyncActionInfo& subaction : modification->m_SubActions)
 	{
-		ApplyVirtualModification(depotClient, depotConfig, subaction, log);
+		ApplyVirtualModification(depotClient, depotConfig, subaction, log, flushBatcher, journal, deleteEmptyDirectories, residentDownloader);
 	}
 
 	// Flush buffered log all at once
@@ -501,7 +1084,12 @@ DepotOperations::CreateSymlinkFile(
 		return true;
 	}
 
-	DepotString targetFile = GetSymlinkTargetPath(depotClient, modification->m_DepotFile, modification->m_Revision);
+	// The target is usually resolved for all of the symlinks of a sync at once by ResolveSymlinkTargets
+	DepotString targetFile = modification->m_SymlinkTarget;
+	if (targetFile.empty())
+	{
+		targetFile = GetSymlinkTargetPath(depotClient, modification->m_DepotFile, modification->m_Revision);
+	}
 	if (targetFile.empty())
 	{
 		return false;
@@ -514,6 +1102,77 @@ DepotOperations::CreateSymlinkFile(
 	return status;
 }
 
+bool
+DepotOperations::PopulateFiles(
+	DepotClient& depotClient,
+	const Array<DepotSyncActionInfo>& modifications,
+	LogDevice* log
+	)
+{
+	struct FPopulateFile
+	{
+		FPopulateFile(const String& tempFilePath) : m_TempFile(tempFilePath.c_str()), m_PrintIndex(size_t(-1)) {}
+		AutoTempFile m_TempFile;
+		FileCore::AutoHandle m_hTempFile;
+		size_t m_PrintIndex;
+	};
+
+	if (log == nullptr)
+	{
+		log = depotClient->Log();
+	}
+
+	// The content of every file is printed into a temporary file by a single command. A populate by stream has no file to
+	// print into, so it is populated by copy from the temporary file.
+	const FileSystem::FilePopulateMethod::Enum populateMethod = FileSystem::FilePopulateMethod::FromString(StringInfo::ToAnsi(SettingManager::StaticInstance().PopulateMethod.GetValue()));
+	const BYTE populateFileMethod = populateMethod == FileSystem::FilePopulateMethod::Move ? P4VFS_POPULATE_METHOD_MOVE : P4VFS_POPULATE_METHOD_COPY;
+
+	bool status = true;
+	FDepotResultPrintDemux print;
+	List<FPopulateFile> populateFiles;
+	for (const DepotSyncActionInfo& modification : modifications)
+	{
+		const String tempFolder = populateFileMethod == P4VFS_POPULATE_METHOD_MOVE ? FileInfo::FolderPath(CSTR_ATOW(modification->m_ClientFile)) : String();
+		FPopulateFile& populateFile = populateFiles.emplace_back(FileInfo::CreateTempFile(tempFolder.c_str()));
+		populateFile.m_hTempFile.Reset(CreateFile(populateFile.m_TempFile.GetFilePath().c_str(), GENERIC_WRITE, 0, NULL, TRUNCATE_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
+		if (populateFile.m_hTempFile.IsValid() == false)
+		{
+			LogDevice::WriteLine(log, LogChannel::Error, StringInfo::Format("Failed to create tempfile to populate '%s'", modification->m_ClientFile.c_str()));
+			modification->m_SyncActionType = DepotSyncActionType::GenericError;
+			status = false;
+			continue;
+		}
+		populateFile.m_PrintIndex = print.AddFile(modification->m_DepotFile, modification->RevisionNumber(), populateFile.m_hTempFile.Handle());
+	}
+
+	if (print.GetFileCount() > 0)
+	{
+		depotClient->Run(DepotCommand("print", print.GetFileSpecs()), print);
+	}
+
+	auto populateFile = populateFiles.begin();
+	for (const DepotSyncActionInfo& modification : modifications)
+	{
+		populateFile->m_hTempFile.Close();
+		if (populateFile->m_PrintIndex != size_t(-1))
+		{
+			HRESULT hr = HRESULT_FROM_WIN32(ERROR_INVALID_PRINTER_COMMAND);
+			if (print.IsFilePrinted(populateFile->m_PrintIndex))
+			{
+				hr = FileOperations::PopulateFile(CSTR_ATOW(modification->m_ClientFile), populateFile->m_TempFile.GetFilePath().c_str(), populateFileMethod);
+			}
+			if (FAILED(hr))
+			{
+				LogDevice::WriteLine(log, LogChannel::Error, StringInfo::Format("Failed to populate file '%s' with error [%s]", modification->m_ClientFile.c_str(), CSTR_WTOA(StringInfo::ToString(hr))));
+				modification->m_SyncActionType = DepotSyncActionType::GenericError;
+				status = false;
+			}
+		}
+		++populateFile;
+	}
+	return status;
+}
+
 DepotSyncResult
 DepotOperations::Hydrate(
 	DepotClient& depotClient, 
@@ -527,72 +1186,250 @@ DepotOperations::Hydrate(
 		return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error);
 	}
 
-	DepotResultFStat hydrateFStat = FStat(depotClient, hydrateSpecs, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::ClientFile | FDepotResultFStatField::HaveRev);
-	if (hydrateFStat->HasError())
-	{
-		depotClient->Log(LogChannel::Error, StringInfo::Format("Failed to fstat paths to hydrate: %s", hydrateFStat->GetError().c_str()));
-		return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error);
-	}
-
 	DepotSyncActionInfoArray modifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
 	DepotSyncStatus::Enum status = DepotSyncStatus::Success;
+	DepotStopwatch totalTimer(DepotStopwatch::Init::Start);
 
-	if (hydrateFStat->NodeCount() > 0)
-	{
-		LogDevice* log = depotClient->Log();
-		FileCore::AutoHandle modificationsMutex = CreateMutex(NULL, FALSE, NULL);
-
-		ThreadPool::ForEach::Execute(
-			hydrateFStat->TagList().data(),
-			hydrateFStat->TagList().size(), 
-			[log, &syncOptions, &status, &modifications, &modificationsMutex](const DepotResultTag& hydrateFStatTag) -> void
+	LogDevice* log = depotClient->Log();
+	FileCore::AutoHandle modificationsMutex = CreateMutex(NULL, FALSE, NULL);
+	const DepotResidentMatcher residentMatcher = FDepotResidentMatcher::FromPattern(syncOptions.m_SyncResident);
+	DepotConcurrencyController concurrency(FDepotConcurrencyOptions::FromSettings(ThreadPool::GetPoolDefaultNumberOfThreads()));
+
+	// Files may be populated directly in batches which are each printed by a single command, rather than each file being 
+	// opened to have the service print it with a command of its own. The files are grouped by the port, client and user
+	// of their placeholders, since that is the configuration the service would have printed each of them with.
+	const size_t printBatchSize = size_t(std::max(0, SettingManager::StaticInstance().HydratePrintBatchSize.GetValue()));
+	const DepotConfig& depotConfig = depotClient->Config();
+	HydrateGroupMap hydrateGroups;
+
+	// Files are hydrated while the remaining fstat records are still being received
+	DepotResultStream hydrateFStat = FStatStream(
+		depotClient, 
+		hydrateSpecs, 
+		"", 
+		FDepotResultFStatField::DepotFile | FDepotResultFStatField::ClientFile | FDepotResultFStatField::HaveRev | FDepotResultFStatField::FileSize,
+		concurrency.GetMaxConcurrency(),
+		[log, &syncOptions, &residentMatcher, &status, &modifications, &modificationsMutex, &concurrency, printBatchSize, &depotConfig, &hydrateGroups](const DepotResultTag& hydrateFStatTag) -> void
+	{
+		const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(hydrateFStatTag);
+		const int32_t haveRev = node.HaveRev();
+		const DepotString& depotFile = node.DepotFile();
+		const DepotString& clientFile = node.ClientFile();
+		const WString& filePath = StringInfo::ToWide(clientFile);
+
+		DWORD fileAttributes = FileCore::FileInfo::FileAttributes(filePath.c_str());
+		if ((fileAttributes == INVALID_FILE_ATTRIBUTES) || (fileAttributes & FILE_ATTRIBUTE_OFFLINE) == 0)
 		{
-			const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(hydrateFStatTag);
-			const int32_t haveRev = node.HaveRev();
-			const DepotString& depotFile = node.DepotFile();
-			const DepotString& clientFile = node.ClientFile();
-			const WString& filePath = StringInfo::ToWide(clientFile);
+			return;
+		}
 
-			DWORD fileAttributes = FileCore::FileInfo::FileAttributes(filePath.c_str());
-			if ((fileAttributes == INVALID_FILE_ATTRIBUTES) || (fileAttributes & FILE_ATTRIBUTE_OFFLINE) == 0)
+		bool isAlwaysResident = false;
+		if (syncOptions.m_SyncResident.empty() == false)
+		{
+			isAlwaysResident = residentMatcher->IsMatch(depotFile);
+			if (isAlwaysResident == false)
 			{
 				return;
 			}
+		}
+
+		DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+		modification->m_DepotFile = depotFile;
+		modification->m_ClientFile = clientFile;
+		modification->m_FileSize = node.FileSize();
+		modification->m_Revision = FDepotRevisionValue(DepotRevisionType::Number, haveRev).ToRevision();
+		modification->m_SyncFlags = syncOptions.m_SyncFlags;
+		modification->m_IsAlwaysResident = isAlwaysResident;
 
-			bool isAlwaysResident = false;
-			if (syncOptions.m_SyncResident.empty() == false)
+		LogDevice::WriteLine(log, LogChannel::Info, StringInfo::Format("%s#%d - request hydrate as %s", depotFile.c_str(), haveRev, clientFile.c_str()));
+		if (modification->IsPreview() == false && printBatchSize > 1)
+		{
+			DepotConfig groupConfig = depotConfig;
+			FileCore::GAllocPtr<P4VFS_REPARSE_DATA_2> reparseData;
+			if (SUCCEEDED(FileOperations::GetFileReparseData(filePath.c_str(), reparseData)) && reparseData.get() != nullptr)
 			{
-				isAlwaysResident = IsFileTypeAlwaysResident(syncOptions.m_SyncResident, depotFile);
-				if (isAlwaysResident == false)
-				{
-					return;
-				}
+				groupConfig.m_Port = ResolveDepotServerName(StringInfo::ToAnsi(reparseData->depotServer.c_str()));
+				groupConfig.m_User = StringInfo::ToAnsi(reparseData->depotUser.c_str());
+				groupConfig.m_Client = StringInfo::ToAnsi(reparseData->depotClient.c_str());
+			}
+
+			AutoMutex modificationsLock(modificationsMutex.Handle());
+			FHydrateGroup& group = hydrateGroups[CreateHydrateGroupKey(groupConfig)];
+			if (group.m_Modifications.empty())
+			{
+				group.m_Config = groupConfig;
+			}
+			group.m_Modifications.push_back(modification);
+		}
+		else if (modification->IsPreview() == false && concurrency.Acquire())
+		{
+			DepotStopwatch timer(DepotStopwatch::Init::Start);
+			HRESULT hr = FileOperations::HydrateFile(filePath.c_str());
+			concurrency.Release(timer.TotalMicroseconds());
+			if (hr != S_OK)
+			{
+				LogDevice::WriteLine(log, LogChannel::Error, StringInfo::Format("Failed to hydrate file '%s' with error [%s]", clientFile.c_str(), CSTR_WTOA(StringInfo::ToString(hr))));
+				modification->m_SyncActionType = DepotSyncActionType::GenericError;
+				status = DepotSyncStatus::Error;
+			}
+		}
+
+		AutoMutex modificationsLock(modificationsMutex.Handle());
+		modifications->push_back(modification);
+	});
+
+	if (hydrateFStat->HasError())
+	{
+		depotClient->Log(LogChannel::Error, StringInfo::Format("Failed to fstat paths to hydrate: %s", hydrateFStat->GetError().c_str()));
+		return std::make_shared<FDepotSyncResult>(DepotSyncStatus::Error, modifications);
+	}
+
+	// Groups of another port, user or client than depotClient are printed with a connection of their own
+	size_t printBatchCount = 0;
+	FileContext* fileContext = depotClient->GetContext();
+	status |= HydrateGroups(
+		depotClient, 
+		hydrateGroups, 
+		printBatchSize, 
+		log, 
+		[fileContext](const DepotConfig& groupConfig) -> DepotClient
+		{
+			DepotClient groupClient = FDepotClient::New(fileContext);
+			if (groupClient->Connect(groupConfig) == false)
+			{
+				return nullptr;
+			}
+			return groupClient;
+		},
+		[log](DepotClient& pooledClient, const Array<DepotSyncActionInfo>& batch) -> bool
+		{
+			return PopulateFiles(pooledClient, batch, log);
+		},
+		&printBatchCount);
+
+	if (hydrateFStat->StreamCount() > 0 && concurrency.IsAdaptive())
+	{
+		concurrency.LogSummary(depotClient);
+	}
+
+	status |= VerifyHydratedFiles(*modifications, log);
+
+	uint64_t requestCount = 0;
+	uint64_t hydrateCount = 0;
+	uint64_t hydrateBytes = 0;
+	for (const DepotSyncActionInfo& modification : *modifications)
+	{
+		if (modification->IsPreview() == false)
+		{
+			requestCount++;
+			if (modification->m_SyncActionType != DepotSyncActionType::GenericError)
+			{
+				hydrateCount++;
+				hydrateBytes += uint64_t(std::max<int64_t>(0, modification->m_FileSize));
 			}
+		}
+	}
 
-			DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
-			modification->m_DepotFile = depotFile;
-			modification->m_ClientFile = clientFile;
-			modification->m_Revision = FDepotRevision::New<FDepotRevisionNumber>(haveRev);
-			modification->m_SyncFlags = syncOptions.m_SyncFlags;
-			modification->m_IsAlwaysResident = isAlwaysResident;
+	if (requestCount > 0)
+	{
+		const double totalSeconds = std::max(totalTimer.DurationSeconds(), 0.001);
+		depotClient->Log(LogChannel::Info, "Hydrate Summary:");
+		depotClient->Log(LogChannel::Info,    StringInfo::Format("Total Files:         %I64u / %I64u", hydrateCount, requestCount));
+		depotClient->Log(LogChannel::Info,    StringInfo::Format("Total Time:          %s", ToDisplayStringMilliseconds(totalTimer.TotalMilliseconds()).c_str()));
+		depotClient->Log(LogChannel::Info,    StringInfo::Format("Hydrated File Size:  %s", ToDisplayStringBytes(hydrateBytes).c_str()));
+		depotClient->Log(LogChannel::Info,    StringInfo::Format("Throughput:          %.1f files/sec, %.2f MB/sec", double(hydrateCount) / totalSeconds, double(hydrateBytes) / (1024.0*1024.0) / totalSeconds));
+		depotClient->Log(LogChannel::Verbose, StringInfo::Format("Print Commands:      %I64u / %I64u", uint64_t(printBatchCount), uint64_t(hydrateGroups.size())));
+	}
 
-			LogDevice::WriteLine(log, LogChannel::Info, StringInfo::Format("%s#%d - request hydrate as %s", depotFile.c_str(), haveRev, clientFile.c_str()));
-			if (modification->IsPreview() == false)
+	return std::make_shared<FDepotSyncResult>(status, modifications);
+}
+
+DepotSyncStatus::Enum
+DepotOperations::HydrateGroups(
+	DepotClient& depotClient,
+	const HydrateGroupMap& hydrateGroups,
+	size_t printBatchSize,
+	LogDevice* log,
+	const HydrateConnectCommand& connectCommand,
+	const HydratePopulateCommand& populateCommand,
+	size_t* printBatchCount
+	)
+{
+	DepotSyncStatus::Enum status = DepotSyncStatus::Success;
+	const DepotString depotConfigKey = CreateHydrateGroupKey(depotClient->Config());
+	for (const HydrateGroupMap::value_type& groupPair : hydrateGroups)
+	{
+		const FHydrateGroup& group = groupPair.second;
+		DepotClient groupClient = depotClient;
+		if (groupPair.first != depotConfigKey)
+		{
+			groupClient = connectCommand(group.m_Config);
+			if (groupClient.get() == nullptr)
 			{
-				HRESULT hr = FileOperations::HydrateFile(filePath.c_str());
-				if (hr != S_OK)
+				for (const DepotSyncActionInfo& modification : group.m_Modifications)
 				{
-					LogDevice::WriteLine(log, LogChannel::Error, StringInfo::Format("Failed to hydrate file '%s' with error [%s]", clientFile.c_str(), CSTR_WTOA(StringInfo::ToString(hr))));
-					status = DepotSyncStatus::Error;
+					LogDevice::WriteLine(log, LogChannel::Error, StringInfo::Format("Failed to hydrate file '%s' with error [Failed to connect %s]", modification->m_ClientFile.c_str(), group.m_Config.ToConnectionString().c_str()));
+					modification->m_SyncActionType = DepotSyncActionType::GenericError;
 				}
+				status = DepotSyncStatus::Error;
+				continue;
 			}
+		}
 
-			AutoMutex modificationsLock(modificationsMutex.Handle());
-			modifications->push_back(modification);
+		const Array<DepotSyncActionInfo>& printModifications = group.m_Modifications;
+		const size_t batchSize = std::max<size_t>(1, printBatchSize);
+		const size_t batchCount = (printModifications.size() + batchSize - 1) / batchSize;
+		ForEachPooledClient(groupClient, batchCount, [batchSize, &printModifications, &populateCommand, &status](DepotClient& pooledClient, size_t batchIndex) -> void
+		{
+			const size_t batchBegin = batchIndex * batchSize;
+			const size_t batchEnd = std::min(printModifications.size(), batchBegin + batchSize);
+			const Array<DepotSyncActionInfo> batch(printModifications.begin() + batchBegin, printModifications.begin() + batchEnd);
+			if (populateCommand(pooledClient, batch) == false)
+			{
+				status = DepotSyncStatus::Error;
+			}
 		});
+
+		if (printBatchCount != nullptr)
+		{
+			*printBatchCount += batchCount;
+		}
 	}
+	return status;
+}
 
-	return std::make_shared<FDepotSyncResult>(status, modifications);
+DepotSyncStatus::Enum
+DepotOperations::VerifyHydratedFiles(
+	const Array<DepotSyncActionInfo>& modifications,
+	LogDevice* log
+	)
+{
+	// A file which was not reported as failed may still be offline, such as when its batch was never printed
+	DepotSyncStatus::Enum status = DepotSyncStatus::Success;
+	for (const DepotSyncActionInfo& modification : modifications)
+	{
+		if (modification->IsPreview() || modification->m_SyncActionType == DepotSyncActionType::GenericError)
+		{
+			continue;
+		}
+
+		const DWORD fileAttributes = FileCore::FileInfo::FileAttributes(CSTR_ATOW(modification->m_ClientFile));
+		if (fileAttributes == INVALID_FILE_ATTRIBUTES || (fileAttributes & FILE_ATTRIBUTE_OFFLINE) != 0)
+		{
+			LogDevice::WriteLine(log, LogChannel::Error, StringInfo::Format("Failed to hydrate file '%s' which is still offline", modification->m_ClientFile.c_str()));
+			modification->m_SyncActionType = DepotSyncActionType::GenericError;
+			status = DepotSyncStatus::Error;
+		}
+	}
+	return status;
+}
+
+DepotString
+DepotOperations::CreateHydrateGroupKey(
+	const DepotConfig& config
+	)
+{
+	return StringInfo::Format("%s,%s,%s", config.m_Port.c_str(), config.m_User.c_str(), config.m_Client.c_str());
 }
 
 bool
@@ -608,72 +1445,71 @@ DepotOperations::Reconfig(
 		return false;
 	}
 
-	DepotResultFStat reconfigFStat = FStat(depotClient, reconfigSpecs, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::ClientFile | FDepotResultFStatField::FileSize);
-	if (reconfigFStat->HasError())
-	{
-		depotClient->Log(LogChannel::Error, StringInfo::Format("Failed to fstat paths to reconfig: %s", reconfigFStat->GetError().c_str()));
-		return false;
-	}
-
 	bool status = true;
-
-	if (reconfigFStat->NodeCount() > 0)
-	{
-		LogDevice* log = depotClient->Log();
-		const DepotConfig depotConfig = depotClient->Config();
-
-		ThreadPool::ForEach::Execute(
-			reconfigFStat->TagList().data(),
-			reconfigFStat->TagList().size(), 
-			[log, depotConfig, &reconfigOptions, &status](const DepotResultTag& reconfigFStatTag) -> void
+	LogDevice* log = depotClient->Log();
+	const DepotConfig depotConfig = depotClient->Config();
+
+	// Files are reconfigured while the remaining fstat records are still being received
+	DepotResultStream reconfigFStat = FStatStream(
+		depotClient, 
+		reconfigSpecs, 
+		"", 
+		FDepotResultFStatField::DepotFile | FDepotResultFStatField::ClientFile | FDepotResultFStatField::FileSize,
+		ThreadPool::GetPoolDefaultNumberOfThreads(),
+		[log, depotConfig, &reconfigOptions, &status](const DepotResultTag& reconfigFStatTag) -> void
+	{
+		const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(reconfigFStatTag);			
+		const DepotString& depotFile = node.DepotFile();
+		const DepotString& clientFile = node.ClientFile();
+		const WString& filePath = StringInfo::ToWide(clientFile);
+		const int64_t fileSize = node.FileSize();
+
+		DWORD fileAttributes = FileCore::FileInfo::FileAttributes(filePath.c_str());
+		if ((fileAttributes == INVALID_FILE_ATTRIBUTES) || (fileAttributes & FILE_ATTRIBUTE_OFFLINE) == 0)
 		{
-			const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(reconfigFStatTag);			
-			const DepotString& depotFile = node.DepotFile();
-			const DepotString& clientFile = node.ClientFile();
-			const WString& filePath = StringInfo::ToWide(clientFile);
-			const int64_t fileSize = node.FileSize();
+			return;
+		}
 
-			DWORD fileAttributes = FileCore::FileInfo::FileAttributes(filePath.c_str());
-			if ((fileAttributes == INVALID_FILE_ATTRIBUTES) || (fileAttributes & FILE_ATTRIBUTE_OFFLINE) == 0)
-			{
-				return;
-			}
+		FileCore::GAllocPtr<P4VFS_REPARSE_DATA_2> reparseData;
+		HRESULT hr = FileOperations::GetFileReparseData(filePath.c_str(), reparseData);
+		if (FAILED(hr) || reparseData.get() == nullptr)
+		{
+			return;
+		}
+		
+		const DepotString reconfigPort = reconfigOptions.m_Flags & DepotReconfigFlags::P4Port ? depotConfig.m_Port : StringInfo::ToAnsi(reparseData->depotServer.c_str());
+		const DepotString reconfigClient = reconfigOptions.m_Flags & DepotReconfigFlags::P4Client ? depotConfig.m_Client : StringInfo::ToAnsi(reparseData->depotClient.c_str());
+		const DepotString reconfigUser = reconfigOptions.m_Flags & DepotReconfigFlags::P4User ? depotConfig.m_User : StringInfo::ToAnsi(reparseData->depotUser.c_str());
 
-			FileCore::GAllocPtr<P4VFS_REPARSE_DATA_2> reparseData;
-			HRESULT hr = FileOperations::GetFileReparseData(filePath.c_str(), reparseData);
-			if (FAILED(hr) || reparseData.get() == nullptr)
+		LogDevice::WriteLine(log, LogChannel::Info, StringInfo::Format("%s#%d - reconfig as %s [%s %s %s]", depotFile.c_str(), int32_t(reparseData->fileRevision), clientFile.c_str(), reconfigPort.c_str(), reconfigClient.c_str(), reconfigUser.c_str()));
+		if ((reconfigOptions.m_Flags & DepotReconfigFlags::Preview) == 0)
+		{
+			hr = FileOperations::InstallReparsePointOnFile(
+				P4VFS_VER_MAJOR,
+				P4VFS_VER_MINOR,
+				P4VFS_VER_BUILD,
+				filePath.c_str(),
+				P4VFS_RESIDENCY_POLICY_RESIDENT,
+				reparseData->fileRevision,
+				fileSize,
+				fileAttributes & FILE_ATTRIBUTE_READONLY,
+				CSTR_ATOW(depotFile),
+				CSTR_ATOW(reconfigPort),
+				CSTR_ATOW(reconfigClient),
+				CSTR_ATOW(reconfigUser));
+
+			if (hr != S_OK)
 			{
-				return;
+				LogDevice::Error(log, StringInfo::Format("Failed to reconfig file '%s' with error [%s]", clientFile.c_str(), CSTR_WTOA(StringInfo::ToString(hr))));
+				status = false;
 			}
-			
-			const DepotString reconfigPort = reconfigOptions.m_Flags & DepotReconfigFlags::P4Port ? depotConfig.m_Port : StringInfo::ToAnsi(reparseData->depotServer.c_str());
-			const DepotString reconfigClient = reconfigOptions.m_Flags & DepotReconfigFlags::P4Client ? depotConfig.m_Client : StringInfo::ToAnsi(reparseData->depotClient.c_str());
-			const DepotString reconfigUser = reconfigOptions.m_Flags & DepotReconfigFlags::P4User ? depotConfig.m_User : StringInfo::ToAnsi(reparseData->depotUser.c_str());
+		}
+	});
 
-			LogDevice::WriteLine(log, LogChannel::Info, StringInfo::Format("%s#%d - reconfig as %s [%s %s %s]", depotFile.c_str(), int32_t(reparseData->fileRevision), clientFile.c_str(), reconfigPort.c_str(), reconfigClient.c_str(), reconfigUser.c_str()));
-			if ((reconfigOptions.m_Flags & DepotReconfigFlags::Preview) == 0)
-			{
-				hr = FileOperations::InstallReparsePointOnFile(
-					P4VFS_VER_MAJOR,
-					P4VFS_VER_MINOR,
-					P4VFS_VER_BUILD,
-					filePath.c_str(),
-					P4VFS_RESIDENCY_POLICY_RESIDENT,
-					reparseData->fileRevision,
-					fileSize,
-					fileAttributes & FILE_ATTRIBUTE_READONLY,
-					CSTR_ATOW(depotFile),
-					CSTR_ATOW(reconfigPort),
-					CSTR_ATOW(reconfigClient),
-					CSTR_ATOW(reconfigUser));
-
-				if (hr != S_OK)
-				{
-					LogDevice::Error(log, StringInfo::Format("Failed to reconfig file '%s' with error [%s]", clientFile.c_str(), CSTR_WTOA(StringInfo::ToString(hr))));
-					status = false;
-				}
-			}
-		});
+	if (reconfigFStat->HasError())
+	{
+		depotClient->Log(LogChannel::Error, StringInfo::Format("Failed to fstat paths to reconfig: %s", reconfigFStat->GetError().c_str()));
+		return false;
 	}
 
 	return status;
@@ -718,7 +1554,8 @@ DepotOperations::InstallPlaceholderFile(
 
 bool
 DepotOperations::UninstallPlaceholderFile(
-	const DepotSyncActionInfo& modification
+	const DepotSyncActionInfo& modification,
+	bool deleteEmptyDirectories
 	)
 {
 	if (modification->IsPreview())
@@ -734,7 +1571,7 @@ DepotOperations::UninstallPlaceholderFile(
 	}
 
 	WString deletedFromFolder = FileInfo::FolderPath(clientFile.c_str());
-	if (StringInfo::IsNullOrWhiteSpace(deletedFromFolder.c_str()) == false)
+	if (deleteEmptyDirectories && StringInfo::IsNullOrWhiteSpace(deletedFromFolder.c_str()) == false)
 	{
 		FileInfo::DeleteEmptyDirectories(deletedFromFolder.c_str());
 	}
@@ -874,50 +1711,21 @@ DepotOperations::SyncCommand(
 		return nullptr;
 	}
 
-	DepotSyncActionInfoArray modifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
-	if (syncResult->TagList().size() > 0)
-	{
-		for (const DepotResultTag& tag : syncResult->TagList())
-		{
-			DepotSyncActionInfo actionInfo = FDepotSyncActionInfo::FromTaggedOutput(*tag, log);
-			if (actionInfo.get() != nullptr)
-			{
-				modifications->push_back(actionInfo);
-			}
-		}
-	}
-
-	if (syncResult->TextList().size() > 0)
+	DepotSyncActionInfoArray modifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+	if (syncResult->TagList().size() > 0)
 	{
-		DepotSyncActionInfo parentActionInfo;
-		for (const DepotResultText& text : syncResult->TextList())
+		for (const DepotResultTag& tag : syncResult->TagList())
 		{
-			DepotSyncActionInfo actionInfo;
-			if (text->m_Channel == DepotResultChannel::StdOut)
-			{
-				actionInfo = FDepotSyncActionInfo::FromInfoOutput(text->m_Value, log);
-			}
-			else if (text->m_Channel == DepotResultChannel::StdErr)
-			{
-				actionInfo = FDepotSyncActionInfo::FromErrorOutput(text->m_Value, log);
-			}
-
-			if (actionInfo.get() == nullptr)
-			{
-				parentActionInfo = nullptr;
-			}
-			else if (text->m_Level == 0)
+			DepotSyncActionInfo actionInfo = FDepotSyncActionInfo::FromTaggedOutput(*tag, log);
+			if (actionInfo.get() != nullptr)
 			{
 				modifications->push_back(actionInfo);
-				parentActionInfo = actionInfo;
-			}
-			else if (parentActionInfo.get() != nullptr)
-			{
-				parentActionInfo->m_SubActions.push_back(actionInfo);
 			}
 		}
 	}
 
+	AppendSyncTextOutput(*syncResult, modifications, log);
+
 	typedef HashSet<DepotString, StringInfo::EqualInsensitive> DepotFileHashSet; 
 	typedef Map<DepotString, FDepotResultSizesNode, StringInfo::LessInsensitive> DepotFileClientSizeMapType;
 
@@ -927,9 +1735,11 @@ DepotOperations::SyncCommand(
 	DepotFileHashSet diffDepotFiles;
 	DepotFileClientSizeMapType depotFileClientSizeMap;
 
+	// The connections pooled by the diff2 pass are kept for the client sizes pass
+	Array<DepotClient> pooledClients;
 	if (syncFlags & (DepotSyncFlags::Preview | DepotSyncFlags::Flush))
 	{
-		DepotResultDiff2 diff2 = Diff2Stat(depotClient, syncFlags, fileSpecs, modifications);
+		DepotResultDiff2 diff2 = Diff2Stat(depotClient, syncFlags, fileSpecs, modifications, &pooledClients);
 		if (diff2.get() == nullptr || diff2->HasError())
 		{
 			reportError(StringInfo::Format("Failed get filetype differences. %s", diff2.get() ? diff2->GetError().c_str() : "Invalid result"));
@@ -953,11 +1763,22 @@ DepotOperations::SyncCommand(
 				symlinkDepotFiles.insert(node.DepotFile2());
 		}
 
-		for (const DepotString& fileSpec : fileSpecs)
+		if ((syncFlags & DepotSyncFlags::ClientSize) != 0 && depotClient->GetServerApiLevel() >= DepotProtocol::SERVER_SIZES_C)
 		{
-			if ((syncFlags & DepotSyncFlags::ClientSize) != 0 && depotClient->GetServerApiLevel() >= DepotProtocol::SERVER_SIZES_C)
+			Array<DepotResultSizes> sizesResults(fileSpecs.size());
+			ForEachPooledClient(depotClient, fileSpecs.size(), [&fileSpecs, &sizesResults](DepotClient& pooledClient, size_t fileSpecIndex) -> void
 			{
-				DepotResultSizes sizes = Sizes(depotClient, fileSpec, SizesFlags::ClientSize);
+				sizesResults[fileSpecIndex] = Sizes(pooledClient, fileSpecs[fileSpecIndex], SizesFlags::ClientSize);
+			}, 
+			&pooledClients);
+
+			// Merge in fileSpec order so that the result is the same as running each fileSpec in sequence
+			for (const DepotResultSizes& sizes : sizesResults)
+			{
+				if (sizes.get() == nullptr)
+				{
+					continue;
+				}
 				for (size_t sizesNodeIndex = 0; sizesNodeIndex < sizes->NodeCount(); ++sizesNodeIndex)
 				{
 					FDepotResultSizesNode node = sizes->Node(sizesNodeIndex);
@@ -967,24 +1788,24 @@ DepotOperations::SyncCommand(
 		}
 	}
 
-	typedef Map<DepotString, FDepotResultFStatNode, StringInfo::LessInsensitive> OpenedHeadDepotFilesType;
+	typedef Map<DepotString, int32_t, StringInfo::LessInsensitive> OpenedHeadDepotFilesType;
 	OpenedHeadDepotFilesType openedHeadDepotFiles;
 
-	DepotResultFStat openedFStat = FStat(depotClient, fileSpecs, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadRev, DepotStringArray{ "-Ro" });
-	for (size_t fstatNodeIndex = 0; fstatNodeIndex < openedFStat->NodeCount(); ++fstatNodeIndex)
+	FStatStream(depotClient, fileSpecs, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadRev, 1, [&openedHeadDepotFiles](const DepotResultTag& tag) -> void
 	{
-		const FDepotResultFStatNode& node = openedFStat->Node(fstatNodeIndex);
-		openedHeadDepotFiles[node.DepotFile()] = node;
-	}
+		const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(tag);
+		openedHeadDepotFiles[node.DepotFile()] = node.HeadRev();
+	}, 
+	DepotStringArray{ "-Ro" });
 
 	for (const DepotSyncActionInfo& modification : *modifications)
 	{
 		if (modification->m_SyncActionType == DepotSyncActionType::OpenedNotChanged && 
 			modification->m_DepotFile.empty() == false)
 		{
-			if (FDepotResultFStatNode* fstatNode = Algo::Find(openedHeadDepotFiles, modification->m_DepotFile))
+			if (const int32_t* headRev = Algo::Find(openedHeadDepotFiles, modification->m_DepotFile))
 			{
-				modification->m_Revision = FDepotRevision::New<FDepotRevisionNumber>(fstatNode->HeadRev());
+				modification->m_Revision = FDepotRevisionValue(DepotRevisionType::Number, *headRev).ToRevision();
 			}
 		}
 
@@ -1014,13 +1835,12 @@ DepotOperations::SyncCommand(
 		if (identicalHaveDepotFiles.size() > 0)
 		{
 			DepotString writableFileTypeFilter = "headType=*+*w*";
-			DepotResultFStat identicalFStat = FStat(depotClient, identicalHaveDepotFiles, writableFileTypeFilter, FDepotResultFStatField::DepotFile);
-			for (size_t fstatNodeIndex = 0; fstatNodeIndex < identicalFStat->NodeCount(); ++fstatNodeIndex)
+			FStatStream(depotClient, identicalHaveDepotFiles, writableFileTypeFilter, FDepotResultFStatField::DepotFile, 1, [&writeableHaveDepotFiles, &writeableHeadDepotFiles](const DepotResultTag& tag) -> void
 			{
-				const FDepotResultFStatNode& node = identicalFStat->Node(fstatNodeIndex);
+				const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(tag);
 				writeableHaveDepotFiles.insert(node.DepotFile());
 				writeableHeadDepotFiles.insert(node.DepotFile());
-			}
+			});
 		}
 	}
 
@@ -1056,6 +1876,130 @@ DepotOperations::SyncCommand(
 	return modifications;
 }
 
+void
+DepotOperations::AppendSyncTextOutput(
+	const FDepotResult& syncResult,
+	DepotSyncActionInfoArray& modifications,
+	FileCore::LogDevice* log
+	)
+{
+	if (syncResult.TextList().size() > 0)
+	{
+		DepotSyncActionInfo parentActionInfo;
+		for (const DepotResultText& text : syncResult.TextList())
+		{
+			DepotSyncActionInfo actionInfo;
+			if (text->m_Channel == DepotResultChannel::StdOut)
+			{
+				actionInfo = FDepotSyncActionInfo::FromInfoOutput(text->m_Value, log);
+			}
+			else if (text->m_Channel == DepotResultChannel::StdErr)
+			{
+				actionInfo = FDepotSyncActionInfo::FromErrorOutput(text->m_Value, log);
+			}
+
+			if (actionInfo.get() == nullptr)
+			{
+				parentActionInfo = nullptr;
+			}
+			else if (text->m_Level == 0)
+			{
+				modifications->push_back(actionInfo);
+				parentActionInfo = actionInfo;
+			}
+			else if (parentActionInfo.get() != nullptr)
+			{
+				parentActionInfo->m_SubActions.push_back(actionInfo);
+			}
+		}
+	}
+}
+
+bool
+DepotOperations::ResolveSyncModifications(
+	DepotClient& depotClient,
+	DepotSyncFlags::Enum syncFlags,
+	const Array<DepotSyncActionInfo>& modifications
+	)
+{
+	typedef HashMap<DepotString, DepotSyncActionInfo, StringInfo::Hash, StringInfo::EqualInsensitive> DepotFileModificationMapType;
+	DepotFileModificationMapType depotFileModifications;
+	DepotSyncActionInfoArray fileModifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+	DepotStringArray openedDepotFiles;
+
+	for (const DepotSyncActionInfo& modification : modifications)
+	{
+		if (IsFullDepotFileSpec(modification->m_DepotFile))
+		{
+			depotFileModifications[modification->m_DepotFile] = modification;
+			if (modification->m_SyncActionType == DepotSyncActionType::OpenedNotChanged)
+			{
+				openedDepotFiles.push_back(modification->m_DepotFile);
+			}
+			else
+			{
+				fileModifications->push_back(modification);
+			}
+		}
+	}
+
+	// The have and head filetypes of each file are used in place of the diff2 of the entire file spec
+	const DepotRevision haveRevision = (syncFlags & DepotSyncFlags::Force) ? FDepotRevision::New<FDepotRevisionNone>() : FDepotRevision::New<FDepotRevisionHave>();
+	DepotStringArray haveFileSpecs = CreateFileSpecs(depotClient, fileModifications, haveRevision, CreateFileSpecFlags::OverrideRevison);
+	DepotStringArray headFileSpecs = CreateFileSpecs(depotClient, fileModifications, nullptr, CreateFileSpecFlags::None);
+
+	FStatStream(depotClient, haveFileSpecs, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadType, 1, [&depotFileModifications](const DepotResultTag& tag) -> void
+	{
+		const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(tag);
+		if (DepotSyncActionInfo* modification = Algo::Find(depotFileModifications, node.DepotFile()))
+		{
+			if (DepotInfo::IsWritableFileType(node.HeadType()))
+				(*modification)->m_SyncActionFlags |= DepotSyncActionFlags::HaveFileWrite;
+			if (DepotInfo::IsSymlinkFileType(node.HeadType()))
+				(*modification)->m_SyncActionFlags |= DepotSyncActionFlags::FileSymlink;
+		}
+	});
+
+	FStatStream(depotClient, headFileSpecs, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadType, 1, [&depotFileModifications](const DepotResultTag& tag) -> void
+	{
+		const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(tag);
+		if (DepotSyncActionInfo* modification = Algo::Find(depotFileModifications, node.DepotFile()))
+		{
+			if (DepotInfo::IsWritableFileType(node.HeadType()))
+				(*modification)->m_SyncActionFlags |= DepotSyncActionFlags::FileWrite;
+			if (DepotInfo::IsSymlinkFileType(node.HeadType()))
+				(*modification)->m_SyncActionFlags |= DepotSyncActionFlags::FileSymlink;
+		}
+	});
+
+	FStatStream(depotClient, openedDepotFiles, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadRev, 1, [&depotFileModifications](const DepotResultTag& tag) -> void
+	{
+		const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(tag);
+		if (DepotSyncActionInfo* modification = Algo::Find(depotFileModifications, node.DepotFile()))
+		{
+			(*modification)->m_Revision = FDepotRevisionValue(DepotRevisionType::Number, node.HeadRev()).ToRevision();
+		}
+	}, 
+	DepotStringArray{ "-Ro" });
+
+	if ((syncFlags & DepotSyncFlags::ClientSize) != 0 && depotClient->GetServerApiLevel() >= DepotProtocol::SERVER_SIZES_C && headFileSpecs.size() > 0)
+	{
+		DepotStringArray sizesArgs{ "-C" };
+		Algo::Append(sizesArgs, headFileSpecs);
+		RunStream(depotClient, DepotCommand("sizes", sizesArgs), 1, [&depotFileModifications](const DepotResultTag& tag) -> void
+		{
+			const FDepotResultSizesNode node = FDepotResultNode::Create<FDepotResultSizesNode>(tag);
+			DepotSyncActionInfo* modification = Algo::Find(depotFileModifications, node.DepotFile());
+			if (modification != nullptr && node.FileSize() > 0)
+			{
+				(*modification)->m_FileSize = node.FileSize();
+			}
+		});
+	}
+
+	return depotClient->IsFaulted() == false;
+}
+
 DepotRevision
 DepotOperations::GetHeadRevisionChangelist(
 	DepotClient& depotClient
@@ -1104,17 +2048,25 @@ DepotOperations::CreateFileSpec(
 	)
 {
 	DepotString fileSpecPath = StringInfo::Trim(filePath.c_str(), "\" ");
-	DepotString fileSpecRev = FDepotRevision::ToString(revision);
+	const char* fileSpecMatchRev = StringInfo::Strpbrk(fileSpecPath.c_str(), "@#");
+	const bool useMatchRev = fileSpecMatchRev != nullptr && (flags & CreateFileSpecFlags::OverrideRevison) == 0 && fileSpecMatchRev[1] != '\0';
+
+	const size_t fileSpecPathLength = fileSpecMatchRev != nullptr ? size_t(fileSpecMatchRev-fileSpecPath.c_str()) : fileSpecPath.size();
 
-	const DepotString fileSpecMatch = fileSpecPath;
-	const char* fileSpecMatchRev = StringInfo::Strpbrk(fileSpecMatch.c_str(), "@#");
-	if (fileSpecMatchRev != nullptr)
+	// Most revisions are a number or keyword, which are parsed and formatted in place without a DepotRevision
+	FDepotRevisionValue revValue;
+	if (useMatchRev ? FDepotRevisionValue::Parse(fileSpecMatchRev, fileSpecPath.size()-fileSpecPathLength, revValue) : FDepotRevisionValue::FromRevision(revision, revValue))
 	{
-		fileSpecPath.assign(fileSpecMatch.c_str(), fileSpecMatchRev-fileSpecMatch.c_str());
-		if ((flags & CreateFileSpecFlags::OverrideRevison) == 0 && fileSpecMatchRev[1] != '\0')
-			fileSpecRev = fileSpecMatchRev;
+		char revText[FDepotRevisionValue::MaxLength+1];
+		const size_t revLength = revValue.Format(revText, _countof(revText));
+		fileSpecPath.resize(fileSpecPathLength);
+		fileSpecPath.append(revText, revLength);
+		return fileSpecPath;
 	}
 
+	const DepotString fileSpecRev = useMatchRev ? DepotString(fileSpecMatchRev) : FDepotRevision::ToString(revision);
+	fileSpecPath.resize(fileSpecPathLength);
+
 	DepotRevision parsedRev;
 	if (fileSpecRev.empty() == false)
 	{
@@ -1187,7 +2139,8 @@ DepotOperations::Diff2Stat(
 	DepotClient& depotClient,
 	DepotSyncFlags::Enum syncFlags,
 	const DepotStringArray& fileSpecs,
-	const DepotSyncActionInfoArray& fileModifications
+	const DepotSyncActionInfoArray& fileModifications,
+	Array<DepotClient>* pooledClients
 	)
 {
 	DepotResultDiff2 diff2stat = MakeResult<DepotResultDiff2>();
@@ -1205,42 +2158,51 @@ DepotOperations::Diff2Stat(
 
 	if (useFStat)
 	{
-		DepotStringArray haveFileSpecs = CreateFileSpecs(depotClient, fileModifications, haveRevision, CreateFileSpecFlags::OverrideRevison);
-		DepotResultFStat haveFStat = FStat(depotClient, haveFileSpecs, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadType | FDepotResultFStatField::HeadRev);
-
-		DepotStringArray headFileSpecs = CreateFileSpecs(depotClient, fileModifications, nullptr, CreateFileSpecFlags::None);
-		DepotResultFStat headFStat = FStat(depotClient, headFileSpecs, "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadType | FDepotResultFStatField::HeadRev);
+		// The have and head fstat are independent, so each runs on its own connection
+		const DepotStringArray fstatFileSpecs[] = {
+			CreateFileSpecs(depotClient, fileModifications, haveRevision, CreateFileSpecFlags::OverrideRevison),
+			CreateFileSpecs(depotClient, fileModifications, nullptr, CreateFileSpecFlags::None),
+		};
 
 		typedef Map<DepotString, DepotResultTag, StringInfo::LessInsensitive> Diff2NodeMap;
 		Diff2NodeMap nodeMap;
+		FileCore::AutoHandle nodeMapMutex = CreateMutex(NULL, FALSE, NULL);
 
-		auto addNodes = [&nodeMap](const DepotResultFStat& fstat, const char* depotFileName, const char* revName, const char* typeName) -> void
+		// Each fstat record is merged into the diff2 node of its depot file as it arrives, instead of being retained
+		auto addNode = [&nodeMap, &nodeMapMutex](const FDepotResultFStatNode& node, const char* depotFileName, const char* revName, const char* typeName) -> void
 		{
-			for (size_t fstatNodeIndex = 0; fstatNodeIndex < fstat->NodeCount(); ++fstatNodeIndex)
-			{
-				const FDepotResultFStatNode& node = fstat->Node(fstatNodeIndex);
-				const DepotString& depotFile = node.DepotFile();
-				DepotResultTag tag = nullptr;
-
-				Diff2NodeMap::iterator tagIt = nodeMap.find(depotFile);
-				if (tagIt == nodeMap.end())
-				{
-					tag = std::make_shared<FDepotResultTag>();
-					nodeMap.insert(Diff2NodeMap::value_type(depotFile, tag));
-				}
-				else
-				{
-					tag = tagIt->second;
-				}
+			const DepotString& depotFile = node.DepotFile();
+			AutoMutex nodeMapLock(nodeMapMutex);
+			DepotResultTag tag = nullptr;
 
-				tag->SetValue(depotFileName, depotFile);
-				tag->SetValue(revName, node.GetTagValue(FDepotResultFStatField::Name::HeadRev));
-				tag->SetValue(typeName, node.GetTagValue(FDepotResultFStatField::Name::HeadType));
+			Diff2NodeMap::iterator tagIt = nodeMap.find(depotFile);
+			if (tagIt == nodeMap.end())
+			{
+				tag = std::make_shared<FDepotResultTag>();
+				nodeMap.insert(Diff2NodeMap::value_type(depotFile, tag));
+			}
+			else
+			{
+				tag = tagIt->second;
 			}
+
+			tag->SetValue(depotFileName, depotFile);
+			tag->SetValue(revName, node.GetTagValue(FDepotResultFStatField::Name::HeadRev));
+			tag->SetValue(typeName, node.GetTagValue(FDepotResultFStatField::Name::HeadType));
 		};
 
-		addNodes(haveFStat, FDepotResultDiff2Field::Name::DepotFile, FDepotResultDiff2Field::Name::Rev, FDepotResultDiff2Field::Name::Type);
-		addNodes(headFStat, FDepotResultDiff2Field::Name::DepotFile2, FDepotResultDiff2Field::Name::Rev2, FDepotResultDiff2Field::Name::Type2);
+		ForEachPooledClient(depotClient, _countof(fstatFileSpecs), [&fstatFileSpecs, &addNode](DepotClient& pooledClient, size_t fstatIndex) -> void
+		{
+			FStatStream(pooledClient, fstatFileSpecs[fstatIndex], "", FDepotResultFStatField::DepotFile | FDepotResultFStatField::HeadType | FDepotResultFStatField::HeadRev, 1, [fstatIndex, &addNode](const DepotResultTag& tag) -> void
+			{
+				const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(tag);
+				if (fstatIndex == 0)
+					addNode(node, FDepotResultDiff2Field::Name::DepotFile, FDepotResultDiff2Field::Name::Rev, FDepotResultDiff2Field::Name::Type);
+				else
+					addNode(node, FDepotResultDiff2Field::Name::DepotFile2, FDepotResultDiff2Field::Name::Rev2, FDepotResultDiff2Field::Name::Type2);
+			});
+		}, 
+		pooledClients);
 
 		for (Diff2NodeMap::value_type& node : nodeMap)
 		{
@@ -1249,6 +2211,8 @@ DepotOperations::Diff2Stat(
 	}
 	else
 	{
+		DepotStringArray haveFileSpecs;
+		haveFileSpecs.reserve(fileSpecs.size());
 		for (const DepotString& fileSpec : fileSpecs)
 		{
 			const DepotString haveFileSpec = CreateFileSpec(fileSpec, haveRevision, CreateFileSpecFlags::OverrideRevison);
@@ -1262,8 +2226,19 @@ DepotOperations::Diff2Stat(
 			{
 				return MakeErrorResult<DepotResultDiff2>(StringInfo::Format("Invalid headFileSpec for fileSpec='%s'", fileSpec.c_str()));
 			}
+			haveFileSpecs.push_back(haveFileSpec);
+		}
+
+		Array<DepotResultDiff2> diff2Results(fileSpecs.size());
+		ForEachPooledClient(depotClient, fileSpecs.size(), [&fileSpecs, &haveFileSpecs, &diff2Results](DepotClient& pooledClient, size_t fileSpecIndex) -> void
+		{
+			diff2Results[fileSpecIndex] = Diff2(pooledClient, haveFileSpecs[fileSpecIndex], fileSpecs[fileSpecIndex]);
+		}, 
+		pooledClients);
 
-			DepotResultDiff2 diff2 = Diff2(depotClient, haveFileSpec, headFileSpec);
+		// Merge in fileSpec order so that the result is the same as running each fileSpec in sequence
+		for (const DepotResultDiff2& diff2 : diff2Results)
+		{
 			if (diff2.get())
 			{
 				diff2stat->Append(diff2->TagList());
@@ -1273,6 +2248,112 @@ DepotOperations::Diff2Stat(
 	return diff2stat;
 }
 
+void
+DepotOperations::ForEachPooledClient(
+	DepotClient& depotClient,
+	size_t itemCount,
+	const PooledClientPredicate& predicate,
+	Array<DepotClient>* pooledClients
+	)
+{
+	const size_t maxConnections = std::min<size_t>(itemCount, size_t(std::max(1, SettingManager::StaticInstance().MaxSyncConnections.GetValue())));
+	if (maxConnections <= 1)
+	{
+		for (size_t itemIndex = 0; itemIndex < itemCount; ++itemIndex)
+		{
+			predicate(depotClient, itemIndex);
+		}
+		return;
+	}
+
+	// The calling client is the first in the pool, followed by the connections kept from a previous call. Additional
+	// connections are only made while all of these are busy, and once a connection fails the items wait for a busy one.
+	Array<DepotClient> localClients;
+	Array<DepotClient>& additionalClients = pooledClients != nullptr ? *pooledClients : localClients;
+	Array<DepotClient> depotClientList{ depotClient };
+	Algo::Append(depotClientList, additionalClients);
+	additionalClients.clear();
+
+	FileCore::AutoHandle clientListMutex = CreateMutex(NULL, FALSE, NULL);
+	FileCore::AutoHandle clientSemaphore = CreateSemaphore(NULL, LONG(depotClientList.size()), LONG_MAX, NULL);
+	size_t connectionCount = depotClientList.size();
+	bool canConnect = true;
+
+	Array<size_t> itemIndices(itemCount);
+	for (size_t itemIndex = 0; itemIndex < itemCount; ++itemIndex)
+	{
+		itemIndices[itemIndex] = itemIndex;
+	}
+
+	ThreadPool::ForEach::ExecuteImpersonated(
+		maxConnections, 
+		itemIndices.data(), 
+		itemIndices.size(), 
+		NULL, 
+		depotClient->GetUserContext(), 
+		[&depotClient, &predicate, maxConnections, &clientListMutex, &clientSemaphore, &depotClientList, &connectionCount, &canConnect](size_t itemIndex) -> void
+		{
+			DepotClient pooledClient;
+			if (WaitForSingleObject(clientSemaphore.Handle(), 0) != WAIT_OBJECT_0)
+			{
+				bool connect = false;
+				{
+					AutoMutex clientListlock(clientListMutex);
+					if (canConnect && connectionCount < maxConnections)
+					{
+						connectionCount++;
+						connect = true;
+					}
+				}
+
+				if (connect)
+				{
+					DepotClient newClient = FDepotClient::New(depotClient->GetContext());
+					if (newClient->Connect(depotClient->Config()))
+					{
+						pooledClient = newClient;
+					}
+					else
+					{
+						depotClient->Log(LogChannel::Warning, "DepotClient failed to connect, continuing on the connected clients");
+						AutoMutex clientListlock(clientListMutex);
+						canConnect = false;
+						connectionCount--;
+					}
+				}
+
+				if (pooledClient.get() == nullptr)
+				{
+					WaitForSingleObject(clientSemaphore.Handle(), INFINITE);
+				}
+			}
+
+			if (pooledClient.get() == nullptr)
+			{
+				AutoMutex clientListlock(clientListMutex);
+				pooledClient = depotClientList.back();
+				depotClientList.pop_back();
+			}
+
+			predicate(pooledClient, itemIndex);
+			{
+				AutoMutex clientListlock(clientListMutex);
+				depotClientList.push_back(pooledClient);
+			}
+			ReleaseSemaphore(clientSemaphore.Handle(), 1, NULL);
+		}
+	);
+
+	// The additional connections are kept for the next call
+	for (const DepotClient& pooledClient : depotClientList)
+	{
+		if (pooledClient.get() != depotClient.get())
+		{
+			additionalClients.push_back(pooledClient);
+		}
+	}
+}
+
 DepotResultDiff2
 DepotOperations::Diff2(
 	DepotClient& depotClient,
@@ -1320,10 +2401,102 @@ DepotOperations::FStat(
 		return std::make_shared<FDepotResultFStat>();
 	}
 
+	return depotClient->Run<DepotResultFStat>(CreateFStatCommand(files, filterType, fields, optionArgs));
+}
+
+DepotResultStream
+DepotOperations::RunStream(
+	DepotClient& depotClient,
+	const DepotCommand& command,
+	size_t maxThreads,
+	const StreamTagPredicate& predicate
+	)
+{
+	if (maxThreads <= 1)
+	{
+		DepotResultStream result = std::make_shared<FDepotResultStream>(predicate);
+		depotClient->Run(command, *result);
+		return result;
+	}
+
+	// The command is run on the calling thread, and the queue limits how far the records can get ahead of the workers
+	struct FStreamWorkers
+	{
+		FStreamWorkers(size_t maxThreads, size_t queueSize, const StreamTagPredicate& predicate) :
+			m_MaxThreads(maxThreads),
+			m_Queue(queueSize),
+			m_Predicate(predicate)
+		{}
+
+		static DWORD Execute(void* data)
+		{
+			FStreamWorkers* workers = reinterpret_cast<FStreamWorkers*>(data);
+			Array<size_t> workerIndices(workers->m_MaxThreads, 0);
+			ThreadPool::ForEach::Execute(workerIndices.size(), workerIndices.data(), workerIndices.size(), NULL, [workers](size_t) -> void
+			{
+				DepotResultTag tag;
+				while (workers->m_Queue.Pop(tag))
+				{
+					workers->m_Predicate(tag);
+				}
+			});
+			return 0;
+		}
+
+		size_t m_MaxThreads;
+		DepotQueue<DepotResultTag> m_Queue;
+		const StreamTagPredicate& m_Predicate;
+	};
+
+	FStreamWorkers workers(maxThreads, size_t(std::max(1, SettingManager::StaticInstance().SyncPipelineQueueSize.GetValue())), predicate);
+	FileCore::AutoHandle workersThread = CreateThread(NULL, 0, FStreamWorkers::Execute, &workers, 0, NULL);
+	if (workersThread.Handle() == NULL)
+	{
+		return RunStream(depotClient, command, 1, predicate);
+	}
+
+	DepotResultStream result = std::make_shared<FDepotResultStream>([&workers](const DepotResultTag& tag) -> void
+	{
+		workers.m_Queue.Push(tag);
+	});
+
+	depotClient->Run(command, *result);
+	workers.m_Queue.Close();
+	WaitForSingleObject(workersThread.Handle(), INFINITE);
+	return result;
+}
+
+DepotResultStream
+DepotOperations::FStatStream(
+	DepotClient& depotClient,
+	const DepotStringArray& files,
+	const DepotString& filterType,
+	FDepotResultFStatField::Enum fields,
+	size_t maxThreads,
+	const StreamTagPredicate& predicate,
+	const DepotStringArray& optionArgs
+	)
+{
+	if (files.size() == 0)
+	{
+		return std::make_shared<FDepotResultStream>(predicate);
+	}
+
+	return RunStream(depotClient, CreateFStatCommand(files, filterType, fields, optionArgs), maxThreads, predicate);
+}
+
+DepotCommand
+DepotOperations::CreateFStatCommand(
+	const DepotStringArray& files,
+	const DepotString& filterType,
+	FDepotResultFStatField::Enum fields,
+	const DepotStringArray& optionArgs
+	)
+{
 	DepotStringArray fieldNames = FDepotResultFStatField::ToNames(fields);
 	DepotStringArray fstatArgs = optionArgs;
 
-	if (fields & FDepotResultFStatField::FileSize)
+	if (fields & (FDepotResultFStatField::FileSize | FDepotResultFStatField::Digest))
 		fstatArgs.push_back("-Ol");
 	if (fieldNames.size())
 		Algo::Append(fstatArgs, DepotStringArray{"-T", StringInfo::Join(fieldNames, ",")});
@@ -1331,7 +2504,7 @@ DepotOperations::FStat(
 		Algo::Append(fstatArgs, DepotStringArray{"-F", filterType});
 
 	Algo::Append(fstatArgs, files);
-	return depotClient->Run<DepotResultFStat>("fstat", fstatArgs);
+	return DepotCommand("fstat", fstatArgs);
 }
 
 bool
@@ -1357,8 +2530,7 @@ DepotOperations::IsFileTypeAlwaysResident(
 {
 	if (depotFile.empty() == false && syncResident.empty() == false)
 	{
-		std::match_results<const char*> match;
-		return std::regex_search(depotFile.c_str(), match, std::regex(syncResident, std::regex_constants::ECMAScript|std::regex_constants::icase));
+		return FDepotResidentMatcher::FromPattern(syncResident)->IsMatch(depotFile);
 	}
 	return false;
 }
@@ -1385,9 +2557,66 @@ DepotOperations::GetSymlinkTargetPath(
 	if (fileSpec.empty())
 		return DepotString();
 	
-	DepotResultPrintString print = depotClient->Run<DepotResultPrintString>(DepotCommand("print", DepotStringArray{ "-q", fileSpec }, DepotCommand::Flags::UnTagged));
-	DepotString targetPath = StringInfo::Trim(print->GetString().c_str());
-	return targetPath;
+	return GetSymlinkTargetPaths(depotClient, DepotStringArray{ fileSpec }).front();
+}
+
+DepotStringArray
+DepotOperations::GetSymlinkTargetPaths(
+	DepotClient& depotClient,
+	const DepotStringArray& fileSpecs
+	)
+{
+	DepotStringArray targetPaths(fileSpecs.size());
+	if (depotClient.get() == nullptr || fileSpecs.empty())
+		return targetPaths;
+
+	// The target of each symlink is a small print, so they are pipelined rather than paying a round trip each
+	Array<DepotCommand> printCmds;
+	printCmds.reserve(fileSpecs.size());
+	for (const DepotString& fileSpec : fileSpecs)
+	{
+		printCmds.push_back(DepotCommand("print", DepotStringArray{ "-q", fileSpec }, DepotCommand::Flags::UnTagged));
+	}
+
+	Array<DepotResultPrintString> prints = depotClient->RunBatch<DepotResultPrintString>(printCmds);
+	for (size_t printIndex = 0; printIndex < prints.size(); ++printIndex)
+	{
+		targetPaths[printIndex] = StringInfo::Trim(prints[printIndex]->GetString().c_str());
+	}
+	return targetPaths;
+}
+
+void
+DepotOperations::ResolveSymlinkTargets(
+	DepotClient& depotClient,
+	const Array<DepotSyncActionInfo>& modifications
+	)
+{
+	Array<DepotSyncActionInfo> symlinkModifications;
+	DepotStringArray symlinkFileSpecs;
+	for (const DepotSyncActionInfo& modification : modifications)
+	{
+		if ((modification->m_SyncActionFlags & DepotSyncActionFlags::FileSymlink) == 0 || 
+			modification->m_SyncActionType == DepotSyncActionType::Deleted ||
+			modification->IsPreview() ||
+			modification->m_SymlinkTarget.empty() == false)
+		{
+			continue;
+		}
+
+		const DepotString fileSpec = CreateFileSpec(modification->m_DepotFile, modification->m_Revision);
+		if (fileSpec.empty() == false)
+		{
+			symlinkModifications.push_back(modification);
+			symlinkFileSpecs.push_back(fileSpec);
+		}
+	}
+
+	const DepotStringArray targetPaths = GetSymlinkTargetPaths(depotClient, symlinkFileSpecs);
+	for (size_t symlinkIndex = 0; symlinkIndex < symlinkModifications.size(); ++symlinkIndex)
+	{
+		symlinkModifications[symlinkIndex]->m_SymlinkTarget = targetPaths[symlinkIndex];
+	}
 }
 
 DepotString
@@ -1559,7 +2788,10 @@ DepotOperations::LogWarningErrorSummary(
 		return e.m_Channel == LogChannel::Warning || e.m_Channel == LogChannel::Error;
 	};
 
-	if (Algo::Any(memoryLog.GetElements(), std::not_fn(inSummary)))
+	// The summary is only useful when the log also has elements which are not warnings or errors
+	const size_t summaryCount = memoryLog.GetChannelCount(LogChannel::Warning) + memoryLog.GetChannelCount(LogChannel::Error);
+	const size_t totalCount = Algo::Sum<size_t>(Array<LogChannel::Enum>{ LogChannel::Verbose, LogChannel::Debug, LogChannel::Info, LogChannel::Warning, LogChannel::Error }, [&memoryLog](LogChannel::Enum channel) -> size_t { return memoryLog.GetChannelCount(channel); });
+	if (totalCount > summaryCount)
 	{
 		bool writeHeader = true;
 		for (const LogElement& element : memoryLog.GetElements())
@@ -1574,6 +2806,11 @@ DepotOperations::LogWarningErrorSummary(
 				depotClient->Log(element.m_Channel, StringInfo::ToAnsi(element.m_Text));
 			}
 		}
+
+		if (memoryLog.GetDroppedCount() > 0)
+		{
+			depotClient->Log(LogChannel::Warning, StringInfo::Format("... %I64u more warnings and errors not shown", uint64_t(memoryLog.GetDroppedCount())));
+		}
 	}
 }
 
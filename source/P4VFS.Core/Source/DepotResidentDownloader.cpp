@@ -0,0 +1,375 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotResidentDownloader.h"
+#include "FileOperations.h"
+#include "ThreadPool.h"
+#include "SettingManager.h"
+#include <queue>
+#include <tuple>
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+DepotResidentDownloader::DepotResidentDownloader(LogDevice* log, size_t maxConnections, int64_t batchBytes, size_t maxBatchFiles, const DownloadCommand& downloadCommand, const ConnectCommand& connectCommand) :
+	m_Log(log),
+	m_MaxConnections(std::max<size_t>(1, maxConnections)),
+	m_BatchBytes(std::max<int64_t>(1, batchBytes)),
+	m_MaxBatchFiles(std::max<size_t>(1, maxBatchFiles)),
+	m_DownloadCommand(new DownloadCommand(downloadCommand)),
+	m_ConnectCommand(new ConnectCommand(connectCommand)),
+	m_DownloadedCallback(new DownloadedCallback),
+	m_UserContext(nullptr),
+	m_CancelationEvent(NULL),
+	m_DispatchThread(NULL),
+	m_Pending(new Batch),
+	m_PendingBytes(0),
+	m_Batches(new BatchListType),
+	m_BatchSemaphore(CreateSemaphore(NULL, 0, LONG_MAX, NULL)),
+	m_CompletedEvent(CreateEvent(NULL, TRUE, FALSE, NULL)),
+	m_BatchCount(0),
+	m_FileCount(0),
+	m_ByteCount(0),
+	m_ErrorCount(0),
+	m_ConnectionCount(0),
+	m_DownloadTime(0)
+{
+}
+
+DepotResidentDownloader::~DepotResidentDownloader()
+{
+	if (m_DispatchThread != NULL)
+	{
+		SetEvent(m_CompletedEvent.Handle());
+		WaitForSingleObject(m_DispatchThread, INFINITE);
+		SafeCloseHandle(m_DispatchThread);
+	}
+
+	SafeDeletePointer(m_Batches);
+	SafeDeletePointer(m_Pending);
+	SafeDeletePointer(m_DownloadedCallback);
+	SafeDeletePointer(m_ConnectCommand);
+	SafeDeletePointer(m_DownloadCommand);
+}
+
+void DepotResidentDownloader::SetDownloadedCallback(const DownloadedCallback& downloadedCallback)
+{
+	*m_DownloadedCallback = downloadedCallback;
+}
+
+bool DepotResidentDownloader::Start(HANDLE cancelationEvent, const FileCore::UserContext* userContext)
+{
+	if (m_DispatchThread == NULL)
+	{
+		m_CancelationEvent = cancelationEvent;
+		m_UserContext = userContext;
+		m_DispatchThread = CreateThread(NULL, 0, &DispatchThreadEntry, this, 0, NULL);
+	}
+	return m_DispatchThread != NULL;
+}
+
+void DepotResidentDownloader::Add(const DepotSyncActionInfo& modification)
+{
+	const int64_t fileBytes = GetModificationBytes(modification);
+	Batch batch;
+	{
+		AutoCriticalSection lock(m_PendingLock);
+		if (fileBytes >= m_BatchBytes)
+		{
+			// A large file is not held back by, and does not hold back, the smaller files of the pending batch
+			batch.push_back(modification);
+		}
+		else
+		{
+			m_Pending->push_back(modification);
+			m_PendingBytes += fileBytes;
+			if (m_PendingBytes >= m_BatchBytes || m_Pending->size() >= m_MaxBatchFiles)
+			{
+				batch.swap(*m_Pending);
+				m_PendingBytes = 0;
+			}
+		}
+	}
+
+	if (batch.size())
+	{
+		PushBatch(batch);
+	}
+}
+
+void DepotResidentDownloader::Complete(DepotClient& depotClient)
+{
+	Batch pending;
+	{
+		AutoCriticalSection lock(m_PendingLock);
+		pending.swap(*m_Pending);
+		m_PendingBytes = 0;
+	}
+
+	// The remaining files are divided between the connections rather than downloaded as a single partial batch
+	if (pending.size())
+	{
+		const size_t batchCount = std::max((pending.size() + m_MaxBatchFiles - 1) / m_MaxBatchFiles, std::min(m_MaxConnections, pending.size()));
+		for (Batch& batch : PartitionBatches(pending, batchCount))
+		{
+			PushBatch(batch);
+		}
+	}
+
+	SetEvent(m_CompletedEvent.Handle());
+	if (m_DispatchThread != NULL)
+	{
+		WaitForSingleObject(m_DispatchThread, INFINITE);
+		SafeCloseHandle(m_DispatchThread);
+	}
+
+	Batch batch;
+	while (PopBatch(batch, false))
+	{
+		if (m_CancelationEvent != NULL && WaitForSingleObject(m_CancelationEvent, 0) == WAIT_OBJECT_0)
+		{
+			break;
+		}
+		ExecuteBatch(depotClient, batch);
+	}
+}
+
+DWORD DepotResidentDownloader::DispatchThreadEntry(void* data)
+{
+	reinterpret_cast<DepotResidentDownloader*>(data)->DispatchBatches();
+	return 0;
+}
+
+void DepotResidentDownloader::DispatchBatches()
+{
+	// Each worker makes its connection when it takes its first batch, so a small number of batches only uses a few connections
+	auto downloadBatches = [this](size_t workerIndex) -> void
+	{
+		DepotClient depotClient;
+		Batch batch;
+		while (PopBatch(batch, true))
+		{
+			if (depotClient.get() == nullptr)
+			{
+				depotClient = (*m_ConnectCommand)();
+				if (depotClient.get() == nullptr)
+				{
+					LogDevice::WriteLine(m_Log, LogChannel::Error, "DepotClient failed to connect");
+					PushBatch(batch);
+					break;
+				}
+				m_ConnectionCount++;
+			}
+			ExecuteBatch(depotClient, batch);
+			batch.clear();
+		}
+	};
+
+	Array<size_t> workers(m_MaxConnections);
+	for (size_t workerIndex = 0; workerIndex < workers.size(); ++workerIndex)
+	{
+		workers[workerIndex] = workerIndex;
+	}
+
+	if (m_UserContext != nullptr)
+	{
+		ThreadPool::ForEach::ExecuteImpersonated(workers.size(), workers.data(), workers.size(), m_CancelationEvent, m_UserContext, downloadBatches);
+	}
+	else
+	{
+		ThreadPool::ForEach::Execute(workers.size(), workers.data(), workers.size(), m_CancelationEvent, downloadBatches);
+	}
+}
+
+void DepotResidentDownloader::PushBatch(Batch& batch)
+{
+	{
+		AutoCriticalSection lock(m_BatchesLock);
+		m_Batches->emplace_back();
+		m_Batches->back().swap(batch);
+	}
+	ReleaseSemaphore(m_BatchSemaphore.Handle(), 1, NULL);
+}
+
+bool DepotResidentDownloader::PopBatch(Batch& batch, bool wait)
+{
+	if (wait)
+	{
+		// Pending batches are preferred over the completed event so that all batches are downloaded after Complete
+		HANDLE handles[3] = { m_CancelationEvent, m_BatchSemaphore.Handle(), m_CompletedEvent.Handle() };
+		const DWORD handleOffset = m_CancelationEvent != NULL ? 0 : 1;
+		if (WaitForMultipleObjects(3-handleOffset, handles+handleOffset, FALSE, INFINITE) != WAIT_OBJECT_0+1-handleOffset)
+		{
+			return false;
+		}
+	}
+	else if (WaitForSingleObject(m_BatchSemaphore.Handle(), 0) != WAIT_OBJECT_0)
+	{
+		return false;
+	}
+
+	AutoCriticalSection lock(m_BatchesLock);
+	batch.swap(m_Batches->front());
+	m_Batches->pop_front();
+	return true;
+}
+
+void DepotResidentDownloader::ExecuteBatch(DepotClient& depotClient, Batch& batch)
+{
+	DepotStringArray fileSpecs;
+	fileSpecs.reserve(batch.size());
+	int64_t batchBytes = 0;
+	for (const DepotSyncActionInfo& modification : batch)
+	{
+		fileSpecs.push_back(modification->ToFileSpecString());
+		batchBytes += GetModificationBytes(modification);
+	}
+
+	DepotStopwatch timer(DepotStopwatch::Init::Start);
+	const bool downloaded = (*m_DownloadCommand)(depotClient, fileSpecs);
+	const int64_t batchTime = timer.TotalMilliseconds();
+
+	m_BatchCount++;
+	m_FileCount += batch.size();
+	m_ByteCount += batchBytes;
+	m_DownloadTime += batchTime;
+
+	// Divide the round trip time between the files of the batch, so that the sum of all m_SyncTime
+	// remains the total time spent downloading
+	const int64_t batchSize = int64_t(batch.size());
+	for (int64_t entryIndex = 0; entryIndex < batchSize; ++entryIndex)
+	{
+		batch[entryIndex]->m_SyncTime = batchTime/batchSize + (entryIndex < batchTime%batchSize ? 1 : 0);
+	}
+
+	if (downloaded == false)
+	{
+		for (const DepotString& fileSpec : fileSpecs)
+		{
+			LogDevice::WriteLine(m_Log, LogChannel::Error, StringInfo::Format("Failed to download %s", fileSpec.c_str()));
+		}
+		m_ErrorCount += batch.size();
+		return;
+	}
+
+	if (*m_DownloadedCallback)
+	{
+		for (const DepotSyncActionInfo& modification : batch)
+		{
+			(*m_DownloadedCallback)(modification);
+		}
+	}
+}
+
+size_t DepotResidentDownloader::GetBatchCount() const
+{
+	return m_BatchCount;
+}
+
+size_t DepotResidentDownloader::GetFileCount() const
+{
+	return m_FileCount;
+}
+
+int64_t DepotResidentDownloader::GetByteCount() const
+{
+	return m_ByteCount;
+}
+
+size_t DepotResidentDownloader::GetErrorCount() const
+{
+	return m_ErrorCount;
+}
+
+size_t DepotResidentDownloader::GetConnectionCount() const
+{
+	return m_ConnectionCount;
+}
+
+int64_t DepotResidentDownloader::GetDownloadTime() const
+{
+	return m_DownloadTime;
+}
+
+int64_t DepotResidentDownloader::GetModificationBytes(const DepotSyncActionInfo& modification)
+{
+	return modification.get() != nullptr ? std::max<int64_t>(0, modification->m_FileSize) : 0;
+}
+
+Array<DepotResidentDownloader::Batch> DepotResidentDownloader::PartitionBatches(const Batch& modifications, size_t batchCount)
+{
+	batchCount = std::min(std::max<size_t>(1, batchCount), modifications.size());
+	if (batchCount == 0)
+	{
+		return Array<Batch>();
+	}
+
+	// Largest first, each file is given to the batch with the fewest bytes so far, then the fewest files
+	Array<size_t> order(modifications.size());
+	for (size_t index = 0; index < order.size(); ++index)
+	{
+		order[index] = index;
+	}
+	std::stable_sort(order.begin(), order.end(), [&modifications](size_t a, size_t b) -> bool
+	{
+		return GetModificationBytes(modifications[a]) > GetModificationBytes(modifications[b]);
+	});
+
+	typedef std::tuple<int64_t, size_t, size_t> BatchLoad;
+	std::priority_queue<BatchLoad, Array<BatchLoad>, std::greater<BatchLoad>> loads;
+	for (size_t batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+	{
+		loads.push(BatchLoad(0, 0, batchIndex));
+	}
+
+	Array<Array<size_t>> batchIndices(batchCount);
+	for (size_t index : order)
+	{
+		BatchLoad load = loads.top();
+		loads.pop();
+		batchIndices[std::get<2>(load)].push_back(index);
+		loads.push(BatchLoad(std::get<0>(load) + GetModificationBytes(modifications[index]), std::get<1>(load) + 1, std::get<2>(load)));
+	}
+
+	// Each batch keeps the files in the order they were added
+	Array<Batch> batches(batchCount);
+	for (size_t batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+	{
+		Array<size_t>& indices = batchIndices[batchIndex];
+		std::sort(indices.begin(), indices.end());
+		batches[batchIndex].reserve(indices.size());
+		for (size_t index : indices)
+		{
+			batches[batchIndex].push_back(modifications[index]);
+		}
+	}
+	return batches;
+}
+
+DepotResidentDownloader::ConnectCommand DepotResidentDownloader::ConnectCommandPooled(const DepotClient& depotClient)
+{
+	FileContext* context = depotClient->GetContext();
+	const DepotConfig config = depotClient->Config();
+	return [context, config]() -> DepotClient
+	{
+		DepotClient pooledClient = FDepotClient::New(context);
+		if (pooledClient->Connect(config) == false)
+		{
+			return nullptr;
+		}
+		return pooledClient;
+	};
+}
+
+int64_t DepotResidentDownloader::GetDefaultBatchBytes()
+{
+	return int64_t(std::max(0, FileCore::SettingManager::StaticInstance().SyncResidentBatchSizeMB.GetValue())) * 1024 * 1024;
+}
+
+size_t DepotResidentDownloader::GetDefaultMaxBatchFiles()
+{
+	return size_t(std::max(1, FileCore::SettingManager::StaticInstance().SyncResidentBatchMaxFiles.GetValue()));
+}
+
+}}}
@@ -0,0 +1,388 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotResidentMatcher.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+namespace DepotResidentMatcherInternal
+{
+	// The form generated by the console for an inverted SyncResident pattern
+	static const char* NegatedPatternPrefix = "^(?!.*(";
+	static const char* NegatedPatternSuffix = ")).*$";
+	static const char* MetaCharacters = ".^$|?*+()[]{}";
+	static const size_t MaxExpandedTermCount = 4096;
+	static const size_t MaxCachedMatcherCount = 32;
+}
+
+FDepotResidentMatcher::FDepotResidentMatcher(const DepotString& pattern) :
+	m_Pattern(pattern),
+	m_IsNegated(false)
+{
+	if (m_Pattern.empty() == false && Compile(m_Pattern) == false)
+	{
+		m_IsNegated = false;
+		m_Suffixes.clear();
+		m_SuffixLengths.clear();
+		m_PrefixNodes.clear();
+		m_Regex = std::make_shared<std::regex>(m_Pattern, std::regex_constants::ECMAScript|std::regex_constants::icase);
+	}
+}
+
+FDepotResidentMatcher::~FDepotResidentMatcher()
+{
+}
+
+bool FDepotResidentMatcher::IsMatch(const DepotString& depotFile) const
+{
+	if (depotFile.empty() || m_Pattern.empty())
+	{
+		return false;
+	}
+
+	if (m_Regex.get() != nullptr)
+	{
+		std::match_results<const char*> match;
+		return std::regex_search(depotFile.c_str(), match, *m_Regex);
+	}
+
+	const bool isMatch = IsSuffixMatch(depotFile) || IsPrefixMatch(depotFile);
+	return isMatch != m_IsNegated;
+}
+
+bool FDepotResidentMatcher::IsRegex() const
+{
+	return m_Regex.get() != nullptr;
+}
+
+const DepotString& FDepotResidentMatcher::Pattern() const
+{
+	return m_Pattern;
+}
+
+DepotResidentMatcher FDepotResidentMatcher::FromPattern(const DepotString& pattern)
+{
+	static CriticalSection s_CacheLock;
+	static Map<DepotString, DepotResidentMatcher> s_Cache;
+	{
+		AutoCriticalSection lock(s_CacheLock);
+		if (const DepotResidentMatcher* matcher = Algo::Find(s_Cache, pattern))
+		{
+			return *matcher;
+		}
+	}
+
+	// Compile outside of the lock, since an invalid regex will throw
+	DepotResidentMatcher matcher = std::make_shared<FDepotResidentMatcher>(pattern);
+
+	AutoCriticalSection lock(s_CacheLock);
+	if (s_Cache.size() >= DepotResidentMatcherInternal::MaxCachedMatcherCount)
+	{
+		s_Cache.clear();
+	}
+	s_Cache[pattern] = matcher;
+	return matcher;
+}
+
+bool FDepotResidentMatcher::Compile(const DepotString& pattern)
+{
+	using namespace DepotResidentMatcherInternal;
+	const char* begin = pattern.c_str();
+	const char* end = begin + pattern.size();
+
+	const size_t negatedPrefixLength = strlen(NegatedPatternPrefix);
+	const size_t negatedSuffixLength = strlen(NegatedPatternSuffix);
+	if (pattern.size() > negatedPrefixLength + negatedSuffixLength &&
+		StringInfo::StartsWith(begin, NegatedPatternPrefix) &&
+		StringInfo::EndsWith(begin, NegatedPatternSuffix))
+	{
+		m_IsNegated = true;
+		begin += negatedPrefixLength;
+		end -= negatedSuffixLength;
+	}
+
+	Array<std::pair<const char*, const char*>> alternatives;
+	if (SplitAlternatives(begin, end, alternatives) == false)
+	{
+		return false;
+	}
+
+	for (const std::pair<const char*, const char*>& alternative : alternatives)
+	{
+		const char* termBegin = alternative.first;
+		const char* termEnd = alternative.second;
+
+		const bool isStartAnchor = termBegin < termEnd && *termBegin == '^';
+		if (isStartAnchor)
+		{
+			++termBegin;
+		}
+
+		bool isEndAnchor = false;
+		if (termBegin < termEnd && termEnd[-1] == '$')
+		{
+			size_t escapeCount = 0;
+			for (const char* c = termEnd-1; c > termBegin && c[-1] == '\\'; --c)
+			{
+				++escapeCount;
+			}
+			isEndAnchor = (escapeCount % 2) == 0;
+		}
+		if (isEndAnchor)
+		{
+			--termEnd;
+		}
+
+		// Exact and unanchored terms are left to the regex
+		if (isStartAnchor == isEndAnchor)
+		{
+			return false;
+		}
+
+		TermArray terms;
+		if (ExpandLiterals(termBegin, termEnd, terms) == false)
+		{
+			return false;
+		}
+
+		for (const DepotString& term : terms)
+		{
+			if (isEndAnchor)
+			{
+				if (m_Suffixes.insert(term).second && std::find(m_SuffixLengths.begin(), m_SuffixLengths.end(), term.size()) == m_SuffixLengths.end())
+				{
+					m_SuffixLengths.push_back(term.size());
+				}
+			}
+			else
+			{
+				if (m_PrefixNodes.empty())
+				{
+					m_PrefixNodes.push_back(FPrefixNode{ Map<char, size_t>(), false });
+				}
+
+				size_t nodeIndex = 0;
+				for (char c : term)
+				{
+					const size_t* childIndex = Algo::Find(m_PrefixNodes[nodeIndex].m_Children, c);
+					if (childIndex == nullptr)
+					{
+						m_PrefixNodes[nodeIndex].m_Children[c] = m_PrefixNodes.size();
+						nodeIndex = m_PrefixNodes.size();
+						m_PrefixNodes.push_back(FPrefixNode{ Map<char, size_t>(), false });
+					}
+					else
+					{
+						nodeIndex = *childIndex;
+					}
+				}
+				m_PrefixNodes[nodeIndex].m_IsTerminal = true;
+			}
+		}
+	}
+
+	std::sort(m_SuffixLengths.begin(), m_SuffixLengths.end());
+	return true;
+}
+
+bool FDepotResidentMatcher::IsSuffixMatch(const DepotString& depotFile) const
+{
+	const size_t depotFileLength = depotFile.size();
+	DepotString suffix;
+	for (size_t suffixLength : m_SuffixLengths)
+	{
+		if (suffixLength > depotFileLength)
+		{
+			break;
+		}
+
+		suffix.assign(depotFile, depotFileLength - suffixLength, suffixLength);
+		for (char& c : suffix)
+		{
+			c = StringInfo::ToLower(c);
+		}
+		if (m_Suffixes.find(suffix) != m_Suffixes.end())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FDepotResidentMatcher::IsPrefixMatch(const DepotString& depotFile) const
+{
+	if (m_PrefixNodes.empty())
+	{
+		return false;
+	}
+
+	size_t nodeIndex = 0;
+	for (size_t charIndex = 0; m_PrefixNodes[nodeIndex].m_IsTerminal == false; ++charIndex)
+	{
+		if (charIndex >= depotFile.size())
+		{
+			return false;
+		}
+
+		const size_t* childIndex = Algo::Find(m_PrefixNodes[nodeIndex].m_Children, StringInfo::ToLower(depotFile[charIndex]));
+		if (childIndex == nullptr)
+		{
+			return false;
+		}
+		nodeIndex = *childIndex;
+	}
+	return true;
+}
+
+bool FDepotResidentMatcher::SplitAlternatives(const char* begin, const char* end, Array<std::pair<const char*, const char*>>& alternatives)
+{
+	int32_t depth = 0;
+	const char* alternativeBegin = begin;
+	for (const char* c = begin; c < end; ++c)
+	{
+		if (*c == '\\')
+		{
+			if (++c >= end)
+			{
+				return false;
+			}
+		}
+		else if (*c == '[')
+		{
+			return false;
+		}
+		else if (*c == '(')
+		{
+			++depth;
+		}
+		else if (*c == ')')
+		{
+			if (--depth < 0)
+			{
+				return false;
+			}
+		}
+		else if (*c == '|' && depth == 0)
+		{
+			alternatives.push_back(std::make_pair(alternativeBegin, c));
+			alternativeBegin = c+1;
+		}
+	}
+
+	if (depth != 0)
+	{
+		return false;
+	}
+	alternatives.push_back(std::make_pair(alternativeBegin, end));
+	return true;
+}
+
+bool FDepotResidentMatcher::ExpandLiterals(const char* begin, const char* end, TermArray& terms)
+{
+	terms = TermArray{ DepotString() };
+	for (const char* pos = begin; pos < end;)
+	{
+		if (*pos == '(')
+		{
+			// A group of literal alternatives, such as an extension list, expands into one term per alternative
+			if (++pos+1 < end && pos[0] == '?' && pos[1] == ':')
+			{
+				pos += 2;
+			}
+
+			TermArray groupLiterals;
+			for (bool isGroupClosed = false; isGroupClosed == false;)
+			{
+				DepotString literal;
+				if (ParseLiteral(pos, end, literal) == false || pos >= end)
+				{
+					return false;
+				}
+
+				groupLiterals.push_back(literal);
+				if (*pos == ')')
+				{
+					isGroupClosed = true;
+				}
+				else if (*pos != '|')
+				{
+					return false;
+				}
+				++pos;
+			}
+
+			if (terms.size() * groupLiterals.size() > DepotResidentMatcherInternal::MaxExpandedTermCount)
+			{
+				return false;
+			}
+
+			TermArray expandedTerms;
+			expandedTerms.reserve(terms.size() * groupLiterals.size());
+			for (const DepotString& term : terms)
+			{
+				for (const DepotString& literal : groupLiterals)
+				{
+					expandedTerms.push_back(term + literal);
+				}
+			}
+			terms.swap(expandedTerms);
+		}
+		else
+		{
+			DepotString literal;
+			const char* literalBegin = pos;
+			if (ParseLiteral(pos, end, literal) == false || pos == literalBegin)
+			{
+				return false;
+			}
+
+			// A literal followed by a quantifier is not a literal
+			if (pos < end && strchr("?*+{", *pos) != nullptr)
+			{
+				return false;
+			}
+
+			for (DepotString& term : terms)
+			{
+				term += literal;
+			}
+		}
+	}
+	return true;
+}
+
+bool FDepotResidentMatcher::ParseLiteral(const char*& pos, const char* end, DepotString& literal)
+{
+	while (pos < end)
+	{
+		const char c = *pos;
+		if (c == '\\')
+		{
+			// Only escaped punctuation is literal. Character classes and assertions such as \d or \b are not.
+			if (pos+1 >= end || (pos[1] & 0x80) != 0 || ispunct(pos[1]) == 0)
+			{
+				return false;
+			}
+			literal += pos[1];
+			pos += 2;
+		}
+		else if (strchr(DepotResidentMatcherInternal::MetaCharacters, c) != nullptr)
+		{
+			break;
+		}
+		else if ((c & 0x80) != 0)
+		{
+			return false;
+		}
+		else
+		{
+			literal += StringInfo::ToLower(c);
+			++pos;
+		}
+	}
+	return true;
+}
+
+}}}
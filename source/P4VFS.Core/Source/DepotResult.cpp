@@ -2,11 +2,171 @@
 // Licensed under the MIT license.
 #include "Pch.h"
 #include "DepotResult.h"
+#include "SettingManager.h"
 
 namespace Microsoft {
 namespace P4VFS {
 namespace P4 {
 
+// The process wide table of tagged field names. Names are never removed, so an interned name can be read without a lock.
+struct FDepotResultFieldKeyTable
+{
+	const char* Intern(const char* tagKey)
+	{
+		AutoCriticalSection lock(m_Lock);
+		Set<DepotString, DepotStringLess>::const_iterator key = m_Keys.find(tagKey);
+		if (key == m_Keys.end())
+			key = m_Keys.insert(DepotString(tagKey)).first;
+		return key->c_str();
+	}
+
+	static FDepotResultFieldKeyTable& StaticInstance()
+	{
+		static FDepotResultFieldKeyTable table;
+		return table;
+	}
+
+	CriticalSection m_Lock;
+	Set<DepotString, DepotStringLess> m_Keys;
+};
+
+// The process wide table of error patterns, each compiled once on first use
+struct FDepotResultRegexTable
+{
+	std::shared_ptr<const std::regex> Find(const char* pattern)
+	{
+		AutoCriticalSection lock(m_Lock);
+		std::shared_ptr<const std::regex>& regex = m_Patterns[pattern];
+		if (regex.get() == nullptr)
+			regex = std::make_shared<const std::regex>(pattern, std::regex_constants::ECMAScript|std::regex_constants::icase);
+		return regex;
+	}
+
+	static FDepotResultRegexTable& StaticInstance()
+	{
+		static FDepotResultRegexTable table;
+		return table;
+	}
+
+	CriticalSection m_Lock;
+	Map<DepotString, std::shared_ptr<const std::regex>, DepotStringLess> m_Patterns;
+};
+
+struct FDepotResultArenaBlock
+{
+	FDepotResultArenaBlock(size_t capacity) :
+		m_Data(new char[capacity]),
+		m_Size(0),
+		m_Capacity(capacity)
+	{}
+
+	~FDepotResultArenaBlock()
+	{
+		delete[] m_Data;
+	}
+
+	char* m_Data;
+	size_t m_Size;
+	size_t m_Capacity;
+};
+
+// Writes the records of a result into a chain of blocks. Each record is written into a single block as its array of 
+// fields, followed by the value slots and the null terminated values. A block is released once the last tag which 
+// refers to it is released, so a streamed result which drops its tags does not grow.
+struct FDepotResultArena
+{
+	static constexpr size_t BlockSize = 256*1024;
+
+	FDepotResultArena() :
+		m_RecordFieldIndex(0),
+		m_BlockCount(0)
+	{}
+
+	void AddField(const char* tagKey, const char* tagValue)
+	{
+		if (StringInfo::IsNullOrEmpty(tagKey))
+			return;
+
+		// The fields of tagged output are almost always in the same order for every record, so the key at the same 
+		// position of the previous record is checked before the shared table.
+		const size_t fieldIndex = m_RecordFieldIndex++;
+		const char* key = nullptr;
+		if (fieldIndex < m_KeyCache.size() && strcmp(m_KeyCache[fieldIndex], tagKey) == 0)
+		{
+			key = m_KeyCache[fieldIndex];
+		}
+		else
+		{
+			key = FDepotResultFieldKeyTable::StaticInstance().Intern(tagKey);
+			if (fieldIndex < m_KeyCache.size())
+				m_KeyCache[fieldIndex] = key;
+			else
+				m_KeyCache.push_back(key);
+		}
+
+		for (const FDepotResultArenaField& field : m_Fields)
+		{
+			if (field.m_Key == key)
+				return;
+		}
+
+		const size_t length = tagValue ? strlen(tagValue) : 0;
+		FDepotResultArenaField field;
+		field.m_Key = key;
+		field.m_Offset = uint32_t(m_Values.size());
+		field.m_Length = uint32_t(length);
+		m_Fields.push_back(field);
+		m_Values.insert(m_Values.end(), tagValue, tagValue+length);
+		m_Values.push_back('\0');
+	}
+
+	DepotResultTag EndRecord()
+	{
+		const size_t fieldCount = m_Fields.size();
+		const size_t valuesOffset = fieldCount * (sizeof(FDepotResultArenaField) + sizeof(DepotString*));
+		const size_t recordSize = valuesOffset + m_Values.size();
+
+		size_t recordOffset = m_Block.get() ? (m_Block->m_Size + alignof(FDepotResultArenaField)-1) & ~(alignof(FDepotResultArenaField)-1) : 0;
+		if (m_Block.get() == nullptr || recordOffset + recordSize > m_Block->m_Capacity)
+		{
+			m_Block = std::make_shared<FDepotResultArenaBlock>(std::max(BlockSize, recordSize));
+			m_BlockCount++;
+			recordOffset = 0;
+		}
+
+		char* record = m_Block->m_Data + recordOffset;
+		FDepotResultArenaField* fields = reinterpret_cast<FDepotResultArenaField*>(record);
+		DepotString** values = reinterpret_cast<DepotString**>(record + fieldCount*sizeof(FDepotResultArenaField));
+		for (size_t fieldIndex = 0; fieldIndex < fieldCount; ++fieldIndex)
+		{
+			fields[fieldIndex] = m_Fields[fieldIndex];
+			fields[fieldIndex].m_Offset += uint32_t(valuesOffset);
+			values[fieldIndex] = nullptr;
+		}
+		if (m_Values.size())
+			memcpy(record + valuesOffset, m_Values.data(), m_Values.size());
+		m_Block->m_Size = recordOffset + recordSize;
+
+		DepotResultTag tag = std::make_shared<FDepotResultTag>();
+		tag->m_ArenaBlock = m_Block;
+		tag->m_ArenaFields = fields;
+		tag->m_ArenaValues = values;
+		tag->m_ArenaFieldCount = fieldCount;
+
+		m_Fields.clear();
+		m_Values.clear();
+		m_RecordFieldIndex = 0;
+		return tag;
+	}
+
+	DepotResultArenaBlock m_Block;
+	Array<FDepotResultArenaField> m_Fields;
+	Array<char> m_Values;
+	Array<const char*> m_KeyCache;
+	size_t m_RecordFieldIndex;
+	size_t m_BlockCount;
+};
+
 FDepotResultText::FDepotResultText(DepotResultChannel channel, const DepotString& value, int32_t level) :
 	m_Channel(channel),
 	m_Value(value),
@@ -14,13 +174,47 @@ FDepotResultText::FDepotResultText(DepotResultChannel channel, const DepotString
 {
 }
 
+FDepotResultTag::FDepotResultTag() :
+	m_ArenaFields(nullptr),
+	m_ArenaValues(nullptr),
+	m_ArenaFieldCount(0)
+{
+}
+
+FDepotResultTag::FDepotResultTag(const FDepotResultTag& src) :
+	m_Fields(src.GetFields()),
+	m_ArenaFields(nullptr),
+	m_ArenaValues(nullptr),
+	m_ArenaFieldCount(0)
+{
+}
+
+FDepotResultTag::~FDepotResultTag()
+{
+	ReleaseArena();
+}
+
+FDepotResultTag& FDepotResultTag::operator=(const FDepotResultTag& src)
+{
+	if (this != &src)
+	{
+		FieldsType fields = src.GetFields();
+		ReleaseArena();
+		m_Fields.swap(fields);
+	}
+	return *this;
+}
+
 bool FDepotResultTag::ContainsKey(const char* tagKey) const
 {
+	if (IsArena())
+		return StringInfo::IsNullOrEmpty(tagKey) == false && FindArenaField(tagKey) != nullptr;
 	return GetValuePtr(tagKey) != nullptr;
 }
 
 void FDepotResultTag::RemoveKey(const char* tagKey)
 {
+	DetachArena();
 	m_Fields.erase(tagKey);
 }
 
@@ -28,6 +222,7 @@ void FDepotResultTag::SetValue(const char* tagKey, const DepotString& tagValue)
 {
 	if (StringInfo::IsNullOrEmpty(tagKey) == false)
 	{
+		DetachArena();
 		m_Fields[tagKey] = tagValue;
 	}
 }
@@ -52,6 +247,27 @@ const DepotString* FDepotResultTag::GetValuePtr(const char* tagKey) const
 {
 	if (StringInfo::IsNullOrEmpty(tagKey) == false)
 	{
+		if (IsArena())
+		{
+			const FDepotResultArenaField* field = FindArenaField(tagKey);
+			if (field == nullptr)
+				return nullptr;
+
+			// Concurrent readers of the same field race to create the value, and all but the first discard theirs
+			PVOID volatile* slot = reinterpret_cast<PVOID volatile*>(&m_ArenaValues[field - m_ArenaFields]);
+			DepotString* value = static_cast<DepotString*>(InterlockedCompareExchangePointer(slot, nullptr, nullptr));
+			if (value == nullptr)
+			{
+				DepotString* newValue = new DepotString(GetArenaFieldData(field), field->m_Length);
+				value = static_cast<DepotString*>(InterlockedCompareExchangePointer(slot, newValue, nullptr));
+				if (value == nullptr)
+					value = newValue;
+				else
+					delete newValue;
+			}
+			return value;
+		}
+
 		DepotResultFields::const_iterator v = m_Fields.find(tagKey);
 		if (v != m_Fields.end())
 			return &v->second;
@@ -61,17 +277,94 @@ const DepotString* FDepotResultTag::GetValuePtr(const char* tagKey) const
 
 int32_t FDepotResultTag::GetValueInt32(const char* tagKey, int32_t defaultValue) const
 {
-	const DepotString* valuePtr = GetValuePtr(tagKey);
-	return valuePtr && valuePtr->empty() == false ? atoi(valuePtr->c_str()) : defaultValue;
+	const char* value = GetValueCStr(tagKey);
+	return value && value[0] ? atoi(value) : defaultValue;
 }
 
 int64_t FDepotResultTag::GetValueInt64(const char* tagKey, int64_t defaultValue) const
 {
+	const char* value = GetValueCStr(tagKey);
+	return value && value[0] ? _atoi64(value) : defaultValue;
+}
+
+size_t FDepotResultTag::GetFieldCount() const
+{
+	return IsArena() ? m_ArenaFieldCount : m_Fields.size();
+}
+
+FDepotResultTag::FieldsType FDepotResultTag::GetFields() const
+{
+	if (IsArena() == false)
+		return m_Fields;
+
+	FieldsType fields;
+	for (size_t fieldIndex = 0; fieldIndex < m_ArenaFieldCount; ++fieldIndex)
+	{
+		const FDepotResultArenaField* field = &m_ArenaFields[fieldIndex];
+		fields.insert(FieldsType::value_type(field->m_Key, DepotString(GetArenaFieldData(field), field->m_Length)));
+	}
+	return fields;
+}
+
+bool FDepotResultTag::IsArena() const
+{
+	return m_ArenaBlock.get() != nullptr;
+}
+
+const FDepotResultArenaField* FDepotResultTag::FindArenaField(const char* tagKey) const
+{
+	for (size_t fieldIndex = 0; fieldIndex < m_ArenaFieldCount; ++fieldIndex)
+	{
+		if (StringInfo::Stricmp(m_ArenaFields[fieldIndex].m_Key, tagKey) == 0)
+			return &m_ArenaFields[fieldIndex];
+	}
+	return nullptr;
+}
+
+const char* FDepotResultTag::GetArenaFieldData(const FDepotResultArenaField* field) const
+{
+	return reinterpret_cast<const char*>(m_ArenaFields) + field->m_Offset;
+}
+
+const char* FDepotResultTag::GetValueCStr(const char* tagKey) const
+{
+	if (IsArena())
+	{
+		const FDepotResultArenaField* field = StringInfo::IsNullOrEmpty(tagKey) ? nullptr : FindArenaField(tagKey);
+		return field ? GetArenaFieldData(field) : nullptr;
+	}
 	const DepotString* valuePtr = GetValuePtr(tagKey);
-	return valuePtr && valuePtr->empty() == false ? _atoi64(valuePtr->c_str()) : defaultValue;
+	return valuePtr ? valuePtr->c_str() : nullptr;
 }
 
-FDepotResult::FDepotResult()
+void FDepotResultTag::DetachArena()
+{
+	// A modified tag keeps its fields in the map, which invalidates any value previously returned by reference
+	if (IsArena())
+	{
+		FieldsType fields = GetFields();
+		ReleaseArena();
+		m_Fields.swap(fields);
+	}
+}
+
+void FDepotResultTag::ReleaseArena()
+{
+	if (IsArena())
+	{
+		for (size_t fieldIndex = 0; fieldIndex < m_ArenaFieldCount; ++fieldIndex)
+		{
+			SafeDeletePointer(m_ArenaValues[fieldIndex]);
+		}
+		m_ArenaBlock.reset();
+		m_ArenaFields = nullptr;
+		m_ArenaValues = nullptr;
+		m_ArenaFieldCount = 0;
+	}
+}
+
+FDepotResult::FDepotResult() :
+	m_ArenaTags(FileCore::SettingManager::StaticInstance().DepotResultArenaTags.GetValue())
 {
 }
 
@@ -111,14 +404,15 @@ bool FDepotResult::HasError() const
 
 bool FDepotResult::HasErrorRegex(const char* pattern) const
 {
-	if (StringInfo::IsNullOrEmpty(pattern) == false)
+	if (StringInfo::IsNullOrEmpty(pattern) == false && HasError())
 	{
+		std::shared_ptr<const std::regex> regex = FDepotResultRegexTable::StaticInstance().Find(pattern);
 		for (const DepotResultText& text : m_TextList)
 		{
 			if (int(text->m_Channel) & int(DepotResultChannel::StdErr))
 			{
 				std::match_results<const char*> match;
-				if (std::regex_search(text->m_Value.c_str(), match, std::regex(pattern, std::regex_constants::ECMAScript|std::regex_constants::icase)))
+				if (std::regex_search(text->m_Value.c_str(), match, *regex))
 					return true;
 			}
 		}
@@ -126,6 +420,19 @@ bool FDepotResult::HasErrorRegex(const char* pattern) const
 	return false;
 }
 
+bool FDepotResult::HasErrorText(const char* searchFor) const
+{
+	if (StringInfo::IsNullOrEmpty(searchFor) == false)
+	{
+		for (const DepotResultText& text : m_TextList)
+		{
+			if ((int(text->m_Channel) & int(DepotResultChannel::StdErr)) && StringInfo::Contains(text->m_Value.c_str(), searchFor, StringInfo::SearchCase::Insensitive))
+				return true;
+		}
+	}
+	return false;
+}
+
 void FDepotResult::SetError(const char* errorText)
 {
 	m_TextList.clear();
@@ -206,4 +513,68 @@ void FDepotResult::Append(const DepotResultTag& srcTag)
 	m_TagList.push_back(srcTag);
 }
 
+void FDepotResult::BeginTag()
+{
+	if (m_ArenaTags == false)
+	{
+		m_TagList.push_back(std::make_shared<FDepotResultTag>());
+	}
+	else if (m_Arena.get() == nullptr)
+	{
+		m_Arena = std::make_shared<FDepotResultArena>();
+	}
+}
+
+void FDepotResult::AddTagField(const char* tagKey, const char* tagValue)
+{
+	if (m_ArenaTags)
+		m_Arena->AddField(tagKey, tagValue);
+	else if (StringInfo::IsNullOrEmpty(tagKey) == false)
+		m_TagList.back()->m_Fields.insert(DepotResultFields::value_type(tagKey, tagValue ? tagValue : ""));
+}
+
+const DepotResultTag& FDepotResult::EndTag()
+{
+	if (m_ArenaTags)
+		m_TagList.push_back(m_Arena->EndRecord());
+	return m_TagList.back();
+}
+
+bool FDepotResult::IsArenaTags() const
+{
+	return m_ArenaTags;
+}
+
+size_t FDepotResult::GetArenaBlockCount() const
+{
+	return m_Arena.get() ? m_Arena->m_BlockCount : 0;
+}
+
+FDepotResultStream::FDepotResultStream(const TagVisitor& visitor) :
+	m_TagVisitor(visitor),
+	m_StreamCount(0)
+{
+}
+
+DepotResultReply FDepotResultStream::OnStreamStat(IDepotClientCommand* cmd, const DepotResultTag& tag)
+{
+	m_StreamCount++;
+	if (m_TagVisitor)
+	{
+		m_TagVisitor(tag);
+	}
+
+	// The record has been consumed by the visitor, so there's no need to retain it in the tag list
+	if (m_TagList.size() && m_TagList.back() == tag)
+	{
+		m_TagList.pop_back();
+	}
+	return DepotResultReply::Handled;
+}
+
+size_t FDepotResultStream::StreamCount() const
+{
+	return m_StreamCount;
+}
+
 }}}
@@ -22,6 +22,8 @@ DepotStringArray FDepotResultFStatField::ToNames(Enum types)
 		names.push_back(FDepotResultFStatField::Name::HeadRev);
 	if (types & FDepotResultFStatField::HeadType)
 		names.push_back(FDepotResultFStatField::Name::HeadType);
+	if (types & FDepotResultFStatField::Digest)
+		names.push_back(FDepotResultFStatField::Name::Digest);
 	return names;
 }
 
@@ -64,5 +64,87 @@ DepotResultReply FDepotResultPrintString::OnStreamOutput(IDepotClientCommand* cm
 	return DepotResultReply::Handled;
 }
 
-}}}
+FDepotResultPrintDemux::FDepotResultPrintDemux() :
+	m_CurrentFile(nullptr)
+{
+}
+
+size_t FDepotResultPrintDemux::AddFile(const DepotString& depotFile, int32_t revision, HANDLE hStream)
+{
+	const size_t fileIndex = m_Files.size();
+	m_Files.push_back(FDepotResultPrintDemuxFile{ depotFile, revision, hStream, 0, false, false });
+	m_FileIndices[CreateFileKey(depotFile, revision)] = fileIndex;
+	m_CurrentFile = nullptr;
+	return fileIndex;
+}
 
+DepotStringArray FDepotResultPrintDemux::GetFileSpecs() const
+{
+	DepotStringArray fileSpecs;
+	fileSpecs.reserve(m_Files.size());
+	for (const FDepotResultPrintDemuxFile& file : m_Files)
+	{
+		fileSpecs.push_back(CreateFileKey(file.m_DepotFile, file.m_Revision));
+	}
+	return fileSpecs;
+}
+
+size_t FDepotResultPrintDemux::GetFileCount() const
+{
+	return m_Files.size();
+}
+
+const FDepotResultPrintDemuxFile& FDepotResultPrintDemux::GetFile(size_t fileIndex) const
+{
+	return m_Files[fileIndex];
+}
+
+bool FDepotResultPrintDemux::IsFilePrinted(size_t fileIndex) const
+{
+	return fileIndex < m_Files.size() && m_Files[fileIndex].m_IsPrinted && m_Files[fileIndex].m_IsWriteError == false;
+}
+
+DepotResultReply FDepotResultPrintDemux::OnStreamStat(IDepotClientCommand* cmd, const DepotResultTag& tag)
+{
+	const DepotString& depotFile = tag->GetValue(FDepotResultPrintCharsetField::Name::DepotFile);
+	const int32_t revision = tag->GetValueInt32(FDepotResultPrintCharsetField::Name::Rev);
+
+	const size_t* fileIndex = Algo::Find(m_FileIndices, CreateFileKey(depotFile, revision));
+	m_CurrentFile = fileIndex ? &m_Files[*fileIndex] : nullptr;
+	if (m_CurrentFile != nullptr)
+	{
+		m_CurrentFile->m_IsPrinted = true;
+	}
+	else
+	{
+		m_TextList.push_back(std::make_shared<FDepotResultText>(FDepotResultText{ DepotResultChannel::StdErr, StringInfo::Format("Unexpected file printed '%s#%d'", depotFile.c_str(), revision) }));
+	}
+
+	if (cmd != nullptr)
+	{
+		cmd->SetOutputEncoding(tag->GetValue(FDepotResultPrintCharsetField::Name::Type));
+	}
+	return DepotResultReply::Handled;
+}
+
+DepotResultReply FDepotResultPrintDemux::OnStreamOutput(IDepotClientCommand* cmd, const char* data, size_t length)
+{
+	if (data != nullptr && length > 0 && m_CurrentFile != nullptr && m_CurrentFile->m_IsWriteError == false)
+	{
+		DWORD dwWritten = 0;
+		if (WriteFile(m_CurrentFile->m_hStream, data, DWORD(length), &dwWritten, NULL) == FALSE || dwWritten != DWORD(length))
+		{
+			m_TextList.push_back(std::make_shared<FDepotResultText>(FDepotResultText{ DepotResultChannel::StdErr, StringInfo::Format("Failed to write data to stream for '%s#%d'", m_CurrentFile->m_DepotFile.c_str(), m_CurrentFile->m_Revision) }));
+			m_CurrentFile->m_IsWriteError = true;
+		}
+		m_CurrentFile->m_ByteCount += int64_t(dwWritten);
+	}
+	return DepotResultReply::Handled;
+}
+
+DepotString FDepotResultPrintDemux::CreateFileKey(const DepotString& depotFile, int32_t revision)
+{
+	return StringInfo::Format("%s#%d", depotFile.c_str(), revision);
+}
+
+}}}
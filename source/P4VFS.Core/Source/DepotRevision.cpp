@@ -20,6 +20,12 @@ DepotRevision FDepotRevision::FromString(const DepotString& text)
 {
 	if (StringInfo::IsNullOrWhiteSpace(text.c_str()) == false)
 	{
+		FDepotRevisionValue value;
+		if (FDepotRevisionValue::Parse(text.c_str(), text.size(), value))
+		{
+			return value.ToRevision();
+		}
+
 		typedef DepotRevision (*FromStringDelegate)(const DepotString&);
 		constexpr FromStringDelegate fromStringDelegates[] = 
 		{
@@ -245,4 +251,76 @@ DepotString FDepotRevisionDate::ToString() const
 	return StringInfo::Format("@%s", DepotInfo::TimeToString(m_Value).c_str());
 }
 
+bool FDepotRevisionValue::FromRevision(const DepotRevision& revision, FDepotRevisionValue& value)
+{
+	if (revision.get() == nullptr)
+	{
+		value = FDepotRevisionValue();
+		return true;
+	}
+
+	// A negative number is not parsed back from its text, so it is left to FDepotRevision
+	switch (revision->GetType())
+	{
+		case DepotRevisionType::Number:
+			value = FDepotRevisionValue(DepotRevisionType::Number, static_cast<const FDepotRevisionNumber*>(revision.get())->m_Value);
+			return value.m_Value >= 0;
+		case DepotRevisionType::Changelist:
+			value = FDepotRevisionValue(DepotRevisionType::Changelist, static_cast<const FDepotRevisionChangelist*>(revision.get())->m_Value);
+			return value.m_Value >= 0;
+		case DepotRevisionType::Now:
+		case DepotRevisionType::None:
+		case DepotRevisionType::Have:
+		case DepotRevisionType::Head:
+			value = FDepotRevisionValue(revision->GetType());
+			return true;
+		default:
+			return false;
+	}
+}
+
+DepotRevision FDepotRevisionValue::ToRevision() const
+{
+	struct FSharedRevisions
+	{
+		FSharedRevisions() :
+			m_Now(FDepotRevision::New<FDepotRevisionNow>()),
+			m_None(FDepotRevision::New<FDepotRevisionNone>()),
+			m_Have(FDepotRevision::New<FDepotRevisionHave>()),
+			m_Head(FDepotRevision::New<FDepotRevisionHead>())
+		{
+			m_Numbers.reserve(SharedNumberCount);
+			for (int32_t number = 0; number < SharedNumberCount; ++number)
+			{
+				m_Numbers.push_back(FDepotRevision::New<FDepotRevisionNumber>(number));
+			}
+		}
+
+		DepotRevision m_Now;
+		DepotRevision m_None;
+		DepotRevision m_Have;
+		DepotRevision m_Head;
+		Array<DepotRevision> m_Numbers;
+	};
+
+	static const FSharedRevisions sharedRevisions;
+	switch (m_Type)
+	{
+		case DepotRevisionType::Number:
+			return m_Value >= 0 && m_Value < SharedNumberCount ? sharedRevisions.m_Numbers[m_Value] : FDepotRevision::New<FDepotRevisionNumber>(m_Value);
+		case DepotRevisionType::Changelist:
+			return FDepotRevision::New<FDepotRevisionChangelist>(m_Value);
+		case DepotRevisionType::Now:
+			return sharedRevisions.m_Now;
+		case DepotRevisionType::None:
+			return sharedRevisions.m_None;
+		case DepotRevisionType::Have:
+			return sharedRevisions.m_Have;
+		case DepotRevisionType::Head:
+			return sharedRevisions.m_Head;
+		default:
+			return nullptr;
+	}
+}
+
 }}}
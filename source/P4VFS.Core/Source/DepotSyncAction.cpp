@@ -2,6 +2,8 @@
 // Licensed under the MIT license.
 #include "Pch.h"
 #include "DepotSyncAction.h"
+#include "DepotSyncActionTable.h"
+#include "DepotSyncActionScanner.h"
 #include "FileAssert.h"
 
 namespace Microsoft {
@@ -140,6 +142,7 @@ FDepotSyncActionInfo::FDepotSyncActionInfo() :
 	m_FlushTime(0),
 	m_SyncTime(0),
 	m_Message(),
+	m_SymlinkTarget(),
 	m_SubActions()
 {
 }
@@ -177,64 +180,28 @@ bool FDepotSyncActionInfo::IsPreview() const
 	return false;
 }
 
-DepotSyncActionInfo FDepotSyncActionInfo::FromInfoOutput(const DepotString& infoText, FileCore::LogDevice* log)
+static DepotSyncActionInfo SyncActionInfoFromScan(const FDepotSyncActionScan& scan, const DepotString& text)
 {
-	struct InfoRegex
-	{
-		std::regex m_FileRev = std::regex("^([^#]*)(#\\w+)? - (.+)");
-		std::regex m_ActionOpened = std::regex("^is opened .+");
-		std::regex m_ActionDeleted = std::regex("^deleted as (.+)");
-		std::regex m_ActionAdded = std::regex("^added as (.+)");
-		std::regex m_ActionUpdated = std::regex("^updating (.+)");
-		std::regex m_ActionNeedsResolve = std::regex("^(...\\s+)*(.*) - must resolve( (#\\w+))? before submitting");
-	};
-	static const InfoRegex rx;
-
 	DepotSyncActionInfo info = std::make_shared<FDepotSyncActionInfo>();
-	info->m_Message = StringInfo::TrimRight(infoText.c_str());
-
-	std::match_results<const char*> match;
-	if (std::regex_search(infoText.c_str(), match, rx.m_FileRev))
-	{
-		info->m_DepotFile = match[1];
-		info->m_Revision = FDepotRevision::FromString(match[2]);
-		DepotString fileRevAction = match[3];
-
-		if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionOpened))
-		{
-			info->m_SyncActionType = DepotSyncActionType::OpenedNotChanged;
-		}
-		else if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionDeleted))
-		{
-			info->m_SyncActionType = DepotSyncActionType::Deleted;
-			info->m_ClientFile = match[1];
-		}
-		else if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionAdded))
-		{
-			info->m_SyncActionType = DepotSyncActionType::Added;
-			info->m_ClientFile = match[1];
-		}
-		else if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionUpdated))
-		{
-			info->m_SyncActionType = DepotSyncActionType::Updated;
-			info->m_ClientFile = match[1];
-		}
-	}
-	
-	if (std::regex_search(infoText.c_str(), match, rx.m_ActionNeedsResolve))
-	{
-		info->m_DepotFile = match[2];
-		info->m_Revision = FDepotRevision::FromString(match[4]);
-		info->m_SyncActionType = DepotSyncActionType::NeedsResolve;
-	}
+	info->m_Message = StringInfo::TrimRight(text.c_str());
+	info->m_SyncActionType = scan.m_SyncActionType;
+	info->m_DepotFile.assign(scan.m_DepotFile);
+	info->m_ClientFile.assign(scan.m_ClientFile);
+	if (scan.m_Revision.empty() == false)
+		info->m_Revision = FDepotRevision::FromString(DepotString(scan.m_Revision));
+	return info;
+}
 
-	if (info->m_SyncActionType == DepotSyncActionType::None)
+DepotSyncActionInfo FDepotSyncActionInfo::FromInfoOutput(const DepotString& infoText, FileCore::LogDevice* log)
+{
+	const FDepotSyncActionScan scan = DepotSyncActionScanner::ScanInfoOutput(infoText.c_str());
+	if (scan.m_SyncActionType == DepotSyncActionType::None)
 	{
 		if (log != nullptr)
 			log->Error(StringInfo::Format("Failed to parse DepotSyncActionInfo InfoOutput '%s'", infoText.c_str()));
 		return nullptr;
 	}
-	return info;
+	return SyncActionInfoFromScan(scan, infoText);
 }
 
 DepotSyncActionInfo FDepotSyncActionInfo::FromTaggedOutput(const FDepotResultTag& tag, FileCore::LogDevice* log)
@@ -252,7 +219,7 @@ DepotSyncActionInfo FDepotSyncActionInfo::FromTaggedOutput(const FDepotResultTag
 	DepotSyncActionInfo info = std::make_shared<FDepotSyncActionInfo>();
 
 	info->m_SyncActionType = syncAction;
-	info->m_Revision = FDepotRevision::New<FDepotRevisionNumber>(tag.GetValueInt32("rev"));
+	info->m_Revision = FDepotRevisionValue(DepotRevisionType::Number, tag.GetValueInt32("rev")).ToRevision();
 	info->m_ClientFile = tag.GetValue("clientFile");
 	info->m_DepotFile = tag.GetValue("depotFile");
 	info->m_FileSize = tag.GetValueInt64("fileSize");
@@ -261,59 +228,7 @@ DepotSyncActionInfo FDepotSyncActionInfo::FromTaggedOutput(const FDepotResultTag
 
 DepotSyncActionInfo FDepotSyncActionInfo::FromErrorOutput(const DepotString& errorText, FileCore::LogDevice* log)
 {
-	struct ErrorRegex
-	{
-		std::regex m_FileRev = std::regex("^([^#]*)(#\\w+)? - (.+)");
-		std::regex m_ActionNoFileAtRevision = std::regex("^no file\\(s\\) at that revision");
-		std::regex m_ActionInvalidPattern = std::regex("^no such file\\(s\\)");
-		std::regex m_ActionNotInClientView = std::regex("^file\\(s\\) not in client view");
-		std::regex m_ActionNoFilesFound = std::regex("^no file\\(s\\) at that changelist number");
-		std::regex m_ActionUpToDate = std::regex("^file\\(s\\) up-to-date");
-		std::regex m_ActionCantClobber = std::regex("^Can't clobber writable file (.+)");
-	};
-	static const ErrorRegex rx;
-
-	DepotSyncActionInfo info = std::make_shared<FDepotSyncActionInfo>();
-	info->m_Message = StringInfo::TrimRight(errorText.c_str());
-
-	std::match_results<const char*> match;
-	if (std::regex_search(errorText.c_str(), match, rx.m_FileRev))
-	{
-		info->m_DepotFile = match[1];
-		info->m_Revision = FDepotRevision::FromString(match[2]);
-		DepotString fileRevAction = match[3];
-
-		if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionNoFileAtRevision))
-		{
-			info->m_SyncActionType = DepotSyncActionType::NoFileAtRevision;
-		}
-		else if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionInvalidPattern))
-		{
-			info->m_SyncActionType = DepotSyncActionType::InvalidPattern;
-		}
-		else if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionNotInClientView))
-		{
-			info->m_SyncActionType = DepotSyncActionType::NotInClientView;
-		}
-		else if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionNoFilesFound))
-		{
-			info->m_SyncActionType = DepotSyncActionType::NoFilesFound;
-		}
-		else if (std::regex_search(fileRevAction.c_str(), match, rx.m_ActionUpToDate))
-		{
-			info->m_SyncActionType = DepotSyncActionType::UpToDate;
-		}
-	}
-	else if (std::regex_search(errorText.c_str(), match, rx.m_ActionCantClobber))
-	{
-		info->m_ClientFile = match[1];
-		info->m_SyncActionType = DepotSyncActionType::CantClobber;
-	}
-	else
-	{
-		info->m_SyncActionType = DepotSyncActionType::GenericError;
-	}
-	return info;
+	return SyncActionInfoFromScan(DepotSyncActionScanner::ScanErrorOutput(errorText.c_str()), errorText);
 }
 
 DepotString FDepotSyncActionInfo::ToString() const
@@ -358,21 +273,32 @@ DepotSyncStatus::Enum DepotSyncStatus::FromLogElement(const LogElement& element)
 
 DepotSyncStatus::Enum DepotSyncStatus::FromLog(const LogDeviceMemory& log)
 {
+	// The channel counts include elements which the log did not keep
 	StaticAssert(DepotSyncStatus::Success == 0);
 	DepotSyncStatus::Enum status = DepotSyncStatus::Success;
-	for (const LogElement& element : log.GetElements())
+	if (log.GetChannelCount(LogChannel::Error) > 0)
+	{
+		status |= DepotSyncStatus::Error;
+	}
+	if (log.GetChannelCount(LogChannel::Warning) > 0)
 	{
-		status |= FromLogElement(element);
+		status |= DepotSyncStatus::Warning;
 	}
 	return status;
 }
 
-FDepotSyncResult::FDepotSyncResult(DepotSyncStatus::Enum status, DepotSyncActionInfoArray modifications) :
+FDepotSyncResult::FDepotSyncResult(DepotSyncStatus::Enum status, DepotSyncActionTable modifications) :
 	m_Status(status),
 	m_Modifications(modifications)
 {
 }
 
+FDepotSyncResult::FDepotSyncResult(DepotSyncStatus::Enum status, const DepotSyncActionInfoArray& modifications) :
+	m_Status(status),
+	m_Modifications(modifications.get() ? FDepotSyncActionTable::FromArray(*modifications) : nullptr)
+{
+}
+
 FDepotSyncResult::~FDepotSyncResult()
 {
 }
@@ -0,0 +1,242 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotSyncActionScanner.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+namespace DepotSyncActionScannerInternal {
+
+	static const std::string_view FileRevSeparator = " - ";
+	static const std::string_view MustResolve = " - must resolve";
+	static const std::string_view BeforeSubmitting = " before submitting";
+
+	// The characters which are not matched by '.'
+	inline bool IsLineTerminator(char c)
+	{
+		return c == '\n' || c == '\r';
+	}
+
+	// The characters matched by \w in the classic locale
+	inline bool IsWordChar(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	// The characters matched by \s in the classic locale
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+
+	inline bool StartsWith(std::string_view text, size_t pos, std::string_view prefix)
+	{
+		return pos <= text.size() && text.size() - pos >= prefix.size() && text.compare(pos, prefix.size(), prefix) == 0;
+	}
+
+	// The end of the longest match of .* from pos
+	inline size_t LineEnd(std::string_view text, size_t pos)
+	{
+		while (pos < text.size() && IsLineTerminator(text[pos]) == false)
+			++pos;
+		return pos;
+	}
+
+	// The end of the longest match of \w* from pos
+	inline size_t WordEnd(std::string_view text, size_t pos)
+	{
+		while (pos < text.size() && IsWordChar(text[pos]))
+			++pos;
+		return pos;
+	}
+
+	// Matches " - (.+)" at pos, returning the group
+	inline bool ScanSeparator(std::string_view text, size_t pos, std::string_view& action)
+	{
+		const size_t actionPos = pos + FileRevSeparator.size();
+		if (StartsWith(text, pos, FileRevSeparator) && actionPos < text.size() && IsLineTerminator(text[actionPos]) == false)
+		{
+			action = text.substr(actionPos, LineEnd(text, actionPos) - actionPos);
+			return true;
+		}
+		return false;
+	}
+
+	// Matches " - must resolve( (#\w+))? before submitting" at pos. The optional group is tried first, and a shorter \w+
+	// could only be followed by another word character, so only the longest one is tried.
+	bool ScanResolveTail(std::string_view text, size_t pos, std::string_view& revision)
+	{
+		if (StartsWith(text, pos, MustResolve) == false)
+			return false;
+
+		const size_t tailPos = pos + MustResolve.size();
+		if (StartsWith(text, tailPos, " #"))
+		{
+			const size_t revisionPos = tailPos + 1;
+			const size_t revisionEnd = WordEnd(text, revisionPos + 1);
+			if (revisionEnd > revisionPos + 1 && StartsWith(text, revisionEnd, BeforeSubmitting))
+			{
+				revision = text.substr(revisionPos, revisionEnd - revisionPos);
+				return true;
+			}
+		}
+		if (StartsWith(text, tailPos, BeforeSubmitting))
+		{
+			revision = std::string_view();
+			return true;
+		}
+		return false;
+	}
+
+	// Matches "(.*) - must resolve..." at pos, trying the longest group first
+	bool ScanResolveRest(std::string_view text, size_t pos, std::string_view& depotFile, std::string_view& revision)
+	{
+		const size_t lineEnd = LineEnd(text, pos);
+		for (size_t tailPos = text.rfind(MustResolve, lineEnd); tailPos != std::string_view::npos && tailPos >= pos; tailPos = tailPos ? text.rfind(MustResolve, tailPos-1) : std::string_view::npos)
+		{
+			if (ScanResolveTail(text, tailPos, revision))
+			{
+				depotFile = text.substr(pos, tailPos - pos);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Matches "(...\s+)*" at pos followed by the rest of the pattern. As a greedy loop, another iteration with the
+	// longest \s+ is tried before a shorter one, and before the rest of the pattern.
+	bool ScanResolvePrefix(std::string_view text, size_t pos, std::string_view& depotFile, std::string_view& revision)
+	{
+		const size_t spacePos = pos + 3;
+		if (spacePos < text.size() && IsLineTerminator(text[pos]) == false && IsLineTerminator(text[pos+1]) == false && IsLineTerminator(text[pos+2]) == false)
+		{
+			size_t spaceEnd = spacePos;
+			while (spaceEnd < text.size() && IsSpace(text[spaceEnd]))
+				++spaceEnd;
+
+			for (size_t nextPos = spaceEnd; nextPos > spacePos; --nextPos)
+			{
+				if (ScanResolvePrefix(text, nextPos, depotFile, revision))
+					return true;
+			}
+		}
+		return ScanResolveRest(text, pos, depotFile, revision);
+	}
+}
+
+using namespace DepotSyncActionScannerInternal;
+
+FDepotSyncActionScan DepotSyncActionScanner::ScanInfoOutput(std::string_view text)
+{
+	FDepotSyncActionScan scan;
+	std::string_view action, opened;
+	if (ScanFileRev(text, scan.m_DepotFile, scan.m_Revision, action))
+	{
+		if (ScanPrefix(action, "is opened ", &opened))
+			scan.m_SyncActionType = DepotSyncActionType::OpenedNotChanged;
+		else if (ScanPrefix(action, "deleted as ", &scan.m_ClientFile))
+			scan.m_SyncActionType = DepotSyncActionType::Deleted;
+		else if (ScanPrefix(action, "added as ", &scan.m_ClientFile))
+			scan.m_SyncActionType = DepotSyncActionType::Added;
+		else if (ScanPrefix(action, "updating ", &scan.m_ClientFile))
+			scan.m_SyncActionType = DepotSyncActionType::Updated;
+	}
+
+	if (ScanNeedsResolve(text, scan.m_DepotFile, scan.m_Revision))
+		scan.m_SyncActionType = DepotSyncActionType::NeedsResolve;
+	return scan;
+}
+
+FDepotSyncActionScan DepotSyncActionScanner::ScanErrorOutput(std::string_view text)
+{
+	FDepotSyncActionScan scan;
+	std::string_view action;
+	if (ScanFileRev(text, scan.m_DepotFile, scan.m_Revision, action))
+	{
+		if (ScanPrefix(action, "no file(s) at that revision"))
+			scan.m_SyncActionType = DepotSyncActionType::NoFileAtRevision;
+		else if (ScanPrefix(action, "no such file(s)"))
+			scan.m_SyncActionType = DepotSyncActionType::InvalidPattern;
+		else if (ScanPrefix(action, "file(s) not in client view"))
+			scan.m_SyncActionType = DepotSyncActionType::NotInClientView;
+		else if (ScanPrefix(action, "no file(s) at that changelist number"))
+			scan.m_SyncActionType = DepotSyncActionType::NoFilesFound;
+		else if (ScanPrefix(action, "file(s) up-to-date"))
+			scan.m_SyncActionType = DepotSyncActionType::UpToDate;
+	}
+	else if (ScanPrefix(text, "Can't clobber writable file ", &scan.m_ClientFile))
+	{
+		scan.m_SyncActionType = DepotSyncActionType::CantClobber;
+	}
+	else
+	{
+		scan.m_SyncActionType = DepotSyncActionType::GenericError;
+	}
+	return scan;
+}
+
+bool DepotSyncActionScanner::ScanFileRev(std::string_view text, std::string_view& depotFile, std::string_view& revision, std::string_view& action)
+{
+	// [^#]* first stops at the first '#', which is the only place that (#\w+) can match
+	const size_t hashPos = text.find('#');
+	if (hashPos != std::string_view::npos)
+	{
+		const size_t revisionEnd = WordEnd(text, hashPos+1);
+		if (revisionEnd > hashPos+1 && ScanSeparator(text, revisionEnd, action))
+		{
+			depotFile = text.substr(0, hashPos);
+			revision = text.substr(hashPos, revisionEnd - hashPos);
+			return true;
+		}
+	}
+
+	// Otherwise the last separator which ends before the first '#'
+	const size_t fileEnd = hashPos == std::string_view::npos ? text.size() : hashPos;
+	if (fileEnd < FileRevSeparator.size())
+		return false;
+
+	for (size_t separatorPos = text.rfind(FileRevSeparator, fileEnd - FileRevSeparator.size()); separatorPos != std::string_view::npos; separatorPos = separatorPos ? text.rfind(FileRevSeparator, separatorPos-1) : std::string_view::npos)
+	{
+		if (ScanSeparator(text, separatorPos, action))
+		{
+			depotFile = text.substr(0, separatorPos);
+			revision = std::string_view();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool DepotSyncActionScanner::ScanNeedsResolve(std::string_view text, std::string_view& depotFile, std::string_view& revision)
+{
+	// Most lines are rejected without trying each way of matching the leading group
+	if (text.find(MustResolve) == std::string_view::npos)
+		return false;
+
+	std::string_view resolveFile, resolveRevision;
+	if (ScanResolvePrefix(text, 0, resolveFile, resolveRevision) == false)
+		return false;
+
+	depotFile = resolveFile;
+	revision = resolveRevision;
+	return true;
+}
+
+bool DepotSyncActionScanner::ScanPrefix(std::string_view text, std::string_view prefix, std::string_view* group)
+{
+	if (StartsWith(text, 0, prefix) == false)
+		return false;
+	if (group == nullptr)
+		return true;
+
+	const size_t groupEnd = LineEnd(text, prefix.size());
+	if (groupEnd == prefix.size())
+		return false;
+
+	*group = text.substr(prefix.size(), groupEnd - prefix.size());
+	return true;
+}
+
+}}}
@@ -0,0 +1,451 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotSyncActionTable.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+// Each enum is stored in a uint8_t column, so every value and combination of flags must fit in a byte
+static_assert(DepotSyncActionType::GenericError <= UINT8_MAX, "DepotSyncActionType must fit in a uint8_t column");
+static_assert(DepotSyncActionFlags::FileSymlink <= 0x80, "DepotSyncActionFlags must fit in a uint8_t column");
+static_assert(DepotSyncFlags::ClientSize <= 0x80, "DepotSyncFlags must fit in a uint8_t column");
+static_assert(DepotFlushType::Atomic <= UINT8_MAX, "DepotFlushType must fit in a uint8_t column");
+
+FDepotSyncActionTable::FDepotSyncActionTable() :
+	m_StringOffsets{ 0, 0 }
+{
+}
+
+FDepotSyncActionTable::~FDepotSyncActionTable()
+{
+}
+
+size_t FDepotSyncActionTable::Append(const FDepotSyncActionInfo& modification)
+{
+	AutoCriticalSection lock(m_RowsLock);
+	const size_t rowIndex = m_DepotFiles.size();
+	m_DepotFiles.push_back(InternPath(modification.m_DepotFile));
+	m_ClientFiles.push_back(InternPath(modification.m_ClientFile));
+
+	int32_t revision = RevisionNull;
+	if (modification.m_Revision.get() != nullptr)
+	{
+		const FDepotRevisionNumber* revisionNumber = FDepotRevision::Cast<const FDepotRevisionNumber*>(modification.m_Revision.get());
+		if (revisionNumber != nullptr && revisionNumber->m_Value >= 0)
+		{
+			revision = revisionNumber->m_Value;
+		}
+		else
+		{
+			const DepotString revisionText = modification.m_Revision->ToString();
+			revision = RevisionStringBase - int32_t(InternString(revisionText.c_str(), revisionText.size()));
+		}
+	}
+	m_Revisions.push_back(revision);
+
+	m_SyncActionTypes.push_back(0);
+	m_SyncActionFlags.push_back(0);
+	m_SyncFlags.push_back(0);
+	m_FlushTypes.push_back(0);
+	m_IsAlwaysResident.push_back(false);
+	for (Array<int64_t>& values : m_Values)
+	{
+		values.push_back(0);
+	}
+
+	WriteRow(rowIndex, modification);
+	return rowIndex;
+}
+
+void FDepotSyncActionTable::Update(size_t rowIndex, const FDepotSyncActionInfo& modification)
+{
+	AutoCriticalSection lock(m_RowsLock);
+	WriteRow(rowIndex, modification);
+}
+
+void FDepotSyncActionTable::Reserve(size_t rowCount)
+{
+	m_DepotFiles.reserve(rowCount);
+	m_ClientFiles.reserve(rowCount);
+	m_Revisions.reserve(rowCount);
+	m_SyncActionTypes.reserve(rowCount);
+	m_SyncActionFlags.reserve(rowCount);
+	m_SyncFlags.reserve(rowCount);
+	m_FlushTypes.reserve(rowCount);
+	m_IsAlwaysResident.reserve(rowCount);
+	for (Array<int64_t>& values : m_Values)
+	{
+		values.reserve(rowCount);
+	}
+}
+
+size_t FDepotSyncActionTable::Count() const
+{
+	return m_DepotFiles.size();
+}
+
+size_t FDepotSyncActionTable::GetMemorySize() const
+{
+	size_t memorySize = sizeof(FDepotSyncActionTable);
+	memorySize += m_StringArena.capacity() * sizeof(char);
+	memorySize += m_StringOffsets.capacity() * sizeof(uint32_t);
+	memorySize += m_StringIds.size() * (sizeof(size_t) + sizeof(uint32_t) + 2*sizeof(void*)) + m_StringIds.bucket_count() * sizeof(void*);
+	memorySize += (m_DepotFiles.capacity() + m_ClientFiles.capacity()) * sizeof(FPath);
+	memorySize += m_Revisions.capacity() * sizeof(int32_t);
+	memorySize += m_SyncActionTypes.capacity() + m_SyncActionFlags.capacity() + m_SyncFlags.capacity() + m_FlushTypes.capacity();
+	memorySize += m_IsAlwaysResident.capacity() / 8;
+	for (const Array<int64_t>& values : m_Values)
+	{
+		memorySize += values.capacity() * sizeof(int64_t);
+	}
+	for (const auto& message : m_Messages)
+	{
+		memorySize += sizeof(message) + message.second.capacity();
+	}
+	for (const auto& symlinkTarget : m_SymlinkTargets)
+	{
+		memorySize += sizeof(symlinkTarget) + symlinkTarget.second.capacity();
+	}
+	for (const auto& subActions : m_SubActions)
+	{
+		memorySize += sizeof(subActions) + subActions.second.capacity() * (sizeof(DepotSyncActionInfo) + sizeof(FDepotSyncActionInfo));
+	}
+	return memorySize;
+}
+
+DepotString FDepotSyncActionTable::DepotFile(size_t rowIndex) const
+{
+	return GetPath(m_DepotFiles[rowIndex]);
+}
+
+DepotString FDepotSyncActionTable::ClientFile(size_t rowIndex) const
+{
+	return GetPath(m_ClientFiles[rowIndex]);
+}
+
+DepotRevision FDepotSyncActionTable::Revision(size_t rowIndex) const
+{
+	const int32_t revision = m_Revisions[rowIndex];
+	if (revision >= 0)
+	{
+		return FDepotRevisionValue(DepotRevisionType::Number, revision).ToRevision();
+	}
+	if (revision == RevisionNull)
+	{
+		return nullptr;
+	}
+	return FDepotRevision::FromString(GetString(uint32_t(RevisionStringBase - revision)));
+}
+
+DepotString FDepotSyncActionTable::RevisionString(size_t rowIndex) const
+{
+	const int32_t revision = m_Revisions[rowIndex];
+	if (revision >= 0)
+	{
+		return FDepotRevisionNumber(revision).ToString();
+	}
+	if (revision == RevisionNull)
+	{
+		return DepotString();
+	}
+	return GetString(uint32_t(RevisionStringBase - revision));
+}
+
+DepotString FDepotSyncActionTable::Message(size_t rowIndex) const
+{
+	const DepotString* message = Algo::Find(m_Messages, uint32_t(rowIndex));
+	return message ? *message : DepotString();
+}
+
+DepotString FDepotSyncActionTable::SymlinkTarget(size_t rowIndex) const
+{
+	const DepotString* symlinkTarget = Algo::Find(m_SymlinkTargets, uint32_t(rowIndex));
+	return symlinkTarget ? *symlinkTarget : DepotString();
+}
+
+Array<DepotSyncActionInfo> FDepotSyncActionTable::SubActions(size_t rowIndex) const
+{
+	const Array<DepotSyncActionInfo>* subActions = Algo::Find(m_SubActions, uint32_t(rowIndex));
+	return subActions ? *subActions : Array<DepotSyncActionInfo>();
+}
+
+DepotString FDepotSyncActionTable::ToFileSpecString(size_t rowIndex) const
+{
+	DepotString file = DepotFile(rowIndex);
+	if (file.empty())
+	{
+		file = ClientFile(rowIndex);
+	}
+	if (file.empty())
+	{
+		return DepotString();
+	}
+	return file + RevisionString(rowIndex);
+}
+
+DepotSyncActionType::Enum FDepotSyncActionTable::SyncActionType(size_t rowIndex) const
+{
+	return DepotSyncActionType::Enum(m_SyncActionTypes[rowIndex]);
+}
+
+DepotSyncActionFlags::Enum FDepotSyncActionTable::SyncActionFlags(size_t rowIndex) const
+{
+	return DepotSyncActionFlags::Enum(m_SyncActionFlags[rowIndex]);
+}
+
+DepotSyncFlags::Enum FDepotSyncActionTable::SyncFlags(size_t rowIndex) const
+{
+	return DepotSyncFlags::Enum(m_SyncFlags[rowIndex]);
+}
+
+DepotFlushType::Enum FDepotSyncActionTable::FlushType(size_t rowIndex) const
+{
+	return DepotFlushType::Enum(m_FlushTypes[rowIndex]);
+}
+
+bool FDepotSyncActionTable::IsAlwaysResident(size_t rowIndex) const
+{
+	return m_IsAlwaysResident[rowIndex];
+}
+
+bool FDepotSyncActionTable::IsPreview(size_t rowIndex) const
+{
+	return (m_SyncFlags[rowIndex] & DepotSyncFlags::Preview) != 0;
+}
+
+int64_t FDepotSyncActionTable::Value(DepotSyncActionColumn::Enum column, size_t rowIndex) const
+{
+	return m_Values[column][rowIndex];
+}
+
+int64_t FDepotSyncActionTable::Sum(DepotSyncActionColumn::Enum column, const IndexArray* rowIndices) const
+{
+	const Array<int64_t>& values = m_Values[column];
+	int64_t sum = 0;
+	if (rowIndices != nullptr)
+	{
+		for (uint32_t rowIndex : *rowIndices)
+		{
+			sum += values[rowIndex];
+		}
+	}
+	else
+	{
+		for (int64_t value : values)
+		{
+			sum += value;
+		}
+	}
+	return sum;
+}
+
+FDepotSyncActionTable::IndexArray FDepotSyncActionTable::Select(const std::function<bool(const FDepotSyncActionTable& table, size_t rowIndex)>& predicate) const
+{
+	IndexArray rowIndices;
+	const size_t rowCount = Count();
+	for (size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex)
+	{
+		if (predicate(*this, rowIndex))
+		{
+			rowIndices.push_back(uint32_t(rowIndex));
+		}
+	}
+	return rowIndices;
+}
+
+DepotSyncActionInfo FDepotSyncActionTable::ToActionInfo(size_t rowIndex) const
+{
+	AutoCriticalSection lock(m_RowsLock);
+	DepotSyncActionInfo info = std::make_shared<FDepotSyncActionInfo>();
+	info->m_DepotFile = DepotFile(rowIndex);
+	info->m_ClientFile = ClientFile(rowIndex);
+	info->m_FileSize = m_Values[DepotSyncActionColumn::FileSize][rowIndex];
+	info->m_Revision = Revision(rowIndex);
+	info->m_SyncActionType = SyncActionType(rowIndex);
+	info->m_SyncActionFlags = SyncActionFlags(rowIndex);
+	info->m_SyncFlags = SyncFlags(rowIndex);
+	info->m_FlushType = FlushType(rowIndex);
+	info->m_DiskFileSize = m_Values[DepotSyncActionColumn::DiskFileSize][rowIndex];
+	info->m_VirtualFileSize = m_Values[DepotSyncActionColumn::VirtualFileSize][rowIndex];
+	info->m_IsAlwaysResident = IsAlwaysResident(rowIndex);
+	info->m_PlaceholderTime = m_Values[DepotSyncActionColumn::PlaceholderTime][rowIndex];
+	info->m_FlushTime = m_Values[DepotSyncActionColumn::FlushTime][rowIndex];
+	info->m_SyncTime = m_Values[DepotSyncActionColumn::SyncTime][rowIndex];
+	info->m_Message = Message(rowIndex);
+	info->m_SymlinkTarget = SymlinkTarget(rowIndex);
+	info->m_SubActions = SubActions(rowIndex);
+	return info;
+}
+
+DepotSyncActionInfoArray FDepotSyncActionTable::ToActionInfoArray(const IndexArray* rowIndices) const
+{
+	DepotSyncActionInfoArray modifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+	if (rowIndices != nullptr)
+	{
+		modifications->reserve(rowIndices->size());
+		for (uint32_t rowIndex : *rowIndices)
+		{
+			modifications->push_back(ToActionInfo(rowIndex));
+		}
+	}
+	else
+	{
+		const size_t rowCount = Count();
+		modifications->reserve(rowCount);
+		for (size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex)
+		{
+			modifications->push_back(ToActionInfo(rowIndex));
+		}
+	}
+	return modifications;
+}
+
+DepotSyncActionTable FDepotSyncActionTable::FromArray(const Array<DepotSyncActionInfo>& modifications)
+{
+	DepotSyncActionTable table = std::make_shared<FDepotSyncActionTable>();
+	table->Reserve(modifications.size());
+	for (const DepotSyncActionInfo& modification : modifications)
+	{
+		if (modification.get() != nullptr)
+		{
+			table->Append(*modification);
+		}
+	}
+	return table;
+}
+
+DepotSyncActionTable FDepotSyncActionTable::Slice(const IndexArray& rowIndices) const
+{
+	DepotSyncActionTable table = std::make_shared<FDepotSyncActionTable>();
+	table->Reserve(rowIndices.size());
+	for (uint32_t rowIndex : rowIndices)
+	{
+		table->Append(*ToActionInfo(rowIndex));
+	}
+	return table;
+}
+
+DepotSyncActionInfo FDepotSyncActionTable::Checkout(const DepotSyncActionTable& table, size_t rowIndex)
+{
+	const DepotSyncActionInfo modification = table->ToActionInfo(rowIndex);
+	return DepotSyncActionInfo(modification.get(), FRowWriter{ table, rowIndex, modification });
+}
+
+DepotSyncActionInfo FDepotSyncActionTable::CheckoutAppend(const DepotSyncActionTable& table, const DepotSyncActionInfo& modification)
+{
+	const size_t rowIndex = table->Append(*modification);
+	return DepotSyncActionInfo(modification.get(), FRowWriter{ table, rowIndex, modification });
+}
+
+size_t FDepotSyncActionTable::GetRowIndex(const DepotSyncActionInfo& modification)
+{
+	// Only a checked out record has a row, which is held by its deleter
+	const FRowWriter* rowWriter = std::get_deleter<FRowWriter>(modification);
+	return rowWriter ? rowWriter->m_RowIndex : InvalidRowIndex;
+}
+
+void FDepotSyncActionTable::FRowWriter::operator()(FDepotSyncActionInfo* modification) const
+{
+	m_Table->Update(m_RowIndex, *modification);
+}
+
+void FDepotSyncActionTable::WriteRow(size_t rowIndex, const FDepotSyncActionInfo& modification)
+{
+	m_SyncActionTypes[rowIndex] = uint8_t(modification.m_SyncActionType);
+	m_SyncActionFlags[rowIndex] = uint8_t(modification.m_SyncActionFlags);
+	m_SyncFlags[rowIndex] = uint8_t(modification.m_SyncFlags);
+	m_FlushTypes[rowIndex] = uint8_t(modification.m_FlushType);
+	m_IsAlwaysResident[rowIndex] = modification.m_IsAlwaysResident;
+
+	m_Values[DepotSyncActionColumn::FileSize][rowIndex] = modification.m_FileSize;
+	m_Values[DepotSyncActionColumn::DiskFileSize][rowIndex] = modification.m_DiskFileSize;
+	m_Values[DepotSyncActionColumn::VirtualFileSize][rowIndex] = modification.m_VirtualFileSize;
+	m_Values[DepotSyncActionColumn::PlaceholderTime][rowIndex] = modification.m_PlaceholderTime;
+	m_Values[DepotSyncActionColumn::FlushTime][rowIndex] = modification.m_FlushTime;
+	m_Values[DepotSyncActionColumn::SyncTime][rowIndex] = modification.m_SyncTime;
+
+	// Messages, symlink targets and sub-actions are only present on a few rows, so they are stored sparsely
+	if (modification.m_Message.empty())
+	{
+		m_Messages.erase(uint32_t(rowIndex));
+	}
+	else
+	{
+		m_Messages[uint32_t(rowIndex)] = modification.m_Message;
+	}
+
+	if (modification.m_SymlinkTarget.empty())
+	{
+		m_SymlinkTargets.erase(uint32_t(rowIndex));
+	}
+	else
+	{
+		m_SymlinkTargets[uint32_t(rowIndex)] = modification.m_SymlinkTarget;
+	}
+
+	if (modification.m_SubActions.empty())
+	{
+		m_SubActions.erase(uint32_t(rowIndex));
+	}
+	else
+	{
+		m_SubActions[uint32_t(rowIndex)] = modification.m_SubActions;
+	}
+}
+
+FDepotSyncActionTable::FPath FDepotSyncActionTable::InternPath(const DepotString& path)
+{
+	// Most files in a sync share their folder with their neighbors, so only the file name is unique per row
+	const size_t separator = path.find_last_of("/\\");
+	const size_t nameOffset = separator == DepotString::npos ? 0 : separator+1;
+	FPath result;
+	result.m_Folder = InternString(path.c_str(), nameOffset);
+	result.m_Name = InternString(path.c_str() + nameOffset, path.size() - nameOffset);
+	return result;
+}
+
+uint32_t FDepotSyncActionTable::InternString(const char* text, size_t length)
+{
+	if (length == 0)
+	{
+		return StringNull;
+	}
+
+	const size_t hash = std::hash<std::string_view>()(std::string_view(text, length));
+	auto range = m_StringIds.equal_range(hash);
+	for (auto stringId = range.first; stringId != range.second; ++stringId)
+	{
+		const uint32_t offset = m_StringOffsets[stringId->second];
+		if (m_StringOffsets[stringId->second+1] - offset == length && memcmp(m_StringArena.data() + offset, text, length) == 0)
+		{
+			return stringId->second;
+		}
+	}
+
+	const uint32_t stringId = uint32_t(m_StringOffsets.size() - 1);
+	m_StringArena.insert(m_StringArena.end(), text, text + length);
+	m_StringOffsets.push_back(uint32_t(m_StringArena.size()));
+	m_StringIds.insert(std::make_pair(hash, stringId));
+	return stringId;
+}
+
+DepotString FDepotSyncActionTable::GetPath(const FPath& path) const
+{
+	const uint32_t folderOffset = m_StringOffsets[path.m_Folder];
+	const uint32_t nameOffset = m_StringOffsets[path.m_Name];
+	DepotString result;
+	result.reserve((m_StringOffsets[path.m_Folder+1] - folderOffset) + (m_StringOffsets[path.m_Name+1] - nameOffset));
+	result.append(m_StringArena.data() + folderOffset, m_StringOffsets[path.m_Folder+1] - folderOffset);
+	result.append(m_StringArena.data() + nameOffset, m_StringOffsets[path.m_Name+1] - nameOffset);
+	return result;
+}
+
+DepotString FDepotSyncActionTable::GetString(uint32_t stringId) const
+{
+	const uint32_t offset = m_StringOffsets[stringId];
+	return DepotString(m_StringArena.data() + offset, m_StringOffsets[stringId+1] - offset);
+}
+
+}}}
@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotSyncDirectoryScheduler.h"
+#include "FileOperations.h"
+#include "ThreadPool.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+FDepotSyncDirectoryScheduler::FDepotSyncDirectoryScheduler(const FDepotSyncActionTable& modifications, size_t maxGroupSize)
+{
+	maxGroupSize = std::max<size_t>(1, maxGroupSize);
+
+	// Client paths are case insensitive, so differently cased folders are the same directory
+	Map<DepotString, size_t, StringInfo::LessInsensitive> directoryIndices;
+	Array<FDepotSyncActionTable::IndexArray> directoryRowIndices;
+	const size_t rowCount = modifications.Count();
+	for (size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex)
+	{
+		const DepotString folderPath = GetFolderPath(modifications.ClientFile(rowIndex));
+		size_t directoryIndex = m_Directories.size();
+		if (const size_t* existingIndex = Algo::Find(directoryIndices, folderPath))
+		{
+			directoryIndex = *existingIndex;
+		}
+		else
+		{
+			directoryIndices[folderPath] = directoryIndex;
+			m_Directories.push_back(FDirectory{ folderPath, 0, 0 });
+			directoryRowIndices.emplace_back();
+		}
+		directoryRowIndices[directoryIndex].push_back(uint32_t(rowIndex));
+	}
+
+	for (size_t directoryIndex = 0; directoryIndex < m_Directories.size(); ++directoryIndex)
+	{
+		FDepotSyncActionTable::IndexArray& directory = directoryRowIndices[directoryIndex];
+		for (size_t groupBegin = 0; groupBegin < directory.size(); groupBegin += maxGroupSize)
+		{
+			const size_t groupEnd = std::min(directory.size(), groupBegin + maxGroupSize);
+			m_Groups.push_back(FGroup{ directoryIndex, FDepotSyncActionTable::IndexArray(directory.begin() + groupBegin, directory.begin() + groupEnd) });
+			m_Directories[directoryIndex].m_PendingGroupCount++;
+		}
+		directory.clear();
+		directory.shrink_to_fit();
+	}
+
+	// The largest groups are started first so that the small groups fill in the tail of the sync. Groups
+	// of equal size remain in preview order.
+	std::stable_sort(m_Groups.begin(), m_Groups.end(), [](const FGroup& a, const FGroup& b) -> bool
+	{
+		return a.m_RowIndices.size() > b.m_RowIndices.size();
+	});
+}
+
+FDepotSyncDirectoryScheduler::~FDepotSyncDirectoryScheduler()
+{
+}
+
+size_t FDepotSyncDirectoryScheduler::Execute(size_t maxThreads, HANDLE cancelationEvent, const FileCore::UserContext* userContext, const ApplyCallback& apply, const FinalizeCallback& finalize)
+{
+	auto applyGroup = [this, cancelationEvent, &apply, &finalize](FGroup& group) -> void
+	{
+		ApplyGroup(group, cancelationEvent, apply, finalize);
+	};
+
+	if (userContext != nullptr)
+	{
+		return ThreadPool::ForEach::ExecuteImpersonated(maxThreads, m_Groups.data(), m_Groups.size(), cancelationEvent, userContext, applyGroup);
+	}
+	return ThreadPool::ForEach::Execute(maxThreads, m_Groups.data(), m_Groups.size(), cancelationEvent, applyGroup);
+}
+
+void FDepotSyncDirectoryScheduler::ApplyGroup(FGroup& group, HANDLE cancelationEvent, const ApplyCallback& apply, const FinalizeCallback& finalize)
+{
+	size_t removedCount = 0;
+	bool isCanceled = false;
+	for (uint32_t rowIndex : group.m_RowIndices)
+	{
+		if (cancelationEvent != NULL && WaitForSingleObject(cancelationEvent, 0) == WAIT_OBJECT_0)
+		{
+			isCanceled = true;
+			break;
+		}
+		if (apply(rowIndex))
+		{
+			removedCount++;
+		}
+	}
+
+	bool isDirectoryComplete = false;
+	DepotString folderPath;
+	{
+		AutoCriticalSection lock(m_DirectoriesLock);
+		FDirectory& directory = m_Directories[group.m_DirectoryIndex];
+		directory.m_RemovedCount += removedCount;
+		isDirectoryComplete = --directory.m_PendingGroupCount == 0 && directory.m_RemovedCount > 0;
+		folderPath = directory.m_FolderPath;
+	}
+
+	// The last group of a directory to finish performs the directory cleanup for all of them
+	if (isDirectoryComplete && isCanceled == false && finalize)
+	{
+		finalize(folderPath);
+	}
+}
+
+size_t FDepotSyncDirectoryScheduler::GetDirectoryCount() const
+{
+	return m_Directories.size();
+}
+
+size_t FDepotSyncDirectoryScheduler::GetGroupCount() const
+{
+	return m_Groups.size();
+}
+
+const FDepotSyncActionTable::IndexArray& FDepotSyncDirectoryScheduler::GetGroupRowIndices(size_t groupIndex) const
+{
+	return m_Groups[groupIndex].m_RowIndices;
+}
+
+const DepotString& FDepotSyncDirectoryScheduler::GetGroupFolderPath(size_t groupIndex) const
+{
+	return m_Directories[m_Groups[groupIndex].m_DirectoryIndex].m_FolderPath;
+}
+
+DepotString FDepotSyncDirectoryScheduler::GetFolderPath(const DepotString& clientFile)
+{
+	const size_t separator = clientFile.find_last_of("\\/");
+	return separator == DepotString::npos ? DepotString() : clientFile.substr(0, separator);
+}
+
+}}}
@@ -0,0 +1,405 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotSyncJournal.h"
+#include "FileOperations.h"
+#include "SettingManager.h"
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+namespace DepotSyncJournalInternal
+{
+	static const uint32_t Signature = 0x4A563450; // "P4VJ"
+	static const uint32_t Version = 2;
+	static const size_t FlushCompletionInterval = 4096;
+	static const size_t MaxSubActionDepth = 4;
+
+	// Each record is followed by its strings, and then by the records of its sub-actions
+	struct FRecord
+	{
+		uint32_t m_SyncActionType;
+		uint32_t m_SyncActionFlags;
+		int64_t m_FileSize;
+		uint32_t m_DepotFileSize;
+		uint32_t m_ClientFileSize;
+		uint32_t m_RevisionSize;
+		uint32_t m_MessageSize;
+		uint32_t m_SubActionCount;
+		uint32_t m_Reserved;
+	};
+
+	static uint64_t Align8(uint64_t value)
+	{
+		return (value + 7) & ~uint64_t(7);
+	}
+
+	static void AppendRecord(Array<uint8_t>& records, const FDepotSyncActionInfo& modification)
+	{
+		const DepotString revision = FDepotRevision::ToString(modification.m_Revision);
+
+		FRecord record = {};
+		record.m_SyncActionType = uint32_t(modification.m_SyncActionType);
+		record.m_SyncActionFlags = uint32_t(modification.m_SyncActionFlags);
+		record.m_FileSize = modification.m_FileSize;
+		record.m_DepotFileSize = uint32_t(modification.m_DepotFile.size());
+		record.m_ClientFileSize = uint32_t(modification.m_ClientFile.size());
+		record.m_RevisionSize = uint32_t(revision.size());
+		record.m_MessageSize = uint32_t(modification.m_Message.size());
+		record.m_SubActionCount = uint32_t(modification.m_SubActions.size());
+
+		const uint8_t* recordBytes = reinterpret_cast<const uint8_t*>(&record);
+		records.insert(records.end(), recordBytes, recordBytes + sizeof(record));
+		records.insert(records.end(), modification.m_DepotFile.begin(), modification.m_DepotFile.end());
+		records.insert(records.end(), modification.m_ClientFile.begin(), modification.m_ClientFile.end());
+		records.insert(records.end(), revision.begin(), revision.end());
+		records.insert(records.end(), modification.m_Message.begin(), modification.m_Message.end());
+		records.resize(size_t(Align8(records.size())));
+
+		for (const DepotSyncActionInfo& subAction : modification.m_SubActions)
+		{
+			AppendRecord(records, *subAction);
+		}
+	}
+
+	// Reads the record at the offset along with its sub-actions, and advances the offset past them. The modification is
+	// only created when requested, so that completed records are skipped without allocating.
+	static bool ReadRecord(const uint8_t* view, uint64_t fileSize, uint64_t& offset, size_t depth, DepotSyncActionInfo* modification)
+	{
+		if (depth > MaxSubActionDepth || offset + sizeof(FRecord) > fileSize)
+		{
+			return false;
+		}
+
+		const FRecord& record = *reinterpret_cast<const FRecord*>(view + offset);
+		const uint64_t stringsOffset = offset + sizeof(FRecord);
+		const uint64_t stringsSize = uint64_t(record.m_DepotFileSize) + record.m_ClientFileSize + record.m_RevisionSize + record.m_MessageSize;
+		if (stringsOffset + stringsSize > fileSize)
+		{
+			return false;
+		}
+		offset = Align8(stringsOffset + stringsSize);
+
+		if (modification != nullptr)
+		{
+			const char* strings = reinterpret_cast<const char*>(view + stringsOffset);
+			*modification = std::make_shared<FDepotSyncActionInfo>();
+			(*modification)->m_SyncActionType = DepotSyncActionType::Enum(record.m_SyncActionType);
+			(*modification)->m_SyncActionFlags = DepotSyncActionFlags::Enum(record.m_SyncActionFlags);
+			(*modification)->m_FileSize = record.m_FileSize;
+			(*modification)->m_DepotFile.assign(strings, record.m_DepotFileSize);
+			strings += record.m_DepotFileSize;
+			(*modification)->m_ClientFile.assign(strings, record.m_ClientFileSize);
+			strings += record.m_ClientFileSize;
+			(*modification)->m_Revision = FDepotRevision::FromString(DepotString(strings, record.m_RevisionSize));
+			strings += record.m_RevisionSize;
+			(*modification)->m_Message.assign(strings, record.m_MessageSize);
+		}
+
+		for (uint32_t subActionIndex = 0; subActionIndex < record.m_SubActionCount; ++subActionIndex)
+		{
+			DepotSyncActionInfo subAction;
+			if (ReadRecord(view, fileSize, offset, depth + 1, modification != nullptr ? &subAction : nullptr) == false)
+			{
+				return false;
+			}
+			if (modification != nullptr)
+			{
+				(*modification)->m_SubActions.push_back(subAction);
+			}
+		}
+		return true;
+	}
+}
+
+DepotSyncJournal::DepotSyncJournal() :
+	m_View(nullptr),
+	m_ViewSize(0),
+	m_RecordIndices(new Array<size_t>),
+	m_CompleteCount(0),
+	m_UnflushedCount(0)
+{
+}
+
+DepotSyncJournal::~DepotSyncJournal()
+{
+	Close();
+	SafeDeletePointer(m_RecordIndices);
+}
+
+bool DepotSyncJournal::Create(const FileCore::String& filePath, const DepotString& key, const DepotSyncActionInfoArray& modifications)
+{
+	using namespace DepotSyncJournalInternal;
+	Close();
+
+	const size_t recordCount = modifications.get() ? modifications->size() : 0;
+	Array<uint8_t> records;
+	for (size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex)
+	{
+		AppendRecord(records, *modifications->at(recordIndex));
+	}
+
+	FHeader header = {};
+	header.m_Version = Version;
+	header.m_KeyOffset = sizeof(FHeader);
+	header.m_KeySize = key.size();
+	header.m_RecordCount = recordCount;
+	header.m_CompletionOffset = Align8(header.m_KeyOffset + header.m_KeySize);
+	header.m_RecordsOffset = Align8(header.m_CompletionOffset + ((recordCount + 31) / 32) * sizeof(LONG));
+	header.m_FileSize = header.m_RecordsOffset + records.size();
+
+	FileInfo::CreateDirectory(FileInfo::FolderPath(filePath.c_str()).c_str());
+	if (MapFile(filePath, CREATE_ALWAYS, header.m_FileSize) == false)
+	{
+		return false;
+	}
+
+	// The signature is written last, so that a journal interrupted while being created is never opened
+	memcpy(m_View, &header, sizeof(header));
+	memcpy(m_View + header.m_KeyOffset, key.data(), key.size());
+	memcpy(m_View + header.m_RecordsOffset, records.data(), records.size());
+	MemoryBarrier();
+	reinterpret_cast<FHeader*>(m_View)->m_Signature = Signature;
+	FlushViewOfFile(m_View, 0);
+
+	m_RecordIndices->resize(recordCount);
+	for (size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex)
+	{
+		(*m_RecordIndices)[recordIndex] = recordIndex;
+	}
+	return true;
+}
+
+bool DepotSyncJournal::Open(const FileCore::String& filePath, const DepotString& key, DepotSyncActionInfoArray& remainingModifications)
+{
+	using namespace DepotSyncJournalInternal;
+	Close();
+
+	if (FileInfo::Exists(filePath.c_str()) == false || MapFile(filePath, OPEN_EXISTING, 0) == false)
+	{
+		return false;
+	}
+
+	const FHeader& header = *reinterpret_cast<const FHeader*>(m_View);
+	if (m_ViewSize < sizeof(FHeader) ||
+		header.m_Signature != Signature ||
+		header.m_Version != Version ||
+		header.m_FileSize != m_ViewSize ||
+		header.m_KeyOffset + header.m_KeySize > header.m_CompletionOffset ||
+		header.m_CompletionOffset + ((header.m_RecordCount + 31) / 32) * sizeof(LONG) > header.m_RecordsOffset ||
+		header.m_RecordsOffset > header.m_FileSize ||
+		header.m_KeySize != key.size() ||
+		memcmp(m_View + header.m_KeyOffset, key.data(), key.size()) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	DepotSyncActionInfoArray modifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+	Array<size_t> recordIndices;
+	size_t completeCount = 0;
+	uint64_t offset = header.m_RecordsOffset;
+
+	for (size_t recordIndex = 0; recordIndex < header.m_RecordCount; ++recordIndex)
+	{
+		const bool isComplete = IsComplete(recordIndex);
+		DepotSyncActionInfo modification;
+		if (ReadRecord(m_View, header.m_FileSize, offset, 0, isComplete ? nullptr : &modification) == false)
+		{
+			Close();
+			return false;
+		}
+
+		if (isComplete)
+		{
+			++completeCount;
+			continue;
+		}
+
+		recordIndices.push_back(recordIndex);
+		modifications->push_back(modification);
+	}
+
+	m_RecordIndices->swap(recordIndices);
+	m_CompleteCount = completeCount;
+	remainingModifications = modifications;
+	return true;
+}
+
+void DepotSyncJournal::Close()
+{
+	if (m_View != nullptr)
+	{
+		FlushViewOfFile(m_View, 0);
+		UnmapViewOfFile(m_View);
+		m_View = nullptr;
+	}
+
+	m_MappingHandle.Close();
+	m_FileHandle.Close();
+	m_ViewSize = 0;
+	m_RecordIndices->clear();
+	m_CompleteCount = 0;
+	m_UnflushedCount = 0;
+}
+
+void DepotSyncJournal::Flush()
+{
+	if (m_View != nullptr)
+	{
+		m_UnflushedCount = 0;
+		FlushViewOfFile(m_View, 0);
+	}
+}
+
+void DepotSyncJournal::MarkComplete(size_t modificationIndex)
+{
+	if (m_View == nullptr || modificationIndex >= m_RecordIndices->size())
+	{
+		return;
+	}
+
+	const size_t recordIndex = (*m_RecordIndices)[modificationIndex];
+	const LONG bit = LONG(1) << (recordIndex % 32);
+	if ((InterlockedOr(&CompletionWords()[recordIndex / 32], bit) & bit) == 0)
+	{
+		m_CompleteCount++;
+		if (++m_UnflushedCount >= DepotSyncJournalInternal::FlushCompletionInterval)
+		{
+			Flush();
+		}
+	}
+}
+
+bool DepotSyncJournal::IsComplete(size_t recordIndex) const
+{
+	if (m_View == nullptr || recordIndex >= GetRecordCount())
+	{
+		return false;
+	}
+	return (CompletionWords()[recordIndex / 32] & (LONG(1) << (recordIndex % 32))) != 0;
+}
+
+bool DepotSyncJournal::IsOpen() const
+{
+	return m_View != nullptr;
+}
+
+size_t DepotSyncJournal::GetRecordCount() const
+{
+	return m_View ? size_t(reinterpret_cast<const FHeader*>(m_View)->m_RecordCount) : 0;
+}
+
+size_t DepotSyncJournal::GetCompleteCount() const
+{
+	return m_CompleteCount;
+}
+
+const FileCore::String& DepotSyncJournal::GetFilePath() const
+{
+	return m_FilePath;
+}
+
+bool DepotSyncJournal::MapFile(const FileCore::String& filePath, DWORD creationDisposition, uint64_t fileSize)
+{
+	m_FilePath = filePath;
+	m_FileHandle.Reset(CreateFile(filePath.c_str(), GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ, NULL, creationDisposition, FILE_ATTRIBUTE_NORMAL, NULL));
+	if (m_FileHandle.IsValid() == false)
+	{
+		return false;
+	}
+
+	if (creationDisposition == OPEN_EXISTING)
+	{
+		LARGE_INTEGER existingFileSize = {};
+		if (GetFileSizeEx(m_FileHandle.Handle(), &existingFileSize) == FALSE || existingFileSize.QuadPart < LONGLONG(sizeof(FHeader)))
+		{
+			Close();
+			return false;
+		}
+		fileSize = uint64_t(existingFileSize.QuadPart);
+	}
+
+	m_MappingHandle.Reset(CreateFileMapping(m_FileHandle.Handle(), NULL, PAGE_READWRITE, DWORD(fileSize >> 32), DWORD(fileSize), NULL));
+	if (m_MappingHandle.IsValid() == false)
+	{
+		Close();
+		return false;
+	}
+
+	m_View = reinterpret_cast<uint8_t*>(MapViewOfFile(m_MappingHandle.Handle(), FILE_MAP_READ|FILE_MAP_WRITE, 0, 0, 0));
+	if (m_View == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_ViewSize = fileSize;
+	return true;
+}
+
+volatile LONG* DepotSyncJournal::CompletionWords() const
+{
+	return reinterpret_cast<volatile LONG*>(m_View + reinterpret_cast<const FHeader*>(m_View)->m_CompletionOffset);
+}
+
+DepotString DepotSyncJournal::CreateKey(DepotClient& depotClient, const FDepotSyncOptions& syncOptions, const DepotRevision& revision)
+{
+	const DepotConfig& config = depotClient->Config();
+	return StringInfo::Join(DepotStringArray{
+		config.m_Port,
+		config.m_User,
+		config.m_Client,
+		FDepotRevision::ToString(revision),
+		DepotSyncFlags::ToString(syncOptions.m_SyncFlags),
+		DepotFlushType::ToString(syncOptions.m_FlushType),
+		syncOptions.m_SyncResident,
+		StringInfo::Join(syncOptions.m_Files, "\n"),
+		}, "\n");
+}
+
+FileCore::String DepotSyncJournal::GetJournalDirectory(DepotClient& depotClient)
+{
+	const FileCore::String journalDirectory = FileCore::SettingManager::StaticInstance().SyncJournalDirectory.GetValue();
+	if (journalDirectory.empty())
+	{
+		return FileCore::String();
+	}
+	return FileInfo::FullPath(FileOperations::GetImpersonatedEnvironmentStrings(journalDirectory.c_str(), depotClient->GetUserContext()).c_str());
+}
+
+FileCore::String DepotSyncJournal::GetJournalFilePath(DepotClient& depotClient, const DepotString& key)
+{
+	const FileCore::String journalDirectory = GetJournalDirectory(depotClient);
+	if (journalDirectory.empty())
+	{
+		return FileCore::String();
+	}
+
+	const DepotString clientId = StringInfo::ToLower(StringInfo::Format("%s\n%s", depotClient->Config().m_Port.c_str(), depotClient->Config().m_Client.c_str()).c_str());
+	return StringInfo::Format(L"%s\\%016I64x.%016I64x.journal", journalDirectory.c_str(), StringInfo::HashMd5(clientId.data(), clientId.size()), StringInfo::HashMd5(key.data(), key.size()));
+}
+
+void DepotSyncJournal::DeleteClientJournals(DepotClient& depotClient, const FileCore::String& keepFilePath)
+{
+	const FileCore::String journalDirectory = GetJournalDirectory(depotClient);
+	if (journalDirectory.empty())
+	{
+		return;
+	}
+
+	// Journals of this client for any other sync are stale once the client has been synced again
+	const FileCore::String clientPattern = FileInfo::FileName(GetJournalFilePath(depotClient, DepotString()).c_str()).substr(0, 17) + L"*.journal";
+	StringArray journalFiles;
+	FileInfo::FindFiles(journalFiles, journalDirectory.c_str(), clientPattern.c_str());
+	for (const FileCore::String& journalFile : journalFiles)
+	{
+		if (StringInfo::Stricmp(journalFile.c_str(), keepFilePath.c_str()) != 0)
+		{
+			FileInfo::Delete(journalFile.c_str());
+		}
+	}
+}
+
+}}}
@@ -0,0 +1,355 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotTelemetry.h"
+#include "SettingManager.h"
+#include <atomic>
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+namespace DepotTelemetryInternal {
+
+	static const size_t CommandSlotCount = 64;
+	static const char* const OverflowName = "*";
+
+	struct FCommandCounters
+	{
+		FCommandCounters() :
+			m_Name(nullptr)
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			m_Count.store(0, std::memory_order_relaxed);
+			m_ErrorCount.store(0, std::memory_order_relaxed);
+			m_ArgCount.store(0, std::memory_order_relaxed);
+			m_RecordCount.store(0, std::memory_order_relaxed);
+			m_ByteCount.store(0, std::memory_order_relaxed);
+			m_TotalUs.store(0, std::memory_order_relaxed);
+			m_ClientUs.store(0, std::memory_order_relaxed);
+			m_MaxUs.store(0, std::memory_order_relaxed);
+			for (std::atomic<uint64_t>& bucket : m_Histogram)
+			{
+				bucket.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		std::atomic<const char*> m_Name;
+		std::atomic<uint64_t> m_Count;
+		std::atomic<uint64_t> m_ErrorCount;
+		std::atomic<uint64_t> m_ArgCount;
+		std::atomic<uint64_t> m_RecordCount;
+		std::atomic<uint64_t> m_ByteCount;
+		std::atomic<uint64_t> m_TotalUs;
+		std::atomic<uint64_t> m_ClientUs;
+		std::atomic<uint64_t> m_MaxUs;
+		std::atomic<uint64_t> m_Histogram[FDepotCommandStats::HistogramBucketCount];
+	};
+
+	// The counters of one thread. Only the owning thread adds to them, and other threads only read them, so
+	// no lock is taken when a sample is recorded. The last slot takes the commands of any names beyond the rest.
+	struct FThreadCounters
+	{
+		FThreadCounters() :
+			m_InUse(false)
+		{}
+
+		FCommandCounters& Find(const char* name);
+
+		std::atomic<bool> m_InUse;
+		FCommandCounters m_Commands[CommandSlotCount];
+	};
+
+	struct FTelemetryState
+	{
+		const char* Intern(const char* name)
+		{
+			AutoCriticalSection lock(m_Lock);
+			return m_Names.insert(DepotString(name ? name : "")).first->c_str();
+		}
+
+		FThreadCounters* Acquire()
+		{
+			AutoCriticalSection lock(m_Lock);
+			for (FThreadCounters& counters : m_Threads)
+			{
+				if (counters.m_InUse.load(std::memory_order_relaxed) == false)
+				{
+					counters.m_InUse.store(true, std::memory_order_relaxed);
+					return &counters;
+				}
+			}
+			m_Threads.emplace_back();
+			m_Threads.back().m_InUse.store(true, std::memory_order_relaxed);
+			return &m_Threads.back();
+		}
+
+		void Release(FThreadCounters* counters)
+		{
+			AutoCriticalSection lock(m_Lock);
+			counters->m_InUse.store(false, std::memory_order_relaxed);
+		}
+
+		static FTelemetryState& StaticInstance()
+		{
+			static FTelemetryState state;
+			return state;
+		}
+
+		CriticalSection m_Lock;
+		List<FThreadCounters> m_Threads;
+		Set<DepotString> m_Names;
+	};
+
+	// Releases the counters of a thread when it exits, so that they can be reused by a later thread
+	struct FThreadSlot
+	{
+		FThreadSlot() :
+			m_Counters(nullptr)
+		{}
+
+		~FThreadSlot()
+		{
+			if (m_Counters != nullptr)
+			{
+				FTelemetryState::StaticInstance().Release(m_Counters);
+			}
+		}
+
+		FThreadCounters& Get()
+		{
+			if (m_Counters == nullptr)
+			{
+				m_Counters = FTelemetryState::StaticInstance().Acquire();
+			}
+			return *m_Counters;
+		}
+
+		FThreadCounters* m_Counters;
+	};
+
+	static thread_local FThreadSlot ThreadSlot;
+
+	FCommandCounters& FThreadCounters::Find(const char* name)
+	{
+		if (name == nullptr)
+		{
+			name = "";
+		}
+		for (size_t slotIndex = 0; slotIndex < CommandSlotCount-1; ++slotIndex)
+		{
+			FCommandCounters& counters = m_Commands[slotIndex];
+			const char* slotName = counters.m_Name.load(std::memory_order_relaxed);
+			if (slotName == nullptr)
+			{
+				counters.m_Name.store(FTelemetryState::StaticInstance().Intern(name), std::memory_order_release);
+				return counters;
+			}
+			if (strcmp(slotName, name) == 0)
+			{
+				return counters;
+			}
+		}
+
+		FCommandCounters& overflow = m_Commands[CommandSlotCount-1];
+		if (overflow.m_Name.load(std::memory_order_relaxed) == nullptr)
+		{
+			overflow.m_Name.store(OverflowName, std::memory_order_release);
+		}
+		return overflow;
+	}
+}
+
+using namespace DepotTelemetryInternal;
+
+bool DepotTelemetry::IsEnabled()
+{
+	return FileCore::SettingManager::StaticInstance().DepotClientTelemetry.GetValue();
+}
+
+void DepotTelemetry::Record(const FDepotCommandSample& sample)
+{
+	const uint64_t totalUs = uint64_t(std::max<int64_t>(0, sample.m_TotalUs));
+	const uint64_t clientUs = std::min<uint64_t>(totalUs, uint64_t(std::max<int64_t>(0, sample.m_ClientUs)));
+
+	FCommandCounters& counters = ThreadSlot.Get().Find(sample.m_Name);
+	counters.m_Count.fetch_add(1, std::memory_order_relaxed);
+	counters.m_ErrorCount.fetch_add(sample.m_ErrorCount, std::memory_order_relaxed);
+	counters.m_ArgCount.fetch_add(sample.m_ArgCount, std::memory_order_relaxed);
+	counters.m_RecordCount.fetch_add(sample.m_RecordCount, std::memory_order_relaxed);
+	counters.m_ByteCount.fetch_add(sample.m_ByteCount, std::memory_order_relaxed);
+	counters.m_TotalUs.fetch_add(totalUs, std::memory_order_relaxed);
+	counters.m_ClientUs.fetch_add(clientUs, std::memory_order_relaxed);
+	counters.m_Histogram[GetHistogramBucket(int64_t(totalUs))].fetch_add(1, std::memory_order_relaxed);
+	if (totalUs > counters.m_MaxUs.load(std::memory_order_relaxed))
+	{
+		counters.m_MaxUs.store(totalUs, std::memory_order_relaxed);
+	}
+}
+
+DepotCommandStatsArray DepotTelemetry::GetStats()
+{
+	Map<DepotString, FDepotCommandStats, DepotStringLess> statsMap;
+	FTelemetryState& state = FTelemetryState::StaticInstance();
+	AutoCriticalSection lock(state.m_Lock);
+
+	for (const FThreadCounters& thread : state.m_Threads)
+	{
+		for (const FCommandCounters& counters : thread.m_Commands)
+		{
+			const char* name = counters.m_Name.load(std::memory_order_acquire);
+			if (name == nullptr)
+			{
+				break;
+			}
+			const uint64_t count = counters.m_Count.load(std::memory_order_relaxed);
+			if (count == 0)
+			{
+				continue;
+			}
+
+			FDepotCommandStats& stats = statsMap[name];
+			stats.m_Name = name;
+			stats.m_Count += count;
+			stats.m_ErrorCount += counters.m_ErrorCount.load(std::memory_order_relaxed);
+			stats.m_ArgCount += counters.m_ArgCount.load(std::memory_order_relaxed);
+			stats.m_RecordCount += counters.m_RecordCount.load(std::memory_order_relaxed);
+			stats.m_ByteCount += counters.m_ByteCount.load(std::memory_order_relaxed);
+			stats.m_TotalUs += counters.m_TotalUs.load(std::memory_order_relaxed);
+			stats.m_ClientUs += counters.m_ClientUs.load(std::memory_order_relaxed);
+			stats.m_MaxUs = std::max(stats.m_MaxUs, counters.m_MaxUs.load(std::memory_order_relaxed));
+			for (size_t bucketIndex = 0; bucketIndex < FDepotCommandStats::HistogramBucketCount; ++bucketIndex)
+			{
+				stats.m_Histogram[bucketIndex] += counters.m_Histogram[bucketIndex].load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	DepotCommandStatsArray result;
+	result.reserve(statsMap.size());
+	for (Map<DepotString, FDepotCommandStats, DepotStringLess>::value_type& statsPair : statsMap)
+	{
+		FDepotCommandStats& stats = statsPair.second;
+		stats.m_ClientUs = std::min(stats.m_ClientUs, stats.m_TotalUs);
+		stats.m_ServerUs = stats.m_TotalUs - stats.m_ClientUs;
+		result.push_back(stats);
+	}
+	return result;
+}
+
+void DepotTelemetry::Reset()
+{
+	// Samples recorded by other threads while resetting may be partly kept
+	FTelemetryState& state = FTelemetryState::StaticInstance();
+	AutoCriticalSection lock(state.m_Lock);
+	for (FThreadCounters& thread : state.m_Threads)
+	{
+		for (FCommandCounters& counters : thread.m_Commands)
+		{
+			counters.Reset();
+		}
+	}
+}
+
+DepotCommandStatsArray DepotTelemetry::Subtract(const DepotCommandStatsArray& stats, const DepotCommandStatsArray& baseline)
+{
+	auto subtract = [](uint64_t value, uint64_t base) -> uint64_t
+	{
+		return value > base ? value - base : 0;
+	};
+
+	DepotCommandStatsArray result;
+	for (const FDepotCommandStats& current : stats)
+	{
+		DepotCommandStatsArray::const_iterator baseIt = std::find_if(baseline.begin(), baseline.end(), [&current](const FDepotCommandStats& s) { return s.m_Name == current.m_Name; });
+		if (baseIt == baseline.end())
+		{
+			result.push_back(current);
+			continue;
+		}
+
+		FDepotCommandStats diff = current;
+		diff.m_Count = subtract(current.m_Count, baseIt->m_Count);
+		if (diff.m_Count == 0)
+		{
+			continue;
+		}
+		diff.m_ErrorCount = subtract(current.m_ErrorCount, baseIt->m_ErrorCount);
+		diff.m_ArgCount = subtract(current.m_ArgCount, baseIt->m_ArgCount);
+		diff.m_RecordCount = subtract(current.m_RecordCount, baseIt->m_RecordCount);
+		diff.m_ByteCount = subtract(current.m_ByteCount, baseIt->m_ByteCount);
+		diff.m_TotalUs = subtract(current.m_TotalUs, baseIt->m_TotalUs);
+		diff.m_ClientUs = std::min(diff.m_TotalUs, subtract(current.m_ClientUs, baseIt->m_ClientUs));
+		diff.m_ServerUs = diff.m_TotalUs - diff.m_ClientUs;
+		for (size_t bucketIndex = 0; bucketIndex < FDepotCommandStats::HistogramBucketCount; ++bucketIndex)
+		{
+			diff.m_Histogram[bucketIndex] = subtract(current.m_Histogram[bucketIndex], baseIt->m_Histogram[bucketIndex]);
+		}
+		result.push_back(diff);
+	}
+	return result;
+}
+
+DepotString DepotTelemetry::ToJson(const DepotCommandStatsArray& stats)
+{
+	DepotString json = "{\"commands\":[";
+	for (size_t statsIndex = 0; statsIndex < stats.size(); ++statsIndex)
+	{
+		const FDepotCommandStats& s = stats[statsIndex];
+		DepotString name;
+		for (char c : s.m_Name)
+		{
+			if (c == '"' || c == '\\')
+			{
+				name += '\\';
+			}
+			if (uint8_t(c) >= 0x20)
+			{
+				name += c;
+			}
+		}
+
+		json += StringInfo::Format("%s{\"name\":\"%s\",\"count\":%I64u,\"errors\":%I64u,\"args\":%I64u,\"records\":%I64u,\"bytes\":%I64u,\"totalUs\":%I64u,\"serverUs\":%I64u,\"clientUs\":%I64u,\"maxUs\":%I64u,\"histogram\":[",
+			statsIndex ? "," : "",
+			name.c_str(),
+			s.m_Count,
+			s.m_ErrorCount,
+			s.m_ArgCount,
+			s.m_RecordCount,
+			s.m_ByteCount,
+			s.m_TotalUs,
+			s.m_ServerUs,
+			s.m_ClientUs,
+			s.m_MaxUs);
+
+		// Trailing empty buckets are left out
+		size_t bucketCount = s.m_Histogram.size();
+		while (bucketCount > 0 && s.m_Histogram[bucketCount-1] == 0)
+		{
+			bucketCount--;
+		}
+		for (size_t bucketIndex = 0; bucketIndex < bucketCount; ++bucketIndex)
+		{
+			json += StringInfo::Format("%s%I64u", bucketIndex ? "," : "", s.m_Histogram[bucketIndex]);
+		}
+		json += "]}";
+	}
+	json += "]}";
+	return json;
+}
+
+size_t DepotTelemetry::GetHistogramBucket(int64_t timeUs)
+{
+	size_t bucket = 0;
+	for (uint64_t value = uint64_t(std::max<int64_t>(0, timeUs)); value != 0; value >>= 1)
+	{
+		bucket++;
+	}
+	return std::min(bucket, FDepotCommandStats::HistogramBucketCount-1);
+}
+
+}}}
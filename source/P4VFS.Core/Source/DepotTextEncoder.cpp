@@ -0,0 +1,169 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "DepotTextEncoder.h"
+#include <intrin.h>
+#include <immintrin.h>
+
+namespace Microsoft {
+namespace P4VFS {
+namespace P4 {
+
+namespace DepotTextLineEndInternal {
+
+	template <typename CharType>
+	size_t InsertCrScalar(const CharType* src, size_t srcNum, CharType* dst)
+	{
+		CharType* out = dst;
+		for (size_t srcIndex = 0; srcIndex < srcNum; ++srcIndex)
+		{
+			const CharType c = src[srcIndex];
+			if (c == LITERAL(CharType, '\n'))
+				*out++ = LITERAL(CharType, '\r');
+			*out++ = c;
+		}
+		return size_t(out - dst);
+	}
+
+	// Copies a block of blockNum characters given the byte mask of its line feeds, which has a bit set for each byte of
+	// every line feed character
+	template <typename CharType>
+	CharType* InsertCrBlock(const CharType* src, size_t blockNum, uint32_t mask, CharType* dst)
+	{
+		const uint32_t charMask = (1u << sizeof(CharType)) - 1;
+		size_t runStart = 0;
+		while (mask != 0)
+		{
+			unsigned long bitIndex = 0;
+			_BitScanForward(&bitIndex, mask);
+			mask &= ~(charMask << bitIndex);
+
+			const size_t lfIndex = size_t(bitIndex) / sizeof(CharType);
+			memcpy(dst, src + runStart, (lfIndex - runStart) * sizeof(CharType));
+			dst += lfIndex - runStart;
+			*dst++ = LITERAL(CharType, '\r');
+			*dst++ = LITERAL(CharType, '\n');
+			runStart = lfIndex + 1;
+		}
+
+		memcpy(dst, src + runStart, (blockNum - runStart) * sizeof(CharType));
+		return dst + (blockNum - runStart);
+	}
+
+	inline __m128i MatchLf(const __m128i& block, const char*)		{ return _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')); }
+	inline __m128i MatchLf(const __m128i& block, const wchar_t*)	{ return _mm_cmpeq_epi16(block, _mm_set1_epi16(L'\n')); }
+	inline __m256i MatchLf(const __m256i& block, const char*)		{ return _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')); }
+	inline __m256i MatchLf(const __m256i& block, const wchar_t*)	{ return _mm256_cmpeq_epi16(block, _mm256_set1_epi16(L'\n')); }
+
+	template <typename CharType>
+	size_t InsertCrSse2(const CharType* src, size_t srcNum, CharType* dst)
+	{
+		constexpr size_t blockNum = sizeof(__m128i) / sizeof(CharType);
+		CharType* out = dst;
+		size_t srcIndex = 0;
+		for (; srcIndex + blockNum <= srcNum; srcIndex += blockNum)
+		{
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + srcIndex));
+			const uint32_t mask = uint32_t(_mm_movemask_epi8(MatchLf(block, src)));
+			if (mask == 0)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), block);
+				out += blockNum;
+			}
+			else
+			{
+				out = InsertCrBlock(src + srcIndex, blockNum, mask, out);
+			}
+		}
+		return size_t(out - dst) + InsertCrScalar(src + srcIndex, srcNum - srcIndex, out);
+	}
+
+	template <typename CharType>
+	size_t InsertCrAvx2(const CharType* src, size_t srcNum, CharType* dst)
+	{
+		constexpr size_t blockNum = sizeof(__m256i) / sizeof(CharType);
+		CharType* out = dst;
+		size_t srcIndex = 0;
+		for (; srcIndex + blockNum <= srcNum; srcIndex += blockNum)
+		{
+			const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + srcIndex));
+			const uint32_t mask = uint32_t(_mm256_movemask_epi8(MatchLf(block, src)));
+			if (mask == 0)
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), block);
+				out += blockNum;
+			}
+			else
+			{
+				out = InsertCrBlock(src + srcIndex, blockNum, mask, out);
+			}
+		}
+		_mm256_zeroupper();
+		return size_t(out - dst) + InsertCrScalar(src + srcIndex, srcNum - srcIndex, out);
+	}
+
+	template <typename CharType>
+	size_t InsertCr(const CharType* src, size_t srcNum, CharType* dst, DepotTextLineEnd::Method::Enum method)
+	{
+		if (src == nullptr || dst == nullptr || srcNum == 0)
+			return 0;
+
+		switch (method)
+		{
+			case DepotTextLineEnd::Method::Avx2:
+				if (DepotTextLineEnd::IsMethodSupported(method))
+					return InsertCrAvx2(src, srcNum, dst);
+				return InsertCrSse2(src, srcNum, dst);
+			case DepotTextLineEnd::Method::Sse2:
+				return InsertCrSse2(src, srcNum, dst);
+		}
+		return InsertCrScalar(src, srcNum, dst);
+	}
+
+	bool IsAvx2Supported()
+	{
+		int32_t cpuInfo[4] = {};
+		__cpuid(cpuInfo, 0);
+		if (cpuInfo[0] < 7)
+			return false;
+
+		// AVX2 also needs the operating system to save the upper halves of the registers
+		__cpuid(cpuInfo, 1);
+		const int32_t osxsaveAvx = (1<<27)|(1<<28);
+		if ((cpuInfo[2] & osxsaveAvx) != osxsaveAvx)
+			return false;
+		if ((_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(cpuInfo, 7, 0);
+		return (cpuInfo[1] & (1<<5)) != 0;
+	}
+}
+
+size_t DepotTextLineEnd::InsertCr(const char* src, size_t srcNum, char* dst, Method::Enum method)
+{
+	return DepotTextLineEndInternal::InsertCr(src, srcNum, dst, method);
+}
+
+size_t DepotTextLineEnd::InsertCr(const wchar_t* src, size_t srcNum, wchar_t* dst, Method::Enum method)
+{
+	return DepotTextLineEndInternal::InsertCr(src, srcNum, dst, method);
+}
+
+DepotTextLineEnd::Method::Enum DepotTextLineEnd::GetDefaultMethod()
+{
+	static const Method::Enum method = IsMethodSupported(Method::Avx2) ? Method::Avx2 : Method::Sse2;
+	return method;
+}
+
+bool DepotTextLineEnd::IsMethodSupported(Method::Enum method)
+{
+	if (method == Method::Avx2)
+	{
+		static const bool isAvx2Supported = DepotTextLineEndInternal::IsAvx2Supported();
+		return isAvx2Supported;
+	}
+	return true;
+}
+
+}}}
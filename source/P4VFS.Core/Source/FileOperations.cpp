@@ -642,14 +642,15 @@ InstallReparsePointOnFile(
 		return hr;
 	}
 
-	// Setup reparse point
+	// Setup reparse point, populated from the share if one is configured when the placeholder is created
+	const BYTE populatePolicy = FileCore::SettingManager::StaticInstance().PopulateShareDirectory.GetValue().empty() ? P4VFS_POPULATE_POLICY_DEPOT : P4VFS_POPULATE_POLICY_SHARE;
 	hr = SetReparsePointOnHandle(
 				hFile.Handle(), 
 				majorVersion,
 				minorVersion,
 				buildversion,
 				residencyPolicy, 
-				P4VFS_POPULATE_POLICY_DEPOT, 
+				populatePolicy, 
 				fileRevision,
 				fileSize,
 				depotPath,
@@ -0,0 +1,441 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "FilePrefetchPredictor.h"
+#include <deque>
+
+namespace Microsoft {
+namespace P4VFS {
+namespace FileSystem {
+
+using namespace FileCore;
+
+namespace FilePrefetchPredictorInternal {
+
+	struct Link
+	{
+		String m_Key;
+		uint32_t m_Count;
+	};
+
+	struct Node
+	{
+		String m_FilePath;
+		Array<Link> m_Links;
+		uint64_t m_UsedSerial;
+	};
+
+	struct Access
+	{
+		String m_Key;
+		String m_FolderKey;
+		int64_t m_TimeMs;
+	};
+
+	typedef HashMap<String, Node> NodeMap;
+
+	String CreateKey(const String& filePath)
+	{
+		return StringInfo::ToLower(filePath.c_str());
+	}
+
+	bool ParseInt64(const AString& text, int64_t& value)
+	{
+		char* end = nullptr;
+		value = _strtoi64(text.c_str(), &end, 10);
+		return text.empty() == false && end != nullptr && *end == '\0';
+	}
+}
+
+using namespace FilePrefetchPredictorInternal;
+
+struct FilePrefetchPredictor::Model
+{
+	Model(const FFilePrefetchPredictorOptions& options) :
+		m_Options(options),
+		m_Serial(0)
+	{}
+
+	Node& Touch(const String& key, const String& filePath)
+	{
+		Node& node = m_Nodes[key];
+		if (node.m_FilePath.empty())
+		{
+			node.m_FilePath = filePath;
+		}
+		node.m_UsedSerial = ++m_Serial;
+		return node;
+	}
+
+	void AddLink(Node& node, const String& key, uint32_t count)
+	{
+		for (Link& link : node.m_Links)
+		{
+			if (link.m_Key == key)
+			{
+				link.m_Count += count;
+				return;
+			}
+		}
+
+		if (node.m_Links.size() < m_Options.m_MaxLinks)
+		{
+			node.m_Links.push_back(Link{ key, count });
+			return;
+		}
+
+		if (node.m_Links.size())
+		{
+			Link& leastLink = *std::min_element(node.m_Links.begin(), node.m_Links.end(), [](const Link& a, const Link& b) -> bool { return a.m_Count < b.m_Count; });
+			leastLink = Link{ key, count };
+		}
+	}
+
+	// Evicts the least recently used files down to three quarters of the limit, so that it is not done on every access
+	void Trim()
+	{
+		if (m_Nodes.size() <= m_Options.m_MaxNodes)
+		{
+			return;
+		}
+
+		Array<uint64_t> serials;
+		serials.reserve(m_Nodes.size());
+		for (const NodeMap::value_type& node : m_Nodes)
+		{
+			serials.push_back(node.second.m_UsedSerial);
+		}
+
+		const size_t evictCount = m_Nodes.size() - (m_Options.m_MaxNodes * 3) / 4;
+		std::nth_element(serials.begin(), serials.begin() + (evictCount - 1), serials.end());
+		const uint64_t evictSerial = serials[evictCount - 1];
+		for (NodeMap::iterator nodeIt = m_Nodes.begin(); nodeIt != m_Nodes.end();)
+		{
+			if (nodeIt->second.m_UsedSerial <= evictSerial)
+				nodeIt = m_Nodes.erase(nodeIt);
+			else
+				++nodeIt;
+		}
+	}
+
+	void TrimWindow(int64_t timeMs)
+	{
+		while (m_Window.size() && (m_Window.front().m_TimeMs + m_Options.m_WindowMs < timeMs || m_Window.size() > m_Options.m_WindowMaxFiles))
+		{
+			m_Window.pop_front();
+		}
+	}
+
+	FFilePrefetchPredictorOptions m_Options;
+	NodeMap m_Nodes;
+	std::deque<Access> m_Window;
+	uint64_t m_Serial;
+};
+
+FilePrefetchPredictor::FilePrefetchPredictor(const FFilePrefetchPredictorOptions& options) :
+	m_Model(new Model(options))
+{
+}
+
+FilePrefetchPredictor::~FilePrefetchPredictor()
+{
+	delete m_Model;
+	m_Model = nullptr;
+}
+
+void FilePrefetchPredictor::Observe(const String& filePath, int64_t timeMs)
+{
+	if (filePath.empty())
+	{
+		return;
+	}
+
+	const String key = CreateKey(filePath);
+	AutoCriticalSection lock(m_Lock);
+
+	m_Model->m_Window.erase(std::remove_if(m_Model->m_Window.begin(), m_Model->m_Window.end(), [&key](const Access& access) -> bool { return access.m_Key == key; }), m_Model->m_Window.end());
+	m_Model->TrimWindow(timeMs);
+
+	Node& node = m_Model->Touch(key, filePath);
+	node.m_FilePath = filePath;
+	for (const Access& access : m_Model->m_Window)
+	{
+		NodeMap::iterator fromNode = m_Model->m_Nodes.find(access.m_Key);
+		if (fromNode != m_Model->m_Nodes.end())
+		{
+			m_Model->AddLink(fromNode->second, key, 1);
+		}
+	}
+
+	m_Model->m_Window.push_back(Access{ key, CreateKey(FileInfo::FolderPath(filePath.c_str())), timeMs });
+	m_Model->TrimWindow(timeMs);
+	m_Model->Trim();
+}
+
+FFilePrefetchPrediction FilePrefetchPredictor::Predict(const String& filePath, int64_t timeMs) const
+{
+	FFilePrefetchPrediction prediction;
+	const String key = CreateKey(filePath);
+	AutoCriticalSection lock(m_Lock);
+
+	NodeMap::const_iterator node = m_Model->m_Nodes.find(key);
+	if (node != m_Model->m_Nodes.end())
+	{
+		Array<Link> links = node->second.m_Links;
+		std::stable_sort(links.begin(), links.end(), [](const Link& a, const Link& b) -> bool { return a.m_Count > b.m_Count; });
+		for (const Link& link : links)
+		{
+			if (link.m_Count < m_Model->m_Options.m_MinLinkCount)
+			{
+				break;
+			}
+
+			NodeMap::const_iterator linkNode = m_Model->m_Nodes.find(link.m_Key);
+			if (linkNode != m_Model->m_Nodes.end())
+			{
+				prediction.m_FilePaths.push_back(linkNode->second.m_FilePath);
+			}
+		}
+	}
+
+	const String folderKey = CreateKey(FileInfo::FolderPath(filePath.c_str()));
+	size_t folderFileCount = 0;
+	for (const Access& access : m_Model->m_Window)
+	{
+		if (access.m_TimeMs + m_Model->m_Options.m_WindowMs >= timeMs && access.m_FolderKey == folderKey)
+		{
+			++folderFileCount;
+		}
+	}
+
+	prediction.m_IsDirectoryAccess = folderFileCount >= m_Model->m_Options.m_DirectoryMinFiles;
+	return prediction;
+}
+
+void FilePrefetchPredictor::Clear()
+{
+	AutoCriticalSection lock(m_Lock);
+	m_Model->m_Nodes.clear();
+	m_Model->m_Window.clear();
+}
+
+size_t FilePrefetchPredictor::GetFileCount() const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_Model->m_Nodes.size();
+}
+
+size_t FilePrefetchPredictor::GetLinkCount() const
+{
+	AutoCriticalSection lock(m_Lock);
+	size_t linkCount = 0;
+	for (const NodeMap::value_type& node : m_Model->m_Nodes)
+	{
+		linkCount += node.second.m_Links.size();
+	}
+	return linkCount;
+}
+
+bool FilePrefetchPredictor::Save(const String& filePath) const
+{
+	if (filePath.empty() || FileInfo::CreateFileDirectory(filePath.c_str()) == false)
+	{
+		return false;
+	}
+
+	// The history is written beside the file and renamed over it, so that it is never left partly written
+	const String tempFilePath = filePath + L".tmp";
+	{
+		AutoCrtFile file = _wfopen(tempFilePath.c_str(), L"wb");
+		if (file.IsValid() == false)
+		{
+			return false;
+		}
+
+		AutoCriticalSection lock(m_Lock);
+		for (const NodeMap::value_type& node : m_Model->m_Nodes)
+		{
+			for (const Link& link : node.second.m_Links)
+			{
+				NodeMap::const_iterator linkNode = m_Model->m_Nodes.find(link.m_Key);
+				if (linkNode != m_Model->m_Nodes.end())
+				{
+					fprintf(file.Get(), "%u\t%s\t%s\n", link.m_Count, CSTR_WTOA(node.second.m_FilePath), CSTR_WTOA(linkNode->second.m_FilePath));
+				}
+			}
+		}
+
+		if (ferror(file.Get()))
+		{
+			return false;
+		}
+	}
+
+	return MoveFileEx(tempFilePath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
+
+bool FilePrefetchPredictor::Load(const String& filePath)
+{
+	Clear();
+	AutoCriticalSection lock(m_Lock);
+	return FileInfo::ReadFileLines(filePath.c_str(), [this](const AString& line) -> bool
+	{
+		const AStringArray fields = StringInfo::Split(line.c_str(), "\t", StringInfo::SplitFlags::None);
+		int64_t count = 0;
+		if (fields.size() == 3 && ParseInt64(fields[0], count) && count > 0 && fields[1].size() && fields[2].size())
+		{
+			const String fromPath = StringInfo::ToWide(fields[1]);
+			const String toPath = StringInfo::ToWide(fields[2]);
+			const String toKey = CreateKey(toPath);
+			m_Model->Touch(toKey, toPath);
+			m_Model->AddLink(m_Model->Touch(CreateKey(fromPath), fromPath), toKey, uint32_t(std::min<int64_t>(count, UINT32_MAX)));
+			m_Model->Trim();
+		}
+		return true;
+	});
+}
+
+FFilePrefetchReplayStats FilePrefetchPredictor::Replay(const Array<FFilePrefetchTraceEntry>& trace, const FFilePrefetchReplayOptions& options)
+{
+	// The placeholders of each folder are approximated by the files of that folder in the trace
+	HashMap<String, int64_t> fileSizes;
+	HashMap<String, StringArray> folderFiles;
+	for (const Array<FFilePrefetchTraceEntry>* entries : { &trace, &options.m_Placeholders })
+	{
+		for (const FFilePrefetchTraceEntry& entry : *entries)
+		{
+			const String key = CreateKey(entry.m_FilePath);
+			if (fileSizes.insert(std::make_pair(key, entry.m_FileSize)).second)
+			{
+				folderFiles[CreateKey(FileInfo::FolderPath(entry.m_FilePath.c_str()))].push_back(entry.m_FilePath);
+			}
+		}
+	}
+
+	FFilePrefetchReplayStats stats;
+	HashSet<String> residentFiles;
+	HashSet<String> prefetchedFiles;
+
+	for (const FFilePrefetchTraceEntry& entry : trace)
+	{
+		const String key = CreateKey(entry.m_FilePath);
+		const int64_t fileSize = std::max<int64_t>(0, fileSizes[key]);
+		if (prefetchedFiles.erase(key))
+		{
+			stats.m_RequestCount++;
+			stats.m_RequestBytes += fileSize;
+			stats.m_HitCount++;
+			stats.m_HitBytes += fileSize;
+			continue;
+		}
+		if (residentFiles.insert(key).second == false)
+		{
+			continue;
+		}
+
+		stats.m_RequestCount++;
+		stats.m_RequestBytes += fileSize;
+		Observe(entry.m_FilePath, entry.m_TimeMs);
+
+		const FFilePrefetchPrediction prediction = Predict(entry.m_FilePath, entry.m_TimeMs);
+		StringArray candidates;
+		if (options.m_CoAccess)
+		{
+			candidates = prediction.m_FilePaths;
+		}
+		if (options.m_Directory && prediction.m_IsDirectoryAccess)
+		{
+			StringArray siblingPaths = folderFiles[CreateKey(FileInfo::FolderPath(entry.m_FilePath.c_str()))];
+			SortSiblings(siblingPaths, entry.m_FilePath);
+			candidates.insert(candidates.end(), siblingPaths.begin(), siblingPaths.end());
+		}
+
+		size_t prefetchCount = 0;
+		int64_t prefetchBytes = 0;
+		for (const String& candidate : candidates)
+		{
+			if (prefetchCount >= options.m_Budget.m_MaxFiles)
+			{
+				break;
+			}
+
+			const String candidateKey = CreateKey(candidate);
+			HashMap<String, int64_t>::const_iterator candidateSize = fileSizes.find(candidateKey);
+			if (candidateSize == fileSizes.end() || residentFiles.find(candidateKey) != residentFiles.end())
+			{
+				continue;
+			}
+			if (candidateSize->second > options.m_Budget.m_MaxFileSize || prefetchBytes + candidateSize->second > options.m_Budget.m_MaxBytes)
+			{
+				continue;
+			}
+
+			residentFiles.insert(candidateKey);
+			prefetchedFiles.insert(candidateKey);
+			prefetchCount++;
+			prefetchBytes += candidateSize->second;
+		}
+
+		stats.m_PrefetchCount += prefetchCount;
+		stats.m_PrefetchBytes += prefetchBytes;
+	}
+
+	for (const String& key : prefetchedFiles)
+	{
+		stats.m_WastedCount++;
+		stats.m_WastedBytes += std::max<int64_t>(0, fileSizes[key]);
+	}
+	return stats;
+}
+
+bool FilePrefetchPredictor::LoadTrace(const String& filePath, Array<FFilePrefetchTraceEntry>& trace)
+{
+	trace.clear();
+	return FileInfo::ReadFileLines(filePath.c_str(), [&trace](const AString& line) -> bool
+	{
+		const AStringArray fields = StringInfo::Split(line.c_str(), "\t", StringInfo::SplitFlags::None);
+		FFilePrefetchTraceEntry entry;
+		if (fields.size() == 3 && ParseInt64(fields[0], entry.m_TimeMs) && ParseInt64(fields[1], entry.m_FileSize) && fields[2].size())
+		{
+			entry.m_FilePath = StringInfo::ToWide(fields[2]);
+			trace.push_back(entry);
+		}
+		return true;
+	});
+}
+
+String FilePrefetchPredictor::FormatTraceEntry(const FFilePrefetchTraceEntry& entry)
+{
+	return StringInfo::Format(L"%I64d\t%I64d\t%s\n", entry.m_TimeMs, entry.m_FileSize, entry.m_FilePath.c_str());
+}
+
+void FilePrefetchPredictor::SortSiblings(StringArray& siblingPaths, const String& filePath)
+{
+	const String fileKey = CreateKey(filePath);
+	siblingPaths.erase(std::remove_if(siblingPaths.begin(), siblingPaths.end(), [&fileKey](const String& siblingPath) -> bool { return CreateKey(siblingPath) == fileKey; }), siblingPaths.end());
+	std::sort(siblingPaths.begin(), siblingPaths.end(), StringInfo::LessInsensitive());
+
+	const StringArray::iterator nextSibling = std::upper_bound(siblingPaths.begin(), siblingPaths.end(), filePath, StringInfo::LessInsensitive());
+	std::rotate(siblingPaths.begin(), nextSibling, siblingPaths.end());
+}
+
+double FFilePrefetchReplayStats::HitRate() const
+{
+	return m_RequestCount ? double(m_HitCount) / m_RequestCount : 0.0;
+}
+
+String FFilePrefetchReplayStats::ToString() const
+{
+	return StringInfo::Format(L"requests=%I64u requestBytes=%I64u hits=%I64u hitBytes=%I64u hitRate=%.1f%% prefetched=%I64u prefetchedBytes=%I64u wasted=%I64u wastedBytes=%I64u",
+		m_RequestCount,
+		m_RequestBytes,
+		m_HitCount,
+		m_HitBytes,
+		HitRate() * 100.0,
+		m_PrefetchCount,
+		m_PrefetchBytes,
+		m_WastedCount,
+		m_WastedBytes);
+}
+
+}}}
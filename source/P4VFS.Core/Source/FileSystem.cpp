@@ -7,6 +7,8 @@
 #include "DriverVersion.h"
 #include "DepotClient.h"
 #include "DepotClientCache.h"
+#include "DepotContentCache.h"
+#include "DepotContentShare.h"
 #include "DepotResultPrint.h"
 #include "DepotOperations.h"
 #include "SettingManager.h"
@@ -51,24 +53,183 @@ private:
 	P4::DepotString m_DepotFileSpec;
 };
 
+class HandleFileStream : public FileCore::FileStream
+{
+public:
+	HandleFileStream(HANDLE hReadHandle) :
+		m_ReadHandle(hReadHandle)
+	{}
+
+	bool CanWrite() override
+	{
+		return false;
+	}
+
+	bool CanRead() override
+	{
+		return true;
+	}
+
+	HRESULT Read(HANDLE hWriteHandle, UINT64* bytesWritten) override
+	{
+		static const DWORD BYTES_TO_READ = 64*1024;
+		FileCore::Array<BYTE> buffer(BYTES_TO_READ);
+		DWORD nBytesRead = 0;
+		DWORD nBytesWritten = 0;
+		UINT64 totalBytesWritten = 0;
+
+		do
+		{
+			if (ReadFile(m_ReadHandle, buffer.data(), BYTES_TO_READ, &nBytesRead, NULL) == FALSE)
+			{
+				return HRESULT_FROM_WIN32(GetLastError());
+			}
+			if (nBytesRead > 0 && (WriteFile(hWriteHandle, buffer.data(), nBytesRead, &nBytesWritten, NULL) == FALSE || nBytesWritten != nBytesRead))
+			{
+				return HRESULT_FROM_WIN32(GetLastError());
+			}
+			totalBytesWritten += nBytesRead;
+		}
+		while (nBytesRead > 0);
+
+		if (bytesWritten != nullptr)
+		{
+			*bytesWritten = totalBytesWritten;
+		}
+		return S_OK;
+	}
+
+private:
+	HANDLE m_ReadHandle;
+};
+
+class DepotContentShareFileStream : public FileCore::FileStream
+{
+public:
+	DepotContentShareFileStream(HANDLE hReadHandle, const P4::FDepotContentShareFile& shareFile) :
+		m_ReadHandle(hReadHandle),
+		m_ShareFile(shareFile)
+	{}
+
+	bool CanWrite() override
+	{
+		return false;
+	}
+
+	bool CanRead() override
+	{
+		return true;
+	}
+
+	HRESULT Read(HANDLE hWriteHandle, UINT64* bytesWritten) override
+	{
+		return P4::DepotContentShare::CopyVerified(m_ReadHandle, hWriteHandle, m_ShareFile, bytesWritten);
+	}
+
+private:
+	HANDLE m_ReadHandle;
+	const P4::FDepotContentShareFile& m_ShareFile;
+};
+
 HRESULT 
-MakeFileResident(
+MakeFileResidentFromContentCache(
 	P4::FDepotClient& depotClient, 
+	P4::DepotContentCache& contentCache,
 	const wchar_t* filePath,
-	const P4VFS_REPARSE_DATA_2* populateInfo
+	const P4VFS_REPARSE_DATA_2* populateInfo,
+	const String& fileSpec
 	)
 {
-	if (StringInfo::IsNullOrEmpty(filePath))
+	const P4::DepotString key = P4::DepotContentCache::CreateKey(depotClient, StringInfo::ToAnsi(populateInfo->depotPath.c_str()), int32_t(populateInfo->fileRevision));
+	FileCore::AutoHandle cacheFile;
+	
+	if (contentCache.OpenFile(key, cacheFile))
 	{
-		return E_INVALIDARG;
+		depotClient.Log(LogChannel::Verbose, StringInfo::Format("MakeFileResident '%s' by CACHE", CSTR_WTOA(fileSpec)));
 	}
+	else
+	{
+		// The revision is printed into the cache once, and then populated from there like any other cached file
+		const String tempPrintFile = contentCache.CreateTempFile();
+		if (tempPrintFile.empty())
+		{
+			depotClient.Log(LogChannel::Warning, StringInfo::Format("MakeFileResident '%s' failed to create tempfile in content cache", CSTR_WTOA(fileSpec)));
+			return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+		}
 
-	if (populateInfo == nullptr)
+		P4::DepotResult print = depotClient.Run("print", P4::DepotStringArray{"-a","-o", StringInfo::ToAnsi(tempPrintFile), StringInfo::ToAnsi(fileSpec)});
+		if (print.get() == nullptr || print->HasError())
+		{
+			AutoTempFile deleteTempPrintFile(tempPrintFile.c_str());
+			depotClient.Log(LogChannel::Error, StringInfo::Format("MakeFileResident '%s' failed print tempfile '%s' for content cache", CSTR_WTOA(fileSpec), CSTR_WTOA(tempPrintFile)));
+			return HRESULT_FROM_WIN32(ERROR_INVALID_PRINTER_COMMAND);
+		}
+
+		if (contentCache.Publish(key, tempPrintFile, &cacheFile) == false)
+		{
+			depotClient.Log(LogChannel::Warning, StringInfo::Format("MakeFileResident '%s' failed to publish to content cache '%s'", CSTR_WTOA(fileSpec), CSTR_WTOA(contentCache.GetFolderPath())));
+			return E_FAIL;
+		}
+		depotClient.Log(LogChannel::Verbose, StringInfo::Format("MakeFileResident '%s' by CACHE after print", CSTR_WTOA(fileSpec)));
+	}
+
+	// Cached content is always streamed, since it must remain in the cache for the next workspace
+	HandleFileStream cacheStream(cacheFile.Handle());
+	HRESULT hr = FileOperations::PopulateFile(filePath, &cacheStream);
+	if (FAILED(hr))
 	{
-		return E_POINTER;
+		depotClient.Log(LogChannel::Error, StringInfo::Format("MakeFileResident '%s' failed PopulateFile by CACHE", CSTR_WTOA(fileSpec)));
+		return hr;
+	}
+	return S_OK;
+}
+
+HRESULT 
+MakeFileResidentFromShare(
+	P4::FDepotClient& depotClient, 
+	const String& shareFolderPath,
+	const P4::FDepotContentShareFile& shareFile,
+	const wchar_t* filePath,
+	const String& fileSpec
+	)
+{
+	FileCore::AutoHandle shareFileHandle;
+	if (P4::DepotContentShare::OpenFile(shareFolderPath, shareFile, shareFileHandle) == false)
+	{
+		depotClient.Log(LogChannel::Verbose, StringInfo::Format("MakeFileResident '%s' not found in share '%s'", CSTR_WTOA(fileSpec), CSTR_WTOA(shareFolderPath)));
+		return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+	}
+
+	depotClient.Log(LogChannel::Verbose, StringInfo::Format("MakeFileResident '%s' by SHARE", CSTR_WTOA(fileSpec)));
+	DepotContentShareFileStream shareStream(shareFileHandle.Handle(), shareFile);
+	
+	HRESULT hr = FileOperations::PopulateFile(filePath, &shareStream);
+	if (FAILED(hr))
+	{
+		depotClient.Log(LogChannel::Warning, StringInfo::Format("MakeFileResident '%s' failed PopulateFile by SHARE [%s]", CSTR_WTOA(fileSpec), CSTR_WTOA(StringInfo::ToString(hr))));
+		return hr;
+	}
+	return S_OK;
+}
+
+HRESULT 
+MakeFileResidentFromDepot(
+	P4::FDepotClient& depotClient, 
+	P4::DepotContentCache* contentCache,
+	const wchar_t* filePath,
+	const P4VFS_REPARSE_DATA_2* populateInfo,
+	const String& fileSpec
+	)
+{
+	if (contentCache != nullptr && contentCache->IsOpen())
+	{
+		// The file is still printed directly if it could not be served from the content cache
+		if (SUCCEEDED(MakeFileResidentFromContentCache(depotClient, *contentCache, filePath, populateInfo, fileSpec)))
+		{
+			return S_OK;
+		}
 	}
 
-	const String fileSpec = StringInfo::Format(L"%s#=%u", populateInfo->depotPath.c_str(), uint32_t(populateInfo->fileRevision));
 	const FilePopulateMethod::Enum populateMethod = FilePopulateMethod::FromString(StringInfo::ToAnsi(SettingManager::StaticInstance().PopulateMethod.GetValue()));
 	
 	switch (populateMethod)
@@ -121,9 +282,56 @@ MakeFileResident(
 	return S_OK;
 }
 
+HRESULT 
+MakeFileResident(
+	P4::FDepotClient& depotClient, 
+	P4::DepotContentCache* contentCache,
+	const wchar_t* filePath,
+	const P4VFS_REPARSE_DATA_2* populateInfo
+	)
+{
+	if (StringInfo::IsNullOrEmpty(filePath))
+	{
+		return E_INVALIDARG;
+	}
+
+	if (populateInfo == nullptr)
+	{
+		return E_POINTER;
+	}
+
+	const String fileSpec = StringInfo::Format(L"%s#=%u", populateInfo->depotPath.c_str(), uint32_t(populateInfo->fileRevision));
+	
+	// The share is only used for files whose printed content can be verified with the digest reported by the server
+	const String shareFolderPath = populateInfo->populatePolicy == P4VFS_POPULATE_POLICY_SHARE ? P4::DepotContentShare::GetConfiguredFolderPath() : String();
+	P4::FDepotContentShareFile shareFile;
+	if (shareFolderPath.empty() == false && P4::DepotContentShare::GetShareFile(depotClient, StringInfo::ToAnsi(populateInfo->depotPath.c_str()), int32_t(populateInfo->fileRevision), shareFile))
+	{
+		if (SUCCEEDED(MakeFileResidentFromShare(depotClient, shareFolderPath, shareFile, filePath, fileSpec)))
+		{
+			return S_OK;
+		}
+	}
+
+	HRESULT hr = MakeFileResidentFromDepot(depotClient, contentCache, filePath, populateInfo, fileSpec);
+	if (SUCCEEDED(hr) && shareFile.m_Digest.empty() == false && SettingManager::StaticInstance().PopulateShareWriteBack.GetValue())
+	{
+		if (P4::DepotContentShare::Publish(shareFolderPath, shareFile, filePath))
+		{
+			depotClient.Log(LogChannel::Verbose, StringInfo::Format("MakeFileResident '%s' written back to share '%s'", CSTR_WTOA(fileSpec), CSTR_WTOA(shareFolderPath)));
+		}
+		else
+		{
+			depotClient.Log(LogChannel::Warning, StringInfo::Format("MakeFileResident '%s' failed to write back to share '%s'", CSTR_WTOA(fileSpec), CSTR_WTOA(shareFolderPath)));
+		}
+	}
+	return hr;
+}
+
 HRESULT 
 ExecuteFileResidencyPolicy(
 	P4::FDepotClient& depotClient, 
+	P4::DepotContentCache* contentCache,
 	const wchar_t* filePath,
 	const P4VFS_REPARSE_DATA_2* populateInfo
 	)
@@ -137,7 +345,7 @@ ExecuteFileResidencyPolicy(
 	{
 		case P4VFS_RESIDENCY_POLICY_RESIDENT:
 		{
-			return MakeFileResident(depotClient, filePath, populateInfo);
+			return MakeFileResident(depotClient, contentCache, filePath, populateInfo);
 		}
 		case P4VFS_RESIDENCY_POLICY_REMOVE_FILE:
 		{
@@ -150,6 +358,20 @@ ExecuteFileResidencyPolicy(
 	return E_FAIL;
 }
 
+P4::DepotConfig
+CreateFileResidencyConfig(
+	const wchar_t* filePath,
+	const P4VFS_REPARSE_DATA_2* populateInfo
+	)
+{
+	P4::DepotConfig config;
+	config.m_Port = P4::DepotOperations::ResolveDepotServerName(StringInfo::ToAnsi(populateInfo->depotServer.c_str()));
+	config.m_User = StringInfo::ToAnsi(populateInfo->depotUser.c_str());
+	config.m_Client = StringInfo::ToAnsi(populateInfo->depotClient.c_str());
+	config.m_Directory = StringInfo::ToAnsi(FileInfo::FolderPath(filePath));
+	return config;
+}
+
 HRESULT 
 ResolveFileResidency(
 	FileContext& context,
@@ -196,16 +418,11 @@ ResolveFileResidency(
 	}
 
 	// Specify a DepotConfig that will be used as a key for similar connections
-	P4::DepotConfig config;
-	config.m_Port = P4::DepotOperations::ResolveDepotServerName(StringInfo::ToAnsi(populateInfo->depotServer.c_str()));
-	config.m_User = StringInfo::ToAnsi(populateInfo->depotUser.c_str());
-	config.m_Client = StringInfo::ToAnsi(populateInfo->depotClient.c_str());
-	config.m_Directory = StringInfo::ToAnsi(FileInfo::FolderPath(filePath));
-	const P4::DepotConfig& configKey = config;
+	const P4::DepotConfig configKey = CreateFileResidencyConfig(filePath, populateInfo.get());
 
 	// Make sure we go through all existing clients and a new one before giving up
 	Assert(context.m_DepotClientCache != nullptr);
-	const size_t maxRetryCount = context.m_DepotClientCache->GetFreeCount() + 1; 
+	const size_t maxRetryCount = context.m_DepotClientCache->GetFreeCount(configKey) + 1;
 	for (size_t retryIndex = 0; retryIndex < maxRetryCount; ++retryIndex)
 	{
 		P4::DepotClient client = context.m_DepotClientCache->Alloc(configKey, context);
@@ -220,7 +437,7 @@ ResolveFileResidency(
 			continue;
 		}
 
-		hr = ExecuteFileResidencyPolicy(*client, filePath, populateInfo.get());
+		hr = ExecuteFileResidencyPolicy(*client, context.m_DepotContentCache, filePath, populateInfo.get());
 		if (FAILED(hr))
 		{
 			if (context.m_LogDevice)
@@ -246,6 +463,52 @@ ResolveFileResidency(
 	return hr;
 }
 
+HRESULT 
+PrefetchFileResidency(
+	FileContext& context,
+	const wchar_t* filePath
+	)
+{
+	if (StringInfo::IsNullOrEmpty(filePath))
+	{
+		return E_INVALIDARG;
+	}
+
+	FileCore::GAllocPtr<P4VFS_REPARSE_DATA_2> populateInfo;
+	HRESULT hr = FileOperations::GetFileReparseData(filePath, populateInfo);
+	if (FAILED(hr) || populateInfo.get() == nullptr || populateInfo->residencyPolicy != P4VFS_RESIDENCY_POLICY_RESIDENT || StringInfo::IsNullOrEmpty(populateInfo->depotPath.c_str()))
+	{
+		return S_FALSE;
+	}
+
+	// A prefetch never connects a new client or retries, so that it only uses connections which would otherwise be idle
+	const P4::DepotConfig configKey = CreateFileResidencyConfig(filePath, populateInfo.get());
+	Assert(context.m_DepotClientCache != nullptr);
+	P4::DepotClient client = context.m_DepotClientCache->AllocIdle(configKey, context);
+	if (client.get() == nullptr)
+	{
+		return S_FALSE;
+	}
+
+	// A failed prefetch is only speculative, and the file is still hydrated when it is opened
+	hr = ExecuteFileResidencyPolicy(*client, context.m_DepotContentCache, filePath, populateInfo.get());
+	if (FAILED(hr))
+	{
+		if (context.m_LogDevice)
+		{
+			context.m_LogDevice->Warning(StringInfo::Format(L"PrefetchFile ExecuteFileResidencyPolicy failed '%s' with error [%s]", filePath, StringInfo::ToString(hr).c_str()));
+		}
+		return hr;
+	}
+
+	context.m_DepotClientCache->Free(configKey, client);
+	if (context.m_LogDevice)
+	{
+		context.m_LogDevice->Info(StringInfo::Format(L"%s#%u - prefetched as %s [%s,%s,%s]", populateInfo->depotPath.c_str(), uint32_t(populateInfo->fileRevision), filePath, CSTR_ATOW(configKey.m_Port), populateInfo->depotUser.c_str(), populateInfo->depotClient.c_str()));
+	}
+	return S_OK;
+}
+
 bool
 IsExcludedProcessId(
 	ULONG processId
@@ -195,15 +195,33 @@ String LogDeviceFile::ExpandVariables(const String& text) const
 	return StringInfo::Replace(text.c_str(), VariableUserName, StringInfo::ToLower(GetDesiredUserName().c_str()).c_str(), StringInfo::SearchCase::Insensitive);
 }
 
-LogDeviceMemory::LogDeviceMemory() :
-	m_ElementsMutex(CreateMutex(NULL, FALSE, NULL))
+LogDeviceMemory::LogDeviceMemory(LogChannel::Enum level, size_t maxElements) :
+	m_ElementsMutex(CreateMutex(NULL, FALSE, NULL)),
+	m_Level(level),
+	m_MaxElements(maxElements),
+	m_ChannelCounts{},
+	m_DroppedCount(0)
 {
 }
 
 void LogDeviceMemory::Write(const LogElement& element)
 {
 	AutoMutex elementsScope(m_ElementsMutex);
-	m_Elements.push_back(element);
+	if (size_t(element.m_Channel) < _countof(m_ChannelCounts))
+	{
+		m_ChannelCounts[element.m_Channel]++;
+	}
+	if (element.m_Channel >= m_Level)
+	{
+		if (m_MaxElements == 0 || m_Elements.size() < m_MaxElements)
+		{
+			m_Elements.push_back(element);
+		}
+		else
+		{
+			m_DroppedCount++;
+		}
+	}
 }
 
 const List<LogElement>& LogDeviceMemory::GetElements() const
@@ -211,6 +229,16 @@ const List<LogElement>& LogDeviceMemory::GetElements() const
 	return m_Elements;
 }
 
+size_t LogDeviceMemory::GetChannelCount(LogChannel::Enum channel) const
+{
+	return size_t(channel) < _countof(m_ChannelCounts) ? m_ChannelCounts[channel] : 0;
+}
+
+size_t LogDeviceMemory::GetDroppedCount() const
+{
+	return m_DroppedCount;
+}
+
 void LogDeviceAggregate::Write(const LogElement& element)
 {
 	for (LogDevice* device : m_Devices)
@@ -4,6 +4,18 @@
 #include "TestFactory.h"
 #include "DepotClient.h"
 #include "DepotResultPrint.h"
+#include "DepotResultFStat.h"
+#include "DepotDateTime.h"
+#include "SettingManager.h"
+#include "ThreadPool.h"
+#include "DepotSyncPipeline.h"
+#include "DepotTextEncoder.h"
+#include "DepotTelemetry.h"
+#include <atomic>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <crtdbg.h>
 
 using namespace Microsoft::P4VFS::FileCore;
 using namespace Microsoft::P4VFS::TestCore;
@@ -107,3 +119,801 @@ void TestDepotClientIsSymlinkFileType(const TestContext& context)
 	#undef TestIsWritableFileType
 }
 
+
+void TestDepotClientResultArenaTags(const TestContext& context)
+{
+	auto CreateResult = [](bool arenaTags, const Array<Array<std::pair<const char*, DepotString>>>& records) -> DepotResult
+	{
+		SettingPropertyScope<bool> arenaTagsScope(SettingManager::StaticInstance().DepotResultArenaTags, arenaTags);
+		DepotResult result = std::make_shared<FDepotResult>();
+		Assert(result->IsArenaTags() == arenaTags);
+		for (const Array<std::pair<const char*, DepotString>>& record : records)
+		{
+			result->BeginTag();
+			for (const std::pair<const char*, DepotString>& field : record)
+			{
+				result->AddTagField(field.first, field.second.c_str());
+			}
+			Assert(result->EndTag() == result->TagList().back());
+		}
+		return result;
+	};
+
+	// Records with repeated keys, keys in a different case and order, empty values, and a value larger than a block
+	Array<Array<std::pair<const char*, DepotString>>> records;
+	for (size_t recordIndex = 0; recordIndex < 20000; ++recordIndex)
+	{
+		Array<std::pair<const char*, DepotString>> record;
+		record.push_back({ FDepotResultFStatField::Name::DepotFile, StringInfo::Format("//depot/main/folder%I64u/file%I64u.txt", uint64_t(recordIndex%100), uint64_t(recordIndex)) });
+		record.push_back({ FDepotResultFStatField::Name::HeadRev, StringInfo::Format("%I64u", uint64_t(recordIndex%7+1)) });
+		record.push_back({ FDepotResultFStatField::Name::FileSize, StringInfo::Format("%I64u", uint64_t(recordIndex)*1000000) });
+		if (recordIndex % 3 == 0)
+			record.push_back({ FDepotResultFStatField::Name::IsMapped, "" });
+		if (recordIndex % 5 == 0)
+			record.push_back({ "DEPOTFILE", "//depot/ignored" });
+		if (recordIndex % 11 == 0)
+			std::reverse(record.begin(), record.end());
+		records.push_back(record);
+	}
+	records.push_back({ { FDepotResultFStatField::Name::Desc, DepotString(300*1024, 'd') }, { FDepotResultFStatField::Name::HeadRev, "3" } });
+	records.push_back({});
+
+	DepotResult mapResult = CreateResult(false, records);
+	DepotResult arenaResult = CreateResult(true, records);
+	Assert(mapResult->GetArenaBlockCount() == 0);
+	Assert(arenaResult->GetArenaBlockCount() > 2);
+	Assert(mapResult->TagList().size() == records.size());
+	Assert(arenaResult->TagList().size() == records.size());
+
+	for (size_t recordIndex = 0; recordIndex < records.size(); ++recordIndex)
+	{
+		const FDepotResultTag& mapTag = *mapResult->TagList()[recordIndex];
+		const FDepotResultTag& arenaTag = *arenaResult->TagList()[recordIndex];
+		Assert(mapTag.IsArena() == false);
+		Assert(arenaTag.IsArena());
+		Assert(arenaTag.GetFieldCount() == mapTag.GetFieldCount());
+		for (const DepotResultFields::value_type& field : mapTag.m_Fields)
+			Assert(arenaTag.GetValue(field.first.c_str()) == field.second);
+
+		FDepotResultFStatNode mapNode = FDepotResultNode::Create<FDepotResultFStatNode>(mapResult->TagList()[recordIndex]);
+		FDepotResultFStatNode arenaNode = FDepotResultNode::Create<FDepotResultFStatNode>(arenaResult->TagList()[recordIndex]);
+		Assert(arenaNode.IsEmpty() == mapNode.IsEmpty());
+		Assert(arenaNode.DepotFile() == mapNode.DepotFile());
+		Assert(arenaNode.Desc() == mapNode.Desc());
+		Assert(arenaNode.HeadRev() == mapNode.HeadRev());
+		Assert(arenaNode.FileSize() == mapNode.FileSize());
+		Assert(arenaNode.IsMapped() == mapNode.IsMapped());
+		Assert(arenaNode.ClientFile().empty() && arenaNode.Tag().GetValuePtr(FDepotResultFStatField::Name::ClientFile) == nullptr);
+		Assert(arenaTag.GetValue("depotfile") == mapTag.GetValue("DepotFile"));
+		Assert(&arenaNode.DepotFile() == &arenaNode.DepotFile());
+	}
+
+	// Concurrent readers of the same field receive the same value
+	const DepotResultTag sharedTag = arenaResult->TagList()[1];
+	Array<const DepotString*> sharedValues(64, nullptr);
+	Array<size_t> readerIndices(sharedValues.size());
+	std::iota(readerIndices.begin(), readerIndices.end(), size_t(0));
+	ThreadPool::ForEach::Execute(8, readerIndices.data(), readerIndices.size(), NULL, [&](size_t readerIndex) -> void
+	{
+		sharedValues[readerIndex] = sharedTag->GetValuePtr(FDepotResultFStatField::Name::DepotFile);
+	});
+	Assert(std::all_of(sharedValues.begin(), sharedValues.end(), [&](const DepotString* v) -> bool { return v == sharedValues[0] && v != nullptr; }));
+
+	// Modifying or copying a tag moves its fields into the map
+	FDepotResultTag copyTag = *sharedTag;
+	Assert(copyTag.IsArena() == false);
+	Assert(copyTag.GetFieldCount() == sharedTag->GetFieldCount());
+	sharedTag->SetValue(FDepotResultFStatField::Name::HaveRev, "2");
+	Assert(sharedTag->IsArena() == false);
+	Assert(sharedTag->GetValueInt32(FDepotResultFStatField::Name::HaveRev) == 2);
+	Assert(sharedTag->GetValue(FDepotResultFStatField::Name::DepotFile) == copyTag.GetValue(FDepotResultFStatField::Name::DepotFile));
+	sharedTag->RemoveKey(FDepotResultFStatField::Name::DepotFile);
+	Assert(sharedTag->ContainsKey(FDepotResultFStatField::Name::DepotFile) == false);
+
+	// Tags outlive their result, and may be appended to another
+	DepotResult appendResult = std::make_shared<FDepotResult>();
+	appendResult->Append(arenaResult->TagList()[2]);
+	const DepotString depotFile2 = arenaResult->TagList()[2]->GetValue(FDepotResultFStatField::Name::DepotFile);
+	arenaResult.reset();
+	Assert(appendResult->GetTagValue(FDepotResultFStatField::Name::DepotFile) == depotFile2);
+}
+
+namespace TestDepotClientResultArenaTagsInternal
+{
+	#if defined(_DEBUG)
+	static std::atomic<int64_t> AllocationCount(0);
+
+	static int __cdecl AllocationCountHook(int allocType, void* userData, size_t size, int blockType, long requestNumber, const unsigned char* fileName, int lineNumber)
+	{
+		if (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)
+			AllocationCount++;
+		return TRUE;
+	}
+
+	// Counts the heap allocations of the calling scope, which are only reported by the debug CRT
+	struct FAllocationCounter
+	{
+		FAllocationCounter() : m_StartCount(AllocationCount), m_PreviousHook(_CrtSetAllocHook(AllocationCountHook)) {}
+		~FAllocationCounter() { _CrtSetAllocHook(m_PreviousHook); }
+		int64_t Count() const { return AllocationCount - m_StartCount; }
+
+		int64_t m_StartCount;
+		_CRT_ALLOC_HOOK m_PreviousHook;
+	};
+	#else
+	struct FAllocationCounter
+	{
+		int64_t Count() const { return -1; }
+	};
+	#endif
+
+	static DepotString ToDisplayAllocations(int64_t count)
+	{
+		return count < 0 ? DepotString("n/a") : StringInfo::Format("%I64d", count);
+	}
+}
+
+void TestDepotClientResultArenaTagsBenchmark(const TestContext& context)
+{
+	using namespace TestDepotClientResultArenaTagsInternal;
+	const size_t recordCount = 1000000;
+
+	// Capture a tagged fstat stream in the format of 'p4 -ztag', with a blank line after each record
+	AutoTempFile captureFile(FileInfo::CreateTempFile(nullptr, TEXT("p4vfs")).c_str());
+	Assert(captureFile.GetFilePath().empty() == false);
+	{
+		FILE* file = fopen(StringInfo::WtoA(captureFile.GetFilePath()), "wb");
+		Assert(file);
+		for (size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex)
+		{
+			const uint64_t folderIndex = uint64_t(recordIndex/1000);
+			fprintf(file, "... depotFile //depot/main/Engine/Source/Runtime/Module%I64u/Private/File%I64u.cpp\n", folderIndex, uint64_t(recordIndex));
+			fprintf(file, "... clientFile d:\\workspace\\Engine\\Source\\Runtime\\Module%I64u\\Private\\File%I64u.cpp\n", folderIndex, uint64_t(recordIndex));
+			fprintf(file, "... isMapped \n");
+			fprintf(file, "... headAction edit\n");
+			fprintf(file, "... headType text\n");
+			fprintf(file, "... headTime 1700000000\n");
+			fprintf(file, "... headRev %I64u\n", uint64_t(recordIndex%31+1));
+			fprintf(file, "... headChange %I64u\n", uint64_t(1000000+recordIndex));
+			fprintf(file, "... headModTime 1690000000\n");
+			fprintf(file, "... haveRev %I64u\n", uint64_t(recordIndex%31+1));
+			fprintf(file, "... fileSize %I64u\n\n", uint64_t(recordIndex%65536)*17);
+		}
+		fclose(file);
+	}
+
+	// Load the capture as null terminated key and value pairs, with an empty key at the end of each record
+	DepotString replay;
+	{
+		std::ifstream file(captureFile.GetFilePath().c_str(), std::ios::binary);
+		Assert(file.good());
+		DepotString line;
+		while (std::getline(file, line))
+		{
+			if (line.empty())
+			{
+				replay.push_back('\0');
+				continue;
+			}
+			Assert(line.compare(0, 4, "... ") == 0);
+			const size_t delim = line.find(' ', 4);
+			Assert(delim != DepotString::npos);
+			replay.append(line.c_str()+4, delim-4).push_back('\0');
+			replay.append(line.c_str()+delim+1).push_back('\0');
+		}
+	}
+
+	auto Replay = [&replay](FDepotResult& result) -> void
+	{
+		const char* data = replay.c_str();
+		const char* dataEnd = data + replay.size();
+		result.BeginTag();
+		while (data < dataEnd)
+		{
+			if (*data == '\0')
+			{
+				result.EndTag();
+				if (++data < dataEnd)
+					result.BeginTag();
+				continue;
+			}
+			const char* key = data;
+			const char* value = key + strlen(key) + 1;
+			result.AddTagField(key, value);
+			data = value + strlen(value) + 1;
+		}
+	};
+
+	struct FResult
+	{
+		size_t m_RecordCount = 0;
+		int64_t m_FileSize = 0;
+		int64_t m_HeadRev = 0;
+		size_t m_DepotFileLength = 0;
+	};
+
+	FResult results[2];
+	for (bool arenaTags : { false, true })
+	{
+		SettingPropertyScope<bool> arenaTagsScope(SettingManager::StaticInstance().DepotResultArenaTags, arenaTags);
+		DepotResult result = std::make_shared<FDepotResult>();
+
+		DepotStopwatch replayTimer(DepotStopwatch::Init::Start);
+		int64_t replayAllocations = 0;
+		{
+			FAllocationCounter allocations;
+			Replay(*result);
+			replayAllocations = allocations.Count();
+		}
+		replayTimer.Stop();
+
+		FResult& totals = results[arenaTags ? 1 : 0];
+		DepotStopwatch readTimer(DepotStopwatch::Init::Start);
+		int64_t readAllocations = 0;
+		{
+			FAllocationCounter allocations;
+			for (const DepotResultTag& tag : result->TagList())
+			{
+				FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(tag);
+				totals.m_RecordCount++;
+				totals.m_FileSize += node.FileSize();
+				totals.m_HeadRev += node.HeadRev();
+				totals.m_DepotFileLength += node.DepotFile().size();
+			}
+			readAllocations = allocations.Count();
+		}
+		readTimer.Stop();
+
+		context.Log()->Info(StringInfo::Format("ResultTags arena=%d records=%I64u replay=%I64dms (%.0f records/sec) replayAllocations=%s read=%I64dms readAllocations=%s arenaBlocks=%I64u", 
+			int32_t(arenaTags),
+			uint64_t(totals.m_RecordCount),
+			replayTimer.TotalMilliseconds(),
+			double(totals.m_RecordCount) * 1000.0 / double(std::max<int64_t>(1, replayTimer.TotalMilliseconds())),
+			ToDisplayAllocations(replayAllocations).c_str(),
+			readTimer.TotalMilliseconds(),
+			ToDisplayAllocations(readAllocations).c_str(),
+			uint64_t(result->GetArenaBlockCount())));
+
+		if (arenaTags && replayAllocations >= 0)
+			Assert(replayAllocations < int64_t(recordCount)*3);
+	}
+
+	Assert(results[0].m_RecordCount == recordCount);
+	Assert(results[1].m_RecordCount == results[0].m_RecordCount);
+	Assert(results[1].m_FileSize == results[0].m_FileSize);
+	Assert(results[1].m_HeadRev == results[0].m_HeadRev);
+	Assert(results[1].m_DepotFileLength == results[0].m_DepotFileLength);
+}
+
+void TestDepotClientResultStream(const TestContext& context)
+{
+	const size_t recordCount = 100000;
+	for (bool arenaTags : { false, true })
+	{
+		SettingPropertyScope<bool> arenaTagsScope(SettingManager::StaticInstance().DepotResultArenaTags, arenaTags);
+		size_t visitCount = 0;
+		int64_t fileSize = 0;
+
+		FDepotResultStream result([&visitCount, &fileSize](const DepotResultTag& tag) -> void
+		{
+			const FDepotResultFStatNode node = FDepotResultNode::Create<FDepotResultFStatNode>(tag);
+			Assert(node.DepotFile() == StringInfo::Format("//depot/file%I64u.txt", uint64_t(visitCount)));
+			fileSize += node.FileSize();
+			visitCount++;
+		});
+
+		// Records are passed to the visitor as the client command does for each tagged output record
+		for (size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex)
+		{
+			result.BeginTag();
+			result.AddTagField(FDepotResultFStatField::Name::DepotFile, StringInfo::Format("//depot/file%I64u.txt", uint64_t(recordIndex)).c_str());
+			result.AddTagField(FDepotResultFStatField::Name::FileSize, StringInfo::Format("%I64u", uint64_t(recordIndex)).c_str());
+			Assert(result.OnStreamStat(nullptr, result.EndTag()) == DepotResultReply::Handled);
+			Assert(result.TagList().empty());
+		}
+
+		Assert(visitCount == recordCount);
+		Assert(result.StreamCount() == recordCount);
+		Assert(fileSize == int64_t(recordCount*(recordCount-1)/2));
+		Assert(result.HasError() == false);
+	}
+
+	// Items pushed by a producer are all received by the consumers once the queue is closed
+	DepotQueue<DepotResultTag> queue(16);
+	std::atomic<size_t> popCount(0);
+	Array<size_t> stages(5);
+	std::iota(stages.begin(), stages.end(), size_t(0));
+	ThreadPool::ForEach::Execute(stages.size(), stages.data(), stages.size(), NULL, [&](size_t stage) -> void
+	{
+		if (stage == 0)
+		{
+			for (size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex)
+			{
+				DepotResultTag tag = std::make_shared<FDepotResultTag>();
+				tag->SetValue(FDepotResultFStatField::Name::DepotFile, "//depot/file.txt");
+				Assert(queue.Push(tag));
+			}
+			queue.Close();
+			return;
+		}
+
+		DepotResultTag tag;
+		while (queue.Pop(tag))
+		{
+			Assert(tag->ContainsKey(FDepotResultFStatField::Name::DepotFile));
+			popCount++;
+		}
+	});
+	Assert(popCount == recordCount);
+}
+
+namespace TestDepotClientCommandPipelineInternal {
+
+	// A stand-in for the server side of a connection, which replies to each packet of commands after a fixed round trip
+	// latency. The commands sent before a wait are received together, as the requests pipelined on a connection are.
+	struct FStandInPacket
+	{
+		Array<std::pair<const DepotCommand*, FDepotResult*>> m_Commands;
+		AutoHandle m_RepliedEvent;
+	};
+
+	struct FStandInServer
+	{
+		FStandInServer(DWORD latencyMs) :
+			m_LatencyMs(latencyMs),
+			m_Packets(16),
+			m_RoundTrips(0)
+		{}
+
+		void Serve()
+		{
+			std::shared_ptr<FStandInPacket> packet;
+			while (m_Packets.Pop(packet))
+			{
+				Sleep(m_LatencyMs);
+				m_RoundTrips++;
+				for (const std::pair<const DepotCommand*, FDepotResult*>& command : packet->m_Commands)
+				{
+					const DepotString text = StringInfo::Join(command.first->m_Args, " ");
+					command.second->OnStreamOutput(nullptr, text.c_str(), text.size());
+				}
+				SetEvent(packet->m_RepliedEvent.Handle());
+			}
+		}
+
+		DWORD m_LatencyMs;
+		DepotQueue<std::shared_ptr<FStandInPacket>> m_Packets;
+		std::atomic<size_t> m_RoundTrips;
+	};
+
+	struct FDepotResultOrdered : FDepotResultPrintString
+	{
+		FDepotResultOrdered(size_t index, Array<size_t>* completed) :
+			m_Index(index),
+			m_Completed(completed)
+		{}
+
+		virtual DepotResultReply OnComplete() override
+		{
+			m_Completed->push_back(m_Index);
+			return DepotResultReply::Handled;
+		}
+
+		size_t m_Index;
+		Array<size_t>* m_Completed;
+	};
+}
+
+void TestDepotClientCommandPipeline(const TestContext& context)
+{
+	using namespace TestDepotClientCommandPipelineInternal;
+	const size_t commandCount = 100;
+	const DWORD latencyMs = 10;
+
+	Array<DepotCommand> cmds;
+	for (size_t cmdIndex = 0; cmdIndex < commandCount; ++cmdIndex)
+	{
+		cmds.push_back(DepotCommand("print", DepotStringArray{ "-q", StringInfo::Format("//depot/link%I64u.txt#1", uint64_t(cmdIndex)) }, DepotCommand::Flags::UnTagged));
+	}
+
+	FStandInServer server(latencyMs);
+	Array<size_t> stages(2);
+	std::iota(stages.begin(), stages.end(), size_t(0));
+	ThreadPool::ForEach::Execute(stages.size(), stages.data(), stages.size(), NULL, [&](size_t stage) -> void
+	{
+		if (stage == 0)
+		{
+			server.Serve();
+			return;
+		}
+
+		// A depth of one is a round trip for every command, as with a separate Run for each
+		int64_t sequentialUs = 0;
+		int64_t pipelinedUs = 0;
+		for (size_t depth : { size_t(1), size_t(32) })
+		{
+			Array<size_t> completed;
+			Array<std::shared_ptr<FDepotResultOrdered>> results;
+			Array<FDepotResult*> resultPtrs;
+			for (size_t cmdIndex = 0; cmdIndex < commandCount; ++cmdIndex)
+			{
+				results.push_back(std::make_shared<FDepotResultOrdered>(cmdIndex, &completed));
+				resultPtrs.push_back(results.back().get());
+			}
+
+			std::shared_ptr<FStandInPacket> packet;
+			const size_t roundTrips = server.m_RoundTrips;
+			DepotStopwatch timer(DepotStopwatch::Init::Start);
+			DepotCommandPipeline::Run(cmds, resultPtrs, depth, 
+				[&packet](const DepotCommand& cmd, FDepotResult& result) -> void
+				{
+					if (packet.get() == nullptr)
+					{
+						packet = std::make_shared<FStandInPacket>();
+						packet->m_RepliedEvent.Reset(CreateEvent(NULL, FALSE, FALSE, NULL));
+					}
+					packet->m_Commands.push_back(std::make_pair(&cmd, &result));
+				},
+				[&packet, &server]() -> void
+				{
+					Assert(packet.get() != nullptr);
+					Assert(server.m_Packets.Push(packet));
+					Assert(WaitForSingleObject(packet->m_RepliedEvent.Handle(), INFINITE) == WAIT_OBJECT_0);
+					packet.reset();
+				});
+			if (depth == 1)
+				sequentialUs = timer.TotalMicroseconds();
+			else
+				pipelinedUs = timer.TotalMicroseconds();
+
+			Assert(server.m_RoundTrips - roundTrips == (commandCount + depth - 1) / depth);
+			Assert(completed.size() == commandCount);
+			for (size_t cmdIndex = 0; cmdIndex < commandCount; ++cmdIndex)
+			{
+				Assert(completed[cmdIndex] == cmdIndex);
+				Assert(results[cmdIndex]->GetString() == StringInfo::Join(cmds[cmdIndex].m_Args, " "));
+			}
+		}
+
+		context.Log()->Info(StringInfo::Format("CommandPipeline %I64u commands %ums latency: sequential %.1fms pipelined %.1fms", uint64_t(commandCount), latencyMs, double(sequentialUs)/1000.0, double(pipelinedUs)/1000.0));
+		Assert(pipelinedUs * 4 < sequentialUs);
+		server.m_Packets.Close();
+	});
+
+	// An unconnected client completes every result of a batch with an error
+	FDepotClient client;
+	Array<DepotResult> results = client.RunBatch(cmds);
+	Assert(results.size() == commandCount);
+	for (const DepotResult& result : results)
+	{
+		Assert(result->HasError());
+	}
+}
+
+void TestDepotClientPrintDemux(const TestContext& context)
+{
+	const size_t fileCount = 3;
+	List<AutoTempFile> tempFiles;
+	List<AutoHandle> tempHandles;
+	FDepotResultPrintDemux print;
+	for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+	{
+		const AutoTempFile& tempFile = tempFiles.emplace_back(FileInfo::CreateTempFile(nullptr, TEXT("p4vfs")).c_str());
+		const AutoHandle& tempHandle = tempHandles.emplace_back(CreateFile(tempFile.GetFilePath().c_str(), GENERIC_WRITE, 0, NULL, TRUNCATE_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
+		Assert(tempHandle.IsValid());
+		Assert(print.AddFile(StringInfo::Format("//depot/file%I64u.txt", uint64_t(fileIndex)), int32_t(fileIndex+1), tempHandle.Handle()) == fileIndex);
+	}
+
+	const DepotStringArray fileSpecs = print.GetFileSpecs();
+	Assert(fileSpecs.size() == fileCount);
+	Assert(fileSpecs[1] == "//depot/file1.txt#2");
+
+	// Each header record routes the output which follows it, in whatever order the server sends the files
+	auto printFile = [&print](const char* depotFile, const char* rev, const Array<const char*>& chunks) -> void
+	{
+		print.BeginTag();
+		print.AddTagField("depotFile", depotFile);
+		print.AddTagField("rev", rev);
+		print.AddTagField("type", "text");
+		Assert(print.OnStreamStat(nullptr, print.EndTag()) == DepotResultReply::Handled);
+		for (const char* chunk : chunks)
+		{
+			Assert(print.OnStreamOutput(nullptr, chunk, strlen(chunk)) == DepotResultReply::Handled);
+		}
+	};
+
+	printFile("//depot/file2.txt", "3", { "third ", "file" });
+	printFile("//depot/FILE0.txt", "1", { "first file" });
+	printFile("//depot/file1.txt", "1", { "wrong revision" });
+	Assert(print.HasError());
+
+	for (AutoHandle& tempHandle : tempHandles)
+	{
+		tempHandle.Close();
+	}
+
+	Assert(print.IsFilePrinted(0));
+	Assert(print.IsFilePrinted(1) == false);
+	Assert(print.IsFilePrinted(2));
+	Assert(print.GetFile(0).m_ByteCount == int64_t(strlen("first file")));
+	Assert(print.GetFile(2).m_ByteCount == int64_t(strlen("third file")));
+
+	const Array<DepotString> expected = { "first file", "", "third file" };
+	size_t fileIndex = 0;
+	for (const AutoTempFile& tempFile : tempFiles)
+	{
+		std::ifstream file(tempFile.GetFilePath().c_str(), std::ios::binary);
+		Assert(file.good());
+		const DepotString text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		Assert(text == expected[fileIndex++]);
+	}
+}
+
+namespace TestDepotClientTextEncoderInternal {
+
+	// The previous encoder, which writes one character at a time, as the reference for the output of the current one
+	template <typename CharType>
+	struct FDepotTextEncoderPlatformReference : FDepotTextEncoderPlatformBase
+	{
+		FDepotTextEncoderPlatformReference(Flags::Enum flags) :
+			m_Flags(flags)
+		{
+		}
+
+		void Encode(const char** pdata, int32_t* plength) override
+		{
+			if (pdata != nullptr && *pdata != nullptr && plength != nullptr && *plength > 0)
+			{
+				m_Buffer.clear();
+				if (m_Flags & Flags::Bom)
+				{
+					m_Flags &= ~Flags::Bom;
+					if (m_Flags & Flags::Utf8)
+						Algo::Append(m_Buffer, std::initializer_list<uint8_t>{ 0xEF, 0xBB, 0xBF });
+					else if (m_Flags & Flags::Utf16)
+						Algo::Append(m_Buffer, std::initializer_list<uint8_t>{ 0xFF, 0xFE });
+				}
+
+				if (m_Buffer.size() == 0 && (m_Flags & Flags::CrLf) == 0)
+					return;
+
+				const size_t srcNum = size_t(*plength) / sizeof(CharType);
+				const CharType* src = reinterpret_cast<const CharType*>(*pdata);
+				for (size_t srcIndex = 0; srcIndex < srcNum; ++srcIndex)
+				{
+					const CharType c = src[srcIndex];
+					if (c == LITERAL(CharType, '\n') && (m_Flags & Flags::CrLf) != 0)
+						Write(LITERAL(CharType, '\r'));
+					Write(c);
+				}
+
+				if (m_Buffer.size() > 0)
+				{
+					*pdata = reinterpret_cast<const char*>(m_Buffer.data());
+					*plength = int32_t(m_Buffer.size());
+				}
+			}
+		}
+
+	private:
+		void Write(CharType c)
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&c);
+			m_Buffer.insert(m_Buffer.end(), bytes, bytes + sizeof(CharType));
+		}
+
+	private:
+		int32_t m_Flags;
+		Array<uint8_t> m_Buffer;
+	};
+
+	template <typename CharType>
+	DepotString EncodeChunks(FDepotTextEncoder& encoder, const Array<DepotString>& chunks)
+	{
+		DepotString output;
+		for (const DepotString& chunk : chunks)
+		{
+			const char* data = chunk.data();
+			int32_t length = int32_t(chunk.size());
+			encoder.Encode(&data, &length);
+			output.append(data, size_t(length));
+		}
+		return output;
+	}
+
+	template <typename CharType>
+	void FuzzTextEncoder(std::mt19937& random, size_t iterationCount)
+	{
+		const Array<FDepotTextEncoderPlatformBase::Flags::Enum> flagsList = {
+			FDepotTextEncoderPlatformBase::Flags::CrLf,
+			FDepotTextEncoderPlatformBase::Flags::TextUtf8,
+			FDepotTextEncoderPlatformBase::Flags::CrLf | FDepotTextEncoderPlatformBase::Flags::TextUtf8,
+			FDepotTextEncoderPlatformBase::Flags::TextUtf16,
+			FDepotTextEncoderPlatformBase::Flags::CrLf | FDepotTextEncoderPlatformBase::Flags::TextUtf16,
+		};
+
+		for (size_t iteration = 0; iteration < iterationCount; ++iteration)
+		{
+			// Chunks of odd lengths, dense with line feeds, carriage returns, and the bytes of UTF-16 line feeds
+			Array<DepotString> chunks(1 + random() % 4);
+			for (DepotString& chunk : chunks)
+			{
+				chunk.resize(1 + random() % 300);
+				for (char& c : chunk)
+				{
+					const uint32_t r = random() % 8;
+					c = r < 3 ? '\n' : r == 3 ? '\r' : r == 4 ? '\0' : char(random());
+				}
+			}
+
+			const FDepotTextEncoderPlatformBase::Flags::Enum flags = flagsList[random() % flagsList.size()];
+			FDepotTextEncoderPlatformReference<CharType> reference(flags);
+			const DepotString expected = EncodeChunks<CharType>(reference, chunks);
+
+			for (DepotTextLineEnd::Method::Enum method : { DepotTextLineEnd::Method::Scalar, DepotTextLineEnd::Method::Sse2, DepotTextLineEnd::Method::Avx2 })
+			{
+				FDepotTextEncoderPlatform<CharType> encoder(flags, method);
+				Assert(EncodeChunks<CharType>(encoder, chunks) == expected);
+			}
+		}
+	}
+}
+
+void TestDepotClientTextEncoder(const TestContext& context)
+{
+	using namespace TestDepotClientTextEncoderInternal;
+	std::mt19937 random(0x50345646);
+	FuzzTextEncoder<char>(random, 20000);
+	FuzzTextEncoder<wchar_t>(random, 20000);
+
+	// Blocks with a line feed at either end, and runs of line feeds across block boundaries
+	for (size_t length = 0; length < 100; ++length)
+	{
+		for (size_t lfIndex = 0; lfIndex < length; ++lfIndex)
+		{
+			DepotString text(length, 'x');
+			text[lfIndex] = '\n';
+			text[length-1] = '\n';
+
+			DepotString expected(length*2, '\0');
+			expected.resize(DepotTextLineEnd::InsertCr(text.data(), text.size(), &expected[0], DepotTextLineEnd::Method::Scalar));
+			for (DepotTextLineEnd::Method::Enum method : { DepotTextLineEnd::Method::Sse2, DepotTextLineEnd::Method::Avx2 })
+			{
+				DepotString output(length*2, '\0');
+				output.resize(DepotTextLineEnd::InsertCr(text.data(), text.size(), &output[0], method));
+				Assert(output == expected);
+			}
+		}
+	}
+
+	Assert(DepotTextLineEnd::IsMethodSupported(DepotTextLineEnd::GetDefaultMethod()));
+}
+
+void TestDepotClientTextEncoderBenchmark(const TestContext& context)
+{
+	using namespace TestDepotClientTextEncoderInternal;
+	const size_t textSize = 256*1024*1024;
+	const size_t chunkSize = 64*1024;
+
+	DepotString text;
+	text.reserve(textSize);
+	while (text.size() < textSize)
+	{
+		text.append(StringInfo::Format("\t\tconst DepotString& depotFile%I64u = node.DepotFile(); // generated text asset line\n", uint64_t(text.size())));
+	}
+
+	// The text is encoded in chunks of the size which the client receives from the server
+	auto encodeText = [&text, chunkSize](FDepotTextEncoder& encoder) -> int64_t
+	{
+		DepotStopwatch timer(DepotStopwatch::Init::Start);
+		size_t outputSize = 0;
+		for (size_t offset = 0; offset < text.size(); offset += chunkSize)
+		{
+			const char* data = text.data() + offset;
+			int32_t length = int32_t(std::min(chunkSize, text.size() - offset));
+			encoder.Encode(&data, &length);
+			outputSize += size_t(length);
+		}
+		Assert(outputSize > text.size());
+		return timer.TotalMilliseconds();
+	};
+
+	FDepotTextEncoderPlatformReference<char> reference(FDepotTextEncoderPlatformBase::Flags::CrLf);
+	const int64_t referenceMs = encodeText(reference);
+	context.Log()->Info(StringInfo::Format("TextEncoder reference %I64u MB: %I64dms (%.0f MB/sec)", uint64_t(text.size()>>20), referenceMs, double(text.size()>>20)*1000.0/double(std::max<int64_t>(1, referenceMs))));
+
+	for (DepotTextLineEnd::Method::Enum method : { DepotTextLineEnd::Method::Scalar, DepotTextLineEnd::Method::Sse2, DepotTextLineEnd::Method::Avx2 })
+	{
+		if (DepotTextLineEnd::IsMethodSupported(method))
+		{
+			FDepotTextEncoderPlatform<char> encoder(FDepotTextEncoderPlatformBase::Flags::CrLf, method);
+			const int64_t encodeMs = encodeText(encoder);
+			context.Log()->Info(StringInfo::Format("TextEncoder method %d %I64u MB: %I64dms (%.0f MB/sec)", int32_t(method), uint64_t(text.size()>>20), encodeMs, double(text.size()>>20)*1000.0/double(std::max<int64_t>(1, encodeMs))));
+		}
+	}
+}
+
+void TestDepotClientTelemetry(const TestContext& context)
+{
+	Assert(DepotTelemetry::GetHistogramBucket(-1) == 0);
+	Assert(DepotTelemetry::GetHistogramBucket(0) == 0);
+	Assert(DepotTelemetry::GetHistogramBucket(1) == 1);
+	Assert(DepotTelemetry::GetHistogramBucket(2) == 2);
+	Assert(DepotTelemetry::GetHistogramBucket(3) == 2);
+	Assert(DepotTelemetry::GetHistogramBucket(1000) == 10);
+	Assert(DepotTelemetry::GetHistogramBucket(INT64_MAX) == FDepotCommandStats::HistogramBucketCount-1);
+
+	auto findStats = [](const DepotCommandStatsArray& stats, const char* name) -> const FDepotCommandStats*
+	{
+		for (const FDepotCommandStats& s : stats)
+		{
+			if (s.m_Name == name)
+				return &s;
+		}
+		return nullptr;
+	};
+
+	// Samples recorded by many threads are summed by name, and the client time of a sample is at most its total time
+	DepotTelemetry::Reset();
+	const size_t threadCount = 8;
+	const size_t sampleCount = 1000;
+	Array<size_t> threads(threadCount);
+	std::iota(threads.begin(), threads.end(), size_t(0));
+	ThreadPool::ForEach::Execute(threads.size(), threads.data(), threads.size(), NULL, [&](size_t threadIndex) -> void
+	{
+		for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
+		{
+			FDepotCommandSample sample;
+			sample.m_Name = sampleIndex % 2 ? "test-fstat" : "test-print";
+			sample.m_ArgCount = 2;
+			sample.m_RecordCount = 3;
+			sample.m_ByteCount = 100;
+			sample.m_ErrorCount = threadIndex == 0 ? 1 : 0;
+			sample.m_TotalUs = 1000;
+			sample.m_ClientUs = sampleIndex % 2 ? 250 : 5000;
+			DepotTelemetry::Record(sample);
+		}
+	});
+
+	const DepotCommandStatsArray stats = DepotTelemetry::GetStats();
+	const FDepotCommandStats* fstat = findStats(stats, "test-fstat");
+	const FDepotCommandStats* print = findStats(stats, "test-print");
+	Assert(fstat && print);
+	Assert(fstat->m_Count == threadCount*sampleCount/2);
+	Assert(fstat->m_ErrorCount == sampleCount/2);
+	Assert(fstat->m_ArgCount == fstat->m_Count*2);
+	Assert(fstat->m_RecordCount == fstat->m_Count*3);
+	Assert(fstat->m_ByteCount == fstat->m_Count*100);
+	Assert(fstat->m_TotalUs == fstat->m_Count*1000);
+	Assert(fstat->m_ClientUs == fstat->m_Count*250);
+	Assert(fstat->m_ServerUs == fstat->m_Count*750);
+	Assert(fstat->m_MaxUs == 1000);
+	Assert(fstat->m_Histogram[DepotTelemetry::GetHistogramBucket(1000)] == fstat->m_Count);
+	Assert(print->m_ClientUs == print->m_TotalUs);
+	Assert(print->m_ServerUs == 0);
+
+	// The difference from a baseline holds only the samples recorded since
+	FDepotCommandSample sample;
+	sample.m_Name = "test-fstat";
+	sample.m_TotalUs = 10;
+	DepotTelemetry::Record(sample);
+	const DepotCommandStatsArray diff = DepotTelemetry::Subtract(DepotTelemetry::GetStats(), stats);
+	Assert(diff.size() == 1);
+	Assert(diff[0].m_Name == "test-fstat");
+	Assert(diff[0].m_Count == 1);
+	Assert(diff[0].m_TotalUs == 10);
+	Assert(diff[0].m_Histogram[DepotTelemetry::GetHistogramBucket(10)] == 1);
+
+	const DepotString json = DepotTelemetry::ToJson(diff);
+	context.Log()->Info(StringInfo::Format("Telemetry: %s", json.c_str()));
+	Assert(json == "{\"commands\":[{\"name\":\"test-fstat\",\"count\":1,\"errors\":0,\"args\":0,\"records\":0,\"bytes\":0,\"totalUs\":10,\"serverUs\":10,\"clientUs\":0,\"maxUs\":1000,\"histogram\":[0,0,0,0,1]}]}");
+	Assert(DepotTelemetry::ToJson(DepotCommandStatsArray()) == "{\"commands\":[]}");
+
+	DepotTelemetry::Reset();
+	Assert(DepotTelemetry::GetStats().empty());
+
+	// Commands run by a DepotClient are recorded only while the setting is enabled
+	Assert(DepotTelemetry::IsEnabled() == false);
+	SettingPropertyScope<bool> telemetry(SettingManager::StaticInstance().DepotClientTelemetry, true);
+	Assert(DepotTelemetry::IsEnabled());
+}
@@ -3,7 +3,13 @@
 #include "Pch.h"
 #include "TestFactory.h"
 #include "DepotClientCache.h"
+#include "DepotConnectionCache.h"
 #include "SettingManager.h"
+#include "DepotDateTime.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <numeric>
+#include <random>
 
 using namespace Microsoft::P4VFS::FileCore;
 using namespace Microsoft::P4VFS::TestCore;
@@ -135,3 +141,430 @@ void TestDepotClientCacheCommon(const TestContext& context)
 	Assert(fileContext.m_DepotClientCache->GetFreeCount() == 0);
 }
 
+
+void TestDepotClientCacheConnection(const TestContext& context)
+{
+	// A scripted stand-in for a server, which counts the commands it is sent
+	struct FScriptedServer
+	{
+		Map<DepotString, size_t> m_CommandCount;
+		bool m_IsTrusted = true;
+		bool m_IsLoggedIn = true;
+		DepotString m_Access;
+		DepotString m_TicketExpiration = "43200";
+
+		size_t TotalCount() const
+		{
+			size_t count = 0;
+			for (const auto& command : m_CommandCount)
+				count += command.second;
+			return count;
+		}
+
+		void Run(const DepotCommand& cmd, FDepotResult& result)
+		{
+			m_CommandCount[cmd.m_Name]++;
+			if (m_IsTrusted == false && cmd.m_Name != "trust")
+			{
+				result.SetError("The authenticity of 'p4vfstest:1666' can't be established, use the 'p4 trust' command");
+			}
+			else if (cmd.m_Name == "trust")
+			{
+				m_IsTrusted = true;
+			}
+			else if (cmd.m_Name == "client")
+			{
+				result.BeginTag();
+				result.AddTagField("Client", "p4vfstest-depot");
+				result.AddTagField("Owner", "p4vfstest");
+				result.AddTagField("Root", "c:\\p4vfstest\\depot");
+				if (m_Access.empty() == false)
+					result.AddTagField("Access", m_Access.c_str());
+				result.EndTag();
+			}
+			else if (cmd.m_Name == "login")
+			{
+				if (m_IsLoggedIn == false)
+				{
+					result.SetError("Perforce password (P4PASSWD) invalid or unset.");
+					return;
+				}
+				result.BeginTag();
+				result.AddTagField("User", "p4vfstest");
+				result.AddTagField("TicketExpiration", m_TicketExpiration.c_str());
+				result.EndTag();
+			}
+		}
+	};
+
+	FScriptedServer server;
+	DepotConnectionCache cache;
+	const DepotString key = DepotConnectionCache::CreateKey("p4vfstest:1666", "p4vfstest", "p4vfstest-depot", "c:\\users\\a\\p4tickets.txt", "c:\\users\\a\\.p4trust");
+
+	auto query = [&server, &cache](const DepotString& queryKey) -> DepotConnectionMetadata
+	{
+		return cache.Query(queryKey, 
+			[&server](const DepotCommand& cmd, FDepotResult& result) -> void
+			{
+				server.Run(cmd, result);
+			},
+			[](DepotConnectionMetadata& protocol) -> void
+			{
+				protocol.m_IsServerUnicode = true;
+				protocol.m_ServerApiLevel = 51;
+			});
+	};
+
+	// The first connection runs client and login commands, and the next connections run none
+	DepotConnectionMetadata metadata = query(key);
+	Assert(metadata.m_IsLoginRequired == false);
+	Assert(metadata.m_Client.get() != nullptr && metadata.m_Client->Client() == "p4vfstest-depot");
+	Assert(server.m_CommandCount["client"] == 1 && server.m_CommandCount["login"] == 1 && server.TotalCount() == 2);
+	for (size_t connectIndex = 0; connectIndex < 10; ++connectIndex)
+	{
+		metadata = query(key);
+		Assert(metadata.m_IsLoginRequired == false);
+		Assert(metadata.m_IsServerUnicode && metadata.m_ServerApiLevel == 51);
+		Assert(metadata.m_Client->Root() == "c:\\p4vfstest\\depot");
+	}
+	Assert(server.TotalCount() == 2);
+	Assert(cache.GetCount() == 1);
+
+	// Each connection is given its own copy of the client spec
+	Assert(query(key).m_Client.get() != query(key).m_Client.get());
+
+	// A different client is cached separately
+	query(DepotConnectionCache::CreateKey("p4vfstest:1666", "p4vfstest", "p4vfstest-other", "c:\\users\\a\\p4tickets.txt", "c:\\users\\a\\.p4trust"));
+	query(DepotConnectionCache::CreateKey("p4vfstest:1666", "p4vfstest", "P4VFSTEST-OTHER", "c:\\users\\a\\p4tickets.txt", "c:\\users\\a\\.p4trust"));
+	Assert(server.TotalCount() == 4);
+	Assert(cache.GetCount() == 2);
+
+	// The same user and client of another Windows user, whose tickets and trust files are its own, is cached separately
+	query(DepotConnectionCache::CreateKey("p4vfstest:1666", "p4vfstest", "p4vfstest-depot", "c:\\users\\b\\p4tickets.txt", "c:\\users\\b\\.p4trust"));
+	Assert(server.TotalCount() == 6);
+	Assert(cache.GetCount() == 3);
+
+	// A login error invalidates the entry, and a connection which requires login is not stored
+	FDepotResult expired;
+	expired.SetError("Your session has expired, please login again.");
+	Assert(DepotConnectionCache::IsInvalidatingError(expired));
+	FDepotResult missing;
+	missing.SetError("//depot/missing.txt - no such file(s).");
+	Assert(DepotConnectionCache::IsInvalidatingError(missing) == false);
+
+	cache.Invalidate(key);
+	server.m_IsLoggedIn = false;
+	server.m_CommandCount.clear();
+	Assert(query(key).m_IsLoginRequired);
+	Assert(query(key).m_IsLoginRequired);
+	Assert(server.m_CommandCount["client"] == 2 && server.m_CommandCount["login"] == 2);
+
+	// An untrusted server is trusted once, and a client with an access time needs no login
+	cache.Clear();
+	server.m_IsLoggedIn = true;
+	server.m_IsTrusted = false;
+	server.m_Access = "1700000000";
+	server.m_CommandCount.clear();
+	Assert(query(key).m_IsLoginRequired == false);
+	Assert(query(key).m_IsLoginRequired == false);
+	Assert(server.m_CommandCount["client"] == 2 && server.m_CommandCount["trust"] == 1 && server.TotalCount() == 3);
+
+	// An entry is not kept beyond the expiration of its ticket, nor the configured timeout
+	cache.Clear();
+	server.m_Access.clear();
+	server.m_TicketExpiration = "0";
+	server.m_CommandCount.clear();
+	query(key);
+	query(key);
+	Assert(server.m_CommandCount["login"] == 2);
+	Assert(cache.GetCount() == 0);
+
+	server.m_TicketExpiration = "43200";
+	{
+		SettingPropertyScope<int32_t> timeoutScope(SettingManager::StaticInstance().DepotConnectionCacheTimeoutMs, 50);
+		server.m_CommandCount.clear();
+		query(key);
+		query(key);
+		Assert(server.m_CommandCount["login"] == 1);
+		Sleep(100);
+		query(key);
+		Assert(server.m_CommandCount["login"] == 2);
+	}
+	{
+		SettingPropertyScope<int32_t> timeoutScope(SettingManager::StaticInstance().DepotConnectionCacheTimeoutMs, 0);
+		cache.Clear();
+		server.m_CommandCount.clear();
+		query(key);
+		query(key);
+		Assert(server.m_CommandCount["login"] == 2);
+		Assert(cache.GetCount() == 0);
+	}
+
+	context.Log()->Info(StringInfo::Format("Connection cache scripted server received %d commands", int32_t(server.TotalCount())));
+}
+
+void TestDepotClientCachePool(const TestContext& context)
+{
+	FileContext fileContext;
+	fileContext.m_LogDevice = context.m_FileContext ? context.m_FileContext->m_LogDevice : nullptr;
+
+	DepotConfig slowConfig;
+	slowConfig.m_Port = "slow:1666";
+	slowConfig.m_User = "p4vfstest";
+	slowConfig.m_Client = "p4vfstest-depot";
+	DepotConfig fastConfig = slowConfig;
+	fastConfig.m_Port = "fast:1666";
+	DepotConfig brokenConfig = slowConfig;
+	brokenConfig.m_Port = "broken:1666";
+
+	// A stand-in connect which blocks on the slow server until it is released
+	AutoHandle slowConnectStarted(CreateEvent(NULL, TRUE, FALSE, NULL));
+	AutoHandle slowConnectReleased(CreateEvent(NULL, TRUE, FALSE, NULL));
+	std::atomic<size_t> connectCount(0);
+	CriticalSection invalidLock;
+	Set<const FDepotClient*> invalidClients;
+
+	DepotClientCache cache;
+	cache.SetConnectCommand([&](FDepotClient& client, const DepotConfig& config) -> bool
+	{
+		connectCount++;
+		if (config.m_Port == slowConfig.m_Port)
+		{
+			SetEvent(slowConnectStarted.Handle());
+			Assert(WaitForSingleObject(slowConnectReleased.Handle(), 10000) == WAIT_OBJECT_0);
+		}
+		return config.m_Port != brokenConfig.m_Port;
+	});
+	cache.SetValidateCommand([&](FDepotClient& client, int64_t timeoutSeconds) -> bool
+	{
+		AutoCriticalSection lock(invalidLock);
+		return invalidClients.find(&client) == invalidClients.end();
+	});
+
+	// Allocations for one server complete while a connection to another server is still being made
+	std::atomic<bool> slowConnected(false);
+	std::atomic<size_t> fastAllocCount(0);
+	Array<size_t> stages(2);
+	std::iota(stages.begin(), stages.end(), size_t(0));
+	ThreadPool::ForEach::Execute(stages.size(), stages.data(), stages.size(), NULL, [&](size_t stage) -> void
+	{
+		if (stage == 0)
+		{
+			DepotClient client = cache.Alloc(slowConfig, fileContext);
+			Assert(client.get() != nullptr);
+			slowConnected = true;
+			cache.Free(slowConfig, client);
+			return;
+		}
+
+		Assert(WaitForSingleObject(slowConnectStarted.Handle(), 10000) == WAIT_OBJECT_0);
+		for (size_t allocIndex = 0; allocIndex < 100; ++allocIndex)
+		{
+			DepotClient client = cache.Alloc(fastConfig, fileContext);
+			Assert(client.get() != nullptr);
+			cache.Free(fastConfig, client);
+			fastAllocCount++;
+		}
+		Assert(slowConnected == false);
+		SetEvent(slowConnectReleased.Handle());
+	});
+
+	Assert(slowConnected && fastAllocCount == 100);
+	Assert(connectCount == 2);
+	Assert(cache.GetFreeCount(slowConfig) == 1 && cache.GetFreeCount(fastConfig) == 1);
+	Assert(cache.GetPoolCount() == 2);
+
+	// Recently used pools are connected up to the warm count
+	cache.Maintain(3, 60);
+	Assert(cache.GetFreeCount(slowConfig) == 3 && cache.GetFreeCount(fastConfig) == 3);
+	Assert(connectCount == 2 + 2 + 2);
+
+	// Allocations are taken from the warm clients, without connecting
+	Array<DepotClient> fastClients;
+	for (size_t allocIndex = 0; allocIndex < 3; ++allocIndex)
+	{
+		fastClients.push_back(cache.Alloc(fastConfig, fileContext));
+		Assert(fastClients.back().get() != nullptr);
+	}
+	Assert(connectCount == 6);
+	Assert(cache.GetFreeCount(fastConfig) == 0);
+
+	// Clients found to be invalid when they are maintained are discarded and replaced
+	for (DepotClient& client : fastClients)
+	{
+		invalidClients.insert(client.get());
+		cache.Free(fastConfig, client);
+	}
+	Assert(cache.GetFreeCount(fastConfig) == 3);
+	cache.Maintain(0, 60);
+	Assert(cache.GetFreeCount(fastConfig) == 0);
+	invalidClients.clear();
+	cache.Maintain(2, 60);
+	Assert(cache.GetFreeCount(fastConfig) == 2);
+	Assert(connectCount == 8);
+
+	// A failed connection is not returned, and leaves nothing in its pool
+	Assert(cache.Alloc(brokenConfig, fileContext).get() == nullptr);
+	Assert(cache.GetFreeCount(brokenConfig) == 0);
+	Assert(connectCount == 9);
+
+	// Pools which are no longer used are not connected, and are removed once empty
+	Assert(cache.GetPoolCount() == 3);
+	cache.Maintain(3, 0);
+	Assert(cache.GetFreeCount() == 3 + 2);
+	Assert(cache.GetPoolCount() == 2);
+	Assert(connectCount == 9);
+
+	// An idle client which is no longer valid is discarded when it is allocated, and the next idle client is used instead
+	{
+		Assert(cache.GetFreeCount(fastConfig) == 2);
+		DepotClient client = cache.Alloc(fastConfig, fileContext);
+		invalidClients.insert(client.get());
+		cache.Free(fastConfig, client);
+		client = cache.Alloc(fastConfig, fileContext);
+		Assert(client.get() != nullptr && invalidClients.find(client.get()) == invalidClients.end());
+		Assert(cache.GetFreeCount(fastConfig) == 0);
+		Assert(connectCount == 9);
+		cache.Free(fastConfig, client);
+		invalidClients.clear();
+	}
+
+	// An idle allocation discards an idle client which is no longer valid, and does not connect a new one
+	{
+		Assert(cache.GetFreeCount(fastConfig) == 1);
+		DepotClient client = cache.AllocIdle(fastConfig, fileContext);
+		Assert(client.get() != nullptr);
+		invalidClients.insert(client.get());
+		cache.Free(fastConfig, client);
+		Assert(cache.AllocIdle(fastConfig, fileContext).get() == nullptr);
+		Assert(cache.GetFreeCount(fastConfig) == 0);
+		Assert(connectCount == 9);
+		invalidClients.clear();
+	}
+
+	cache.Clear();
+	Assert(cache.GetFreeCount() == 0);
+	Assert(cache.GetPoolCount() == 0);
+}
+
+void TestDepotClientCacheBenchmark(const TestContext& context)
+{
+	const size_t threadCount = 16;
+	const size_t allocCount = 100;
+	const size_t keyCount = 8;
+	const DWORD slowConnectMs = 50;
+	const DWORD fastConnectMs = 5;
+
+	// Connections to the first key are slow, and are never returned to the cache
+	Array<DepotConfig> configs(keyCount);
+	for (size_t keyIndex = 0; keyIndex < keyCount; ++keyIndex)
+	{
+		configs[keyIndex].m_Port = StringInfo::Format("p4vfstest%d:1666", int32_t(keyIndex));
+		configs[keyIndex].m_User = "p4vfstest";
+		configs[keyIndex].m_Client = "p4vfstest-depot";
+	}
+
+	auto connect = [&configs, slowConnectMs, fastConnectMs](const DepotConfig& config) -> bool
+	{
+		Sleep(config.m_Port == configs[0].m_Port ? slowConnectMs : fastConnectMs);
+		return true;
+	};
+
+	// A cache as it was before pools, which holds a single lock while it connects
+	struct FGlobalLockCache
+	{
+		CriticalSection m_Lock;
+		UnorderedMultiMap<DepotString, DepotClient, StringInfo::Hash, StringInfo::EqualInsensitive> m_Free;
+	};
+
+	struct FResult
+	{
+		int64_t m_TotalUs = 0;
+		int64_t m_FastTotalUs = 0;
+		int64_t m_FastMaxUs = 0;
+		size_t m_FastCount = 0;
+	};
+
+	auto runBenchmark = [&](const std::function<DepotClient(const DepotConfig&)>& alloc, const std::function<void(const DepotConfig&, DepotClient)>& free) -> FResult
+	{
+		FResult result;
+		CriticalSection resultLock;
+		DepotStopwatch totalTimer(DepotStopwatch::Init::Start);
+		Array<size_t> threads(threadCount);
+		std::iota(threads.begin(), threads.end(), size_t(0));
+		ThreadPool::ForEach::Execute(threads.size(), threads.data(), threads.size(), NULL, [&](size_t threadIndex) -> void
+		{
+			std::mt19937 random(uint32_t(threadIndex));
+			for (size_t allocIndex = 0; allocIndex < allocCount; ++allocIndex)
+			{
+				const size_t keyIndex = random() % keyCount;
+				DepotStopwatch allocTimer(DepotStopwatch::Init::Start);
+				DepotClient client = alloc(configs[keyIndex]);
+				const int64_t allocUs = allocTimer.TotalMicroseconds();
+				Assert(client.get() != nullptr);
+				if (keyIndex != 0)
+				{
+					free(configs[keyIndex], client);
+					AutoCriticalSection lock(resultLock);
+					result.m_FastTotalUs += allocUs;
+					result.m_FastMaxUs = std::max(result.m_FastMaxUs, allocUs);
+					result.m_FastCount++;
+				}
+			}
+		});
+		result.m_TotalUs = totalTimer.TotalMicroseconds();
+		return result;
+	};
+
+	FGlobalLockCache globalCache;
+	const FResult globalResult = runBenchmark(
+		[&](const DepotConfig& config) -> DepotClient
+		{
+			AutoCriticalSection lock(globalCache.m_Lock);
+			const DepotString key = StringInfo::Format("%s,%s,%s", config.m_Port.c_str(), config.m_User.c_str(), config.m_Client.c_str());
+			auto clientIt = globalCache.m_Free.find(key);
+			if (clientIt != globalCache.m_Free.end())
+			{
+				DepotClient client = clientIt->second;
+				globalCache.m_Free.erase(clientIt);
+				return client;
+			}
+			DepotClient client = FDepotClient::New();
+			return connect(config) ? client : nullptr;
+		},
+		[&](const DepotConfig& config, DepotClient client) -> void
+		{
+			AutoCriticalSection lock(globalCache.m_Lock);
+			const DepotString key = StringInfo::Format("%s,%s,%s", config.m_Port.c_str(), config.m_User.c_str(), config.m_Client.c_str());
+			globalCache.m_Free.insert(std::make_pair(key, client));
+		});
+
+	FileContext fileContext;
+	DepotClientCache cache;
+	cache.SetConnectCommand([&connect](FDepotClient& client, const DepotConfig& config) -> bool
+	{
+		return connect(config);
+	});
+	const FResult poolResult = runBenchmark(
+		[&](const DepotConfig& config) -> DepotClient
+		{
+			return cache.Alloc(config, fileContext);
+		},
+		[&](const DepotConfig& config, DepotClient client) -> void
+		{
+			cache.Free(config, client);
+		});
+
+	auto report = [&context](const char* name, const FResult& result) -> void
+	{
+		context.Log()->Info(StringInfo::Format("%s: total %.1f ms, other key alloc average %.1f us, max %.1f ms", 
+			name, 
+			result.m_TotalUs/1000.0, 
+			result.m_FastCount ? double(result.m_FastTotalUs)/result.m_FastCount : 0.0, 
+			result.m_FastMaxUs/1000.0));
+	};
+
+	report("GlobalLock", globalResult);
+	report("PerKeyPool", poolResult);
+	Assert(poolResult.m_FastMaxUs < globalResult.m_FastMaxUs);
+}
@@ -6,6 +6,22 @@
 #include "DepotResultWhere.h"
 #include "FileSystem.h"
 #include "DepotOperations.h"
+#include "DepotFlushBatcher.h"
+#include "DepotSyncPipeline.h"
+#include "DepotResidentMatcher.h"
+#include "DepotSyncJournal.h"
+#include "DepotSyncActionTable.h"
+#include "DepotSyncActionScanner.h"
+#include "DepotResidentDownloader.h"
+#include "DepotConcurrencyController.h"
+#include "DepotContentCache.h"
+#include "DepotContentShare.h"
+#include "ThreadPool.h"
+#include "SettingManager.h"
+#include <random>
+#include <queue>
+#include <numeric>
+#include <psapi.h>
 
 using namespace Microsoft::P4VFS::FileCore;
 using namespace Microsoft::P4VFS::TestCore;
@@ -20,7 +36,7 @@ void TestDepotOperationsSync(const TestContext& context)
 	DepotResult changes = client->Run(DepotCommand("changes"));
 	Assert(changes->HasError() == false);
 	Assert(changes->TagList().size() > 0);
-	Assert(changes->TagList().size() == size_t(std::count_if(changes->TagList().begin(), changes->TagList().end(), [](const DepotResultTag& t) -> bool { return t->m_Fields.find("change") != t->m_Fields.end(); })));
+	Assert(changes->TagList().size() == size_t(std::count_if(changes->TagList().begin(), changes->TagList().end(), [](const DepotResultTag& t) -> bool { return t->ContainsKey("change"); })));
 
 	DepotRevision headChange = DepotOperations::GetHeadRevisionChangelist(client);
 	Assert(headChange.get());
@@ -47,7 +63,7 @@ void TestDepotOperationsSync(const TestContext& context)
 				DepotSyncResult syncResult = DepotOperations::Sync(client, DepotStringArray{ fileSpec }, nullptr, syncFlags, syncMethod);
 				Assert(syncResult.get() != nullptr);
 				Assert(syncResult->m_Status == DepotSyncStatus::Success);
-				Assert(syncResult->m_Modifications.get() && syncResult->m_Modifications->size() > 0);
+				Assert(syncResult->m_Modifications.get() && syncResult->m_Modifications->Count() > 0);
 				Assert(client->Run(DepotCommand("flush", DepotStringArray{ "-f", fileSpec }))->HasError() == false);
 				Assert(context.m_ReconcilePreviewAny(TEXT("//...")) == false);
 			}
@@ -69,7 +85,7 @@ void TestDepotOperationsSyncStatus(const TestContext& context)
 				DepotSyncResult syncResult = DepotOperations::Sync(client, DepotStringArray{ fileSpec }, nullptr, syncFlags, syncMethod);
 				Assert(syncResult.get() != nullptr);
 				Assert(syncResult->m_Status == status);
-				Assert((modificationCount < 0 && syncResult->m_Modifications.get() == nullptr) || (syncResult->m_Modifications.get() && int32_t(syncResult->m_Modifications->size()) == modificationCount));
+				Assert((modificationCount < 0 && syncResult->m_Modifications.get() == nullptr) || (syncResult->m_Modifications.get() && int32_t(syncResult->m_Modifications->Count()) == modificationCount));
 				Assert(context.m_ReconcilePreviewAny(TEXT("//...")) == false);
 			}
 		}
@@ -127,8 +143,8 @@ void TestDepotOperationsToString(const TestContext& context)
 	Assert(FDepotRevision::ToString(DepotRevision()) == "");
 }
 
-void TestDepotOperationsCreateFileSpec(const TestContext& context)
-{
+namespace TestDepotOperationsCreateFileSpecInternal {
+
 	struct FLegacyDepotClient
 	{
 		static DepotString CreateFileSpec(const DepotString& filePath, const DepotRevision& revision, DepotOperations::CreateFileSpecFlags::Enum flags)
@@ -156,26 +172,75 @@ void TestDepotOperationsCreateFileSpec(const TestContext& context)
 			return StringInfo::Format("%s%s", fileSpecPath.c_str(), FDepotRevision::ToString(parsedRev).c_str());
 		}
 	};
+}
+
+void TestDepotOperationsCreateFileSpec(const TestContext& context)
+{
+	using namespace TestDepotOperationsCreateFileSpecInternal;
 
 	#define TestCreateFileSpec(...) Assert(DepotOperations::CreateFileSpec(__VA_ARGS__) == FLegacyDepotClient::CreateFileSpec(__VA_ARGS__))
 	for (const DepotString& path : DepotStringArray({ "", "//depot/gears1", "//depot/gears1/...", "D:\\depot\\gears1", "D:\\depot\\gears1\\..." }))
 	{
-		for (const DepotString& rev : DepotStringArray({ "", "@1234", "#have", "@my_label", "#", "@" }))
+		for (const DepotString& rev : DepotStringArray({ "", "@1234", "#have", "@my_label", "#", "@", "#0", "#00012", "#NONE", "@now", "#head\t", "#-1", "#2147483648", "@2019/08/15", "#4,8", "@=77" }))
 		{
 			TestCreateFileSpec(path, nullptr, DepotOperations::CreateFileSpecFlags::None);
 			TestCreateFileSpec(path+rev, nullptr, DepotOperations::CreateFileSpecFlags::None);
 			TestCreateFileSpec(path, nullptr, DepotOperations::CreateFileSpecFlags::OverrideRevison);
 			TestCreateFileSpec(path+rev, nullptr, DepotOperations::CreateFileSpecFlags::OverrideRevison);
 
-			TestCreateFileSpec(path, FDepotRevision::New<FDepotRevisionHead>(), DepotOperations::CreateFileSpecFlags::None);
-			TestCreateFileSpec(path+rev, FDepotRevision::New<FDepotRevisionHead>(), DepotOperations::CreateFileSpecFlags::None);
-			TestCreateFileSpec(path, FDepotRevision::New<FDepotRevisionHead>(), DepotOperations::CreateFileSpecFlags::OverrideRevison);
-			TestCreateFileSpec(path+rev, FDepotRevision::New<FDepotRevisionHead>(), DepotOperations::CreateFileSpecFlags::OverrideRevison);
+			for (const DepotRevision& revision : Array<DepotRevision>({ 
+				FDepotRevision::New<FDepotRevisionHead>(), 
+				FDepotRevision::New<FDepotRevisionNumber>(7), 
+				FDepotRevision::New<FDepotRevisionNumber>(-1), 
+				FDepotRevision::New<FDepotRevisionChangelist>(5), 
+				FDepotRevision::New<FDepotRevisionLabel>("my_label") }))
+			{
+				TestCreateFileSpec(path, revision, DepotOperations::CreateFileSpecFlags::None);
+				TestCreateFileSpec(path+rev, revision, DepotOperations::CreateFileSpecFlags::None);
+				TestCreateFileSpec(path, revision, DepotOperations::CreateFileSpecFlags::OverrideRevison);
+				TestCreateFileSpec(path+rev, revision, DepotOperations::CreateFileSpecFlags::OverrideRevison);
+			}
 		}
 	}
 	#undef TestCreateFileSpec
 }
 
+void TestDepotOperationsCreateFileSpecBenchmark(const TestContext& context)
+{
+	using namespace TestDepotOperationsCreateFileSpecInternal;
+
+	const size_t fileCount = 1000000;
+	DepotSyncActionInfoArray modifications = std::make_shared<Array<DepotSyncActionInfo>>();
+	modifications->reserve(fileCount);
+	for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+	{
+		DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+		modification->m_DepotFile = StringInfo::Format("//depot/gears1/Folder%I64u/File%I64u.txt", uint64_t(fileIndex % 1000), uint64_t(fileIndex));
+		modification->m_Revision = FDepotRevisionValue(DepotRevisionType::Number, int32_t(1 + fileIndex % 2000)).ToRevision();
+		modifications->push_back(modification);
+	}
+
+	DepotClient depotClient;
+	DepotStopwatch valueTimer(DepotStopwatch::Init::Start);
+	DepotStringArray valueFileSpecs = DepotOperations::CreateFileSpecs(depotClient, modifications, nullptr, DepotOperations::CreateFileSpecFlags::None);
+	valueTimer.Stop();
+
+	DepotStopwatch legacyTimer(DepotStopwatch::Init::Start);
+	DepotStringArray legacyFileSpecs;
+	legacyFileSpecs.reserve(fileCount);
+	for (const DepotSyncActionInfo& modification : *modifications)
+	{
+		legacyFileSpecs.push_back(FLegacyDepotClient::CreateFileSpec(modification->m_DepotFile, modification->m_Revision, DepotOperations::CreateFileSpecFlags::None));
+	}
+	legacyTimer.Stop();
+
+	Assert(valueFileSpecs == legacyFileSpecs);
+	context.Log()->Info(StringInfo::Format("CreateFileSpecs files=%I64u value=%0.1fns/file legacy=%0.1fns/file", 
+		uint64_t(fileCount), 
+		valueTimer.DurationMilliseconds() * 1e6 / fileCount, 
+		legacyTimer.DurationMilliseconds() * 1e6 / fileCount));
+}
+
 void TestDepotOperationsToDisplayString(const TestContext& context)
 {
 	Assert(DepotOperations::ToDisplayStringBytes(uint64_t(0)) == "0 bytes");
@@ -211,3 +276,1932 @@ void TestDepotOperationsToDisplayString(const TestContext& context)
 	Assert(DepotOperations::ToDisplayStringMilliseconds(225083) == "225 sec (3:45.083)");
 	Assert(DepotOperations::ToDisplayStringMilliseconds(25003) == "25 sec (25.003)");
 }
+
+void TestDepotOperationsFlushBatcher(const TestContext& context)
+{
+	const size_t fileCount = 10000;
+	const size_t errorFileInterval = 997;
+
+	// A local stand-in for the depot server which counts 'sync -k' round trips, fails a known
+	// subset of files, and reports the rest as up-to-date
+	struct FakeDepot
+	{
+		std::atomic<size_t> m_RoundTrips = 0;
+		std::atomic<size_t> m_FileSpecs = 0;
+
+		DepotSyncActionInfoArray Flush(const DepotStringArray& fileSpecs, size_t errorFileInterval)
+		{
+			m_RoundTrips++;
+			m_FileSpecs += fileSpecs.size();
+			Sleep(1);
+
+			DepotSyncActionInfoArray errors = std::make_shared<DepotSyncActionInfoArray::element_type>();
+			for (const DepotString& fileSpec : fileSpecs)
+			{
+				const size_t fileIndex = size_t(atoi(fileSpec.c_str() + fileSpec.find_last_of('/') + 5));
+				const char* status = (fileIndex % errorFileInterval) == 0 ? "no such file(s)." : "file(s) up-to-date.";
+				errors->push_back(FDepotSyncActionInfo::FromErrorOutput(StringInfo::Format("%s - %s", fileSpec.c_str(), status), nullptr));
+			}
+			return errors;
+		}
+	};
+
+	Array<DepotSyncActionInfo> modifications;
+	for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+	{
+		DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+		modification->m_DepotFile = StringInfo::Format("//depot/fake/dir%02u/file%05u.txt", uint32_t(fileIndex % 64), uint32_t(fileIndex));
+		modification->m_ClientFile = StringInfo::Format("c:\\fake\\dir%02u\\file%05u.txt", uint32_t(fileIndex % 64), uint32_t(fileIndex));
+		modification->m_Revision = FDepotRevision::New<FDepotRevisionNumber>(int32_t(1 + fileIndex % 3));
+		modification->m_SyncActionType = DepotSyncActionType::Added;
+		modifications.push_back(modification);
+	}
+
+	const size_t expectedErrorCount = (fileCount + errorFileInterval - 1) / errorFileInterval;
+	for (size_t batchSize : { size_t(1), size_t(10), size_t(100), size_t(500), size_t(2000) })
+	{
+		for (const DepotSyncActionInfo& modification : modifications)
+		{
+			modification->m_FlushTime = -1;
+			modification->m_Message.clear();
+		}
+
+		FakeDepot depot;
+		DepotFlushBatcher flushBatcher(context.Log(), batchSize, -1, [&depot, errorFileInterval](DepotClient& depotClient, const DepotStringArray& fileSpecs) -> DepotSyncActionInfoArray
+		{
+			return depot.Flush(fileSpecs, errorFileInterval);
+		});
+
+		DepotStopwatch timer(DepotStopwatch::Init::Start);
+		ThreadPool::ForEach::Execute(8, modifications.data(), modifications.size(), NULL, [&flushBatcher](const DepotSyncActionInfo& modification) -> void
+		{
+			DepotClient depotClient;
+			flushBatcher.Add(depotClient, modification, DepotOperations::CreateFileSpec(modification->m_DepotFile, modification->m_Revision));
+		});
+
+		DepotClient depotClient;
+		flushBatcher.Flush(depotClient);
+		timer.Stop();
+
+		context.Log()->Info(StringInfo::Format("FlushBatcher batchSize=%I64u files=%I64u roundTrips=%I64u time=%I64dms", uint64_t(batchSize), uint64_t(fileCount), uint64_t(depot.m_RoundTrips), timer.TotalMilliseconds()));
+		Assert(depot.m_RoundTrips == (fileCount + batchSize - 1) / batchSize);
+		Assert(depot.m_FileSpecs == fileCount);
+		Assert(flushBatcher.GetBatchCount() == depot.m_RoundTrips);
+		Assert(flushBatcher.GetFileCount() == fileCount);
+		Assert(flushBatcher.GetErrorCount() == expectedErrorCount);
+
+		for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+		{
+			const DepotSyncActionInfo& modification = modifications[fileIndex];
+			Assert(modification->m_FlushTime >= 0);
+			Assert(modification->m_Message.empty() == ((fileIndex % errorFileInterval) != 0));
+		}
+	}
+
+	// An error which names no file of the batch fails the whole batch, so that none of its files are reported as flushed
+	{
+		size_t flushedCount = 0;
+		DepotFlushBatcher flushBatcher(context.Log(), 4, -1, [](DepotClient& depotClient, const DepotStringArray& fileSpecs) -> DepotSyncActionInfoArray
+		{
+			DepotSyncActionInfoArray errors = std::make_shared<DepotSyncActionInfoArray::element_type>();
+			errors->push_back(FDepotSyncActionInfo::FromErrorOutput("Your session has expired, please login again.", nullptr));
+			return errors;
+		});
+		flushBatcher.SetFlushedCallback([&flushedCount](const DepotSyncActionInfo& modification) -> void
+		{
+			flushedCount++;
+		});
+
+		DepotClient depotClient;
+		for (size_t fileIndex = 0; fileIndex < 4; ++fileIndex)
+		{
+			flushBatcher.Add(depotClient, modifications[fileIndex], DepotOperations::CreateFileSpec(modifications[fileIndex]->m_DepotFile, modifications[fileIndex]->m_Revision));
+		}
+		Assert(flushBatcher.GetBatchCount() == 1);
+		Assert(flushBatcher.GetErrorCount() == 5);
+		Assert(flushedCount == 0);
+	}
+
+	// A partial batch is executed once it expires, without waiting for another file to be added
+	{
+		size_t flushedCount = 0;
+		DepotFlushBatcher flushBatcher(context.Log(), 100, 20, [](DepotClient& depotClient, const DepotStringArray& fileSpecs) -> DepotSyncActionInfoArray
+		{
+			return std::make_shared<DepotSyncActionInfoArray::element_type>();
+		});
+		flushBatcher.SetFlushedCallback([&flushedCount](const DepotSyncActionInfo& modification) -> void
+		{
+			flushedCount++;
+		});
+
+		DepotClient depotClient;
+		Assert(flushBatcher.GetExpireWaitMs() == INFINITE);
+		flushBatcher.Add(depotClient, modifications[0], DepotOperations::CreateFileSpec(modifications[0]->m_DepotFile, modifications[0]->m_Revision));
+		Assert(flushBatcher.GetExpireWaitMs() <= 20);
+		flushBatcher.FlushExpired(depotClient);
+		Assert(flushBatcher.GetBatchCount() == 0);
+
+		Sleep(flushBatcher.GetExpireWaitMs() + 5);
+		flushBatcher.FlushExpired(depotClient);
+		Assert(flushBatcher.GetBatchCount() == 1);
+		Assert(flushedCount == 1);
+		Assert(flushBatcher.GetExpireWaitMs() == INFINITE);
+	}
+}
+
+void TestDepotOperationsSyncActionQueue(const TestContext& context)
+{
+	auto makeModification = [](size_t index) -> DepotSyncActionInfo
+	{
+		DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+		modification->m_DepotFile = StringInfo::Format("//depot/fake/file%05u.txt", uint32_t(index));
+		modification->m_FileSize = int64_t(index);
+		return modification;
+	};
+
+	{
+		DepotSyncActionQueue queue(4);
+		DepotSyncActionInfo modification;
+		Assert(queue.Capacity() == 4);
+		Assert(queue.TryPop(modification) == false);
+		for (size_t index = 0; index < queue.Capacity(); ++index)
+		{
+			Assert(queue.Push(makeModification(index)));
+		}
+
+		AutoHandle cancelationEvent(CreateEvent(NULL, TRUE, TRUE, NULL));
+		Assert(queue.Push(makeModification(queue.Capacity()), cancelationEvent.Handle()) == false);
+
+		queue.Close();
+		Assert(queue.Push(makeModification(queue.Capacity())) == false);
+		for (size_t index = 0; index < queue.Capacity(); ++index)
+		{
+			Assert(queue.Pop(modification));
+			Assert(modification->m_FileSize == int64_t(index));
+		}
+		Assert(queue.Pop(modification) == false);
+	}
+	{
+		DepotSyncActionQueue queue(4);
+		DepotSyncActionInfo modification;
+		AutoHandle cancelationEvent(CreateEvent(NULL, TRUE, TRUE, NULL));
+		Assert(queue.Pop(modification, cancelationEvent.Handle()) == false);
+	}
+	{
+		// A single producer streams through a small queue to several consumers, the same shape as the sync pipeline
+		const size_t itemCount = 20000;
+		DepotSyncActionQueue queue(16);
+		std::atomic<int64_t> consumedSum = 0;
+		std::atomic<size_t> consumedCount = 0;
+
+		Array<DepotSyncPipelineStage::Enum> stages = { DepotSyncPipelineStage::Preview };
+		stages.resize(stages.size() + 7, DepotSyncPipelineStage::Apply);
+
+		ThreadPool::ForEach::Execute(stages.size(), stages.data(), stages.size(), NULL, [&](DepotSyncPipelineStage::Enum stage) -> void
+		{
+			if (stage == DepotSyncPipelineStage::Preview)
+			{
+				for (size_t index = 0; index < itemCount; ++index)
+				{
+					Assert(queue.Push(makeModification(index)));
+				}
+				queue.Close();
+			}
+			else
+			{
+				DepotSyncActionInfo modification;
+				while (queue.Pop(modification))
+				{
+					consumedSum += modification->m_FileSize;
+					consumedCount++;
+				}
+			}
+		});
+
+		Assert(consumedCount == itemCount);
+		Assert(consumedSum == int64_t(itemCount*(itemCount-1)/2));
+	}
+}
+
+void TestDepotOperationsSyncPipeline(const TestContext& context)
+{
+	DepotClient client = FDepotClient::New(context.m_FileContext);
+	Assert(client->Connect(context.GetDepotConfig()));
+
+	const DepotStringArray fileSpecs = {
+		"//depot/tools/dev/source/CinematicCapture/...@16",
+		"//depot/tools/dev/source/CinematicCapture/...@18",
+		"//depot/tools/dev/source/Hammer/...@19",
+		"//depot/tools/dev/external/EsrpClient/1.1.5/Enable-EsrpClientLog.ps1",
+		"//depot/gears1/WarGame/Localization/INT/Human_Myrrah_Dialog.int",
+	};
+
+	auto syncResultToString = [](const DepotSyncResult& syncResult) -> DepotString
+	{
+		DepotStringArray lines;
+		const DepotSyncActionFlags::Enum resolvedFlags = DepotSyncActionFlags::FileWrite | DepotSyncActionFlags::HaveFileWrite | DepotSyncActionFlags::FileSymlink;
+		const FDepotSyncActionTable& table = *syncResult->m_Modifications;
+		for (size_t rowIndex = 0; rowIndex < table.Count(); ++rowIndex)
+		{
+			lines.push_back(StringInfo::Format("%s %s %s 0x%02x %I64d %I64d %I64d", 
+				table.DepotFile(rowIndex).c_str(), 
+				table.RevisionString(rowIndex).c_str(), 
+				DepotSyncActionType::ToString(table.SyncActionType(rowIndex)).c_str(), 
+				uint32_t(table.SyncActionFlags(rowIndex) & resolvedFlags), 
+				table.Value(DepotSyncActionColumn::FileSize, rowIndex), 
+				table.Value(DepotSyncActionColumn::VirtualFileSize, rowIndex), 
+				table.Value(DepotSyncActionColumn::DiskFileSize, rowIndex)));
+		}
+		std::sort(lines.begin(), lines.end());
+		return StringInfo::Format("%s\n%s", DepotSyncStatus::ToString(syncResult->m_Status).c_str(), StringInfo::Join(lines, "\n").c_str());
+	};
+
+	// The pipelined sync resolves the same action types, flags, and sizes as the sync which resolves the whole preview
+	DepotStringArray syncResults[2];
+	for (bool syncPipeline : { false, true })
+	{
+		SettingPropertyScope<bool> syncPipelineScope(SettingManager::StaticInstance().SyncPipeline, syncPipeline);
+		TestUtilities::WorkspaceReset(context);
+		for (const DepotString& fileSpec : fileSpecs)
+		{
+			DepotSyncResult syncResult = DepotOperations::Sync(client, DepotStringArray{ fileSpec }, nullptr, DepotSyncFlags::Normal, DepotSyncMethod::Virtual);
+			Assert(syncResult.get() != nullptr);
+			Assert(syncResult->m_Status == DepotSyncStatus::Success);
+			Assert(syncResult->m_Modifications.get() && syncResult->m_Modifications->Count() > 0);
+			syncResults[syncPipeline ? 1 : 0].push_back(syncResultToString(syncResult));
+		}
+		Assert(context.m_ReconcilePreviewAny(TEXT("//...")) == false);
+	}
+	Assert(syncResults[0].size() == fileSpecs.size());
+	Assert(syncResults[0] == syncResults[1]);
+
+	// A resolver which cannot connect cancels the pipeline, and every record which was not applied is returned as an error
+	TestUtilities::WorkspaceReset(context);
+	{
+		LogDeviceMemory log;
+		FDepotSyncActionTable::IndexArray resultRows;
+		DepotOperations::FSyncVirtualModificationParams params(&log, client, &resultRows);
+		params.m_Config.m_Port = "localhost:1";
+		params.m_Table = std::make_shared<FDepotSyncActionTable>();
+
+		FDepotSyncOptions syncOptions;
+		syncOptions.m_Files = fileSpecs;
+		DepotStopwatch previewTime(DepotStopwatch::Init::Start);
+		Assert(DepotOperations::SyncVirtualPipeline(params, syncOptions, nullptr, DepotSyncFlags::Normal, previewTime));
+		Assert(WaitForSingleObject(params.m_CancelationEvent.Handle(), 0) == WAIT_OBJECT_0);
+		Assert((DepotSyncStatus::FromLog(log) & DepotSyncStatus::Error) != 0);
+
+		const FDepotSyncActionTable& table = *params.m_Table;
+		Assert(table.Count() > 0);
+		std::sort(resultRows.begin(), resultRows.end());
+		Assert(resultRows.size() == table.Count());
+		for (size_t rowIndex = 0; rowIndex < table.Count(); ++rowIndex)
+		{
+			Assert(resultRows[rowIndex] == rowIndex);
+			Assert(table.SyncActionType(rowIndex) == DepotSyncActionType::GenericError);
+			Assert(table.Message(rowIndex).empty() == false);
+			Assert(FileInfo::Exists(CSTR_ATOW(table.ClientFile(rowIndex))) == false);
+		}
+	}
+}
+
+namespace TestDepotOperationsResidentMatcherInternal
+{
+	static const char* Patterns[] = {
+		"\\.(xml|txt)$",
+		"\\.XML$",
+		"\\.(?:exe|DLL|pdb)$",
+		"\\.cs$|\\.h$|^//depot/Src/inc/",
+		"^//depot/Tools/",
+		"^(//depot/a/|//depot/b/)",
+		"^(?!.*(\\.(xml|txt)$)).*$",
+		"(xml|)$",
+		"\\.(png|jpe?g)$",
+		"[ab]\\.txt$",
+		"\\d+\\.txt$",
+		"^//depot/x$",
+		"file",
+		"^(?!.*(file)).*$",
+	};
+
+	static DepotStringArray CreateDepotFiles(size_t count)
+	{
+		static const char* folders[] = { "//depot/tools/", "//depot/a/", "//Depot/B/", "//depot/c/", "//depot/src/INC/", "//depot/x", "//depot/file/" };
+		static const char* extensions[] = { ".xml", ".TXT", ".png", ".jpg", ".jpeg", ".exe", ".dll", ".pdb", ".cs", ".h", ".c", "", "xml", ".Xml" };
+
+		std::mt19937 random(1);
+		DepotStringArray depotFiles;
+		depotFiles.reserve(count);
+		for (size_t index = 0; index < count; ++index)
+		{
+			DepotString depotFile = folders[random() % _countof(folders)];
+			for (size_t depth = random() % 4; depth > 0; --depth)
+			{
+				depotFile += StringInfo::Format("dir%u/", uint32_t(random() % 8));
+			}
+			depotFile += StringInfo::Format("file%u%s", uint32_t(random() % 100), extensions[random() % _countof(extensions)]);
+			depotFiles.push_back(depotFile);
+		}
+		return depotFiles;
+	}
+}
+
+void TestDepotOperationsResidentMatcher(const TestContext& context)
+{
+	using namespace TestDepotOperationsResidentMatcherInternal;
+
+	Assert(FDepotResidentMatcher(R"(\.(xml|txt)$)").IsRegex() == false);
+	Assert(FDepotResidentMatcher(R"(^//depot/tools/)").IsRegex() == false);
+	Assert(FDepotResidentMatcher(R"(^(?!.*(\.xml$)).*$)").IsRegex() == false);
+	Assert(FDepotResidentMatcher(R"(\.(png|jpe?g)$)").IsRegex());
+	Assert(FDepotResidentMatcher(R"(file)").IsRegex());
+	Assert(FDepotResidentMatcher("").IsMatch("//depot/file.txt") == false);
+	Assert(FDepotResidentMatcher(R"(\.txt$)").IsMatch("") == false);
+	Assert(FDepotResidentMatcher::FromPattern(R"(\.txt$)") == FDepotResidentMatcher::FromPattern(R"(\.txt$)"));
+
+	// The compiled matcher must agree with a regex search of the same pattern
+	const DepotStringArray depotFiles = CreateDepotFiles(50000);
+	for (const char* pattern : Patterns)
+	{
+		const FDepotResidentMatcher matcher(pattern);
+		const std::regex regex(pattern, std::regex_constants::ECMAScript|std::regex_constants::icase);
+		for (const DepotString& depotFile : depotFiles)
+		{
+			std::match_results<const char*> match;
+			Assert(matcher.IsMatch(depotFile) == std::regex_search(depotFile.c_str(), match, regex));
+			Assert(DepotOperations::IsFileTypeAlwaysResident(pattern, depotFile) == matcher.IsMatch(depotFile));
+		}
+	}
+}
+
+void TestDepotOperationsResidentMatcherBenchmark(const TestContext& context)
+{
+	using namespace TestDepotOperationsResidentMatcherInternal;
+
+	const DepotStringArray depotFiles = CreateDepotFiles(1000000);
+	const size_t regexFileCount = 10000;
+
+	for (const char* pattern : Patterns)
+	{
+		DepotStopwatch compiledTimer(DepotStopwatch::Init::Start);
+		const DepotResidentMatcher matcher = FDepotResidentMatcher::FromPattern(pattern);
+		size_t compiledMatches = 0;
+		for (const DepotString& depotFile : depotFiles)
+		{
+			compiledMatches += matcher->IsMatch(depotFile) ? 1 : 0;
+		}
+		compiledTimer.Stop();
+
+		// Constructing the regex per file is too slow to run over every file, so only a subset is timed
+		DepotStopwatch regexTimer(DepotStopwatch::Init::Start);
+		size_t regexMatches = 0;
+		for (size_t fileIndex = 0; fileIndex < regexFileCount; ++fileIndex)
+		{
+			std::match_results<const char*> match;
+			regexMatches += std::regex_search(depotFiles[fileIndex].c_str(), match, std::regex(pattern, std::regex_constants::ECMAScript|std::regex_constants::icase)) ? 1 : 0;
+		}
+		regexTimer.Stop();
+
+		context.Log()->Info(StringInfo::Format("ResidentMatcher pattern=\"%s\" regex=%d files=%I64u matches=%I64u compiled=%0.1fns/file perFileRegex=%0.1fns/file", 
+			pattern, 
+			matcher->IsRegex() ? 1 : 0, 
+			uint64_t(depotFiles.size()), 
+			uint64_t(compiledMatches), 
+			compiledTimer.DurationMilliseconds() * 1e6 / depotFiles.size(), 
+			regexTimer.DurationMilliseconds() * 1e6 / regexFileCount));
+	}
+}
+
+void TestDepotOperationsForEachPooledClient(const TestContext& context)
+{
+	TestUtilities::WorkspaceReset(context);
+
+	DepotClient client = FDepotClient::New(context.m_FileContext);
+	Assert(client->Connect(context.GetDepotConfig()));
+
+	const DepotStringArray fileSpecs = {
+		"//depot/tools/dev/source/CinematicCapture/...@16",
+		"//depot/tools/dev/source/CinematicCapture/...@18",
+		"//depot/tools/dev/source/Hammer/...@19",
+		"//depot/tools/dev/external/EsrpClient/1.1.5/Enable-EsrpClientLog.ps1",
+		"//depot/gears1/WarGame/Localization/INT/Human_Myrrah_Dialog.int",
+	};
+
+	auto diff2ToString = [](const DepotResultDiff2& diff2) -> DepotString
+	{
+		DepotStringArray lines;
+		for (size_t diff2NodeIndex = 0; diff2NodeIndex < diff2->NodeCount(); ++diff2NodeIndex)
+		{
+			FDepotResultDiff2Node node = diff2->Node(diff2NodeIndex);
+			lines.push_back(StringInfo::Format("%s %s %s %s", node.DepotFile().c_str(), node.Type().c_str(), node.DepotFile2().c_str(), node.Type2().c_str()));
+		}
+		return StringInfo::Join(lines, "\n");
+	};
+
+	DepotStringArray diff2Results;
+	for (int32_t maxSyncConnections : { 1, 4 })
+	{
+		SettingPropertyScope<int32_t> maxSyncConnectionsScope(SettingManager::StaticInstance().MaxSyncConnections, maxSyncConnections);
+
+		// The additional connections of each pass are kept for the next pass
+		Array<DepotClient> additionalClients;
+		Set<FDepotClient*> keptClients;
+		for (size_t passIndex = 0; passIndex < 2; ++passIndex)
+		{
+			Set<FDepotClient*> uniqueClients;
+			Array<DepotClient> pooledClients(16);
+			DepotOperations::ForEachPooledClient(client, pooledClients.size(), [&pooledClients](DepotClient& pooledClient, size_t itemIndex) -> void
+			{
+				Assert(pooledClient->IsConnected());
+				Assert(pooledClient->Run(DepotCommand("changes", DepotStringArray{ "-m", "1" }))->HasError() == false);
+				pooledClients[itemIndex] = pooledClient;
+			}, 
+			&additionalClients);
+
+			for (const DepotClient& pooledClient : pooledClients)
+			{
+				Assert(pooledClient.get() != nullptr);
+				uniqueClients.insert(pooledClient.get());
+			}
+			Assert(uniqueClients.size() <= size_t(maxSyncConnections));
+			Assert(uniqueClients.find(client.get()) != uniqueClients.end());
+			Assert(additionalClients.size() < size_t(maxSyncConnections));
+			Assert(Algo::All(additionalClients, [&client](const DepotClient& additionalClient) -> bool { return additionalClient.get() != client.get(); }));
+			Assert(Algo::All(keptClients, [&additionalClients](FDepotClient* keptClient) -> bool { return Algo::Any(additionalClients, [keptClient](const DepotClient& additionalClient) -> bool { return additionalClient.get() == keptClient; }); }));
+			for (const DepotClient& additionalClient : additionalClients)
+			{
+				keptClients.insert(additionalClient.get());
+			}
+		}
+
+		DepotResultDiff2 diff2 = DepotOperations::Diff2Stat(client, DepotSyncFlags::Preview, fileSpecs, nullptr);
+		Assert(diff2.get() != nullptr && diff2->HasError() == false);
+		Assert(diff2->NodeCount() > 0);
+		diff2Results.push_back(diff2ToString(diff2));
+	}
+
+	// The pooled diff2 passes are merged in fileSpec order
+	Assert(diff2Results.size() == 2);
+	Assert(diff2Results[0] == diff2Results[1]);
+}
+
+void TestDepotOperationsSyncJournal(const TestContext& context)
+{
+	AutoTempFile journalFile(FileInfo::CreateTempFile(nullptr, TEXT("p4vfs")).c_str());
+	Assert(journalFile.GetFilePath().empty() == false);
+
+	const DepotString journalKey = "ssl:perforce:1666\nuser\nclient\n@1234\nNormal\nAtomic\n\n//depot/...";
+	const size_t modificationCount = 1000;
+
+	DepotSyncActionInfoArray modifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+	for (size_t index = 0; index < modificationCount; ++index)
+	{
+		DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+		modification->m_DepotFile = StringInfo::Format("//depot/journal/dir%u/file%05u.txt", uint32_t(index % 7), uint32_t(index));
+		modification->m_ClientFile = StringInfo::Format("C:\\workspace\\journal\\dir%u\\file%05u.txt", uint32_t(index % 7), uint32_t(index));
+		modification->m_Revision = FDepotRevision::New<FDepotRevisionNumber>(int32_t(index % 5) + 1);
+		modification->m_SyncActionType = index % 3 ? DepotSyncActionType::Added : DepotSyncActionType::Deleted;
+		modification->m_SyncActionFlags = index % 2 ? DepotSyncActionFlags::FileWrite : DepotSyncActionFlags::None;
+		modification->m_FileSize = int64_t(index * 100);
+		if (index % 11 == 0)
+		{
+			DepotSyncActionInfo subAction = std::make_shared<FDepotSyncActionInfo>();
+			subAction->m_DepotFile = modification->m_DepotFile;
+			subAction->m_ClientFile = modification->m_ClientFile;
+			subAction->m_SyncActionType = DepotSyncActionType::CantClobber;
+			subAction->m_Message = StringInfo::Format("Can't clobber writable file %s", modification->m_ClientFile.c_str());
+			modification->m_SubActions.push_back(subAction);
+			modification->m_Message = StringInfo::Format("%s - %s", modification->m_DepotFile.c_str(), DepotSyncActionType::ToString(modification->m_SyncActionType).c_str());
+		}
+		modifications->push_back(modification);
+	}
+
+	{
+		DepotSyncJournal journal;
+		Assert(journal.Create(journalFile.GetFilePath(), journalKey, modifications));
+		Assert(journal.GetRecordCount() == modificationCount);
+		Assert(journal.GetCompleteCount() == 0);
+
+		// Complete every modification with an index which is not a multiple of 3, from many threads
+		Array<size_t> modificationIndices(modificationCount);
+		std::iota(modificationIndices.begin(), modificationIndices.end(), size_t(0));
+		ThreadPool::ForEach::Execute(8, modificationIndices.data(), modificationIndices.size(), NULL, [&journal, &modifications](size_t modificationIndex) -> void
+		{
+			if (modifications->at(modificationIndex)->m_SyncActionType == DepotSyncActionType::Added)
+			{
+				journal.MarkComplete(modificationIndex);
+				journal.MarkComplete(modificationIndex);
+			}
+		});
+
+		journal.MarkComplete(modificationCount);
+		journal.MarkComplete(FDepotSyncActionTable::InvalidRowIndex);
+		Assert(journal.GetCompleteCount() == modificationCount - (modificationCount + 2) / 3);
+	}
+
+	DepotSyncActionInfoArray remainingModifications;
+	{
+		DepotSyncJournal journal;
+		Assert(journal.Open(journalFile.GetFilePath(), journalKey + "@1235", remainingModifications) == false);
+		Assert(journal.Open(journalFile.GetFilePath(), journalKey, remainingModifications));
+		Assert(journal.GetRecordCount() == modificationCount);
+		Assert(remainingModifications.get() && remainingModifications->size() == (modificationCount + 2) / 3);
+
+		for (size_t remainingIndex = 0; remainingIndex < remainingModifications->size(); ++remainingIndex)
+		{
+			const size_t index = remainingIndex * 3;
+			Assert(journal.IsComplete(index) == false);
+			Assert(journal.IsComplete(index + 1) == (index + 1 < modificationCount));
+
+			const DepotSyncActionInfo& expected = modifications->at(index);
+			const DepotSyncActionInfo& remaining = remainingModifications->at(remainingIndex);
+			Assert(remaining->m_DepotFile == expected->m_DepotFile);
+			Assert(remaining->m_ClientFile == expected->m_ClientFile);
+			Assert(FDepotRevision::ToString(remaining->m_Revision) == FDepotRevision::ToString(expected->m_Revision));
+			Assert(remaining->m_SyncActionType == expected->m_SyncActionType);
+			Assert(remaining->m_SyncActionFlags == expected->m_SyncActionFlags);
+			Assert(remaining->m_FileSize == expected->m_FileSize);
+			Assert(remaining->m_Message == expected->m_Message);
+			Assert(remaining->m_SubActions.size() == expected->m_SubActions.size());
+			for (size_t subActionIndex = 0; subActionIndex < remaining->m_SubActions.size(); ++subActionIndex)
+			{
+				Assert(remaining->m_SubActions[subActionIndex]->m_SyncActionType == expected->m_SubActions[subActionIndex]->m_SyncActionType);
+				Assert(remaining->m_SubActions[subActionIndex]->m_ClientFile == expected->m_SubActions[subActionIndex]->m_ClientFile);
+				Assert(remaining->m_SubActions[subActionIndex]->m_Message == expected->m_SubActions[subActionIndex]->m_Message);
+			}
+		}
+
+		// A resumed journal continues to record completion of the remaining modifications
+		for (size_t remainingIndex = 0; remainingIndex < remainingModifications->size(); ++remainingIndex)
+		{
+			journal.MarkComplete(remainingIndex);
+		}
+		Assert(journal.GetCompleteCount() == modificationCount);
+	}
+
+	{
+		DepotSyncJournal journal;
+		Assert(journal.Open(journalFile.GetFilePath(), journalKey, remainingModifications));
+		Assert(remainingModifications->size() == 0);
+	}
+
+	// A truncated journal is never opened
+	{
+		AutoHandle fileHandle(CreateFile(journalFile.GetFilePath().c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
+		Assert(fileHandle.IsValid());
+		LARGE_INTEGER truncatedSize = {};
+		truncatedSize.QuadPart = 64;
+		Assert(SetFilePointerEx(fileHandle.Handle(), truncatedSize, NULL, FILE_BEGIN));
+		Assert(SetEndOfFile(fileHandle.Handle()));
+	}
+	{
+		DepotSyncJournal journal;
+		Assert(journal.Open(journalFile.GetFilePath(), journalKey, remainingModifications) == false);
+	}
+}
+
+namespace TestDepotOperationsSyncActionTableInternal
+{
+	static DepotSyncActionInfo CreateModification(size_t fileIndex)
+	{
+		DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+		modification->m_DepotFile = StringInfo::Format("//depot/gears1/Development/Src/Module%03u/Private/File%07u.cpp", uint32_t(fileIndex % 500), uint32_t(fileIndex));
+		modification->m_ClientFile = StringInfo::Format("c:\\workspace\\gears1\\Development\\Src\\Module%03u\\Private\\File%07u.cpp", uint32_t(fileIndex % 500), uint32_t(fileIndex));
+		modification->m_Revision = FDepotRevision::New<FDepotRevisionNumber>(int32_t(1 + fileIndex % 7));
+		modification->m_SyncActionType = (fileIndex % 5) == 0 ? DepotSyncActionType::Updated : DepotSyncActionType::Added;
+		modification->m_SyncFlags = DepotSyncFlags::Preview;
+		modification->m_FileSize = int64_t(fileIndex * 13);
+		modification->m_VirtualFileSize = int64_t(fileIndex * 11);
+		modification->m_IsAlwaysResident = (fileIndex % 9) == 0;
+		return modification;
+	}
+
+	static uint64_t GetWorkingSetSize(uint64_t* peakWorkingSetSize = nullptr)
+	{
+		PROCESS_MEMORY_COUNTERS counters = {0};
+		counters.cb = sizeof(counters);
+		if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE)
+		{
+			return 0;
+		}
+		if (peakWorkingSetSize != nullptr)
+		{
+			*peakWorkingSetSize = counters.PeakWorkingSetSize;
+		}
+		return counters.WorkingSetSize;
+	}
+}
+
+void TestDepotOperationsSyncActionTable(const TestContext& context)
+{
+	using namespace TestDepotOperationsSyncActionTableInternal;
+
+	DepotSyncActionInfoArray modifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+	for (size_t fileIndex = 0; fileIndex < 1000; ++fileIndex)
+	{
+		modifications->push_back(CreateModification(fileIndex));
+	}
+
+	DepotSyncActionInfo labelModification = std::make_shared<FDepotSyncActionInfo>();
+	labelModification->m_DepotFile = "//depot/tools/label.txt";
+	labelModification->m_Revision = FDepotRevision::FromString("@my_label");
+	labelModification->m_SyncActionType = DepotSyncActionType::NoFileAtRevision;
+	labelModification->m_Message = "//depot/tools/label.txt@my_label - no file(s) at that revision.";
+	labelModification->m_SubActions.push_back(CreateModification(2000));
+	modifications->push_back(labelModification);
+
+	modifications->at(3)->m_SyncActionFlags = DepotSyncActionFlags::FileSymlink;
+	modifications->at(3)->m_SymlinkTarget = "c:\\workspace\\gears1\\Development\\Src\\Target.cpp";
+
+	DepotSyncActionInfo emptyModification = std::make_shared<FDepotSyncActionInfo>();
+	emptyModification->m_SyncActionType = DepotSyncActionType::InvalidPattern;
+	modifications->push_back(emptyModification);
+
+	DepotSyncActionTable table = FDepotSyncActionTable::FromArray(*modifications);
+	Assert(table.get() != nullptr);
+	Assert(table->Count() == modifications->size());
+
+	for (size_t rowIndex = 0; rowIndex < modifications->size(); ++rowIndex)
+	{
+		const DepotSyncActionInfo& modification = modifications->at(rowIndex);
+		Assert(table->DepotFile(rowIndex) == modification->m_DepotFile);
+		Assert(table->ClientFile(rowIndex) == modification->m_ClientFile);
+		Assert(table->RevisionString(rowIndex) == FDepotRevision::ToString(modification->m_Revision));
+		Assert(table->ToFileSpecString(rowIndex) == modification->ToFileSpecString());
+		Assert(table->Message(rowIndex) == modification->m_Message);
+		Assert(table->SymlinkTarget(rowIndex) == modification->m_SymlinkTarget);
+		Assert(table->SubActions(rowIndex) == modification->m_SubActions);
+		Assert(table->SyncActionType(rowIndex) == modification->m_SyncActionType);
+		Assert(table->SyncActionFlags(rowIndex) == modification->m_SyncActionFlags);
+		Assert(table->SyncFlags(rowIndex) == modification->m_SyncFlags);
+		Assert(table->IsPreview(rowIndex) == modification->IsPreview());
+		Assert(table->IsAlwaysResident(rowIndex) == modification->m_IsAlwaysResident);
+		Assert(table->Value(DepotSyncActionColumn::FileSize, rowIndex) == modification->m_FileSize);
+
+		const DepotSyncActionInfo info = table->ToActionInfo(rowIndex);
+		Assert(info->ToString() == modification->ToString());
+		Assert(info->RevisionNumber() == modification->RevisionNumber());
+		Assert(info->m_VirtualFileSize == modification->m_VirtualFileSize);
+		Assert(info->m_SymlinkTarget == modification->m_SymlinkTarget);
+		Assert(info->m_SubActions == modification->m_SubActions);
+	}
+
+	Assert(table->Revision(modifications->size()-1).get() == nullptr);
+	Assert(table->Sum(DepotSyncActionColumn::VirtualFileSize) == Algo::Sum<int64_t>(*modifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_VirtualFileSize; }));
+
+	const FDepotSyncActionTable::IndexArray residentIndices = table->Select([](const FDepotSyncActionTable& t, size_t rowIndex) -> bool { return t.IsAlwaysResident(rowIndex); });
+	Assert(residentIndices.size() == 112);
+	Assert(table->Sum(DepotSyncActionColumn::FileSize, &residentIndices) == Algo::Sum<int64_t>(*modifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_IsAlwaysResident ? m->m_FileSize : 0; }));
+
+	DepotSyncActionInfoArray residentModifications = table->ToActionInfoArray(&residentIndices);
+	Assert(residentModifications->size() == residentIndices.size());
+	Assert(residentModifications->front()->m_DepotFile == modifications->front()->m_DepotFile);
+	Assert(table->ToActionInfoArray()->size() == table->Count());
+
+	DepotSyncResult syncResult = std::make_shared<FDepotSyncResult>(DepotSyncStatus::Success, modifications);
+	Assert(syncResult->m_Modifications.get() && syncResult->m_Modifications->Count() == modifications->size());
+	Assert(std::make_shared<FDepotSyncResult>(DepotSyncStatus::Success, DepotSyncActionInfoArray())->m_Modifications.get() == nullptr);
+
+	const DepotSyncActionTable slice = table->Slice(FDepotSyncActionTable::IndexArray{ 1, 3 });
+	Assert(slice->Count() == 2);
+	Assert(slice->DepotFile(1) == table->DepotFile(3));
+	Assert(slice->SymlinkTarget(1) == table->SymlinkTarget(3));
+
+	// Records checked out from many threads write their changes back to their rows once they are released
+	Assert(FDepotSyncActionTable::GetRowIndex(modifications->front()) == FDepotSyncActionTable::InvalidRowIndex);
+	FDepotSyncActionTable::IndexArray rowIndices(table->Count());
+	std::iota(rowIndices.begin(), rowIndices.end(), uint32_t(0));
+	ThreadPool::ForEach::Execute(8, rowIndices.data(), rowIndices.size(), NULL, [&table](uint32_t rowIndex) -> void
+	{
+		const DepotSyncActionInfo modification = FDepotSyncActionTable::Checkout(table, rowIndex);
+		if (FDepotSyncActionTable::GetRowIndex(modification) == rowIndex)
+		{
+			modification->m_PlaceholderTime = int64_t(rowIndex);
+			modification->m_Message = StringInfo::Format("applied %u", rowIndex);
+		}
+	});
+	for (uint32_t rowIndex : rowIndices)
+	{
+		Assert(table->Value(DepotSyncActionColumn::PlaceholderTime, rowIndex) == int64_t(rowIndex));
+		Assert(table->Message(rowIndex) == StringInfo::Format("applied %u", rowIndex));
+	}
+	Assert(table->SubActions(modifications->size()-2).size() == 1);
+
+	// An appended record is written back only when the last reference to it is released
+	DepotSyncActionInfo appended = FDepotSyncActionTable::CheckoutAppend(table, CreateModification(3000));
+	const size_t appendedRowIndex = FDepotSyncActionTable::GetRowIndex(appended);
+	Assert(appendedRowIndex == modifications->size());
+	Assert(table->Count() == modifications->size()+1);
+	DepotSyncActionInfo pending = appended;
+	appended->m_FlushTime = 7;
+	appended.reset();
+	Assert(table->Value(DepotSyncActionColumn::FlushTime, appendedRowIndex) == 0);
+	pending.reset();
+	Assert(table->Value(DepotSyncActionColumn::FlushTime, appendedRowIndex) == 7);
+}
+
+void TestDepotOperationsSyncActionTableBenchmark(const TestContext& context)
+{
+	using namespace TestDepotOperationsSyncActionTableInternal;
+
+	const size_t fileCount = 2000000;
+	uint64_t peakWorkingSetSize = 0;
+	const uint64_t baseWorkingSetSize = GetWorkingSetSize();
+
+	// The shared pointer records of a preview, as held by SyncVirtual before the preview is compacted
+	int64_t arrayVirtualFileSize = 0;
+	{
+		DepotStopwatch timer(DepotStopwatch::Init::Start);
+		DepotSyncActionInfoArray modifications = std::make_shared<DepotSyncActionInfoArray::element_type>();
+		modifications->reserve(fileCount);
+		for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+		{
+			modifications->push_back(CreateModification(fileIndex));
+		}
+		arrayVirtualFileSize = Algo::Sum<int64_t>(*modifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_VirtualFileSize; });
+		timer.Stop();
+
+		const uint64_t workingSetSize = GetWorkingSetSize(&peakWorkingSetSize);
+		context.Log()->Info(StringInfo::Format("SyncActionArray files=%I64u time=%I64dms workingSet=%s peakWorkingSet=%s", 
+			uint64_t(fileCount), 
+			timer.TotalMilliseconds(), 
+			DepotOperations::ToDisplayStringBytes(workingSetSize > baseWorkingSetSize ? workingSetSize - baseWorkingSetSize : 0).c_str(), 
+			DepotOperations::ToDisplayStringBytes(peakWorkingSetSize).c_str()));
+	}
+
+	const uint64_t tableBaseWorkingSetSize = GetWorkingSetSize();
+	int64_t tableVirtualFileSize = 0;
+	{
+		DepotStopwatch timer(DepotStopwatch::Init::Start);
+		FDepotSyncActionTable table;
+		table.Reserve(fileCount);
+		for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+		{
+			table.Append(*CreateModification(fileIndex));
+		}
+		tableVirtualFileSize = table.Sum(DepotSyncActionColumn::VirtualFileSize);
+		timer.Stop();
+
+		const uint64_t workingSetSize = GetWorkingSetSize(&peakWorkingSetSize);
+		context.Log()->Info(StringInfo::Format("SyncActionTable files=%I64u time=%I64dms workingSet=%s tableSize=%s peakWorkingSet=%s", 
+			uint64_t(fileCount), 
+			timer.TotalMilliseconds(), 
+			DepotOperations::ToDisplayStringBytes(workingSetSize > tableBaseWorkingSetSize ? workingSetSize - tableBaseWorkingSetSize : 0).c_str(), 
+			DepotOperations::ToDisplayStringBytes(uint64_t(table.GetMemorySize())).c_str(), 
+			DepotOperations::ToDisplayStringBytes(peakWorkingSetSize).c_str()));
+	}
+
+	Assert(arrayVirtualFileSize == tableVirtualFileSize);
+}
+
+void TestDepotOperationsSyncStreamingSummary(const TestContext& context)
+{
+	// A bounded log keeps only the first warnings and errors, but the status still reflects every element written
+	const size_t maxLogElements = 1000;
+	LogDeviceMemory boundedLog(LogChannel::Warning, maxLogElements);
+	LogDeviceMemory completeLog;
+	for (size_t elementIndex = 0; elementIndex < 100000; ++elementIndex)
+	{
+		const LogChannel::Enum channel = (elementIndex % 20) == 0 ? LogChannel::Warning : LogChannel::Info;
+		boundedLog.WriteLine(channel, StringInfo::Format("element %I64u", uint64_t(elementIndex)));
+		completeLog.WriteLine(channel, StringInfo::Format("element %I64u", uint64_t(elementIndex)));
+	}
+
+	Assert(boundedLog.GetElements().size() == maxLogElements);
+	Assert(boundedLog.GetChannelCount(LogChannel::Info) == 95000);
+	Assert(boundedLog.GetChannelCount(LogChannel::Warning) == 5000);
+	Assert(boundedLog.GetDroppedCount() == 4000);
+	Assert(DepotSyncStatus::FromLog(boundedLog) == DepotSyncStatus::Warning);
+	Assert(DepotSyncStatus::FromLog(boundedLog) == DepotSyncStatus::FromLog(completeLog));
+	Assert(completeLog.GetElements().size() == 100000);
+	Assert(completeLog.GetDroppedCount() == 0);
+
+	// An error written after the bound is reached is dropped but still fails the sync
+	boundedLog.WriteLine(LogChannel::Error, "late error");
+	Assert(boundedLog.GetElements().size() == maxLogElements);
+	Assert(DepotSyncStatus::FromLog(boundedLog) == (DepotSyncStatus::Warning | DepotSyncStatus::Error));
+
+	// Totals accumulated concurrently as modifications are applied match the totals of the retained modifications
+	Array<DepotSyncActionInfo> modifications;
+	for (size_t fileIndex = 0; fileIndex < 20000; ++fileIndex)
+	{
+		DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+		modification->m_VirtualFileSize = int64_t(fileIndex * 7);
+		modification->m_DiskFileSize = int64_t(fileIndex % 3);
+		modification->m_PlaceholderTime = int64_t(fileIndex % 5);
+		modification->m_FlushTime = int64_t(fileIndex % 11);
+		modifications.push_back(modification);
+	}
+
+	for (bool isFlushBatched : { false, true })
+	{
+		DepotOperations::FSyncVirtualSummary summary;
+		ThreadPool::ForEach::Execute(8, modifications.data(), modifications.size(), NULL, [&summary, isFlushBatched](const DepotSyncActionInfo& modification) -> void
+		{
+			summary.Add(*modification, isFlushBatched);
+		});
+
+		Assert(summary.m_AppliedCount == modifications.size());
+		Assert(summary.m_VirtualFileSize == Algo::Sum<int64_t>(modifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_VirtualFileSize; }));
+		Assert(summary.m_DiskFileSize == Algo::Sum<int64_t>(modifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_DiskFileSize; }));
+		Assert(summary.m_PlaceholderTime == Algo::Sum<int64_t>(modifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_PlaceholderTime; }));
+		Assert(summary.m_FlushTime == (isFlushBatched ? 0 : Algo::Sum<int64_t>(modifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_FlushTime; })));
+	}
+}
+
+namespace TestDepotOperationsDirectorySchedulerInternal
+{
+	// An in-memory stand-in for the client file system, which records when two workers operate
+	// within the same directory at the same time
+	struct FakeFileSystem
+	{
+		typedef Map<DepotString, Set<DepotString, StringInfo::LessInsensitive>, StringInfo::LessInsensitive> DirectoryMap;
+
+		CriticalSection m_Lock;
+		DirectoryMap m_Directories;
+		Map<DepotString, size_t, StringInfo::LessInsensitive> m_ActiveWorkers;
+		Map<DepotString, size_t, StringInfo::LessInsensitive> m_FinalizeCounts;
+		size_t m_ContentionCount = 0;
+		size_t m_DeleteEmptyDirectoriesCount = 0;
+
+		void AddFile(const DepotString& filePath)
+		{
+			AutoCriticalSection lock(m_Lock);
+			for (DepotString folderPath = FDepotSyncDirectoryScheduler::GetFolderPath(filePath); folderPath.size(); folderPath = FDepotSyncDirectoryScheduler::GetFolderPath(folderPath))
+			{
+				m_Directories[folderPath];
+			}
+			m_Directories[FDepotSyncDirectoryScheduler::GetFolderPath(filePath)].insert(filePath);
+		}
+
+		bool ApplyModification(const DepotSyncActionInfo& modification)
+		{
+			const DepotString folderPath = FDepotSyncDirectoryScheduler::GetFolderPath(modification->m_ClientFile);
+			{
+				AutoCriticalSection lock(m_Lock);
+				size_t& activeWorkers = m_ActiveWorkers[folderPath];
+				m_ContentionCount += activeWorkers > 0 ? 1 : 0;
+				activeWorkers++;
+			}
+
+			bool isRemoved = false;
+			if (modification->m_SyncActionType == DepotSyncActionType::Deleted)
+			{
+				AutoCriticalSection lock(m_Lock);
+				DirectoryMap::iterator directory = m_Directories.find(folderPath);
+				isRemoved = directory != m_Directories.end() && directory->second.erase(modification->m_ClientFile) > 0;
+			}
+			else
+			{
+				AddFile(modification->m_ClientFile);
+			}
+
+			// Hold the directory for a moment so that interleaved workers would overlap
+			Sleep(0);
+
+			AutoCriticalSection lock(m_Lock);
+			m_ActiveWorkers[folderPath]--;
+			return isRemoved;
+		}
+
+		void DeleteEmptyDirectories(const DepotString& folderPath)
+		{
+			AutoCriticalSection lock(m_Lock);
+			m_FinalizeCounts[folderPath]++;
+			m_DeleteEmptyDirectoriesCount++;
+			for (DepotString path = folderPath; path.size(); path = FDepotSyncDirectoryScheduler::GetFolderPath(path))
+			{
+				DirectoryMap::iterator directory = m_Directories.find(path);
+				if (directory == m_Directories.end() || directory->second.size() > 0)
+				{
+					break;
+				}
+				const bool hasChildDirectory = std::any_of(m_Directories.begin(), m_Directories.end(), [&path](const DirectoryMap::value_type& d) -> bool 
+				{ 
+					return StringInfo::Stricmp(FDepotSyncDirectoryScheduler::GetFolderPath(d.first).c_str(), path.c_str()) == 0; 
+				});
+				if (hasChildDirectory)
+				{
+					break;
+				}
+				m_Directories.erase(directory);
+			}
+		}
+	};
+
+	static Array<DepotSyncActionInfo> CreateModifications(FakeFileSystem& fileSystem, size_t directoryCount, size_t filesPerDirectory)
+	{
+		// Files of each directory are interleaved with the other directories, as they are in a sync preview, and
+		// the folder casing varies between files of the same directory
+		Array<DepotSyncActionInfo> modifications;
+		for (size_t fileIndex = 0; fileIndex < filesPerDirectory; ++fileIndex)
+		{
+			for (size_t directoryIndex = 0; directoryIndex < directoryCount; ++directoryIndex)
+			{
+				DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+				modification->m_ClientFile = StringInfo::Format("c:\\workspace\\%s\\dir%03u\\file%05u.txt", (fileIndex % 2) ? "Data" : "data", uint32_t(directoryIndex), uint32_t(fileIndex));
+				modification->m_SyncActionType = (directoryIndex % 3) == 0 ? DepotSyncActionType::Deleted : DepotSyncActionType::Added;
+				if (modification->m_SyncActionType == DepotSyncActionType::Deleted)
+				{
+					fileSystem.AddFile(modification->m_ClientFile);
+				}
+				modifications.push_back(modification);
+			}
+		}
+		return modifications;
+	}
+}
+
+void TestDepotOperationsDirectoryScheduler(const TestContext& context)
+{
+	using namespace TestDepotOperationsDirectorySchedulerInternal;
+
+	const size_t directoryCount = 48;
+	const size_t filesPerDirectory = 64;
+	for (size_t maxGroupSize : { size_t(16), FDepotSyncDirectoryScheduler::DefaultMaxGroupSize })
+	{
+		FakeFileSystem fileSystem;
+		const Array<DepotSyncActionInfo> modifications = CreateModifications(fileSystem, directoryCount, filesPerDirectory);
+		const DepotSyncActionTable table = FDepotSyncActionTable::FromArray(modifications);
+		FDepotSyncDirectoryScheduler scheduler(*table, maxGroupSize);
+
+		// Every row is scheduled exactly once, in a group of files from a single directory
+		Assert(scheduler.GetDirectoryCount() == directoryCount);
+		Assert(scheduler.GetGroupCount() == directoryCount * ((filesPerDirectory + maxGroupSize - 1) / maxGroupSize));
+		Set<uint32_t> scheduled;
+		for (size_t groupIndex = 0; groupIndex < scheduler.GetGroupCount(); ++groupIndex)
+		{
+			const FDepotSyncActionTable::IndexArray& group = scheduler.GetGroupRowIndices(groupIndex);
+			Assert(group.size() > 0 && group.size() <= maxGroupSize);
+			Assert(groupIndex == 0 || group.size() <= scheduler.GetGroupRowIndices(groupIndex-1).size());
+			for (uint32_t rowIndex : group)
+			{
+				Assert(StringInfo::Stricmp(FDepotSyncDirectoryScheduler::GetFolderPath(table->ClientFile(rowIndex)).c_str(), scheduler.GetGroupFolderPath(groupIndex).c_str()) == 0);
+				Assert(scheduled.insert(rowIndex).second);
+			}
+		}
+		Assert(scheduled.size() == modifications.size());
+
+		const size_t appliedCount = scheduler.Execute(
+			8, 
+			NULL, 
+			nullptr, 
+			[&fileSystem, &modifications](size_t rowIndex) -> bool { return fileSystem.ApplyModification(modifications[rowIndex]); }, 
+			[&fileSystem](const DepotString& folderPath) -> void { fileSystem.DeleteEmptyDirectories(folderPath); });
+
+		context.Log()->Info(StringInfo::Format("DirectoryScheduler maxGroupSize=%I64u groups=%I64u contention=%I64u finalized=%I64u", uint64_t(maxGroupSize), uint64_t(appliedCount), uint64_t(fileSystem.m_ContentionCount), uint64_t(fileSystem.m_DeleteEmptyDirectoriesCount)));
+		Assert(appliedCount == scheduler.GetGroupCount());
+
+		// Directories which are not split are never shared between workers
+		if (maxGroupSize >= filesPerDirectory)
+		{
+			Assert(fileSystem.m_ContentionCount == 0);
+		}
+
+		// Each directory with deletes is finalized once, after which it no longer exists
+		const size_t deletedDirectoryCount = (directoryCount + 2) / 3;
+		Assert(fileSystem.m_FinalizeCounts.size() == deletedDirectoryCount);
+		Assert(fileSystem.m_DeleteEmptyDirectoriesCount == deletedDirectoryCount);
+		for (const auto& finalizeCount : fileSystem.m_FinalizeCounts)
+		{
+			Assert(finalizeCount.second == 1);
+			Assert(fileSystem.m_Directories.find(finalizeCount.first) == fileSystem.m_Directories.end());
+		}
+
+		// Added files are all present, and so their directories remain
+		for (const DepotSyncActionInfo& modification : modifications)
+		{
+			const auto directory = fileSystem.m_Directories.find(FDepotSyncDirectoryScheduler::GetFolderPath(modification->m_ClientFile));
+			const bool isPresent = directory != fileSystem.m_Directories.end() && directory->second.count(modification->m_ClientFile) > 0;
+			Assert(isPresent == (modification->m_SyncActionType == DepotSyncActionType::Added));
+		}
+	}
+
+	// Cancelation stops the remaining groups, without finalizing the directories
+	FakeFileSystem fileSystem;
+	const Array<DepotSyncActionInfo> modifications = CreateModifications(fileSystem, 8, 8);
+	FDepotSyncDirectoryScheduler scheduler(*FDepotSyncActionTable::FromArray(modifications));
+	AutoHandle cancelationEvent(CreateEvent(NULL, TRUE, TRUE, NULL));
+	scheduler.Execute(4, cancelationEvent.Handle(), nullptr, [](size_t) -> bool { return true; }, [&fileSystem](const DepotString& folderPath) -> void { fileSystem.DeleteEmptyDirectories(folderPath); });
+	Assert(fileSystem.m_DeleteEmptyDirectoriesCount == 0);
+}
+
+void TestDepotOperationsResidentDownloader(const TestContext& context)
+{
+	const int64_t batchBytes = 1024*1024;
+	const size_t maxBatchFiles = 64;
+	const size_t maxConnections = 4;
+
+	// A mix of many small files, some medium files, and a few files larger than a batch
+	Array<DepotSyncActionInfo> modifications;
+	std::mt19937 random(1);
+	for (size_t fileIndex = 0; fileIndex < 2000; ++fileIndex)
+	{
+		DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+		modification->m_DepotFile = StringInfo::Format("//depot/fake/bin/file%05u.dll", uint32_t(fileIndex));
+		modification->m_ClientFile = StringInfo::Format("c:\\fake\\bin\\file%05u.dll", uint32_t(fileIndex));
+		modification->m_Revision = FDepotRevision::New<FDepotRevisionNumber>(1);
+		modification->m_SyncActionType = DepotSyncActionType::Added;
+		modification->m_IsAlwaysResident = true;
+		modification->m_FileSize = (fileIndex % 500) == 7 ? batchBytes*4 : (fileIndex % 10) == 0 ? int64_t(random() % (batchBytes/4)) : int64_t(random() % 16384);
+		modification->m_SyncTime = -1;
+		modifications.push_back(modification);
+	}
+
+	// Partitions are balanced by bytes to within the size of the largest file, and each keeps the order of its files
+	for (size_t batchCount : { size_t(1), size_t(3), size_t(16), modifications.size(), modifications.size()*2 })
+	{
+		const Array<DepotResidentDownloader::Batch> batches = DepotResidentDownloader::PartitionBatches(modifications, batchCount);
+		Assert(batches.size() == std::min(batchCount, modifications.size()));
+
+		int64_t minBatchBytes = INT64_MAX;
+		int64_t maxBatchBytes = 0;
+		int64_t maxFileBytes = 0;
+		Set<const FDepotSyncActionInfo*> partitioned;
+		for (const DepotResidentDownloader::Batch& batch : batches)
+		{
+			Assert(batch.size() > 0);
+			int64_t bytes = 0;
+			for (size_t index = 0; index < batch.size(); ++index)
+			{
+				Assert(partitioned.insert(batch[index].get()).second);
+				Assert(index == 0 || batch[index-1]->m_DepotFile < batch[index]->m_DepotFile);
+				bytes += batch[index]->m_FileSize;
+				maxFileBytes = std::max(maxFileBytes, batch[index]->m_FileSize);
+			}
+			minBatchBytes = std::min(minBatchBytes, bytes);
+			maxBatchBytes = std::max(maxBatchBytes, bytes);
+		}
+		Assert(partitioned.size() == modifications.size());
+		Assert(maxBatchBytes - minBatchBytes <= maxFileBytes);
+	}
+	Assert(DepotResidentDownloader::PartitionBatches(DepotResidentDownloader::Batch(), 4).empty());
+
+	// A local stand-in for the depot server which records each 'sync -f' batch and how many were running at once
+	struct FakeDepot
+	{
+		CriticalSection m_Lock;
+		Array<DepotStringArray> m_Batches;
+		HashSet<FDepotClient*> m_Clients;
+		std::atomic<size_t> m_ActiveDownloads = 0;
+		std::atomic<size_t> m_MaxActiveDownloads = 0;
+		std::atomic<size_t> m_Connections = 0;
+		AutoHandle m_DownloadedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		bool Download(DepotClient& depotClient, const DepotStringArray& fileSpecs)
+		{
+			const size_t activeDownloads = ++m_ActiveDownloads;
+			for (size_t maxActive = m_MaxActiveDownloads; activeDownloads > maxActive && m_MaxActiveDownloads.compare_exchange_weak(maxActive, activeDownloads) == false;);
+			Sleep(5);
+			{
+				AutoCriticalSection lock(m_Lock);
+				m_Batches.push_back(fileSpecs);
+				m_Clients.insert(depotClient.get());
+			}
+			m_ActiveDownloads--;
+			SetEvent(m_DownloadedEvent.Handle());
+			return true;
+		}
+	};
+
+	Map<DepotString, DepotSyncActionInfo> depotFileModifications;
+	for (const DepotSyncActionInfo& modification : modifications)
+	{
+		depotFileModifications[modification->ToFileSpecString()] = modification;
+	}
+
+	for (bool canConnect : { true, false })
+	{
+		FakeDepot depot;
+		DepotResidentDownloader downloader(
+			canConnect ? context.Log() : nullptr, 
+			maxConnections, 
+			batchBytes, 
+			maxBatchFiles, 
+			[&depot](DepotClient& depotClient, const DepotStringArray& fileSpecs) -> bool
+			{
+				return depot.Download(depotClient, fileSpecs);
+			},
+			[&depot, &context, canConnect]() -> DepotClient
+			{
+				depot.m_Connections++;
+				return canConnect ? FDepotClient::New(context.m_FileContext) : nullptr;
+			});
+
+		std::atomic<size_t> downloadedCount = 0;
+		downloader.SetDownloadedCallback([&downloadedCount](const DepotSyncActionInfo& modification) -> void
+		{
+			downloadedCount++;
+		});
+
+		Assert(downloader.Start(NULL, nullptr));
+		ThreadPool::ForEach::Execute(8, modifications.data(), modifications.size(), NULL, [&downloader](const DepotSyncActionInfo& modification) -> void
+		{
+			downloader.Add(modification);
+		});
+
+		// Full batches are downloaded before the downloader is completed
+		if (canConnect)
+		{
+			Assert(WaitForSingleObject(depot.m_DownloadedEvent.Handle(), 10000) == WAIT_OBJECT_0);
+		}
+
+		DepotClient callingClient = FDepotClient::New(context.m_FileContext);
+		downloader.Complete(callingClient);
+
+		context.Log()->Info(StringInfo::Format("ResidentDownloader canConnect=%d batches=%I64u connections=%I64u maxActive=%I64u", int32_t(canConnect), uint64_t(depot.m_Batches.size()), uint64_t(downloader.GetConnectionCount()), uint64_t(depot.m_MaxActiveDownloads)));
+		Assert(downloader.GetFileCount() == modifications.size());
+		Assert(downloader.GetBatchCount() == depot.m_Batches.size());
+		Assert(downloader.GetErrorCount() == 0);
+		Assert(downloadedCount == modifications.size());
+		Assert(downloader.GetByteCount() == Algo::Sum<int64_t>(modifications, [](const DepotSyncActionInfo& m) -> int64_t { return m->m_FileSize; }));
+
+		// Every file is downloaded once, a large file on its own, and the other batches are bounded by bytes and file count
+		Set<DepotString> downloaded;
+		for (const DepotStringArray& batch : depot.m_Batches)
+		{
+			Assert(batch.size() > 0 && batch.size() <= maxBatchFiles);
+			int64_t bytes = 0;
+			for (const DepotString& fileSpec : batch)
+			{
+				Assert(downloaded.insert(fileSpec).second);
+				const DepotSyncActionInfo* modification = Algo::Find(depotFileModifications, fileSpec);
+				Assert(modification != nullptr);
+				Assert((*modification)->m_SyncTime >= 0);
+				Assert((*modification)->m_FileSize < batchBytes || batch.size() == 1);
+				bytes += (*modification)->m_FileSize;
+			}
+			Assert(bytes - depotFileModifications[batch.back()]->m_FileSize < batchBytes);
+		}
+		Assert(downloaded.size() == modifications.size());
+
+		if (canConnect)
+		{
+			Assert(downloader.GetConnectionCount() > 1 && downloader.GetConnectionCount() <= maxConnections);
+			Assert(depot.m_MaxActiveDownloads > 1 && depot.m_MaxActiveDownloads <= maxConnections);
+			Assert(depot.m_Clients.count(callingClient.get()) == 0);
+		}
+		else
+		{
+			// Batches which could not be downloaded by the workers are downloaded with the calling client
+			Assert(downloader.GetConnectionCount() == 0);
+			Assert(depot.m_Clients.size() == 1 && depot.m_Clients.count(callingClient.get()) == 1);
+		}
+
+		for (const DepotSyncActionInfo& modification : modifications)
+		{
+			modification->m_SyncTime = -1;
+		}
+	}
+}
+
+void TestDepotOperationsConcurrencyController(const TestContext& context)
+{
+	// A deterministic simulation of a server which serves up to serverCapacity commands at the base latency, after
+	// which commands queue and the latency grows with the number of active commands
+	struct FSimulation
+	{
+		size_t m_ServerCapacity;
+		int64_t m_BaseLatencyUs;
+		size_t m_CompletedCount = 0;
+		double m_TailConcurrency = 0;
+		int64_t m_TimeUs = 0;
+
+		void Run(DepotConcurrencyController& controller, size_t itemCount)
+		{
+			typedef std::pair<int64_t, int64_t> Completion;
+			std::priority_queue<Completion, Array<Completion>, std::greater<Completion>> active;
+			size_t startedCount = 0;
+			size_t tailSamples = 0;
+			while (m_CompletedCount < itemCount)
+			{
+				while (startedCount < itemCount && controller.TryAcquire())
+				{
+					const size_t activeCount = controller.GetActiveCount();
+					const int64_t latencyUs = activeCount <= m_ServerCapacity ? m_BaseLatencyUs : m_BaseLatencyUs * int64_t(activeCount) / int64_t(m_ServerCapacity);
+					active.push(Completion(m_TimeUs + latencyUs, latencyUs));
+					startedCount++;
+				}
+
+				const Completion completion = active.top();
+				active.pop();
+				m_TimeUs = completion.first;
+				controller.Release(completion.second);
+				m_CompletedCount++;
+
+				if (m_CompletedCount > itemCount/2)
+				{
+					m_TailConcurrency += double(controller.GetConcurrency());
+					tailSamples++;
+				}
+			}
+			m_TailConcurrency /= double(std::max<size_t>(1, tailSamples));
+		}
+	};
+
+	const size_t itemCount = 20000;
+	for (size_t serverCapacity : { size_t(1), size_t(4), size_t(8), size_t(16), size_t(1000) })
+	{
+		FSimulation simulation;
+		simulation.m_ServerCapacity = serverCapacity;
+		simulation.m_BaseLatencyUs = 10000;
+
+		FDepotConcurrencyOptions options;
+		options.m_InitialConcurrency = 2;
+		options.m_MinConcurrency = 1;
+		options.m_MaxConcurrency = 64;
+		DepotConcurrencyController controller(options, [&simulation]() -> int64_t { return simulation.m_TimeUs; });
+		Assert(controller.IsAdaptive());
+		Assert(controller.GetConcurrency() == 2);
+
+		simulation.Run(controller, itemCount);
+		context.Log()->Info(StringInfo::Format("ConcurrencyController capacity=%I64u final=%I64u tail=%.1f increases=%I64u decreases=%I64u time=%I64dms", 
+			uint64_t(serverCapacity), uint64_t(controller.GetConcurrency()), simulation.m_TailConcurrency, uint64_t(controller.GetIncreaseCount()), uint64_t(controller.GetDecreaseCount()), simulation.m_TimeUs/1000));
+
+		Assert(controller.GetCompletedCount() == itemCount);
+		Assert(controller.GetActiveCount() == 0);
+		Assert(controller.GetIncreaseCount() > 0);
+
+		// Each decision is recorded, and moves the concurrency by one on increase, or at least one on decrease, within the bounds
+		const Array<FDepotConcurrencyDecisionRecord> decisions = controller.GetDecisions();
+		Assert(decisions.size() == controller.GetIncreaseCount() + controller.GetDecreaseCount());
+		size_t concurrency = options.m_InitialConcurrency;
+		int64_t timeUs = 0;
+		for (const FDepotConcurrencyDecisionRecord& record : decisions)
+		{
+			Assert(record.m_PreviousConcurrency == concurrency);
+			Assert(record.m_Concurrency >= options.m_MinConcurrency && record.m_Concurrency <= options.m_MaxConcurrency);
+			Assert(record.m_TimeUs >= timeUs);
+			Assert(record.m_ItemsPerSecond > 0);
+			if (record.m_Decision == DepotConcurrencyDecision::Increase)
+			{
+				Assert(record.m_Concurrency == concurrency+1);
+			}
+			else
+			{
+				Assert(record.m_Decision == DepotConcurrencyDecision::Decrease);
+				Assert(record.m_Concurrency < concurrency);
+			}
+			concurrency = record.m_Concurrency;
+			timeUs = record.m_TimeUs;
+		}
+		Assert(concurrency == controller.GetConcurrency());
+
+		if (serverCapacity >= options.m_MaxConcurrency)
+		{
+			// The latency never rises, so the concurrency grows to the maximum without backing off
+			Assert(controller.GetConcurrency() == options.m_MaxConcurrency);
+			Assert(controller.GetDecreaseCount() == 0);
+		}
+		else
+		{
+			// The concurrency settles around the capacity of the server
+			Assert(controller.GetDecreaseCount() > 0);
+			Assert(simulation.m_TailConcurrency >= double(serverCapacity)/2);
+			Assert(simulation.m_TailConcurrency <= double(serverCapacity)*2 + 2);
+		}
+	}
+
+	// A fixed concurrency never changes, and limits the active items
+	FDepotConcurrencyOptions fixedOptions;
+	fixedOptions.m_InitialConcurrency = 3;
+	fixedOptions.m_MinConcurrency = 3;
+	fixedOptions.m_MaxConcurrency = 3;
+	DepotConcurrencyController fixedController(fixedOptions);
+	Assert(fixedController.IsAdaptive() == false);
+	for (size_t itemIndex = 0; itemIndex < 1000; ++itemIndex)
+	{
+		while (fixedController.TryAcquire());
+		Assert(fixedController.GetActiveCount() == 3);
+		fixedController.Release(int64_t(itemIndex * 1000));
+	}
+	Assert(fixedController.GetConcurrency() == 3);
+	Assert(fixedController.GetDecisions().empty());
+
+	// Acquire waits for a release, and gives up once the cancelation event is set
+	while (fixedController.TryAcquire());
+	AutoHandle cancelationEvent(CreateEvent(NULL, TRUE, TRUE, NULL));
+	Assert(fixedController.Acquire(cancelationEvent.Handle()) == false);
+	fixedController.Release(0);
+	Assert(fixedController.Acquire(cancelationEvent.Handle()));
+}
+
+namespace TestDepotOperationsSyncActionScannerInternal
+{
+	// Lines of untagged sync output captured from servers, including the shapes which are not classified
+	static const char* InfoCorpus[] = {
+		"//depot/main/src/Engine/Render.cpp#12 - updating C:\\ws\\main\\src\\Engine\\Render.cpp",
+		"//depot/main/src/Engine/Shader.h#1 - added as C:\\ws\\main\\src\\Engine\\Shader.h",
+		"//depot/main/src/Engine/Legacy.h#3 - deleted as C:\\ws\\main\\src\\Engine\\Legacy.h",
+		"//depot/main/src/Engine/Edit.cpp#4 - is opened and not being changed",
+		"//depot/main/src/Engine/Edit.cpp#4 - is opened for edit - not changed",
+		"//depot/main/src/Engine/Render.cpp#12 - refreshing C:\\ws\\main\\src\\Engine\\Render.cpp",
+		"//depot/main/src/Engine/Render.cpp#12 - replacing C:\\ws\\main\\src\\Engine\\Render.cpp",
+		"//depot/main/docs/Read Me - Copy.txt#2 - updating C:\\ws\\main\\docs\\Read Me - Copy.txt",
+		"//depot/main/docs/Notes - 2024 - Final.docx#7 - added as C:\\ws\\main\\docs\\Notes - 2024 - Final.docx",
+		"//depot/main/src/%40home.txt#1 - added as C:\\ws\\main\\src\\@home.txt",
+		"//depot/main/src/issue%23123.txt#1 - added as C:\\ws\\main\\src\\issue#123.txt",
+		"//depot/main/src/Engine/Render.cpp#none - deleted as C:\\ws\\main\\src\\Engine\\Render.cpp",
+		"//depot/main/src/Engine/Render.cpp#head - updating C:\\ws\\main\\src\\Engine\\Render.cpp",
+		"//depot/main/src/Engine/Conflict.cpp - must resolve #5 before submitting",
+		"... //depot/main/src/Engine/Conflict.cpp - must resolve #5 before submitting",
+		"//depot/main/src/Engine/Conflict.cpp - must resolve before submitting",
+		"... //depot/main/src/Engine/Conflict.cpp - must resolve before submitting",
+		"//depot/main/src/Engine/Conflict.cpp#5 - is opened for edit - must resolve #6 before submitting",
+		"//depot/main/docs/Read Me.txt - must resolve #2 before submitting",
+		"... ... //depot/main/docs/Read Me.txt - must resolve #2 before submitting",
+		"//depot/main/src/Engine/Render.cpp#12 - updating ",
+		"//depot/main/src/Engine/Render.cpp#12 -",
+		"//depot/main/src/Engine/Render.cpp#12",
+		"Change 1234 created with 3 open file(s).",
+		"",
+		" - ",
+		"#",
+	};
+
+	static const char* ErrorCorpus[] = {
+		"//depot/main/src/...@1234 - file(s) up-to-date.",
+		"//depot/main/src/...#head - file(s) up-to-date.",
+		"//depot/main/src/Engine/Render.cpp@2024/01/31:12:00:00 - file(s) up-to-date.",
+		"//depot/main/src/Missing.txt - no such file(s).",
+		"//other/path/... - file(s) not in client view.",
+		"C:\\ws\\main\\src\\Engine\\Render.cpp - file(s) not in client view.",
+		"//depot/main/src/Engine/Render.cpp#99 - no file(s) at that revision.",
+		"//depot/main/...@999999 - no file(s) at that changelist number.",
+		"//depot/main/src/Engine/Render.cpp#12 - has been purged.",
+		"Can't clobber writable file C:\\ws\\main\\src\\Engine\\Writable.cpp",
+		"Can't clobber writable file C:\\ws\\main\\docs\\Read Me - Copy.txt",
+		"Can't clobber writable file ",
+		"Perforce password (P4PASSWD) invalid or unset.",
+		"Your session has expired, please login again.",
+		"Request too large (over 500000); see 'p4 help maxresults'.",
+		"Client 'ws-main' unknown - use 'client' command to create it.",
+		"",
+	};
+
+	// Fragments which are joined at random to reach the corners of each pattern. Each message is parsed on its own, so
+	// line breaks are left out.
+	static const char* Fragments[] = {
+		" - ", "#", "#12", "#head", " ", "  ", "\t", "...", "... ", "//depot/a b/c.txt", "C:\\ws\\x y.txt",
+		"is opened ", "is opened for edit", "deleted as ", "added as ", "updating ", "must resolve", " - must resolve",
+		" before submitting", " #3", " #", "no file(s) at that revision", "no such file(s)", "file(s) not in client view",
+		"no file(s) at that changelist number", "file(s) up-to-date", "Can't clobber writable file ", "x", "ab", "abc", "_", "-", "@",
+	};
+
+	struct FRegexSyncAction
+	{
+		FRegexSyncAction() :
+			m_SyncActionType(DepotSyncActionType::None)
+		{}
+
+		bool operator==(const FRegexSyncAction& rhs) const
+		{
+			return m_SyncActionType == rhs.m_SyncActionType && m_DepotFile == rhs.m_DepotFile && m_Revision == rhs.m_Revision && m_ClientFile == rhs.m_ClientFile;
+		}
+
+		DepotSyncActionType::Enum m_SyncActionType;
+		DepotString m_DepotFile;
+		DepotString m_Revision;
+		DepotString m_ClientFile;
+	};
+
+	static FRegexSyncAction FromScan(const FDepotSyncActionScan& scan)
+	{
+		FRegexSyncAction action;
+		action.m_SyncActionType = scan.m_SyncActionType;
+		action.m_DepotFile.assign(scan.m_DepotFile);
+		action.m_Revision.assign(scan.m_Revision);
+		action.m_ClientFile.assign(scan.m_ClientFile);
+		return action;
+	}
+
+	// The regular expressions which FDepotSyncActionInfo::FromInfoOutput used before DepotSyncActionScanner
+	static FRegexSyncAction FromInfoOutputRegex(const DepotString& infoText)
+	{
+		static const std::regex fileRev("^([^#]*)(#\\w+)? - (.+)");
+		static const std::regex actionOpened("^is opened .+");
+		static const std::regex actionDeleted("^deleted as (.+)");
+		static const std::regex actionAdded("^added as (.+)");
+		static const std::regex actionUpdated("^updating (.+)");
+		static const std::regex actionNeedsResolve("^(...\\s+)*(.*) - must resolve( (#\\w+))? before submitting");
+
+		FRegexSyncAction info;
+		std::match_results<const char*> match;
+		if (std::regex_search(infoText.c_str(), match, fileRev))
+		{
+			info.m_DepotFile = match[1];
+			info.m_Revision = match[2];
+			const DepotString fileRevAction = match[3];
+			if (std::regex_search(fileRevAction.c_str(), match, actionOpened))
+			{
+				info.m_SyncActionType = DepotSyncActionType::OpenedNotChanged;
+			}
+			else if (std::regex_search(fileRevAction.c_str(), match, actionDeleted))
+			{
+				info.m_SyncActionType = DepotSyncActionType::Deleted;
+				info.m_ClientFile = match[1];
+			}
+			else if (std::regex_search(fileRevAction.c_str(), match, actionAdded))
+			{
+				info.m_SyncActionType = DepotSyncActionType::Added;
+				info.m_ClientFile = match[1];
+			}
+			else if (std::regex_search(fileRevAction.c_str(), match, actionUpdated))
+			{
+				info.m_SyncActionType = DepotSyncActionType::Updated;
+				info.m_ClientFile = match[1];
+			}
+		}
+		if (std::regex_search(infoText.c_str(), match, actionNeedsResolve))
+		{
+			info.m_DepotFile = match[2];
+			info.m_Revision = match[4];
+			info.m_SyncActionType = DepotSyncActionType::NeedsResolve;
+		}
+		return info;
+	}
+
+	// The regular expressions which FDepotSyncActionInfo::FromErrorOutput used before DepotSyncActionScanner
+	static FRegexSyncAction FromErrorOutputRegex(const DepotString& errorText)
+	{
+		static const std::regex fileRev("^([^#]*)(#\\w+)? - (.+)");
+		static const std::regex actionNoFileAtRevision("^no file\\(s\\) at that revision");
+		static const std::regex actionInvalidPattern("^no such file\\(s\\)");
+		static const std::regex actionNotInClientView("^file\\(s\\) not in client view");
+		static const std::regex actionNoFilesFound("^no file\\(s\\) at that changelist number");
+		static const std::regex actionUpToDate("^file\\(s\\) up-to-date");
+		static const std::regex actionCantClobber("^Can't clobber writable file (.+)");
+
+		FRegexSyncAction info;
+		std::match_results<const char*> match;
+		if (std::regex_search(errorText.c_str(), match, fileRev))
+		{
+			info.m_DepotFile = match[1];
+			info.m_Revision = match[2];
+			const DepotString fileRevAction = match[3];
+			if (std::regex_search(fileRevAction.c_str(), match, actionNoFileAtRevision))
+				info.m_SyncActionType = DepotSyncActionType::NoFileAtRevision;
+			else if (std::regex_search(fileRevAction.c_str(), match, actionInvalidPattern))
+				info.m_SyncActionType = DepotSyncActionType::InvalidPattern;
+			else if (std::regex_search(fileRevAction.c_str(), match, actionNotInClientView))
+				info.m_SyncActionType = DepotSyncActionType::NotInClientView;
+			else if (std::regex_search(fileRevAction.c_str(), match, actionNoFilesFound))
+				info.m_SyncActionType = DepotSyncActionType::NoFilesFound;
+			else if (std::regex_search(fileRevAction.c_str(), match, actionUpToDate))
+				info.m_SyncActionType = DepotSyncActionType::UpToDate;
+		}
+		else if (std::regex_search(errorText.c_str(), match, actionCantClobber))
+		{
+			info.m_ClientFile = match[1];
+			info.m_SyncActionType = DepotSyncActionType::CantClobber;
+		}
+		else
+		{
+			info.m_SyncActionType = DepotSyncActionType::GenericError;
+		}
+		return info;
+	}
+
+	// Each line of the corpus as it was captured, and with the newline which a message is formatted with
+	static DepotStringArray CreateCorpus(const char* const* lines, size_t lineCount)
+	{
+		DepotStringArray corpus;
+		for (size_t lineIndex = 0; lineIndex < lineCount; ++lineIndex)
+		{
+			corpus.push_back(lines[lineIndex]);
+			corpus.push_back(StringInfo::Format("%s\n", lines[lineIndex]));
+		}
+		return corpus;
+	}
+
+	static DepotStringArray CreateFuzzLines(size_t count)
+	{
+		std::mt19937 random(1);
+		DepotStringArray lines;
+		lines.reserve(count);
+		for (size_t lineIndex = 0; lineIndex < count; ++lineIndex)
+		{
+			DepotString line;
+			for (size_t fragmentCount = random() % 12; fragmentCount > 0; --fragmentCount)
+			{
+				line += Fragments[random() % _countof(Fragments)];
+			}
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
+	static void AssertInfoOutput(const DepotString& line)
+	{
+		const FRegexSyncAction expected = FromInfoOutputRegex(line);
+		const FRegexSyncAction scanned = FromScan(DepotSyncActionScanner::ScanInfoOutput(line.c_str()));
+		Assert(scanned.m_SyncActionType == expected.m_SyncActionType);
+		Assert(scanned.m_SyncActionType == DepotSyncActionType::None || scanned == expected);
+
+		const DepotSyncActionInfo info = FDepotSyncActionInfo::FromInfoOutput(line);
+		Assert(info.get() ? info->m_SyncActionType == expected.m_SyncActionType : expected.m_SyncActionType == DepotSyncActionType::None);
+	}
+
+	static void AssertErrorOutput(const DepotString& line)
+	{
+		const FRegexSyncAction expected = FromErrorOutputRegex(line);
+		Assert(FromScan(DepotSyncActionScanner::ScanErrorOutput(line.c_str())) == expected);
+
+		const DepotSyncActionInfo info = FDepotSyncActionInfo::FromErrorOutput(line);
+		Assert(info.get() && info->m_SyncActionType == expected.m_SyncActionType);
+		Assert(info->m_DepotFile == expected.m_DepotFile && info->m_ClientFile == expected.m_ClientFile);
+	}
+}
+
+void TestDepotOperationsSyncActionScanner(const TestContext& context)
+{
+	using namespace TestDepotOperationsSyncActionScannerInternal;
+
+	// Every line of captured output is classified as it was by the regular expressions
+	for (const DepotString& line : CreateCorpus(InfoCorpus, _countof(InfoCorpus)))
+	{
+		AssertInfoOutput(line);
+	}
+	for (const DepotString& line : CreateCorpus(ErrorCorpus, _countof(ErrorCorpus)))
+	{
+		AssertErrorOutput(line);
+	}
+	for (const DepotString& line : CreateFuzzLines(20000))
+	{
+		AssertInfoOutput(line);
+		AssertErrorOutput(line);
+	}
+
+	const FDepotSyncActionScan updated = DepotSyncActionScanner::ScanInfoOutput(InfoCorpus[7]);
+	Assert(updated.m_SyncActionType == DepotSyncActionType::Updated);
+	Assert(updated.m_DepotFile == "//depot/main/docs/Read Me - Copy.txt");
+	Assert(updated.m_Revision == "#2");
+	Assert(updated.m_ClientFile == "C:\\ws\\main\\docs\\Read Me - Copy.txt");
+	Assert(updated.m_DepotFile.data() == InfoCorpus[7]);
+
+	const FDepotSyncActionScan resolve = DepotSyncActionScanner::ScanInfoOutput(InfoCorpus[14]);
+	Assert(resolve.m_SyncActionType == DepotSyncActionType::NeedsResolve);
+	Assert(resolve.m_DepotFile == "//depot/main/src/Engine/Conflict.cpp");
+	Assert(resolve.m_Revision == "#5");
+
+	const DepotSyncActionInfo upToDate = FDepotSyncActionInfo::FromErrorOutput(ErrorCorpus[0]);
+	Assert(upToDate->m_SyncActionType == DepotSyncActionType::UpToDate);
+	Assert(upToDate->m_DepotFile == "//depot/main/src/...@1234");
+	Assert(upToDate->m_Revision.get() == nullptr);
+}
+
+void TestDepotOperationsSyncActionScannerBenchmark(const TestContext& context)
+{
+	using namespace TestDepotOperationsSyncActionScannerInternal;
+
+	DepotStringArray lines;
+	for (size_t repeat = 0; repeat < 2000; ++repeat)
+	{
+		for (const char* line : InfoCorpus)
+		{
+			lines.push_back(line);
+		}
+	}
+
+	DepotStopwatch scannerTimer(DepotStopwatch::Init::Start);
+	size_t scannerCount = 0;
+	for (const DepotString& line : lines)
+	{
+		scannerCount += DepotSyncActionScanner::ScanInfoOutput(line.c_str()).m_SyncActionType != DepotSyncActionType::None ? 1 : 0;
+	}
+	scannerTimer.Stop();
+
+	DepotStopwatch regexTimer(DepotStopwatch::Init::Start);
+	size_t regexCount = 0;
+	for (const DepotString& line : lines)
+	{
+		regexCount += FromInfoOutputRegex(line).m_SyncActionType != DepotSyncActionType::None ? 1 : 0;
+	}
+	regexTimer.Stop();
+
+	Assert(scannerCount == regexCount);
+	context.Log()->Info(StringInfo::Format("SyncActionScanner lines=%I64u actions=%I64u scanner=%0.1fns/line regex=%0.1fns/line", 
+		uint64_t(lines.size()), 
+		uint64_t(scannerCount), 
+		scannerTimer.DurationMilliseconds() * 1e6 / lines.size(), 
+		regexTimer.DurationMilliseconds() * 1e6 / lines.size()));
+}
+
+void TestDepotOperationsContentCache(const TestContext& context)
+{
+	const String rootFolder = context.GetEnvironment(TEXT("P4ROOT"));
+	Assert(rootFolder.size() > 0);
+
+	const String cacheFolder = StringInfo::Format(TEXT("%s\\TestDepotOperationsContentCache"), rootFolder.c_str());
+	Assert(FileInfo::DeleteDirectoryRecursively(cacheFolder.c_str()));
+
+	auto createContent = [](size_t index) -> Array<uint8_t>
+	{
+		Array<uint8_t> contents(1000 + index * 100);
+		for (size_t byteIndex = 0; byteIndex < contents.size(); ++byteIndex)
+			contents[byteIndex] = uint8_t(byteIndex * 17 + index);
+		return contents;
+	};
+
+	auto createKey = [](size_t index) -> DepotString
+	{
+		return StringInfo::Format("ssl:perforce:1666\nuser\ncrlf\n//depot/cache/file%02u.dat#%u", uint32_t(index), uint32_t(index + 1));
+	};
+
+	auto publishContent = [](DepotContentCache& cache, const DepotString& key, const Array<uint8_t>& contents) -> bool
+	{
+		const String tempFilePath = cache.CreateTempFile();
+		Assert(FileInfo::IsRegular(tempFilePath.c_str()));
+		{
+			AutoHandle tempFile = CreateFile(tempFilePath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			DWORD bytesWritten = 0;
+			Assert(tempFile.IsValid());
+			Assert(WriteFile(tempFile.Handle(), contents.data(), DWORD(contents.size()), &bytesWritten, NULL) && bytesWritten == contents.size());
+		}
+		Assert(FileInfo::SetReadOnly(tempFilePath.c_str(), true));
+		const bool published = cache.Publish(key, tempFilePath);
+		Assert(FileInfo::Exists(tempFilePath.c_str()) == false);
+		return published;
+	};
+
+	auto isContentMatch = [](DepotContentCache& cache, const DepotString& key, const Array<uint8_t>& contents) -> bool
+	{
+		AutoHandle cacheFile;
+		if (cache.OpenFile(key, cacheFile) == false)
+			return false;
+
+		Array<uint8_t> fileContents(contents.size() + 1);
+		DWORD bytesRead = 0;
+		Assert(ReadFile(cacheFile.Handle(), fileContents.data(), DWORD(fileContents.size()), &bytesRead, NULL));
+		return bytesRead == contents.size() && memcmp(fileContents.data(), contents.data(), contents.size()) == 0;
+	};
+
+	const size_t fileCount = 8;
+	{
+		DepotContentCache cache;
+		Assert(cache.IsOpen() == false);
+		Assert(cache.CreateTempFile().empty());
+		Assert(cache.Open(String(), 1024*1024) == false);
+		Assert(cache.Open(cacheFolder, 1024*1024));
+		Assert(cache.IsOpen());
+		Assert(StringInfo::Stricmp(cache.GetFolderPath().c_str(), cacheFolder.c_str()) == 0);
+		
+		for (size_t index = 0; index < fileCount; ++index)
+		{
+			Assert(isContentMatch(cache, createKey(index), createContent(index)) == false);
+			Assert(publishContent(cache, createKey(index), createContent(index)));
+			Assert(isContentMatch(cache, createKey(index), createContent(index)));
+		}
+
+		// A key which was never published is not a hit, and a published file is not replaced
+		Assert(isContentMatch(cache, createKey(0) + "0", createContent(0)) == false);
+		Assert(publishContent(cache, createKey(0), createContent(1)));
+		Assert(isContentMatch(cache, createKey(0), createContent(0)));
+
+		FDepotContentCacheStats stats = cache.GetStats();
+		Assert(stats.m_HitCount == fileCount + 1);
+		Assert(stats.m_MissCount == fileCount + 1);
+		Assert(stats.m_PublishCount == fileCount + 1);
+		Assert(stats.m_FileCount == fileCount);
+		Assert(stats.m_EvictCount == 0);
+		Assert(stats.ToString().empty() == false);
+	}
+
+	// The files in the folder are indexed when it is opened again, and evicted if they exceed the budget
+	{
+		DepotContentCache cache;
+		Assert(cache.Open(cacheFolder, 1024*1024));
+		FDepotContentCacheStats stats = cache.GetStats();
+		Assert(stats.m_FileCount == fileCount);
+		Assert(isContentMatch(cache, createKey(fileCount-1), createContent(fileCount-1)));
+
+		uint64_t totalBytes = 0;
+		for (size_t index = 0; index < fileCount; ++index)
+			totalBytes += createContent(index).size();
+		Assert(stats.m_TotalBytes == totalBytes);
+
+		Assert(cache.Open(cacheFolder, 0));
+		stats = cache.GetStats();
+		Assert(stats.m_FileCount == 0);
+		Assert(stats.m_TotalBytes == 0);
+		Assert(stats.m_EvictCount == fileCount);
+		Assert(stats.m_EvictBytes == totalBytes);
+		Assert(isContentMatch(cache, createKey(0), createContent(0)) == false);
+	}
+
+	// The least recently used files are evicted as files are published, except for a file which is open for reading
+	{
+		DepotContentCache cache;
+		Assert(cache.Open(cacheFolder, createContent(0).size() + createContent(fileCount-2).size() + createContent(fileCount-1).size()));
+
+		AutoHandle openFile;
+		for (size_t index = 0; index < fileCount; ++index)
+		{
+			Assert(publishContent(cache, createKey(index), createContent(index)));
+			if (index == 0)
+				Assert(cache.OpenFile(createKey(index), openFile));
+		}
+
+		openFile.Close();
+		cache.Trim();
+
+		const FDepotContentCacheStats stats = cache.GetStats();
+		Assert(stats.m_FileCount == 3);
+		Assert(stats.m_EvictCount == fileCount - 3);
+		Assert(stats.m_TotalBytes <= cache.GetMaxBytes());
+		Assert(isContentMatch(cache, createKey(0), createContent(0)));
+		Assert(isContentMatch(cache, createKey(1), createContent(1)) == false);
+		Assert(isContentMatch(cache, createKey(fileCount-2), createContent(fileCount-2)));
+		Assert(isContentMatch(cache, createKey(fileCount-1), createContent(fileCount-1)));
+	}
+
+	Assert(FileInfo::DeleteDirectoryRecursively(cacheFolder.c_str()));
+}
+
+void TestDepotOperationsContentShare(const TestContext& context)
+{
+	const String rootFolder = context.GetEnvironment(TEXT("P4ROOT"));
+	Assert(rootFolder.size() > 0);
+
+	const String shareFolder = StringInfo::Format(TEXT("%s\\TestDepotOperationsContentShare"), rootFolder.c_str());
+	Assert(FileInfo::DeleteDirectoryRecursively(shareFolder.c_str()));
+
+	Assert(DepotContentShare::IsDigestOfPrintedFile("binary", FDepotResultLineEnd::Local));
+	Assert(DepotContentShare::IsDigestOfPrintedFile("binary+lFS4", FDepotResultLineEnd::Win));
+	Assert(DepotContentShare::IsDigestOfPrintedFile("xbinary", FDepotResultLineEnd::Local));
+	Assert(DepotContentShare::IsDigestOfPrintedFile("text+w", FDepotResultLineEnd::Unix));
+	Assert(DepotContentShare::IsDigestOfPrintedFile("text", FDepotResultLineEnd::Share) == false);
+	Assert(DepotContentShare::IsDigestOfPrintedFile("text", FDepotResultLineEnd::Local) == false);
+	Assert(DepotContentShare::IsDigestOfPrintedFile("text+k", FDepotResultLineEnd::Unix) == false);
+	Assert(DepotContentShare::IsDigestOfPrintedFile("binary+ko", FDepotResultLineEnd::Unix) == false);
+	Assert(DepotContentShare::IsDigestOfPrintedFile("ktext", FDepotResultLineEnd::Unix) == false);
+	Assert(DepotContentShare::IsDigestOfPrintedFile("utf16", FDepotResultLineEnd::Unix) == false);
+	Assert(DepotContentShare::IsDigestOfPrintedFile("symlink", FDepotResultLineEnd::Unix) == false);
+
+	Assert(DepotContentShare::GetDigestFilePath(shareFolder, "5d41402abc4b2a76b9719d911017c592") == shareFolder + TEXT("\\5D\\5D41402ABC4B2A76B9719D911017C592"));
+	Assert(DepotContentShare::GetDigestFilePath(shareFolder, "5D41402ABC4B2A76B9719D911017C59").empty());
+	Assert(DepotContentShare::GetDigestFilePath(shareFolder, "..\\41402ABC4B2A76B9719D911017C592").empty());
+	Assert(DepotContentShare::GetDepotFilePath(shareFolder, "//depot/share/file.txt", 3) == shareFolder + TEXT("\\depot\\share\\file.txt#3"));
+	Assert(DepotContentShare::GetDepotFilePath(shareFolder, "//depot/share/file.txt", 0).empty());
+	Assert(DepotContentShare::GetDepotFilePath(shareFolder, "//depot/../file.txt", 1).empty());
+	Assert(DepotContentShare::GetDepotFilePath(shareFolder, "//depot//file.txt", 1).empty());
+	Assert(DepotContentShare::GetDepotFilePath(shareFolder, "//depot/c:/file.txt", 1).empty());
+	Assert(DepotContentShare::GetDepotFilePath(shareFolder, "depot/file.txt", 1).empty());
+
+	auto writeFile = [](const String& filePath, const AString& contents) -> void
+	{
+		Assert(FileInfo::CreateFileDirectory(filePath.c_str()));
+		AutoHandle file = CreateFile(filePath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		DWORD bytesWritten = 0;
+		Assert(file.IsValid());
+		Assert(WriteFile(file.Handle(), contents.data(), DWORD(contents.size()), &bytesWritten, NULL) && bytesWritten == contents.size());
+	};
+
+	auto copyVerified = [](const String& filePath, const FDepotContentShareFile& shareFile) -> HRESULT
+	{
+		AutoTempFile dstFile(FileInfo::CreateTempFile(nullptr, TEXT("p4vfs")).c_str());
+		AutoHandle src = CreateFile(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		AutoHandle dst = CreateFile(dstFile.GetFilePath().c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		Assert(src.IsValid() && dst.IsValid());
+		UINT64 bytesWritten = 0;
+		return DepotContentShare::CopyVerified(src.Handle(), dst.Handle(), shareFile, &bytesWritten);
+	};
+
+	FDepotContentShareFile shareFile;
+	shareFile.m_DepotFile = "//depot/share/file.txt";
+	shareFile.m_Revision = 3;
+	shareFile.m_Digest = "5D41402ABC4B2A76B9719D911017C592";
+	shareFile.m_FileSize = 5;
+
+	AutoTempFile localFile(FileInfo::CreateTempFile(nullptr, TEXT("p4vfs")).c_str());
+	writeFile(localFile.GetFilePath(), "hello");
+	Assert(SUCCEEDED(copyVerified(localFile.GetFilePath(), shareFile)));
+
+	// A file of the same size with different content, or of a different size, is not verified
+	writeFile(localFile.GetFilePath(), "jello");
+	Assert(copyVerified(localFile.GetFilePath(), shareFile) == HRESULT_FROM_WIN32(ERROR_FILE_CORRUPT));
+	writeFile(localFile.GetFilePath(), "hello!");
+	Assert(copyVerified(localFile.GetFilePath(), shareFile) == HRESULT_FROM_WIN32(ERROR_FILE_CORRUPT));
+
+	// A file is found by its depot path when it is not in the share by digest
+	AutoHandle shareFileHandle;
+	Assert(DepotContentShare::OpenFile(shareFolder, shareFile, shareFileHandle) == false);
+	writeFile(DepotContentShare::GetDepotFilePath(shareFolder, shareFile.m_DepotFile, shareFile.m_Revision), "hello");
+	Assert(DepotContentShare::OpenFile(shareFolder, shareFile, shareFileHandle));
+	shareFileHandle.Close();
+
+	// A file is only published if it is verified, and is then found by its digest
+	Assert(DepotContentShare::Publish(shareFolder, shareFile, localFile.GetFilePath()) == false);
+	Assert(FileInfo::IsRegular(DepotContentShare::GetDigestFilePath(shareFolder, shareFile.m_Digest).c_str()) == false);
+	writeFile(localFile.GetFilePath(), "hello");
+	Assert(DepotContentShare::Publish(shareFolder, shareFile, localFile.GetFilePath()));
+	Assert(DepotContentShare::Publish(shareFolder, shareFile, localFile.GetFilePath()));
+	Assert(FileInfo::IsRegular(DepotContentShare::GetDigestFilePath(shareFolder, shareFile.m_Digest).c_str()));
+	Assert(FileInfo::Delete(DepotContentShare::GetDepotFilePath(shareFolder, shareFile.m_DepotFile, shareFile.m_Revision).c_str()));
+	Assert(DepotContentShare::OpenFile(shareFolder, shareFile, shareFileHandle));
+	shareFileHandle.Close();
+	Assert(SUCCEEDED(copyVerified(DepotContentShare::GetDigestFilePath(shareFolder, shareFile.m_Digest), shareFile)));
+
+	// A file of the wrong size in the share is not opened
+	writeFile(DepotContentShare::GetDigestFilePath(shareFolder, shareFile.m_Digest), "hello!");
+	Assert(DepotContentShare::OpenFile(shareFolder, shareFile, shareFileHandle) == false);
+
+	Assert(FileInfo::DeleteDirectoryRecursively(shareFolder.c_str()));
+}
+
+void TestDepotOperationsHydrateGroups(const TestContext& context)
+{
+	SettingPropertyScope<int32_t> maxSyncConnectionsScope(SettingManager::StaticInstance().MaxSyncConnections, 1);
+	DepotClient client = FDepotClient::New(context.m_FileContext);
+	Assert(client->Connect(context.GetDepotConfig()));
+
+	// Offline stand-ins for placeholders, grouped by the workspace of the client, another workspace, and a server which
+	// cannot be connected
+	DepotConfig otherConfig = client->Config();
+	otherConfig.m_Client = "p4vfstest-other";
+	DepotConfig brokenConfig = client->Config();
+	brokenConfig.m_Port = "broken:1666";
+	const DepotConfig* groupConfigs[] = { &client->Config(), &otherConfig, &brokenConfig };
+	const size_t groupFileCounts[] = { 5, 2, 3 };
+
+	List<AutoTempFile> tempFiles;
+	Array<DepotSyncActionInfo> modifications;
+	DepotOperations::HydrateGroupMap hydrateGroups;
+	for (size_t groupIndex = 0; groupIndex < _countof(groupConfigs); ++groupIndex)
+	{
+		DepotOperations::FHydrateGroup& group = hydrateGroups[DepotOperations::CreateHydrateGroupKey(*groupConfigs[groupIndex])];
+		group.m_Config = *groupConfigs[groupIndex];
+		for (size_t fileIndex = 0; fileIndex < groupFileCounts[groupIndex]; ++fileIndex)
+		{
+			const AutoTempFile& tempFile = tempFiles.emplace_back(FileInfo::CreateTempFile(nullptr, TEXT("p4vfs")).c_str());
+			Assert(SetFileAttributes(tempFile.GetFilePath().c_str(), FILE_ATTRIBUTE_OFFLINE));
+
+			DepotSyncActionInfo modification = std::make_shared<FDepotSyncActionInfo>();
+			modification->m_DepotFile = StringInfo::Format("//depot/hydrate/group%u/file%u.txt", uint32_t(groupIndex), uint32_t(fileIndex));
+			modification->m_ClientFile = CSTR_WTOA(tempFile.GetFilePath());
+			group.m_Modifications.push_back(modification);
+			modifications.push_back(modification);
+		}
+	}
+	Assert(hydrateGroups.size() == _countof(groupConfigs));
+
+	// Groups of another workspace are connected separately, and the second batch of the client's workspace is never printed
+	Array<DepotString> connectedPorts;
+	Map<DepotString, FDepotClient*> populateClients;
+	const DepotString unprintedDepotFile = "//depot/hydrate/group0/file2.txt";
+	LogDeviceMemory log;
+	size_t printBatchCount = 0;
+	const DepotSyncStatus::Enum groupStatus = DepotOperations::HydrateGroups(
+		client, 
+		hydrateGroups, 
+		2, 
+		&log, 
+		[&context, &connectedPorts, &brokenConfig](const DepotConfig& groupConfig) -> DepotClient
+		{
+			connectedPorts.push_back(groupConfig.m_Port);
+			return groupConfig.m_Port == brokenConfig.m_Port ? nullptr : FDepotClient::New(context.m_FileContext);
+		},
+		[&populateClients, &unprintedDepotFile](DepotClient& pooledClient, const Array<DepotSyncActionInfo>& batch) -> bool
+		{
+			for (const DepotSyncActionInfo& modification : batch)
+			{
+				populateClients[modification->m_DepotFile] = pooledClient.get();
+				if (batch.front()->m_DepotFile != unprintedDepotFile)
+				{
+					Assert(SetFileAttributes(CSTR_ATOW(modification->m_ClientFile), FILE_ATTRIBUTE_NORMAL));
+				}
+			}
+			return true;
+		},
+		&printBatchCount);
+
+	Assert(groupStatus == DepotSyncStatus::Error);
+	Assert(connectedPorts.size() == 2);
+	Assert(printBatchCount == 3 + 1);
+	Assert(populateClients.size() == 5 + 2);
+	Assert(populateClients["//depot/hydrate/group0/file0.txt"] == client.get());
+	Assert(populateClients["//depot/hydrate/group1/file0.txt"] != client.get());
+	Assert(log.GetChannelCount(LogChannel::Error) == 3);
+
+	// The files of the unprinted batch are still offline, and are marked along with the files of the failed connection
+	Assert(DepotOperations::VerifyHydratedFiles(modifications, &log) == DepotSyncStatus::Error);
+	Assert(log.GetChannelCount(LogChannel::Error) == 3 + 2);
+	Assert(DepotSyncStatus::FromLog(log) == DepotSyncStatus::Error);
+
+	const Set<DepotString> errorDepotFiles = {
+		"//depot/hydrate/group0/file2.txt",
+		"//depot/hydrate/group0/file3.txt",
+		"//depot/hydrate/group2/file0.txt",
+		"//depot/hydrate/group2/file1.txt",
+		"//depot/hydrate/group2/file2.txt",
+	};
+	for (const DepotSyncActionInfo& modification : modifications)
+	{
+		const bool isError = errorDepotFiles.find(modification->m_DepotFile) != errorDepotFiles.end();
+		Assert((modification->m_SyncActionType == DepotSyncActionType::GenericError) == isError);
+	}
+
+	// Files which were already hydrated are left alone
+	Assert(DepotOperations::VerifyHydratedFiles(modifications, &log) == DepotSyncStatus::Success);
+	Assert(log.GetChannelCount(LogChannel::Error) == 3 + 2);
+}
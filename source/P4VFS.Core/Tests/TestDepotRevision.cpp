@@ -218,3 +218,64 @@ void TestDepotRevisionDateShort(const TestContext& context)
 	Assert(datetime == dateRevision->m_Value);
 	Assert(dateRevision->ToString() == revisionString+":00:00:00");
 }
+
+void TestDepotRevisionValue(const TestContext& context)
+{
+	static_assert([]() constexpr -> bool
+	{
+		FDepotRevisionValue value;
+		char text[FDepotRevisionValue::MaxLength+1] = {};
+		return FDepotRevisionValue::Parse(" #042 ", 6, value) && value == FDepotRevisionValue(DepotRevisionType::Number, 42) && value.Format(text, sizeof(text)) == 3 && text[0] == '#' && text[3] == '\0';
+	}(), "FDepotRevisionValue is expected to parse and format in a constant expression");
+
+	// Each revision text is parsed and formatted as FDepotRevision does
+	for (const DepotString& revisionString : DepotStringArray({ "#1", "@1", "#0", "@0", "#000", " #12\t", "@34 ", "#2147483647", "@2147483647", "#none", "#NONE", "#have", "#Head", "@now", "@NOW" }))
+	{
+		FDepotRevisionValue value;
+		Assert(FDepotRevisionValue::Parse(revisionString.c_str(), revisionString.size(), value));
+
+		DepotRevision revision = FDepotRevision::FromString(revisionString);
+		Assert(revision.get() != nullptr && revision->GetType() == value.m_Type);
+
+		char text[FDepotRevisionValue::MaxLength+1];
+		Assert(value.Format(text, _countof(text)) == revision->ToString().size());
+		Assert(revision->ToString() == text);
+		Assert(FDepotRevision::ToString(value.ToRevision()) == text);
+
+		FDepotRevisionValue revisionValue;
+		Assert(FDepotRevisionValue::FromRevision(revision, revisionValue) && revisionValue == value);
+	}
+
+	// Labels, ranges, dates, and anything which is not a revision, are not values
+	for (const DepotString& revisionString : DepotStringArray({ "", " ", "#", "@", "#-1", "#2147483648", "#12a", " #none", "#have ", "@mylabel", "#10,20", "@=2389", "@2019/08/15" }))
+	{
+		FDepotRevisionValue value;
+		Assert(FDepotRevisionValue::Parse(revisionString.c_str(), revisionString.size(), value) == false);
+	}
+
+	for (const DepotRevision& revision : Array<DepotRevision>({ FDepotRevision::New<FDepotRevisionLabel>("mylabel"), FDepotRevision::FromString("#10,20"), FDepotRevision::FromString("@2019/08/15"), FDepotRevision::New<FDepotRevisionNumber>(-1) }))
+	{
+		FDepotRevisionValue value;
+		Assert(revision.get() != nullptr);
+		Assert(FDepotRevisionValue::FromRevision(revision, value) == false);
+	}
+
+	FDepotRevisionValue emptyValue(DepotRevisionType::Head);
+	Assert(FDepotRevisionValue::FromRevision(nullptr, emptyValue) && emptyValue == FDepotRevisionValue());
+	Assert(emptyValue.ToRevision().get() == nullptr);
+
+	char emptyText[1] = { 'x' };
+	Assert(emptyValue.Format(emptyText, _countof(emptyText)) == 0 && emptyText[0] == '\0');
+
+	char shortText[3] = { 'x' };
+	Assert(FDepotRevisionValue(DepotRevisionType::Number, 100).Format(shortText, _countof(shortText)) == 0 && shortText[0] == '\0');
+
+	char longText[FDepotRevisionValue::MaxLength+1];
+	Assert(FDepotRevisionValue(DepotRevisionType::Changelist, INT32_MIN).Format(longText, _countof(longText)) == FDepotRevisionValue::MaxLength);
+	Assert(DepotString(longText) == "@-2147483648");
+
+	// Keywords and small numbers are shared, and larger numbers are allocated
+	Assert(FDepotRevisionValue(DepotRevisionType::Have).ToRevision() == FDepotRevisionValue(DepotRevisionType::Have).ToRevision());
+	Assert(FDepotRevisionValue(DepotRevisionType::Number, 7).ToRevision() == FDepotRevisionValue(DepotRevisionType::Number, 7).ToRevision());
+	Assert(FDepotRevisionValue(DepotRevisionType::Number, FDepotRevisionValue::SharedNumberCount).ToRevision() != FDepotRevisionValue(DepotRevisionType::Number, FDepotRevisionValue::SharedNumberCount).ToRevision());
+}
@@ -9,6 +9,10 @@
 #include "DriverOperations.h"
 #include "DriverVersion.h"
 #include "FileSystem.h"
+#include "FileOperations.h"
+#include "FilePrefetchPredictor.h"
+#include "FileResolveCoalescer.h"
+#include "ThreadPool.h"
 
 using namespace Microsoft::P4VFS::FileCore;
 using namespace Microsoft::P4VFS::TestCore;
@@ -59,7 +63,7 @@ void TestRequireFilterOpLock(const TestContext& context)
 	DepotSyncResult syncResult = DepotOperations::Sync(client, DepotStringArray{ depotFile }, nullptr);
 	Assert(syncResult.get() != nullptr);
 	Assert(syncResult->m_Status == DepotSyncStatus::Success);
-	Assert(syncResult->m_Modifications.get() && syncResult->m_Modifications->size() > 0);
+	Assert(syncResult->m_Modifications.get() && syncResult->m_Modifications->Count() > 0);
 
 	const String clientFile = StringInfo::ToWide(client->Run<DepotResultWhere>("where", DepotStringArray{ depotFile })->Node().LocalPath());
 	Assert(FileInfo::IsRegular(clientFile.c_str()));
@@ -433,3 +437,323 @@ void TestReadDirectoryChanges(const TestContext& context)
 	Assert(uniqueChanges[0].m_File == mutableClientRelativeFile);
 }
 
+
+void TestFilePrefetchPredictor(const TestContext& context)
+{
+	using namespace Microsoft::P4VFS::FileSystem;
+
+	const String rootFolder = context.GetEnvironment(TEXT("P4ROOT"));
+	Assert(rootFolder.size() > 0);
+
+	const String testFolder = StringInfo::Format(TEXT("%s\\TestFilePrefetchPredictor"), rootFolder.c_str());
+	Assert(FileInfo::DeleteDirectoryRecursively(testFolder.c_str()));
+
+	auto createTrace = [](const StringArray& filePaths, int64_t timeMs) -> Array<FFilePrefetchTraceEntry>
+	{
+		Array<FFilePrefetchTraceEntry> trace;
+		for (const String& filePath : filePaths)
+		{
+			FFilePrefetchTraceEntry entry;
+			entry.m_TimeMs = timeMs + int64_t(trace.size()) * 100;
+			entry.m_FileSize = 1000;
+			entry.m_FilePath = filePath;
+			trace.push_back(entry);
+		}
+		return trace;
+	};
+
+	auto observeTrace = [](FilePrefetchPredictor& predictor, const Array<FFilePrefetchTraceEntry>& trace) -> void
+	{
+		for (const FFilePrefetchTraceEntry& entry : trace)
+			predictor.Observe(entry.m_FilePath, entry.m_TimeMs);
+	};
+
+	// Files of different folders which are hydrated together, as by a build
+	const StringArray buildFiles = { L"C:\\ws\\a\\main.cpp", L"C:\\ws\\b\\core.h", L"C:\\ws\\c\\util.h", L"C:\\ws\\d\\types.h", L"C:\\ws\\e\\config.h" };
+	const StringArray buildPrediction(buildFiles.begin() + 1, buildFiles.end());
+
+	// A link is only predicted once it has been seen twice
+	FilePrefetchPredictor predictor;
+	observeTrace(predictor, createTrace(buildFiles, 0));
+	Assert(predictor.Predict(buildFiles[0], 1000).m_FilePaths.empty());
+	observeTrace(predictor, createTrace(buildFiles, 100000));
+	Assert(predictor.Predict(buildFiles[0], 101000).m_FilePaths == buildPrediction);
+	Assert(predictor.Predict(buildFiles[0], 101000).m_IsDirectoryAccess == false);
+	Assert(predictor.Predict(buildFiles.back(), 101000).m_FilePaths.empty());
+
+	// A folder is read through once a second file of it is hydrated within the window
+	predictor.Observe(L"C:\\ws\\f\\0.txt", 200000);
+	Assert(predictor.Predict(L"C:\\ws\\f\\0.txt", 200000).m_IsDirectoryAccess == false);
+	predictor.Observe(L"C:\\ws\\f\\1.txt", 200100);
+	Assert(predictor.Predict(L"C:\\ws\\f\\1.txt", 200100).m_IsDirectoryAccess);
+	Assert(predictor.Predict(L"C:\\ws\\f\\1.txt", 300000).m_IsDirectoryAccess == false);
+
+	// The links are kept across runs
+	const String historyFilePath = StringInfo::Format(TEXT("%s\\History.txt"), testFolder.c_str());
+	Assert(predictor.Save(historyFilePath));
+	FilePrefetchPredictor loadedPredictor;
+	Assert(loadedPredictor.Load(historyFilePath));
+	Assert(loadedPredictor.GetFileCount() == predictor.GetFileCount());
+	Assert(loadedPredictor.GetLinkCount() == predictor.GetLinkCount());
+	Assert(loadedPredictor.Predict(StringInfo::ToUpper(buildFiles[0].c_str()), 0).m_FilePaths == buildPrediction);
+
+	// The least counted link is replaced once a file has the most links
+	{
+		FFilePrefetchPredictorOptions options;
+		options.m_MaxLinks = 2;
+		FilePrefetchPredictor limitedPredictor(options);
+		observeTrace(limitedPredictor, createTrace(StringArray{ L"C:\\ws\\a.txt", L"C:\\ws\\b.txt", L"C:\\ws\\c.txt", L"C:\\ws\\d.txt" }, 0));
+		Assert(limitedPredictor.GetFileCount() == 4);
+		Assert(limitedPredictor.GetLinkCount() == 5);
+	}
+
+	// Siblings are ordered by name from the file after the one hydrated
+	StringArray siblingPaths = { L"C:\\ws\\g\\c.txt", L"C:\\ws\\g\\A.txt", L"C:\\ws\\g\\b.txt", L"C:\\ws\\g\\d.txt" };
+	FilePrefetchPredictor::SortSiblings(siblingPaths, L"C:\\ws\\g\\B.txt");
+	Assert(siblingPaths == StringArray({ L"C:\\ws\\g\\c.txt", L"C:\\ws\\g\\d.txt", L"C:\\ws\\g\\A.txt" }));
+
+	// Folders of ten files which are each read through in order
+	Array<FFilePrefetchTraceEntry> folderTrace;
+	Array<FFilePrefetchTraceEntry> folderPlaceholders;
+	for (uint32_t folderIndex = 0; folderIndex < 4; ++folderIndex)
+	{
+		StringArray folderFiles;
+		for (uint32_t fileIndex = 0; fileIndex < 14; ++fileIndex)
+			folderFiles.push_back(StringInfo::Format(L"C:\\ws\\dir%u\\file%02u.dat", folderIndex, fileIndex));
+
+		const Array<FFilePrefetchTraceEntry> trace = createTrace(folderFiles, folderIndex * 60000);
+		folderTrace.insert(folderTrace.end(), trace.begin(), trace.begin() + 10);
+		folderPlaceholders.insert(folderPlaceholders.end(), trace.begin() + 10, trace.end());
+	}
+
+	FFilePrefetchReplayOptions noPrefetchOptions;
+	noPrefetchOptions.m_CoAccess = false;
+	noPrefetchOptions.m_Directory = false;
+	FFilePrefetchReplayStats stats = FilePrefetchPredictor().Replay(folderTrace, noPrefetchOptions);
+	Assert(stats.m_RequestCount == 40 && stats.m_RequestBytes == 40000 && stats.m_HitCount == 0 && stats.m_PrefetchCount == 0);
+
+	// The rest of each folder is prefetched after its second file
+	stats = FilePrefetchPredictor().Replay(folderTrace, FFilePrefetchReplayOptions());
+	Assert(stats.m_RequestCount == 40 && stats.m_HitCount == 32 && stats.m_HitBytes == 32000 && stats.m_PrefetchCount == 32 && stats.m_WastedCount == 0);
+	Assert(stats.HitRate() == 0.8);
+
+	// Placeholders which are never hydrated are wasted
+	FFilePrefetchReplayOptions placeholderOptions;
+	placeholderOptions.m_Placeholders = folderPlaceholders;
+	stats = FilePrefetchPredictor().Replay(folderTrace, placeholderOptions);
+	Assert(stats.m_HitCount == 32 && stats.m_PrefetchCount == 48 && stats.m_WastedCount == 16 && stats.m_WastedBytes == 16000);
+
+	// A smaller budget leaves more requests to the folder
+	FFilePrefetchReplayOptions budgetOptions;
+	budgetOptions.m_Budget.m_MaxFiles = 4;
+	stats = FilePrefetchPredictor().Replay(folderTrace, budgetOptions);
+	Assert(stats.m_HitCount == 28 && stats.m_PrefetchCount == 28);
+
+	budgetOptions.m_Budget.m_MaxFiles = 16;
+	budgetOptions.m_Budget.m_MaxFileSize = 999;
+	stats = FilePrefetchPredictor().Replay(folderTrace, budgetOptions);
+	Assert(stats.m_HitCount == 0 && stats.m_PrefetchCount == 0);
+
+	// Co-access links are only predicted once they have been learned by earlier runs
+	FFilePrefetchReplayOptions coAccessOptions;
+	coAccessOptions.m_Directory = false;
+	FilePrefetchPredictor replayPredictor;
+	Assert(replayPredictor.Replay(createTrace(buildFiles, 0), coAccessOptions).m_HitCount == 0);
+	Assert(replayPredictor.Replay(createTrace(buildFiles, 1000000), coAccessOptions).m_HitCount == 0);
+	stats = replayPredictor.Replay(createTrace(buildFiles, 2000000), coAccessOptions);
+	Assert(stats.m_RequestCount == 5 && stats.m_HitCount == 4 && stats.m_WastedCount == 0);
+
+	// A trace is read as it is written by the service
+	const String traceFilePath = StringInfo::Format(TEXT("%s\\Trace.txt"), testFolder.c_str());
+	for (const FFilePrefetchTraceEntry& entry : folderTrace)
+		Assert(SUCCEEDED(Microsoft::P4VFS::FileOperations::FileAppend(traceFilePath.c_str(), FilePrefetchPredictor::FormatTraceEntry(entry).c_str())));
+
+	Array<FFilePrefetchTraceEntry> loadedTrace;
+	Assert(FilePrefetchPredictor::LoadTrace(traceFilePath, loadedTrace));
+	Assert(loadedTrace.size() == folderTrace.size());
+	for (size_t entryIndex = 0; entryIndex < loadedTrace.size(); ++entryIndex)
+	{
+		Assert(loadedTrace[entryIndex].m_TimeMs == folderTrace[entryIndex].m_TimeMs);
+		Assert(loadedTrace[entryIndex].m_FileSize == folderTrace[entryIndex].m_FileSize);
+		Assert(loadedTrace[entryIndex].m_FilePath == folderTrace[entryIndex].m_FilePath);
+	}
+
+	Assert(FileInfo::DeleteDirectoryRecursively(testFolder.c_str()));
+}
+
+void TestFilePrefetchPredictorBenchmark(const TestContext& context)
+{
+	using namespace Microsoft::P4VFS::FileSystem;
+
+	// A trace recorded by the service with PrefetchTraceFile can be replayed in place of the generated one
+	Array<FFilePrefetchTraceEntry> trace;
+	wchar_t traceFilePath[MAX_PATH] = {0};
+	if (GetEnvironmentVariable(L"P4VFS_PREFETCH_TRACE", traceFilePath, _countof(traceFilePath)) > 0)
+	{
+		Assert(FilePrefetchPredictor::LoadTrace(traceFilePath, trace));
+	}
+	else
+	{
+		// Builds of the same project, each reading headers of a shared set of folders and then part of a few source folders
+		const uint32_t buildCount = 4;
+		const uint32_t headerCount = 400;
+		const uint32_t sourceFolderCount = 100;
+		const uint32_t sourceFileCount = 40;
+		uint32_t seed = 1;
+		auto random = [&seed](uint32_t range) -> uint32_t
+		{
+			seed = seed * 1103515245 + 12345;
+			return (seed >> 16) % range;
+		};
+
+		int64_t timeMs = 0;
+		for (uint32_t buildIndex = 0; buildIndex < buildCount; ++buildIndex)
+		{
+			for (uint32_t headerIndex = 0; headerIndex < headerCount; ++headerIndex)
+			{
+				FFilePrefetchTraceEntry entry;
+				entry.m_TimeMs = (timeMs += 20);
+				entry.m_FileSize = 2000 + random(30000);
+				entry.m_FilePath = StringInfo::Format(L"C:\\ws\\include\\lib%u\\header%03u.h", headerIndex % 20, headerIndex);
+				trace.push_back(entry);
+			}
+			for (uint32_t folderIndex = buildIndex; folderIndex < sourceFolderCount; folderIndex += 1 + random(8))
+			{
+				const uint32_t readCount = 1 + random(sourceFileCount);
+				for (uint32_t fileIndex = 0; fileIndex < readCount; ++fileIndex)
+				{
+					FFilePrefetchTraceEntry entry;
+					entry.m_TimeMs = (timeMs += 50);
+					entry.m_FileSize = 5000 + random(200000);
+					entry.m_FilePath = StringInfo::Format(L"C:\\ws\\source\\module%03u\\file%03u.cpp", folderIndex, fileIndex);
+					trace.push_back(entry);
+				}
+			}
+			timeMs += 3600000;
+		}
+	}
+
+	struct FReplay
+	{
+		const wchar_t* m_Name;
+		bool m_CoAccess;
+		bool m_Directory;
+		size_t m_MaxFiles;
+	};
+
+	const FReplay replays[] = {
+		{ L"none", false, false, 0 },
+		{ L"directory", false, true, 16 },
+		{ L"coaccess", true, false, 16 },
+		{ L"both", true, true, 16 },
+		{ L"both-small", true, true, 4 },
+		{ L"both-large", true, true, 64 },
+	};
+
+	for (const FReplay& replay : replays)
+	{
+		FFilePrefetchReplayOptions options;
+		options.m_CoAccess = replay.m_CoAccess;
+		options.m_Directory = replay.m_Directory;
+		options.m_Budget.m_MaxFiles = replay.m_MaxFiles;
+
+		// The trace is replayed once to learn its history, as the service would over earlier runs
+		FilePrefetchPredictor predictor;
+		predictor.Replay(trace, options);
+		const FFilePrefetchReplayStats stats = predictor.Replay(trace, options);
+		context.Log()->Info(StringInfo::Format(L"PrefetchReplay %s entries=%I64u %s", replay.m_Name, uint64_t(trace.size()), stats.ToString().c_str()));
+	}
+}
+
+void TestFileResolveCoalescer(const TestContext& context)
+{
+	using namespace Microsoft::P4VFS::FileSystem;
+	typedef FileResolveCoalescer<size_t> FCoalescer;
+
+	// A request for a file which is being resolved is attached to that resolve, regardless of case
+	{
+		FCoalescer coalescer;
+		Assert(coalescer.Attach(L"C:\\ws\\a.txt", 0) == false);
+		Assert(coalescer.Begin(L"C:\\ws\\a.txt", 1));
+		Assert(coalescer.Begin(L"C:\\WS\\A.TXT", 2) == false);
+		Assert(coalescer.Attach(L"c:\\ws\\a.txt", 3));
+		Assert(coalescer.Begin(L"C:\\ws\\b.txt", 4));
+		Assert(coalescer.IsResolving(L"C:\\ws\\A.txt"));
+		Assert(coalescer.GetResolveCount() == 2);
+		Assert(coalescer.GetWaiterCount() == 2);
+		Assert(coalescer.End(L"C:\\ws\\a.txt") == FCoalescer::RequestArray({ 2, 3 }));
+		Assert(coalescer.IsResolving(L"C:\\ws\\a.txt") == false);
+		Assert(coalescer.GetWaiterCount() == 0);
+		Assert(coalescer.End(L"C:\\ws\\a.txt").empty());
+		Assert(coalescer.Begin(L"C:\\ws\\b.txt", 5) == false);
+		Assert(coalescer.Clear() == FCoalescer::RequestArray({ 5 }));
+		Assert(coalescer.GetResolveCount() == 0);
+	}
+
+	// Thousands of concurrent requests for a small set of hot files, against a resolver which takes a while. Each request
+	// is either resolved by the thread which submitted it, or is given the result of the resolve it was attached to.
+	const size_t threadCount = 64;
+	const size_t requestCount = 8000;
+	const size_t fileCount = 8;
+	const DWORD resolveMs = 2;
+
+	StringArray filePaths;
+	for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+		filePaths.push_back(StringInfo::Format(L"C:\\ws\\hot\\file%02u.h", uint32_t(fileIndex)));
+
+	std::atomic<size_t> resolveCounts[fileCount];
+	std::atomic<size_t> activeCounts[fileCount];
+	for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+	{
+		resolveCounts[fileIndex] = 0;
+		activeCounts[fileIndex] = 0;
+	}
+
+	FCoalescer coalescer;
+	Array<int64_t> results(requestCount, -1);
+	Array<size_t> threads(threadCount);
+	for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+		threads[threadIndex] = threadIndex;
+
+	const ULONGLONG startTime = GetTickCount64();
+	ThreadPool::ForEach::Execute(threads.size(), threads.data(), threads.size(), NULL, [&](size_t threadIndex) -> void
+	{
+		for (size_t requestIndex = threadIndex; requestIndex < requestCount; requestIndex += threadCount)
+		{
+			const size_t fileIndex = requestIndex % fileCount;
+			if (coalescer.Begin(filePaths[fileIndex], requestIndex) == false)
+				continue;
+
+			// Only one resolve of a file is ever in progress
+			Assert(activeCounts[fileIndex].fetch_add(1) == 0);
+			Sleep(resolveMs);
+			const int64_t result = int64_t(fileIndex * requestCount + resolveCounts[fileIndex].fetch_add(1));
+			Assert(activeCounts[fileIndex].fetch_sub(1) == 1);
+
+			results[requestIndex] = result;
+			for (size_t waiterIndex : coalescer.End(filePaths[fileIndex]))
+				results[waiterIndex] = result;
+		}
+	});
+	const ULONGLONG elapsedMs = GetTickCount64() - startTime;
+
+	// Every request was given the result of a resolve of its own file
+	size_t resolveCount = 0;
+	for (size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex)
+	{
+		Assert(resolveCounts[fileIndex] > 0);
+		resolveCount += resolveCounts[fileIndex];
+	}
+
+	for (size_t requestIndex = 0; requestIndex < requestCount; ++requestIndex)
+	{
+		Assert(results[requestIndex] >= 0);
+		Assert(size_t(results[requestIndex]) / requestCount == requestIndex % fileCount);
+		Assert(size_t(results[requestIndex]) % requestCount < resolveCounts[requestIndex % fileCount]);
+	}
+
+	Assert(coalescer.GetResolveCount() == 0);
+	Assert(coalescer.GetWaiterCount() == 0);
+	Assert(resolveCount < requestCount / 2);
+	context.Log()->Info(StringInfo::Format(L"ResolveCoalescer requests=%I64u resolves=%I64u coalesced=%I64u elapsed=%I64ums", uint64_t(requestCount), uint64_t(resolveCount), uint64_t(requestCount - resolveCount), uint64_t(elapsedMs)));
+}
@@ -13,6 +13,14 @@ P4VFS_REGISTER_TEST( TestDepotClientPrintToFile,				10100 )
 P4VFS_REGISTER_TEST( TestDepotClientConnectFromClientOwner,		10101 )
 P4VFS_REGISTER_TEST( TestDepotClientIsWritableFileType,			10102 )
 P4VFS_REGISTER_TEST( TestDepotClientIsSymlinkFileType,			10103 )
+P4VFS_REGISTER_TEST( TestDepotClientResultArenaTags,			10104 )
+P4VFS_REGISTER_TEST( TestDepotClientResultArenaTagsBenchmark,	10105, TestFlags::Explicit )
+P4VFS_REGISTER_TEST( TestDepotClientResultStream,				10106 )
+P4VFS_REGISTER_TEST( TestDepotClientCommandPipeline,			10107 )
+P4VFS_REGISTER_TEST( TestDepotClientPrintDemux,					10108 )
+P4VFS_REGISTER_TEST( TestDepotClientTextEncoder,				10109 )
+P4VFS_REGISTER_TEST( TestDepotClientTextEncoderBenchmark,		10110, TestFlags::Explicit )
+P4VFS_REGISTER_TEST( TestDepotClientTelemetry,					10111 )
 
 // TestFileSystem
 P4VFS_REGISTER_TEST( TestResolveFileResidency,					10200 )
@@ -20,6 +28,9 @@ P4VFS_REGISTER_TEST( TestRequireFilterOpLock,					10201 )
 P4VFS_REGISTER_TEST( TestFileAlternateStream,					10202 )
 P4VFS_REGISTER_TEST( TestDevDriveAttachPolicy,					10203 )
 P4VFS_REGISTER_TEST( TestReadDirectoryChanges,					10204 )
+P4VFS_REGISTER_TEST( TestFilePrefetchPredictor,					10205 )
+P4VFS_REGISTER_TEST( TestFilePrefetchPredictorBenchmark,		10206, TestFlags::Explicit )
+P4VFS_REGISTER_TEST( TestFileResolveCoalescer,					10207 )
 
 // TestStringInfo
 P4VFS_REGISTER_TEST( TestStringInfoHash,						10300 )
@@ -37,15 +48,38 @@ P4VFS_REGISTER_TEST( TestDepotRevisionRange,					10406 )
 P4VFS_REGISTER_TEST( TestDepotRevisionLabel,					10407 )
 P4VFS_REGISTER_TEST( TestDepotRevisionDate,						10408 )
 P4VFS_REGISTER_TEST( TestDepotRevisionDateShort,				10409 )
+P4VFS_REGISTER_TEST( TestDepotRevisionValue,					10410 )
 
 // TestDepotClientCache
 P4VFS_REGISTER_TEST( TestDepotClientCacheCommon,				10500 )
+P4VFS_REGISTER_TEST( TestDepotClientCacheConnection,			10501 )
+P4VFS_REGISTER_TEST( TestDepotClientCachePool,					10502 )
+P4VFS_REGISTER_TEST( TestDepotClientCacheBenchmark,				10503, TestFlags::Explicit )
 
 // TestDepotOperations
 P4VFS_REGISTER_TEST( TestDepotOperationsSync,					10600 )
 P4VFS_REGISTER_TEST( TestDepotOperationsToString,				10601 )
 P4VFS_REGISTER_TEST( TestDepotOperationsCreateFileSpec,			10602 )
 P4VFS_REGISTER_TEST( TestDepotOperationsToDisplayString,		10603 )
+P4VFS_REGISTER_TEST( TestDepotOperationsFlushBatcher,			10604 )
+P4VFS_REGISTER_TEST( TestDepotOperationsSyncActionQueue,		10605 )
+P4VFS_REGISTER_TEST( TestDepotOperationsResidentMatcher,		10606 )
+P4VFS_REGISTER_TEST( TestDepotOperationsResidentMatcherBenchmark,	10607, TestFlags::Explicit )
+P4VFS_REGISTER_TEST( TestDepotOperationsForEachPooledClient,	10608 )
+P4VFS_REGISTER_TEST( TestDepotOperationsSyncJournal,			10609 )
+P4VFS_REGISTER_TEST( TestDepotOperationsSyncActionTable,		10610 )
+P4VFS_REGISTER_TEST( TestDepotOperationsSyncActionTableBenchmark,	10611, TestFlags::Explicit )
+P4VFS_REGISTER_TEST( TestDepotOperationsSyncStreamingSummary,	10612 )
+P4VFS_REGISTER_TEST( TestDepotOperationsDirectoryScheduler,		10613 )
+P4VFS_REGISTER_TEST( TestDepotOperationsResidentDownloader,		10614 )
+P4VFS_REGISTER_TEST( TestDepotOperationsConcurrencyController,	10615 )
+P4VFS_REGISTER_TEST( TestDepotOperationsSyncActionScanner,		10616 )
+P4VFS_REGISTER_TEST( TestDepotOperationsSyncActionScannerBenchmark,	10617, TestFlags::Explicit )
+P4VFS_REGISTER_TEST( TestDepotOperationsCreateFileSpecBenchmark,	10618, TestFlags::Explicit )
+P4VFS_REGISTER_TEST( TestDepotOperationsContentCache,			10619 )
+P4VFS_REGISTER_TEST( TestDepotOperationsContentShare,			10620 )
+P4VFS_REGISTER_TEST( TestDepotOperationsSyncPipeline,			10621 )
+P4VFS_REGISTER_TEST( TestDepotOperationsHydrateGroups,			10622 )
 
 // TestServiceOperations
 P4VFS_REGISTER_TEST( TestServiceOperationsStartStop,			10700 )
@@ -24,7 +24,8 @@ DepotResultTag^ DepotResultTag::FromNative(const P4::DepotResultTag& src)
 	if (src.get() != nullptr)
 	{
 		dst = gcnew DepotResultTag();
-		for (P4::FDepotResultTag::FieldsType::const_iterator i = src->m_Fields.begin(); i != src->m_Fields.end(); ++i)
+		const P4::FDepotResultTag::FieldsType srcFields = src->GetFields();
+		for (P4::FDepotResultTag::FieldsType::const_iterator i = srcFields.begin(); i != srcFields.end(); ++i)
 		{
 			dst->m_Fields->Add(Marshal::FromNativeAnsi(i->first.c_str()), Marshal::FromNativeAnsi(i->second.c_str()));
 		}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 #include "Pch.h"
 #include "DepotSyncActionInterop.h"
+#include "DepotSyncActionTable.h"
 #include "CoreMarshal.h"
 
 namespace Microsoft {
@@ -70,12 +71,15 @@ P4::DepotSyncResult DepotSyncResult::ToNative()
 	if (Modifications != nullptr)
 	{
 		const size_t resultCount = size_t(std::max(0, Modifications->Length));
-		dst->m_Modifications = std::make_shared<P4::DepotSyncActionInfoArray::element_type>();
-		dst->m_Modifications->resize(resultCount);
+		dst->m_Modifications = std::make_shared<P4::FDepotSyncActionTable>();
+		dst->m_Modifications->Reserve(resultCount);
 		for (size_t resultIndex = 0; resultIndex < resultCount; ++resultIndex)
 		{
 			DepotSyncActionInfo^ modification = Modifications[int32_t(resultIndex)];
-			dst->m_Modifications->at(resultIndex) = (modification != nullptr ? modification->ToNative() : nullptr);
+			if (modification != nullptr)
+			{
+				dst->m_Modifications->Append(*modification->ToNative());
+			}
 		}
 	}
 	return dst;
@@ -90,11 +94,12 @@ DepotSyncResult^ DepotSyncResult::FromNative(const P4::DepotSyncResult& src)
 		dst->Status = safe_cast<DepotSyncStatus>(src->m_Status);
 		if (src->m_Modifications.get() != nullptr)
 		{
-			const size_t resultCount = src->m_Modifications->size();
+			const P4::FDepotSyncActionTable& table = *src->m_Modifications;
+			const size_t resultCount = table.Count();
 			dst->Modifications = gcnew array<DepotSyncActionInfo^>(int32_t(resultCount));
 			for (size_t resultIndex = 0; resultIndex < resultCount; ++resultIndex)
 			{
-				dst->Modifications[int32_t(resultIndex)] = DepotSyncActionInfo::FromNative(src->m_Modifications->at(resultIndex));
+				dst->Modifications[int32_t(resultIndex)] = DepotSyncActionInfo::FromNative(table.ToActionInfo(resultIndex));
 			}
 		}
 	}
@@ -11,5 +11,6 @@ namespace Microsoft.P4VFS.Extensions
 		DateTime GetLastRequestTime();
 		DateTime GetLastModifiedTime();
 		bool GarbageCollect(Int64 timeout);
+		string GetCommandTelemetry(bool reset);
 	}
 }
@@ -175,6 +175,12 @@ namespace Microsoft.P4VFS.Extensions.SocketModel
 				SocketModelReply reply = new SocketModelReply{ Success = VirtualFileSystem.ServiceHost != null ? VirtualFileSystem.ServiceHost.GarbageCollect(request.Timeout) : false };
 				SocketModelProtocol.SendMessage(stream, new SocketModelMessage(reply), _Cancellation.Token);
 			}
+			else if (msg.Type == typeof(SocketModelRequestGetCommandTelemetry).Name)
+			{
+				SocketModelRequestGetCommandTelemetry request = msg.GetData<SocketModelRequestGetCommandTelemetry>();
+				SocketModelReplyGetCommandTelemetry reply = new SocketModelReplyGetCommandTelemetry{ Json = VirtualFileSystem.ServiceHost?.GetCommandTelemetry(request.Reset) };
+				SocketModelProtocol.SendMessage(stream, new SocketModelMessage(reply), _Cancellation.Token);
+			}
 			else if (msg.Type == typeof(SocketModelRequestReflectPackage).Name)
 			{
 				SocketModelRequestReflectPackage request = msg.GetData<SocketModelRequestReflectPackage>();
@@ -329,6 +335,18 @@ namespace Microsoft.P4VFS.Extensions.SocketModel
 			return reply != null && reply.Success;
 		}
 
+		public string GetCommandTelemetry(bool reset = false)
+		{
+			List<SocketModelMessage> result = new List<SocketModelMessage>();
+			if (SendCommand(new SocketModelRequestGetCommandTelemetry{ Reset = reset }, result) == false)
+			{
+				return null;
+			}
+
+			SocketModelReplyGetCommandTelemetry reply = SocketModelMessage.GetData<SocketModelReplyGetCommandTelemetry>(result);
+			return reply?.Json;
+		}
+
 		public byte[] ReflectPackage(byte[] package)
 		{
 			List<SocketModelMessage> result = new List<SocketModelMessage>();
@@ -624,6 +642,16 @@ namespace Microsoft.P4VFS.Extensions.SocketModel
 		public Int64 Timeout;
 	}
 
+	public class SocketModelRequestGetCommandTelemetry
+	{
+		public bool Reset;
+	}
+
+	public class SocketModelReplyGetCommandTelemetry
+	{
+		public string Json;
+	}
+
 	public class SocketModelRequestReflectPackage
 	{
 		public byte[] Package;
@@ -26,6 +26,11 @@ public:
 	GarbageCollect(
 		int64_t timeout
 		) = 0;
+
+	virtual std::string
+	GetCommandTelemetry(
+		bool reset
+		) = 0;
 };
 	
 }}}
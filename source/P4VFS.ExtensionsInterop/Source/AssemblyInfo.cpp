@@ -49,3 +49,4 @@ CA_GLOBAL_SUPPRESS_MESSAGE("Microsoft.Security", "CA2123:OverrideLinkDemandsShou
 CA_GLOBAL_SUPPRESS_MESSAGE("Microsoft.Security", "CA2123:OverrideLinkDemandsShouldBeIdenticalToBase", Scope="member", Target="Microsoft.P4VFS.ExtensionsProtocol.ManagedServiceHost.#GetLastModifiedTime()");
 CA_GLOBAL_SUPPRESS_MESSAGE("Microsoft.Security", "CA2123:OverrideLinkDemandsShouldBeIdenticalToBase", Scope="member", Target="Microsoft.P4VFS.ExtensionsProtocol.ManagedServiceHost.#NotifyModifiedTime()");
 CA_GLOBAL_SUPPRESS_MESSAGE("Microsoft.Security", "CA2123:OverrideLinkDemandsShouldBeIdenticalToBase", Scope="member", Target="Microsoft.P4VFS.ExtensionsProtocol.ManagedServiceHost.#GarbageCollect(System.Int64)");
+CA_GLOBAL_SUPPRESS_MESSAGE("Microsoft.Security", "CA2123:OverrideLinkDemandsShouldBeIdenticalToBase", Scope="member", Target="Microsoft.P4VFS.ExtensionsProtocol.ManagedServiceHost.#GetCommandTelemetry(System.Boolean)");
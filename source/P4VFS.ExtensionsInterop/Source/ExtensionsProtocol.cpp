@@ -63,6 +63,14 @@ public:
 		return m_SrvHost ? m_SrvHost->GarbageCollect(timeout) : false;
 	}
 
+	virtual System::String^
+	GetCommandTelemetry(
+		bool reset
+		)
+	{
+		return m_SrvHost ? marshal_as<System::String^>(m_SrvHost->GetCommandTelemetry(reset)) : nullptr;
+	}
+
 private:
 	Microsoft::P4VFS::ExtensionsInterop::ServiceHost* m_SrvHost;
 };
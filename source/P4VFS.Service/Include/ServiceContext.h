@@ -3,7 +3,9 @@
 #pragma once
 #include "FileContext.h"
 #include "DepotClientCache.h"
+#include "DepotContentCache.h"
 #include "ServiceLog.h"
+#include "ServicePrefetch.h"
 
 namespace Microsoft {
 namespace P4VFS {
@@ -16,6 +18,8 @@ public:
 public:
 	ServiceLogDevice m_ServiceLogDevice;
 	static P4::DepotClientCache m_StaticDepotClientCache;
+	static P4::DepotContentCache m_StaticDepotContentCache;
+	static ServicePrefetcher m_StaticPrefetcher;
 };
 
 }}
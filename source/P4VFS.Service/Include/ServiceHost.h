@@ -2,6 +2,8 @@
 // Licensed under the MIT license.
 #pragma once
 #include "ExtensionsServiceHost.h"
+#include "DepotContentCache.h"
+#include "ServicePrefetch.h"
 
 namespace Microsoft {
 namespace P4VFS {
@@ -83,6 +85,11 @@ public:
 		int64_t timeout
 		) override;
 
+	virtual std::string
+	GetCommandTelemetry(
+		bool reset
+		) override;
+
 private:
 	static bool
 	HasArgument(
@@ -101,6 +108,8 @@ private:
 	class ServiceListener*			m_SrvListener;
 	std::atomic<FILETIME>			m_SrvLastRequestTime;
 	HANDLE							m_SrvTickThread;
+	P4::FDepotContentCacheStats		m_SrvContentCacheStats;
+	ServicePrefetchStats			m_SrvPrefetchStats;
 };
 
 }}
@@ -0,0 +1,134 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#pragma once
+#include "DriverData.h"
+#include "FileContext.h"
+#include "FilePrefetchPredictor.h"
+
+namespace Microsoft {
+namespace P4VFS {
+
+struct ServicePrefetchRequest
+{
+	ServicePrefetchRequest() :
+		m_FileSize(0)
+	{}
+
+	// The placeholder to hydrate, and its name as the driver would give it in a request
+	FileCore::String m_FilePath;
+	FileCore::String m_DataName;
+	int64_t m_FileSize;
+	// The user whose request this prefetch follows, who is impersonated to hydrate it
+	FileCore::UserContext m_UserContext;
+};
+
+struct ServicePrefetchStats
+{
+	ServicePrefetchStats() :
+		m_RequestCount(0),
+		m_QueuedCount(0),
+		m_QueuedBytes(0),
+		m_PrefetchCount(0),
+		m_PrefetchBytes(0),
+		m_SkippedCount(0),
+		m_FailedCount(0),
+		m_CanceledCount(0)
+	{}
+
+	uint64_t m_RequestCount;
+	uint64_t m_QueuedCount;
+	uint64_t m_QueuedBytes;
+	uint64_t m_PrefetchCount;
+	uint64_t m_PrefetchBytes;
+	uint64_t m_SkippedCount;
+	uint64_t m_FailedCount;
+	uint64_t m_CanceledCount;
+
+	FileCore::String ToString() const;
+};
+
+// Chooses the placeholders to hydrate ahead of the requests of the driver. Each request is observed by a predictor
+// which learns the files hydrated together, and the predicted files are prefetched along with the other placeholders
+// of a folder which is being read through. The learned history is saved across runs, and each request can also be
+// written to a trace file which FilePrefetchPredictor can replay to measure the hit rate and wasted bytes of a budget.
+class ServicePrefetcher
+{
+public:
+	ServicePrefetcher();
+	~ServicePrefetcher();
+
+	// Observes a hydration request, returning the placeholders to prefetch after it if prefetch is enabled
+	void
+	OnResolveFile(
+		const P4VFS_SERVICE_RESOLVE_FILE_MSG& message,
+		const FileCore::String& filePath,
+		FileCore::Array<ServicePrefetchRequest>& requests
+		);
+
+	void
+	OnQueued(
+		const ServicePrefetchRequest& request
+		);
+
+	void
+	OnCanceled(
+		size_t requestCount
+		);
+
+	void
+	OnPrefetched(
+		const ServicePrefetchRequest& request,
+		HRESULT hr
+		);
+
+	void
+	LoadHistory(
+		);
+
+	// Saves the history if it has changed since it was loaded or last saved
+	void
+	SaveHistory(
+		);
+
+	ServicePrefetchStats
+	GetStats(
+		) const;
+
+	static bool
+	IsEnabled(
+		);
+
+	static FileSystem::FFilePrefetchBudget
+	GetBudget(
+		);
+
+	static size_t
+	GetMaxConcurrency(
+		);
+
+	// The number of pending and active requests of the driver at which queued prefetches are canceled
+	static size_t
+	GetCancelLoad(
+		);
+
+private:
+	void
+	AddSiblingPlaceholders(
+		const FileCore::String& filePath,
+		FileCore::StringArray& candidatePaths
+		) const;
+
+	static FileCore::String
+	GetConfiguredFilePath(
+		const FileCore::String& filePath
+		);
+
+private:
+	mutable FileCore::CriticalSection m_Lock;
+	FileSystem::FilePrefetchPredictor m_Predictor;
+	ServicePrefetchStats m_Stats;
+	FileCore::String m_HistoryFilePath;
+	bool m_HistoryChanged;
+};
+
+}}
@@ -3,6 +3,8 @@
 #pragma once
 #include "DriverData.h"
 #include "ServiceListener.h"
+#include "ServicePrefetch.h"
+#include "FileResolveCoalescer.h"
 #include "FileCore.h"
 
 namespace Microsoft {
@@ -42,6 +44,8 @@ private:
 
 		HANDLE m_DriverPort;
 		std::shared_ptr<const P4VFS_SERVICE_MSG_USER_MODE> m_Message;
+		// A prefetch task has no message and is not replied to
+		std::shared_ptr<const ServicePrefetchRequest> m_Prefetch;
 	};
 
 	struct ServiceThread
@@ -65,12 +69,15 @@ private:
 		ServiceReply(HRESULT requestResult = E_FAIL, NTSTATUS successStatus = STATUS_SUCCESS, NTSTATUS failureStatus = STATUS_UNSUCCESSFUL) :
 			m_RequestResult(requestResult),
 			m_SuccessStatus(successStatus),
-			m_FailureStatus(failureStatus)
+			m_FailureStatus(failureStatus),
+			m_IsShared(true)
 		{}
 
 		HRESULT m_RequestResult;
 		NTSTATUS m_SuccessStatus;
 		NTSTATUS m_FailureStatus;
+		// Whether the reply is also given to the requests which were attached to this one
+		bool m_IsShared;
 	};
 
 private:	
@@ -91,19 +98,64 @@ private:
 	BeginTask(
 		);
 	
+	// Ends a task, returning the requests which were attached to it. The attached requests are instead pending again if
+	// the task did not resolve its file.
 	HRESULT
 	EndTask(
-		ServiceTask* task
+		ServiceTask* task,
+		bool isResolved,
+		ServiceTaskArray& waiters
 		);
 
-	bool 
-	IsTaskReady(
-		const ServiceTask* task
+	// Attaches the pending requests of a file to the resolve which has just begun for it. Called with the task array
+	// locked.
+	void
+	AttachPendingTasks(
+		const wchar_t* dataName
+		);
+
+	void
+	ReplyToWaiters(
+		ServiceTaskArray& waiters,
+		const ServiceReply& reply
+		);
+
+	// Queues prefetch tasks to be run when no request of the driver is ready to run, unless the load of requests is
+	// already at PrefetchCancelLoad
+	HRESULT
+	SubmitPrefetch(
+		const FileCore::Array<ServicePrefetchRequest>& requests
+		);
+
+	// Removes the queued prefetch tasks of a file, or all of them if dataName is null. Called with the task array locked.
+	size_t
+	CancelPrefetchTasks(
+		const wchar_t* dataName
+		);
+
+	// The number of pending and active requests of the driver. Called with the task array locked.
+	size_t
+	GetRequestLoad(
+		) const;
+
+	size_t
+	GetActivePrefetchCount(
+		) const;
+
+	bool
+	IsDataNameQueued(
+		const wchar_t* dataName
 		) const;
 
 	ServiceReply
 	HandleResolveFileRequest(
-		const P4VFS_SERVICE_RESOLVE_FILE_MSG& message
+		const P4VFS_SERVICE_RESOLVE_FILE_MSG& message,
+		FileCore::String& residentFilePath
+		);
+
+	HRESULT
+	HandlePrefetchRequest(
+		const ServicePrefetchRequest& request
 		);
 
 	ServiceReply
@@ -118,6 +170,11 @@ private:
 		const ServiceReply& reply
 		);
 
+	static const wchar_t*
+	GetTaskDataName(
+		const ServiceTask* task
+		);
+
 	static HRESULT
 	ResolvePathFromMessage(
 		const P4VFS_SERVICE_RESOLVE_FILE_MSG& message,
@@ -131,6 +188,9 @@ private:
 	ServiceThreadArray m_Threads;
 	ServiceTaskArray m_TasksPending;
 	ServiceTaskArray m_TasksActive;
+	ServiceTaskArray m_TasksPrefetch;
+	int64_t m_PrefetchBytes;
+	FileSystem::FileResolveCoalescer<ServiceTask*> m_ResolveCoalescer;
 };
 
 }}
@@ -8,12 +8,15 @@ namespace Microsoft {
 namespace P4VFS {
 
 P4::DepotClientCache ServiceContext::m_StaticDepotClientCache;
+P4::DepotContentCache ServiceContext::m_StaticDepotContentCache;
+ServicePrefetcher ServiceContext::m_StaticPrefetcher;
 
 ServiceContext::ServiceContext(HANDLE hCancelationEvent) :
 	m_ServiceLogDevice(hCancelationEvent)
 {
 	m_LogDevice = &m_ServiceLogDevice;
 	m_DepotClientCache = &m_StaticDepotClientCache;
+	m_DepotContentCache = &m_StaticDepotContentCache;
 }
 
 }}
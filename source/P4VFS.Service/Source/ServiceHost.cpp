@@ -10,6 +10,7 @@
 #include "FileCore.h"
 #include "FileAssert.h"
 #include "SettingManager.h"
+#include "DepotTelemetry.h"
 
 using namespace Microsoft::P4VFS::ExtensionsInterop;
 using namespace Microsoft::P4VFS::FileCore;
@@ -112,6 +113,9 @@ ServiceHost::SrvMain(
 	ExtensionsInterop::InitializeServiceHost(this);
 	
 	SrvBeginTickThread();
+	ServiceContext::m_StaticDepotClientCache.Start();
+	ServiceContext::m_StaticDepotContentCache.Configure();
+	ServiceContext::m_StaticPrefetcher.LoadHistory();
 	ServiceLog::Info(TEXT("ServiceHost::SrvMain Begin"));
 
 	SrvReportStatus(SERVICE_RUNNING, NO_ERROR, 0);
@@ -122,6 +126,9 @@ ServiceHost::SrvMain(
 	}
 	
 	ServiceLog::Info(TEXT("ServiceHost::SrvMain End"));
+	ServiceContext::m_StaticDepotClientCache.Stop();
+	ServiceContext::m_StaticDepotContentCache.Close();
+	ServiceContext::m_StaticPrefetcher.SaveHistory();
 	SrvEndTickThread();
 	LogSystem::StaticInstance().Shutdown(0);
 	ExtensionsInterop::ShutdownServiceHost();
@@ -271,9 +278,48 @@ ServiceHost::GarbageCollect(
 	)
 {
 	ServiceContext::m_StaticDepotClientCache.GarbageCollect(timeout);
+
+	// The content cache follows changes to its settings, and its activity is logged as it changes
+	P4::DepotContentCache& contentCache = ServiceContext::m_StaticDepotContentCache;
+	contentCache.Configure();
+	
+	const P4::FDepotContentCacheStats contentCacheStats = contentCache.GetStats();
+	if (contentCacheStats.m_HitCount != m_SrvContentCacheStats.m_HitCount ||
+		contentCacheStats.m_MissCount != m_SrvContentCacheStats.m_MissCount ||
+		contentCacheStats.m_EvictCount != m_SrvContentCacheStats.m_EvictCount)
+	{
+		m_SrvContentCacheStats = contentCacheStats;
+		ServiceLog::Info(StringInfo::Format(TEXT("DepotContentCache '%s' %s"), contentCache.GetFolderPath().c_str(), CSTR_ATOW(contentCacheStats.ToString())).c_str());
+	}
+
+	// The prefetch history is saved as it is learned, so that it is kept if the service does not stop cleanly
+	ServicePrefetcher& prefetcher = ServiceContext::m_StaticPrefetcher;
+	prefetcher.SaveHistory();
+
+	const ServicePrefetchStats prefetchStats = prefetcher.GetStats();
+	if (prefetchStats.m_RequestCount != m_SrvPrefetchStats.m_RequestCount ||
+		prefetchStats.m_PrefetchCount != m_SrvPrefetchStats.m_PrefetchCount ||
+		prefetchStats.m_CanceledCount != m_SrvPrefetchStats.m_CanceledCount)
+	{
+		m_SrvPrefetchStats = prefetchStats;
+		ServiceLog::Info(StringInfo::Format(TEXT("ServicePrefetcher %s"), prefetchStats.ToString().c_str()).c_str());
+	}
 	return true;
 }
 
+std::string
+ServiceHost::GetCommandTelemetry(
+	bool reset
+	)
+{
+	const std::string json = P4::DepotTelemetry::ToJson(P4::DepotTelemetry::GetStats());
+	if (reset)
+	{
+		P4::DepotTelemetry::Reset();
+	}
+	return json;
+}
+
 bool
 ServiceHost::HasArgument(
 	DWORD dwNumServicesArgs,
@@ -0,0 +1,301 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+#include "Pch.h"
+#include "ServicePrefetch.h"
+#include "ServiceLog.h"
+#include "FileOperations.h"
+#include "SettingManager.h"
+
+using namespace Microsoft::P4VFS::FileCore;
+
+namespace Microsoft {
+namespace P4VFS {
+
+ServicePrefetcher::ServicePrefetcher() :
+	m_HistoryChanged(false)
+{
+}
+
+ServicePrefetcher::~ServicePrefetcher()
+{
+}
+
+void
+ServicePrefetcher::OnResolveFile(
+	const P4VFS_SERVICE_RESOLVE_FILE_MSG& message,
+	const String& filePath,
+	Array<ServicePrefetchRequest>& requests
+	)
+{
+	requests.clear();
+
+	FileSystem::FFilePrefetchTraceEntry traceEntry;
+	traceEntry.m_TimeMs = int64_t(GetTickCount64());
+	traceEntry.m_FileSize = std::max<int64_t>(0, FileInfo::FileSize(filePath.c_str()));
+	traceEntry.m_FilePath = filePath;
+
+	// The trace is written whether or not prefetch is enabled, so that a budget can be measured before it is used
+	const String traceFilePath = GetConfiguredFilePath(SettingManager::StaticInstance().PrefetchTraceFile.GetValue());
+	if (traceFilePath.empty() == false)
+	{
+		FileOperations::FileAppend(traceFilePath.c_str(), FileSystem::FilePrefetchPredictor::FormatTraceEntry(traceEntry).c_str());
+	}
+
+	if (IsEnabled() == false)
+	{
+		return;
+	}
+
+	m_Predictor.Observe(filePath, traceEntry.m_TimeMs);
+	const FileSystem::FFilePrefetchPrediction prediction = m_Predictor.Predict(filePath, traceEntry.m_TimeMs);
+	{
+		AutoCriticalSection lock(m_Lock);
+		m_Stats.m_RequestCount++;
+		m_HistoryChanged = true;
+	}
+
+	StringArray candidatePaths = prediction.m_FilePaths;
+	if (prediction.m_IsDirectoryAccess)
+	{
+		AddSiblingPlaceholders(filePath, candidatePaths);
+	}
+	if (candidatePaths.empty())
+	{
+		return;
+	}
+
+	// Only the files of the same volume can be named as the driver would name them
+	const size_t volumeNameLength = StringInfo::Strlen(message.volumeName.c_str());
+	const size_t dataNameLength = StringInfo::Strlen(message.dataName.c_str());
+	if (dataNameLength < volumeNameLength || filePath.size() < dataNameLength - volumeNameLength)
+	{
+		return;
+	}
+
+	const String volumePath = filePath.substr(0, filePath.size() - (dataNameLength - volumeNameLength));
+	const FileSystem::FFilePrefetchBudget budget = GetBudget();
+	int64_t requestBytes = 0;
+	HashSet<String> candidateKeys;
+
+	for (const String& candidatePath : candidatePaths)
+	{
+		if (requests.size() >= budget.m_MaxFiles)
+		{
+			break;
+		}
+		if (StringInfo::Stricmp(candidatePath.c_str(), filePath.c_str()) == 0 || StringInfo::StartsWith(candidatePath.c_str(), volumePath.c_str(), StringInfo::SearchCase::Insensitive) == false)
+		{
+			continue;
+		}
+		if (candidateKeys.insert(StringInfo::ToLower(candidatePath.c_str())).second == false)
+		{
+			continue;
+		}
+
+		// A file which is no longer offline is no longer a placeholder
+		WIN32_FILE_ATTRIBUTE_DATA attributes = {0};
+		if (GetFileAttributesEx(candidatePath.c_str(), GetFileExInfoStandard, &attributes) == FALSE || (attributes.dwFileAttributes & (FILE_ATTRIBUTE_OFFLINE|FILE_ATTRIBUTE_DIRECTORY)) != FILE_ATTRIBUTE_OFFLINE)
+		{
+			continue;
+		}
+
+		const int64_t fileSize = (int64_t(attributes.nFileSizeHigh) << 32) | int64_t(attributes.nFileSizeLow);
+		if (fileSize > budget.m_MaxFileSize || requestBytes + fileSize > budget.m_MaxBytes)
+		{
+			continue;
+		}
+
+		ServicePrefetchRequest request;
+		request.m_FilePath = candidatePath;
+		request.m_DataName = String(message.volumeName.c_str()) + candidatePath.substr(volumePath.size());
+		request.m_FileSize = fileSize;
+		request.m_UserContext.m_SessionId = message.sessionId;
+		request.m_UserContext.m_ProcessId = message.processId;
+		request.m_UserContext.m_ThreadId = message.threadId;
+		requests.push_back(request);
+		requestBytes += fileSize;
+	}
+}
+
+void
+ServicePrefetcher::OnQueued(
+	const ServicePrefetchRequest& request
+	)
+{
+	AutoCriticalSection lock(m_Lock);
+	m_Stats.m_QueuedCount++;
+	m_Stats.m_QueuedBytes += request.m_FileSize;
+}
+
+void
+ServicePrefetcher::OnCanceled(
+	size_t requestCount
+	)
+{
+	AutoCriticalSection lock(m_Lock);
+	m_Stats.m_CanceledCount += requestCount;
+}
+
+void
+ServicePrefetcher::OnPrefetched(
+	const ServicePrefetchRequest& request,
+	HRESULT hr
+	)
+{
+	AutoCriticalSection lock(m_Lock);
+	if (FAILED(hr))
+	{
+		m_Stats.m_FailedCount++;
+	}
+	else if (hr == S_FALSE)
+	{
+		m_Stats.m_SkippedCount++;
+	}
+	else
+	{
+		m_Stats.m_PrefetchCount++;
+		m_Stats.m_PrefetchBytes += request.m_FileSize;
+	}
+}
+
+void
+ServicePrefetcher::LoadHistory(
+	)
+{
+	const String historyFilePath = GetConfiguredFilePath(SettingManager::StaticInstance().PrefetchHistoryFile.GetValue());
+	if (IsEnabled() == false || historyFilePath.empty())
+	{
+		return;
+	}
+
+	if (FileInfo::IsRegular(historyFilePath.c_str()) && m_Predictor.Load(historyFilePath))
+	{
+		ServiceLog::Info(StringInfo::Format(TEXT("ServicePrefetcher loaded '%s' files [%Iu] links [%Iu]"), historyFilePath.c_str(), m_Predictor.GetFileCount(), m_Predictor.GetLinkCount()).c_str());
+	}
+
+	AutoCriticalSection lock(m_Lock);
+	m_HistoryFilePath = historyFilePath;
+	m_HistoryChanged = false;
+}
+
+void
+ServicePrefetcher::SaveHistory(
+	)
+{
+	String historyFilePath;
+	{
+		AutoCriticalSection lock(m_Lock);
+		if (m_HistoryChanged == false)
+		{
+			return;
+		}
+		historyFilePath = m_HistoryFilePath.size() ? m_HistoryFilePath : GetConfiguredFilePath(SettingManager::StaticInstance().PrefetchHistoryFile.GetValue());
+		m_HistoryFilePath = historyFilePath;
+		m_HistoryChanged = false;
+	}
+
+	if (historyFilePath.size() && m_Predictor.Save(historyFilePath) == false)
+	{
+		ServiceLog::Error(StringInfo::Format(TEXT("ServicePrefetcher failed to save '%s'"), historyFilePath.c_str()).c_str());
+	}
+}
+
+ServicePrefetchStats
+ServicePrefetcher::GetStats(
+	) const
+{
+	AutoCriticalSection lock(m_Lock);
+	return m_Stats;
+}
+
+bool
+ServicePrefetcher::IsEnabled(
+	)
+{
+	return SettingManager::StaticInstance().Prefetch.GetValue();
+}
+
+FileSystem::FFilePrefetchBudget
+ServicePrefetcher::GetBudget(
+	)
+{
+	const SettingManager& settings = SettingManager::StaticInstance();
+	FileSystem::FFilePrefetchBudget budget;
+	budget.m_MaxFiles = size_t(std::max<int32_t>(0, settings.PrefetchMaxFiles.GetValue()));
+	budget.m_MaxBytes = int64_t(std::max<int32_t>(0, settings.PrefetchMaxBytesMB.GetValue())) * 1024 * 1024;
+	budget.m_MaxFileSize = int64_t(std::max<int32_t>(0, settings.PrefetchMaxFileSizeMB.GetValue())) * 1024 * 1024;
+	return budget;
+}
+
+size_t
+ServicePrefetcher::GetMaxConcurrency(
+	)
+{
+	return size_t(std::max<int32_t>(0, SettingManager::StaticInstance().PrefetchMaxConcurrency.GetValue()));
+}
+
+size_t
+ServicePrefetcher::GetCancelLoad(
+	)
+{
+	return size_t(std::max<int32_t>(1, SettingManager::StaticInstance().PrefetchCancelLoad.GetValue()));
+}
+
+void
+ServicePrefetcher::AddSiblingPlaceholders(
+	const String& filePath,
+	StringArray& candidatePaths
+	) const
+{
+	const String folderPath = FileInfo::FolderPath(filePath.c_str());
+	StringArray siblingPaths;
+
+	WIN32_FIND_DATA findData = {0};
+	HANDLE hFind = FindFirstFile(StringInfo::Format(L"%s\\*", folderPath.c_str()).c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	do
+	{
+		if ((findData.dwFileAttributes & (FILE_ATTRIBUTE_OFFLINE|FILE_ATTRIBUTE_DIRECTORY)) == FILE_ATTRIBUTE_OFFLINE)
+		{
+			siblingPaths.push_back(StringInfo::Format(L"%s\\%s", folderPath.c_str(), findData.cFileName));
+		}
+	}
+	while (FindNextFile(hFind, &findData));
+	FindClose(hFind);
+
+	FileSystem::FilePrefetchPredictor::SortSiblings(siblingPaths, filePath);
+	candidatePaths.insert(candidatePaths.end(), siblingPaths.begin(), siblingPaths.end());
+}
+
+String
+ServicePrefetcher::GetConfiguredFilePath(
+	const String& filePath
+	)
+{
+	if (filePath.empty())
+	{
+		return String();
+	}
+	return FileInfo::FullPath(FileOperations::GetImpersonatedEnvironmentStrings(filePath.c_str()).c_str());
+}
+
+String
+ServicePrefetchStats::ToString(
+	) const
+{
+	return StringInfo::Format(TEXT("requests=%I64u queued=%I64u queuedBytes=%I64u prefetched=%I64u prefetchedBytes=%I64u skipped=%I64u failed=%I64u canceled=%I64u"),
+		m_RequestCount,
+		m_QueuedCount,
+		m_QueuedBytes,
+		m_PrefetchCount,
+		m_PrefetchBytes,
+		m_SkippedCount,
+		m_FailedCount,
+		m_CanceledCount);
+}
+
+}}
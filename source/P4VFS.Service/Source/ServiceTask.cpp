@@ -18,7 +18,8 @@ namespace P4VFS {
 ServiceTaskManager::ServiceTaskManager() : 
 	m_CancelationEvent(NULL),
 	m_TaskNotifySemaphore(NULL),
-	m_TaskArrayMutex(NULL)
+	m_TaskArrayMutex(NULL),
+	m_PrefetchBytes(0)
 {
 }
 
@@ -66,6 +67,10 @@ ServiceTaskManager::Shutdown()
 	Algo::ClearDelete(m_Threads);
 	Algo::ClearDelete(m_TasksPending);
 	Algo::ClearDelete(m_TasksActive);
+	Algo::ClearDelete(m_TasksPrefetch);
+
+	ServiceTaskArray waiters = m_ResolveCoalescer.Clear();
+	Algo::ClearDelete(waiters);
 
 	SafeCloseHandle(m_CancelationEvent);
 	SafeCloseHandle(m_TaskNotifySemaphore);
@@ -88,15 +93,137 @@ ServiceTaskManager::Submit(
 	
 		if (WaitForSingleObject(m_TaskArrayMutex, INFINITE) == WAIT_OBJECT_0)
 		{
-			m_TasksPending.push_back(task);
+			// A request for a file which is already being resolved is given the result of that resolve
+			const wchar_t* taskDataName = GetTaskDataName(task);
+			const bool isAttached = taskDataName != nullptr && m_ResolveCoalescer.Attach(taskDataName, task);
+			if (isAttached == false)
+			{
+				m_TasksPending.push_back(task);
+			}
+
+			// A queued prefetch of this file is no longer ahead of its request, and none are left queued under load
+			size_t canceledCount = taskDataName != nullptr ? CancelPrefetchTasks(taskDataName) : 0;
+			if (GetRequestLoad() >= ServicePrefetcher::GetCancelLoad())
+			{
+				canceledCount += CancelPrefetchTasks(nullptr);
+			}
+
 			ReleaseMutex(m_TaskArrayMutex);
-			ReleaseSemaphore(m_TaskNotifySemaphore, 1, NULL);
+			if (isAttached == false)
+			{
+				ReleaseSemaphore(m_TaskNotifySemaphore, 1, NULL);
+			}
+			if (canceledCount)
+			{
+				ServiceContext::m_StaticPrefetcher.OnCanceled(canceledCount);
+			}
 			hr = S_OK;
 		}
 	}
 	return hr;
 }
 
+HRESULT
+ServiceTaskManager::SubmitPrefetch(
+	const Array<ServicePrefetchRequest>& requests
+	)
+{
+	if (requests.empty())
+	{
+		return S_OK;
+	}
+
+	Array<const ServicePrefetchRequest*> queuedRequests;
+	if (WaitForSingleObject(m_TaskArrayMutex, INFINITE) != WAIT_OBJECT_0)
+	{
+		return E_FAIL;
+	}
+
+	if (GetRequestLoad() < ServicePrefetcher::GetCancelLoad())
+	{
+		const int64_t maxBytes = ServicePrefetcher::GetBudget().m_MaxBytes;
+		for (const ServicePrefetchRequest& request : requests)
+		{
+			if (m_PrefetchBytes + request.m_FileSize > maxBytes || IsDataNameQueued(request.m_DataName.c_str()))
+			{
+				continue;
+			}
+
+			ServiceTask* task = new ServiceTask();
+			task->m_Prefetch = std::make_shared<ServicePrefetchRequest>(request);
+			m_TasksPrefetch.push_back(task);
+			m_PrefetchBytes += request.m_FileSize;
+			queuedRequests.push_back(&request);
+		}
+	}
+
+	ReleaseMutex(m_TaskArrayMutex);
+	if (queuedRequests.size())
+	{
+		ReleaseSemaphore(m_TaskNotifySemaphore, LONG(queuedRequests.size()), NULL);
+	}
+	for (const ServicePrefetchRequest* request : queuedRequests)
+	{
+		ServiceContext::m_StaticPrefetcher.OnQueued(*request);
+	}
+	return S_OK;
+}
+
+size_t
+ServiceTaskManager::CancelPrefetchTasks(
+	const wchar_t* dataName
+	)
+{
+	size_t canceledCount = 0;
+	for (ServiceTaskArray::iterator prefetchIt = m_TasksPrefetch.begin(); prefetchIt != m_TasksPrefetch.end();)
+	{
+		ServiceTask* prefetchTask = *prefetchIt;
+		if (dataName == nullptr || StringInfo::Stricmp(dataName, prefetchTask->m_Prefetch->m_DataName.c_str()) == 0)
+		{
+			m_PrefetchBytes -= prefetchTask->m_Prefetch->m_FileSize;
+			prefetchIt = m_TasksPrefetch.erase(prefetchIt);
+			delete prefetchTask;
+			++canceledCount;
+		}
+		else
+		{
+			++prefetchIt;
+		}
+	}
+	return canceledCount;
+}
+
+size_t
+ServiceTaskManager::GetRequestLoad(
+	) const
+{
+	return m_TasksPending.size() + m_TasksActive.size() + m_ResolveCoalescer.GetWaiterCount() - GetActivePrefetchCount();
+}
+
+size_t
+ServiceTaskManager::GetActivePrefetchCount(
+	) const
+{
+	return size_t(std::count_if(m_TasksActive.begin(), m_TasksActive.end(), [](const ServiceTask* task) -> bool { return task->m_Prefetch.get() != nullptr; }));
+}
+
+bool
+ServiceTaskManager::IsDataNameQueued(
+	const wchar_t* dataName
+	) const
+{
+	for (const ServiceTaskArray* tasks : { &m_TasksPending, &m_TasksActive, &m_TasksPrefetch })
+	{
+		for (const ServiceTask* task : *tasks)
+		{
+			const wchar_t* taskDataName = GetTaskDataName(task);
+			if (taskDataName != nullptr && StringInfo::Stricmp(dataName, taskDataName) == 0)
+				return true;
+		}
+	}
+	return false;
+}
+
 DWORD 
 ServiceTaskManager::ServiceTaskThreadEntry(
 	void* data
@@ -120,54 +247,152 @@ ServiceTaskManager::BeginTask(
 	ServiceTask* result = nullptr;
 	if (WaitForSingleObject(m_TaskArrayMutex, INFINITE) == WAIT_OBJECT_0)
 	{
-		for (ServiceTaskArray::iterator pendingIt = m_TasksPending.begin(); pendingIt != m_TasksPending.end(); ++pendingIt)
+		while (result == nullptr && m_TasksPending.size())
 		{
-			ServiceTask* pendingTask = *pendingIt;
-			if (IsTaskReady(pendingTask))
+			ServiceTask* pendingTask = m_TasksPending.front();
+			m_TasksPending.erase(m_TasksPending.begin());
+
+			// A pending request is attached instead if its file has begun to be resolved since it was submitted
+			const wchar_t* pendingDataName = GetTaskDataName(pendingTask);
+			if (pendingDataName == nullptr || m_ResolveCoalescer.Begin(pendingDataName, pendingTask))
 			{
-				m_TasksPending.erase(pendingIt);
+				if (pendingDataName != nullptr)
+				{
+					AttachPendingTasks(pendingDataName);
+				}
 				m_TasksActive.push_back(pendingTask);
 				result = pendingTask;
-				break;
+			}
+		}
+
+		// A prefetch only runs when no request of the driver is ready, and within its own concurrency limit. A prefetch
+		// of a file which is already being resolved is not needed.
+		size_t canceledCount = 0;
+		while (result == nullptr && m_TasksPrefetch.size() && GetActivePrefetchCount() < ServicePrefetcher::GetMaxConcurrency())
+		{
+			ServiceTask* prefetchTask = m_TasksPrefetch.front();
+			m_TasksPrefetch.erase(m_TasksPrefetch.begin());
+
+			const wchar_t* prefetchDataName = GetTaskDataName(prefetchTask);
+			if (m_ResolveCoalescer.IsResolving(prefetchDataName) == false && m_ResolveCoalescer.Begin(prefetchDataName, prefetchTask))
+			{
+				m_TasksActive.push_back(prefetchTask);
+				result = prefetchTask;
+			}
+			else
+			{
+				m_PrefetchBytes -= prefetchTask->m_Prefetch->m_FileSize;
+				delete prefetchTask;
+				++canceledCount;
 			}
 		}
 		ReleaseMutex(m_TaskArrayMutex);
+
+		if (canceledCount)
+		{
+			ServiceContext::m_StaticPrefetcher.OnCanceled(canceledCount);
+		}
 	}
 	return result;
 }
 	
 HRESULT
 ServiceTaskManager::EndTask(
-	ServiceTask* task
+	ServiceTask* task,
+	bool isResolved,
+	ServiceTaskArray& waiters
 	)
 {
 	HRESULT result = E_FAIL;
+	waiters.clear();
 	if (WaitForSingleObject(m_TaskArrayMutex, INFINITE) == WAIT_OBJECT_0)
 	{
 		Algo::Remove(m_TasksActive, task);
+		const wchar_t* taskDataName = GetTaskDataName(task);
+		if (taskDataName != nullptr)
+		{
+			waiters = m_ResolveCoalescer.End(taskDataName);
+		}
+
+		// The attached requests are resolved on their own, ahead of any request submitted after them
+		const size_t requeueCount = isResolved ? 0 : waiters.size();
+		if (requeueCount)
+		{
+			m_TasksPending.insert(m_TasksPending.begin(), waiters.begin(), waiters.end());
+			waiters.clear();
+		}
+
+		if (task->m_Prefetch.get() != nullptr)
+		{
+			m_PrefetchBytes -= task->m_Prefetch->m_FileSize;
+		}
 		delete task;
+
+		// A queued prefetch may have been held back by this task
+		const size_t releaseCount = requeueCount + (m_TasksPrefetch.size() ? 1 : 0);
 		ReleaseMutex(m_TaskArrayMutex);
+		if (releaseCount)
+		{
+			ReleaseSemaphore(m_TaskNotifySemaphore, LONG(releaseCount), NULL);
+		}
 		result = S_OK;
 	}
 	return result;
 }
 
-bool 
-ServiceTaskManager::IsTaskReady(
-	const ServiceTask* task
-	) const
+void
+ServiceTaskManager::AttachPendingTasks(
+	const wchar_t* dataName
+	)
 {
-	if (task->m_Message->m_driverRequest.operation == P4VFS_SERVICE_RESOLVE_FILE)
+	for (ServiceTaskArray::iterator pendingIt = m_TasksPending.begin(); pendingIt != m_TasksPending.end();)
 	{
-		const wchar_t* taskDataName = task->m_Message->m_driverRequest.resolveFile.dataName.c_str();
-		for (const ServiceTask* taskActive : m_TasksActive)
+		const wchar_t* pendingDataName = GetTaskDataName(*pendingIt);
+		if (pendingDataName != nullptr && StringInfo::Stricmp(dataName, pendingDataName) == 0 && m_ResolveCoalescer.Attach(pendingDataName, *pendingIt))
+		{
+			pendingIt = m_TasksPending.erase(pendingIt);
+		}
+		else
 		{
-			// The task is not ready if it's file is currently being processed by another task!
-			if (StringInfo::Stricmp(taskDataName, taskActive->m_Message->m_driverRequest.resolveFile.dataName.c_str()) == 0)
-				return false;
+			++pendingIt;
 		}
 	}
-	return true;
+}
+
+void
+ServiceTaskManager::ReplyToWaiters(
+	ServiceTaskArray& waiters,
+	const ServiceReply& reply
+	)
+{
+	for (ServiceTask* waiter : waiters)
+	{
+		// The result is not given to a process which would not have been allowed to resolve the file itself
+		const P4VFS_SERVICE_RESOLVE_FILE_MSG& message = waiter->m_Message->m_driverRequest.resolveFile;
+		if (FileSystem::IsExcludedProcessId(message.processId))
+		{
+			ServiceLog::Verbose(StringInfo::Format(TEXT("HandleResolveFileRequest Ignoring '%s' process [%d.%d]"), message.dataName.c_str(), message.processId, message.threadId).c_str());
+			ReplyToDriver(waiter->m_DriverPort, *waiter->m_Message, ServiceReply(E_FAIL, STATUS_ACCESS_DENIED));
+		}
+		else
+		{
+			ServiceLog::Verbose(StringInfo::Format(TEXT("HandleResolveFileRequest Coalesced '%s' process [%d.%d]"), message.dataName.c_str(), message.processId, message.threadId).c_str());
+			ReplyToDriver(waiter->m_DriverPort, *waiter->m_Message, reply);
+		}
+	}
+	Algo::ClearDelete(waiters);
+}
+
+const wchar_t*
+ServiceTaskManager::GetTaskDataName(
+	const ServiceTask* task
+	)
+{
+	if (task->m_Prefetch.get() != nullptr)
+		return task->m_Prefetch->m_DataName.c_str();
+	if (task->m_Message.get() != nullptr && task->m_Message->m_driverRequest.operation == P4VFS_SERVICE_RESOLVE_FILE)
+		return task->m_Message->m_driverRequest.resolveFile.dataName.c_str();
+	return nullptr;
 }
 
 DWORD
@@ -188,11 +413,22 @@ ServiceTaskManager::UpdateServiceTasks(
 			if (task == nullptr)
 				break;
 
+			// Requests which arrive during a prefetch are only given its result if it hydrated the file
+			ServiceTaskArray waiters;
+			if (task->m_Prefetch.get() != nullptr)
+			{
+				const HRESULT prefetchResult = HandlePrefetchRequest(*task->m_Prefetch);
+				EndTask(task, prefetchResult == S_OK, waiters);
+				ReplyToWaiters(waiters, ServiceReply(S_OK, STATUS_SUCCESS));
+				continue;
+			}
+
 			ServiceReply reply;
+			String residentFilePath;
 			switch (task->m_Message->m_driverRequest.operation)
 			{
 				case P4VFS_SERVICE_RESOLVE_FILE:
-					reply = HandleResolveFileRequest(task->m_Message->m_driverRequest.resolveFile);
+					reply = HandleResolveFileRequest(task->m_Message->m_driverRequest.resolveFile, residentFilePath);
 					break;
 				case P4VFS_SERVICE_LOG_WRITE:
 					reply = HandleLogWriteRequest(task->m_Message->m_driverRequest.logWrite);
@@ -200,7 +436,17 @@ ServiceTaskManager::UpdateServiceTasks(
 			}
 
 			ReplyToDriver(task->m_DriverPort, *task->m_Message, reply);
-			EndTask(task);
+			const std::shared_ptr<const P4VFS_SERVICE_MSG_USER_MODE> message = task->m_Message;
+			EndTask(task, reply.m_IsShared, waiters);
+			ReplyToWaiters(waiters, reply);
+
+			// The files likely to be requested next are chosen once the request itself has been replied to
+			if (residentFilePath.size())
+			{
+				Array<ServicePrefetchRequest> prefetchRequests;
+				ServiceContext::m_StaticPrefetcher.OnResolveFile(message->m_driverRequest.resolveFile, residentFilePath, prefetchRequests);
+				SubmitPrefetch(prefetchRequests);
+			}
 		}
 	}
 	return 0;
@@ -208,13 +454,16 @@ ServiceTaskManager::UpdateServiceTasks(
 
 ServiceTaskManager::ServiceReply
 ServiceTaskManager::HandleResolveFileRequest(
-	const P4VFS_SERVICE_RESOLVE_FILE_MSG& message
+	const P4VFS_SERVICE_RESOLVE_FILE_MSG& message,
+	FileCore::String& residentFilePath
 	)
 {
 	if (FileSystem::IsExcludedProcessId(message.processId))
 	{
 		ServiceLog::Verbose(StringInfo::Format(TEXT("HandleResolveFileRequest Ignoring '%s' process [%d.%d]"), message.dataName.c_str(), message.processId, message.threadId).c_str());
-		return ServiceReply(E_FAIL, STATUS_ACCESS_DENIED);
+		ServiceReply reply(E_FAIL, STATUS_ACCESS_DENIED);
+		reply.m_IsShared = false;
+		return reply;
 	}
 
 	ServiceLog::Verbose(StringInfo::Format(TEXT("HandleResolveFileRequest Start '%s' process [%d.%d]"), message.dataName.c_str(), message.processId, message.threadId).c_str());
@@ -255,6 +504,11 @@ ServiceTaskManager::HandleResolveFileRequest(
 		ServiceLog::Error(StringInfo::Format(TEXT("HandleResolveFileRequest Failed to revert back to self for file '%s' process [%d.%d] error [%s]"), localFileToMakeResident.c_str(), message.processId, message.threadId, StringInfo::ToString(HRESULT_FROM_WIN32(GetLastError())).c_str()).c_str());
 	}
 
+	if (SUCCEEDED(hr) && fileResidencyPolicy == P4VFS_RESIDENCY_POLICY_RESIDENT)
+	{
+		residentFilePath = localFileToMakeResident;
+	}
+
 	NTSTATUS successStatus = STATUS_SUCCESS;
 	if (fileResidencyPolicy == P4VFS_RESIDENCY_POLICY_SYMLINK)
 		successStatus = STATUS_RETRY;
@@ -265,6 +519,33 @@ ServiceTaskManager::HandleResolveFileRequest(
 	return ServiceReply(hr, successStatus);
 }
 
+HRESULT
+ServiceTaskManager::HandlePrefetchRequest(
+	const ServicePrefetchRequest& request
+	)
+{
+	// A prefetch is hydrated at background priority, as the user whose request it follows
+	SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+	FileCore::UserContext userContext = request.m_UserContext;
+	HRESULT hr = FileOperations::ImpersonateLoggedOnUser(&userContext);
+	if (SUCCEEDED(hr))
+	{
+		ServiceContext serviceContext(m_CancelationEvent);
+		serviceContext.m_UserContext = &userContext;
+		hr = FileSystem::PrefetchFileResidency(serviceContext, request.m_FilePath.c_str());
+
+		if (RevertToSelf() == FALSE)
+		{
+			ServiceLog::Error(StringInfo::Format(TEXT("HandlePrefetchRequest Failed to revert back to self for file '%s' error [%s]"), request.m_FilePath.c_str(), StringInfo::ToString(HRESULT_FROM_WIN32(GetLastError())).c_str()).c_str());
+		}
+	}
+
+	SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+	ServiceContext::m_StaticPrefetcher.OnPrefetched(request, hr);
+	return hr;
+}
+
 ServiceTaskManager::ServiceReply
 ServiceTaskManager::HandleLogWriteRequest(
 	const P4VFS_SERVICE_LOG_WRITE_MSG& message
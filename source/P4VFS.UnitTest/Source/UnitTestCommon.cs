@@ -771,6 +771,11 @@ namespace Microsoft.P4VFS.UnitTest
 				Assert(depotClient.Sync(String.Format("{0}\\...", srcFolder), new DepotRevisionChangelist(Int32.Parse(srcRevision)), DepotSyncFlags.Normal, DepotSyncMethod.Virtual, DepotFlushType.Atomic)?.Status == DepotSyncStatus.Success);
 				Assert(DepotOperations.Hydrate(depotClient, new DepotSyncOptions{ Files=new[]{ String.Format("{0}\\...", srcFolder) } })?.Status == DepotSyncStatus.Success);
 				verifyResidentFiles(true);
+
+				WorkspaceReset();
+				Assert(depotClient.Sync(String.Format("{0}\\...", srcFolder), new DepotRevisionChangelist(Int32.Parse(srcRevision)), DepotSyncFlags.Normal, DepotSyncMethod.Virtual, DepotFlushType.Atomic)?.Status == DepotSyncStatus.Success);
+				Assert(ProcessInfo.ExecuteWait(P4vfsExe, String.Format("{0} hydrate -b 4 \"{1}\\...\"", ClientConfig, srcFolder), echo:true, log:true) == 0);
+				verifyResidentFiles(true);
 			}
 
 			foreach (string syncOption in EnumerateCommonConsoleSyncOptions())